@@ -35,6 +35,7 @@
 #endif
 #include "simplesslerrorhandler.h"
 #include "syncengine.h"
+#include "common/metrics.h"
 #include "common/syncjournaldb.h"
 #include "config.h"
 #include "csync_exclude.h"
@@ -76,8 +77,10 @@ struct CmdOptions
     bool useNetrc = false;
     bool interactive = false;
     bool ignoreHiddenFiles = false;
+    bool logDebug = false;
     QString exclude;
     QString unsyncedfolders;
+    QString metricsFile;
     int restartTimes = 0;
     int downlimit = 0;
     int uplimit = 0;
@@ -189,6 +192,7 @@ void help()
     std::cout << "  --max-sync-retries [n] Retries maximum n times (default to 3)" << std::endl;
     std::cout << "  --uplimit [n]          Limit the upload speed of files to n KB/s" << std::endl;
     std::cout << "  --downlimit [n]        Limit the download speed of files to n KB/s" << std::endl;
+    std::cout << "  --metrics [file]       Write the sync metrics in the OpenMetrics text format to [file]" << std::endl;
     std::cout << "  -h                     Sync hidden files, do not ignore them" << std::endl;
     std::cout << "  --version, -v          Display version and exit" << std::endl;
     std::cout << "  --logdebug             More verbose logging" << std::endl;
@@ -266,9 +270,12 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
             options->uplimit = it.next().toInt() * 1000;
         } else if (option == "--downlimit" && !it.peekNext().startsWith("-")) {
             options->downlimit = it.next().toInt() * 1000;
+        } else if (option == "--metrics" && !it.peekNext().startsWith("-")) {
+            options->metricsFile = it.next();
         } else if (option == "--logdebug") {
             Logger::instance()->setLogFile("-");
             Logger::instance()->setLogDebug(true);
+            options->logDebug = true;
         } else if (option == "--path" && !it.peekNext().startsWith("-")) {
             options->remotePath = it.next();
         }
@@ -334,6 +341,10 @@ int main(int argc, char **argv)
 
     if (options.silent) {
         qInstallMessageHandler(nullMessageHandler);
+    } else if (options.logDebug) {
+        // The Logger formats the time itself
+        Logger::instance()->setLogPattern(QStringLiteral("MM-dd hh:mm:ss:zzz"),
+                                          QStringLiteral("[ %{type} %{category} ]%{if-debug}\t[ %{function} ]%{endif}:\t%{message}"));
     } else {
         qSetMessagePattern("%{time MM-dd hh:mm:ss:zzz} [ %{type} %{category} ]%{if-debug}\t[ %{function} ]%{endif}:\t%{message}");
     }
@@ -568,6 +579,10 @@ restart_sync:
 
     int resultCode = app.exec();
 
+    if (!options.metricsFile.isEmpty()) {
+        MetricsRegistry::instance().writeOpenMetrics(options.metricsFile);
+    }
+
     if (engine.isAnotherSyncNeeded() != NoFollowUpSync) {
         if (restartCount < options.restartTimes) {
             restartCount++;
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include <iostream>
+#include <qcoreapplication.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+#include "common/synctrace.h"
+
+using namespace OCC;
+
+/* Converts a trace written with OWNCLOUD_SYNC_TRACE set into the JSON
+ * trace event format, which chrome://tracing and ui.perfetto.dev open.
+ */
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    const auto args = app.arguments();
+    if (args.size() < 2 || args.size() > 3 || args.at(1) == QLatin1String("--help") || args.at(1) == QLatin1String("-h")) {
+        std::cout << "Usage: " << qPrintable(QFileInfo(args.at(0)).fileName()) << " <sync trace> [<output json>]" << std::endl;
+        std::cout << "Converts a sync trace into the JSON trace event format. Writes to stdout if no output is given." << std::endl;
+        return args.size() == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    QFile trace(args.at(1));
+    if (!trace.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not open " << qPrintable(trace.fileName()) << ": " << qPrintable(trace.errorString()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    QFile json;
+    auto opened = false;
+    if (args.size() == 3) {
+        json.setFileName(args.at(2));
+        opened = json.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = json.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        std::cerr << "Could not open " << qPrintable(json.fileName()) << " for writing: " << qPrintable(json.errorString()) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    QString error;
+    if (!SyncTrace::convertToChromeTrace(&trace, &json, &error)) {
+        std::cerr << qPrintable(trace.fileName()) << ": " << qPrintable(error) << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
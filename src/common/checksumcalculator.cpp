@@ -13,12 +13,16 @@
  */
 #include "checksumcalculator.h"
 
-#include <zlib.h>
+#include "checksumkernels.h"
+#include "metrics.h"
+#include "synctrace.h"
 
-#include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLoggingCategory>
 
+#include <openssl/evp.h>
+
 namespace
 {
 constexpr qint64 bufSize = 500 * 1024;
@@ -28,40 +32,56 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcChecksumCalculator, "nextcloud.common.checksumcalculator", QtInfoMsg)
 
-static QCryptographicHash::Algorithm algorithmTypeToQCryptoHashAlgorithm(ChecksumCalculator::AlgorithmType algorithmType)
+static const EVP_MD *algorithmTypeToEvpMd(ChecksumCalculator::AlgorithmType algorithmType)
 {
     switch (algorithmType) {
     case ChecksumCalculator::AlgorithmType::Undefined:
     case ChecksumCalculator::AlgorithmType::Adler32:
         qCWarning(lcChecksumCalculator) << "Invalid algorithm type" << static_cast<int>(algorithmType);
-        return static_cast<QCryptographicHash::Algorithm>(-1);
+        return nullptr;
     case ChecksumCalculator::AlgorithmType::MD5:
-        return QCryptographicHash::Algorithm::Md5;
+        return EVP_md5();
     case ChecksumCalculator::AlgorithmType::SHA1:
-        return QCryptographicHash::Algorithm::Sha1;
+        return EVP_sha1();
     case ChecksumCalculator::AlgorithmType::SHA256:
-        return QCryptographicHash::Algorithm::Sha256;
+        return EVP_sha256();
     case ChecksumCalculator::AlgorithmType::SHA3_256:
-        return QCryptographicHash::Algorithm::Sha3_256;
+        return EVP_sha3_256();
     }
-    return static_cast<QCryptographicHash::Algorithm>(-1);
+    return nullptr;
 }
 
-ChecksumCalculator::ChecksumCalculator(const QString &filePath, const QByteArray &checksumTypeName)
-    : _device(new QFile(filePath))
+static ChecksumCalculator::AlgorithmType checksumTypeNameToAlgorithmType(const QByteArray &checksumTypeName)
 {
     if (checksumTypeName == checkSumMD5C) {
-        _algorithmType = AlgorithmType::MD5;
+        return ChecksumCalculator::AlgorithmType::MD5;
     } else if (checksumTypeName == checkSumSHA1C) {
-        _algorithmType = AlgorithmType::SHA1;
+        return ChecksumCalculator::AlgorithmType::SHA1;
     } else if (checksumTypeName == checkSumSHA2C) {
-        _algorithmType = AlgorithmType::SHA256;
+        return ChecksumCalculator::AlgorithmType::SHA256;
     } else if (checksumTypeName == checkSumSHA3C) {
-        _algorithmType = AlgorithmType::SHA3_256;
+        return ChecksumCalculator::AlgorithmType::SHA3_256;
     } else if (checksumTypeName == checkSumAdlerC) {
-        _algorithmType = AlgorithmType::Adler32;
+        return ChecksumCalculator::AlgorithmType::Adler32;
     }
+    return ChecksumCalculator::AlgorithmType::Undefined;
+}
+
+void ChecksumCalculator::EvpContextDeleter::operator()(evp_md_ctx_st *context) const
+{
+    EVP_MD_CTX_free(context);
+}
+
+ChecksumCalculator::ChecksumCalculator(const QString &filePath, const QByteArray &checksumTypeName)
+    : _device(new QFile(filePath))
+    , _algorithmType(checksumTypeNameToAlgorithmType(checksumTypeName))
+{
+    initChecksumAlgorithm();
+}
 
+ChecksumCalculator::ChecksumCalculator(const QByteArray &checksumTypeName)
+    : _algorithmType(checksumTypeNameToAlgorithmType(checksumTypeName))
+{
     initChecksumAlgorithm();
 }
 
@@ -77,10 +97,14 @@ QByteArray ChecksumCalculator::calculate()
 {
     QByteArray result;
 
-    if (!_isInitialized) {
+    if (!_isInitialized || !_device) {
         return result;
     }
 
+    const auto file = qobject_cast<QFile *>(_device.data());
+    SyncTraceScope traceScope(SyncTrace::Category::Checksum, "checksum",
+                              SyncTrace::isEnabled() && file ? file->fileName() : QString());
+
     Q_ASSERT(!_device->isOpen());
     if (_device->isOpen()) {
         qCWarning(lcChecksumCalculator) << "Device already open. Ignoring.";
@@ -95,6 +119,9 @@ QByteArray ChecksumCalculator::calculate()
         return result;
     }
 
+    QElapsedTimer duration;
+    duration.start();
+    qint64 bytesRead = 0;
     for (;;) {
         QMutexLocker locker(&_deviceMutex);
         if (!_device->isOpen() || _device->atEnd()) {
@@ -109,10 +136,13 @@ QByteArray ChecksumCalculator::calculate()
         if (sizeRead <= 0) {
             break;
         }
-        if (!addChunk(buf, sizeRead)) {
+        if (!addData(buf.constData(), sizeRead)) {
             break;
         }
+        bytesRead += sizeRead;
     }
+    SyncMetrics::checksumBytes().add(bytesRead);
+    SyncMetrics::checksumDuration().observe(std::chrono::nanoseconds(duration.nsecsElapsed()));
 
     {
         QMutexLocker locker(&_deviceMutex);
@@ -121,14 +151,7 @@ QByteArray ChecksumCalculator::calculate()
         }
     }
 
-    if (_algorithmType == AlgorithmType::Adler32) {
-        result = QByteArray::number(_adlerHash, 16);
-    } else {
-        Q_ASSERT(_cryptographicHash);
-        if (_cryptographicHash) {
-            result = _cryptographicHash->result().toHex();
-        }
-    }
+    result = this->result();
 
     {
         QMutexLocker locker(&_deviceMutex);
@@ -148,15 +171,21 @@ void ChecksumCalculator::initChecksumAlgorithm()
     }
 
     if (_algorithmType == AlgorithmType::Adler32) {
-        _adlerHash = adler32(0L, Z_NULL, 0);
+        _adlerHash = 1; // initial Adler-32 value, same as adler32(0, Z_NULL, 0)
+        qCDebug(lcChecksumCalculator) << "Adler-32 kernel:" << ChecksumKernels::adler32KernelName();
     } else {
-        _cryptographicHash.reset(new QCryptographicHash(algorithmTypeToQCryptoHashAlgorithm(_algorithmType)));
+        _evpContext.reset(EVP_MD_CTX_new());
+        if (!_evpContext || EVP_DigestInit_ex(_evpContext.get(), algorithmTypeToEvpMd(_algorithmType), nullptr) != 1) {
+            qCWarning(lcChecksumCalculator) << "Could not initialize digest for algorithm type" << static_cast<int>(_algorithmType);
+            _evpContext.reset();
+            return;
+        }
     }
 
     _isInitialized = true;
 }
 
-bool ChecksumCalculator::addChunk(const QByteArray &chunk, const qint64 size)
+bool ChecksumCalculator::addData(const char *data, qint64 size)
 {
     Q_ASSERT(_algorithmType != AlgorithmType::Undefined);
     if (_algorithmType == AlgorithmType::Undefined) {
@@ -165,16 +194,40 @@ bool ChecksumCalculator::addChunk(const QByteArray &chunk, const qint64 size)
     }
 
     if (_algorithmType == AlgorithmType::Adler32) {
-        _adlerHash = adler32(_adlerHash, (const Bytef *)chunk.data(), size);
+        _adlerHash = ChecksumKernels::adler32(_adlerHash, data, size);
         return true;
     } else {
-        Q_ASSERT(_cryptographicHash);
-        if (_cryptographicHash) {
-            _cryptographicHash->addData(chunk.data(), size);
-            return true;
+        Q_ASSERT(_evpContext);
+        if (_evpContext) {
+            return EVP_DigestUpdate(_evpContext.get(), data, static_cast<size_t>(size)) == 1;
         }
     }
     return false;
 }
 
+QByteArray ChecksumCalculator::result()
+{
+    if (!_isInitialized) {
+        return {};
+    }
+
+    if (_algorithmType == AlgorithmType::Adler32) {
+        return QByteArray::number(_adlerHash, 16);
+    }
+
+    Q_ASSERT(_evpContext);
+    if (!_evpContext) {
+        return {};
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    if (EVP_DigestFinal_ex(_evpContext.get(), digest, &digestLength) != 1) {
+        qCWarning(lcChecksumCalculator) << "Could not finalize digest for algorithm type" << static_cast<int>(_algorithmType);
+        return {};
+    }
+    _evpContext.reset();
+    _isInitialized = false;
+    return QByteArray(reinterpret_cast<const char *>(digest), static_cast<int>(digestLength)).toHex();
+}
+
 }
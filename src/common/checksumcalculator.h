@@ -24,9 +24,19 @@
 #include <QMutex>
 #include <QScopedPointer>
 
-class QCryptographicHash;
+#include <memory>
+
+struct evp_md_ctx_st;
 
 namespace OCC {
+
+/**
+ * Computes a checksum either over a whole file (calculate()) or incrementally
+ * over data handed in through addData() (result()).
+ *
+ * Adler-32 uses the vectorized ChecksumKernels, the cryptographic hashes go
+ * through OpenSSL's EVP interface which picks SHA-NI/AVX2 code paths at runtime.
+ */
 class OCSYNC_EXPORT ChecksumCalculator
 {
     Q_DISABLE_COPY(ChecksumCalculator)
@@ -42,15 +52,30 @@ public:
     };
 
     ChecksumCalculator(const QString &filePath, const QByteArray &checksumTypeName);
+    /// Creates a calculator without a file, feed it with addData()
+    explicit ChecksumCalculator(const QByteArray &checksumTypeName);
     ~ChecksumCalculator();
     [[nodiscard]] QByteArray calculate();
 
+    [[nodiscard]] bool isValid() const { return _isInitialized; }
+    [[nodiscard]] AlgorithmType algorithmType() const { return _algorithmType; }
+
+    /// Adds \a size bytes of \a data to the running checksum
+    bool addData(const char *data, qint64 size);
+
+    /// Finalizes the running checksum and returns it hex encoded
+    [[nodiscard]] QByteArray result();
+
 private:
+    struct EvpContextDeleter
+    {
+        void operator()(evp_md_ctx_st *context) const;
+    };
+
     void initChecksumAlgorithm();
-    bool addChunk(const QByteArray &chunk, const qint64 size);
     QScopedPointer<QIODevice> _device;
-    QScopedPointer<QCryptographicHash> _cryptographicHash;
-    unsigned int _adlerHash = 0;
+    std::unique_ptr<evp_md_ctx_st, EvpContextDeleter> _evpContext;
+    quint32 _adlerHash = 0;
     bool _isInitialized = false;
     AlgorithmType _algorithmType = AlgorithmType::Undefined;
     QMutex _deviceMutex;
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "checksumkernels.h"
+
+#include <zlib.h>
+
+#include <QLoggingCategory>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OCC_CHECKSUM_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+constexpr uint32_t adlerBase = 65521;
+// largest n such that 255n(n+1)/2 + (n+1)(adlerBase-1) <= 2^32-1
+constexpr size_t adlerNMax = 5552;
+constexpr size_t adlerBlockSize = 32;
+
+using Adler32Kernel = uint32_t (*)(uint32_t adler, const unsigned char *data, size_t size);
+
+uint32_t adler32Zlib(uint32_t adler, const unsigned char *data, size_t size)
+{
+    // zlib takes an uInt length, feed it in pieces it can digest
+    while (size > 0) {
+        const auto chunk = static_cast<uInt>(qMin<size_t>(size, 1u << 30));
+        adler = static_cast<uint32_t>(::adler32(adler, data, chunk));
+        data += chunk;
+        size -= chunk;
+    }
+    return adler;
+}
+
+#ifdef OCC_CHECKSUM_KERNELS_X86
+uint32_t adler32Tail(uint32_t s1, uint32_t s2, const unsigned char *data, size_t size)
+{
+    // only ever called with less than adlerBlockSize bytes
+    while (size--) {
+        s1 += *data++;
+        s2 += s1;
+    }
+    return (s1 % adlerBase) | ((s2 % adlerBase) << 16);
+}
+
+/*
+ * Both vector kernels process blocks of 32 bytes: s1 is the plain byte sum
+ * (psadbw), s2 the byte sum weighted with 32..1 (pmaddubsw) plus 32 times the
+ * s1 value of every preceding block. The modulo is applied every adlerNMax bytes.
+ */
+__attribute__((target("ssse3"))) uint32_t adler32Ssse3(uint32_t adler, const unsigned char *data, size_t size)
+{
+    auto s1 = adler & 0xffff;
+    auto s2 = adler >> 16;
+    auto blocks = size / adlerBlockSize;
+    size -= blocks * adlerBlockSize;
+
+    const auto tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const auto tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const auto zero = _mm_setzero_si128();
+    const auto ones = _mm_set1_epi16(1);
+
+    while (blocks > 0) {
+        auto n = qMin(blocks, adlerNMax / adlerBlockSize);
+        blocks -= n;
+
+        auto previousSums = _mm_set_epi32(0, 0, 0, static_cast<int>(s1 * n));
+        auto vS2 = _mm_set_epi32(0, 0, 0, static_cast<int>(s2));
+        auto vS1 = _mm_setzero_si128();
+        do {
+            const auto bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            const auto bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+            previousSums = _mm_add_epi32(previousSums, vS1);
+            vS1 = _mm_add_epi32(vS1, _mm_sad_epu8(bytes1, zero));
+            vS2 = _mm_add_epi32(vS2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            vS1 = _mm_add_epi32(vS1, _mm_sad_epu8(bytes2, zero));
+            vS2 = _mm_add_epi32(vS2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            data += adlerBlockSize;
+        } while (--n);
+        vS2 = _mm_add_epi32(vS2, _mm_slli_epi32(previousSums, 5));
+
+        vS1 = _mm_add_epi32(vS1, _mm_shuffle_epi32(vS1, _MM_SHUFFLE(2, 3, 0, 1)));
+        vS1 = _mm_add_epi32(vS1, _mm_shuffle_epi32(vS1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += static_cast<uint32_t>(_mm_cvtsi128_si32(vS1));
+        vS2 = _mm_add_epi32(vS2, _mm_shuffle_epi32(vS2, _MM_SHUFFLE(2, 3, 0, 1)));
+        vS2 = _mm_add_epi32(vS2, _mm_shuffle_epi32(vS2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(vS2));
+
+        s1 %= adlerBase;
+        s2 %= adlerBase;
+    }
+    return adler32Tail(s1, s2, data, size);
+}
+
+__attribute__((target("avx2"))) uint32_t adler32Avx2(uint32_t adler, const unsigned char *data, size_t size)
+{
+    auto s1 = adler & 0xffff;
+    auto s2 = adler >> 16;
+    auto blocks = size / adlerBlockSize;
+    size -= blocks * adlerBlockSize;
+
+    const auto tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const auto zero = _mm256_setzero_si256();
+    const auto ones = _mm256_set1_epi16(1);
+
+    while (blocks > 0) {
+        auto n = qMin(blocks, adlerNMax / adlerBlockSize);
+        blocks -= n;
+
+        auto previousSums = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, static_cast<int>(s1 * n));
+        auto vS2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, static_cast<int>(s2));
+        auto vS1 = _mm256_setzero_si256();
+        do {
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+            previousSums = _mm256_add_epi32(previousSums, vS1);
+            vS1 = _mm256_add_epi32(vS1, _mm256_sad_epu8(bytes, zero));
+            vS2 = _mm256_add_epi32(vS2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+            data += adlerBlockSize;
+        } while (--n);
+        vS2 = _mm256_add_epi32(vS2, _mm256_slli_epi32(previousSums, 5));
+
+        auto sumS1 = _mm_add_epi32(_mm256_castsi256_si128(vS1), _mm256_extracti128_si256(vS1, 1));
+        sumS1 = _mm_add_epi32(sumS1, _mm_shuffle_epi32(sumS1, _MM_SHUFFLE(2, 3, 0, 1)));
+        sumS1 = _mm_add_epi32(sumS1, _mm_shuffle_epi32(sumS1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += static_cast<uint32_t>(_mm_cvtsi128_si32(sumS1));
+        auto sumS2 = _mm_add_epi32(_mm256_castsi256_si128(vS2), _mm256_extracti128_si256(vS2, 1));
+        sumS2 = _mm_add_epi32(sumS2, _mm_shuffle_epi32(sumS2, _MM_SHUFFLE(2, 3, 0, 1)));
+        sumS2 = _mm_add_epi32(sumS2, _mm_shuffle_epi32(sumS2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(sumS2));
+
+        s1 %= adlerBase;
+        s2 %= adlerBase;
+    }
+    return adler32Tail(s1, s2, data, size);
+}
+#endif
+
+struct Adler32Dispatch
+{
+    Adler32Kernel kernel = &adler32Zlib;
+    const char *name = "zlib";
+};
+
+Adler32Dispatch selectAdler32Kernel()
+{
+    Adler32Dispatch dispatch;
+#ifdef OCC_CHECKSUM_KERNELS_X86
+    __builtin_cpu_init();
+    if (qEnvironmentVariableIsSet("OWNCLOUD_DISABLE_SIMD_CHECKSUMS")) {
+        return dispatch;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        dispatch = {&adler32Avx2, "avx2"};
+    } else if (__builtin_cpu_supports("ssse3")) {
+        dispatch = {&adler32Ssse3, "ssse3"};
+    }
+#endif
+    return dispatch;
+}
+
+const Adler32Dispatch &adler32Dispatch()
+{
+    static const auto dispatch = selectAdler32Kernel();
+    return dispatch;
+}
+}
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcChecksumKernels, "nextcloud.common.checksumkernels", QtInfoMsg)
+
+quint32 ChecksumKernels::adler32(quint32 adler, const char *data, qint64 size)
+{
+    if (size <= 0) {
+        return adler;
+    }
+    return adler32Dispatch().kernel(adler, reinterpret_cast<const unsigned char *>(data), static_cast<size_t>(size));
+}
+
+const char *ChecksumKernels::adler32KernelName()
+{
+    static const auto name = [] {
+        const auto kernelName = adler32Dispatch().name;
+        qCInfo(lcChecksumKernels) << "Using" << kernelName << "Adler-32 kernel";
+        return kernelName;
+    }();
+    return name;
+}
+
+}
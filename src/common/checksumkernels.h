@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+
+#include <QtGlobal>
+
+namespace OCC {
+
+/**
+ * Low level checksum kernels used by ChecksumCalculator.
+ *
+ * The implementation is selected once at runtime based on the CPU features
+ * available, the result is always identical to the portable implementation.
+ */
+namespace ChecksumKernels {
+
+    /**
+     * Updates the running Adler-32 checksum \a adler with \a size bytes of \a data.
+     *
+     * Use 1 as initial value. Equivalent to zlib's adler32().
+     */
+    OCSYNC_EXPORT quint32 adler32(quint32 adler, const char *data, qint64 size);
+
+    /// Name of the Adler-32 kernel selected for this CPU, for logging and benchmarks
+    OCSYNC_EXPORT const char *adler32KernelName();
+}
+
+}
@@ -249,17 +249,25 @@ ValidateChecksumHeader::ValidateChecksumHeader(QObject *parent)
 {
 }
 
-ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+bool ValidateChecksumHeader::parseExpectedChecksumHeader(const QByteArray &checksumHeader)
 {
     // If the incoming header is empty no validation can happen. Just continue.
     if (checksumHeader.isEmpty()) {
         emit validated(QByteArray(), QByteArray());
-        return nullptr;
+        return false;
     }
 
     if (!parseChecksumHeader(checksumHeader, &_expectedChecksumType, &_expectedChecksum)) {
         qCWarning(lcChecksums) << "Checksum header malformed:" << checksumHeader;
         emit validationFailed(tr("The checksum header is malformed."), _calculatedChecksumType, _calculatedChecksum, ChecksumHeaderMalformed);
+        return false;
+    }
+    return true;
+}
+
+ComputeChecksum *ValidateChecksumHeader::prepareStart(const QByteArray &checksumHeader)
+{
+    if (!parseExpectedChecksumHeader(checksumHeader)) {
         return nullptr;
     }
 
@@ -276,6 +284,13 @@ void ValidateChecksumHeader::start(const QString &filePath, const QByteArray &ch
         calculator->start(filePath);
 }
 
+void ValidateChecksumHeader::start(const QByteArray &checksumHeader, const QByteArray &calculatedChecksumType, const QByteArray &calculatedChecksum)
+{
+    if (parseExpectedChecksumHeader(checksumHeader)) {
+        slotChecksumCalculated(calculatedChecksumType, calculatedChecksum);
+    }
+}
+
 QByteArray ValidateChecksumHeader::calculatedChecksumType() const
 {
     return _calculatedChecksumType;
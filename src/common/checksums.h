@@ -137,6 +137,14 @@ public:
      */
     void start(const QString &filePath, const QByteArray &checksumHeader);
 
+    /**
+     * Check an already calculated checksum against the provided checksumHeader
+     *
+     * For data that was hashed while it was written. Emits the same signals as
+     * the file based start(), synchronously.
+     */
+    void start(const QByteArray &checksumHeader, const QByteArray &calculatedChecksumType, const QByteArray &calculatedChecksum);
+
     [[nodiscard]] QByteArray calculatedChecksumType() const;
     [[nodiscard]] QByteArray calculatedChecksum() const;
 
@@ -149,6 +157,7 @@ private slots:
     void slotChecksumCalculated(const QByteArray &checksumType, const QByteArray &checksum);
 
 private:
+    bool parseExpectedChecksumHeader(const QByteArray &checksumHeader);
     ComputeChecksum *prepareStart(const QByteArray &checksumHeader);
 
     QByteArray _expectedChecksumType;
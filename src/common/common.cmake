@@ -4,6 +4,7 @@
 set(common_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/checksums.cpp
     ${CMAKE_CURRENT_LIST_DIR}/checksumcalculator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/checksumkernels.cpp
     ${CMAKE_CURRENT_LIST_DIR}/filesystembase.cpp
     ${CMAKE_CURRENT_LIST_DIR}/ownsql.cpp
     ${CMAKE_CURRENT_LIST_DIR}/preparedsqlquerymanager.cpp
@@ -15,6 +16,8 @@ set(common_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/pinstate.cpp
     ${CMAKE_CURRENT_LIST_DIR}/plugin.cpp
     ${CMAKE_CURRENT_LIST_DIR}/syncfilestatus.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/synctrace.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/metrics.cpp
 )
 
 if(WIN32)
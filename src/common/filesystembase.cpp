@@ -24,11 +24,22 @@
 #include <QDir>
 #include <QUrl>
 #include <QFile>
+#include <QTemporaryFile>
 #include <QCoreApplication>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
 #ifdef Q_OS_WIN
 #include <windows.h>
 #include <windef.h>
@@ -214,6 +225,207 @@ bool FileSystem::rename(const QString &originFileName,
     return success;
 }
 
+#ifdef Q_OS_LINUX
+static bool isOnSameDevice(const QString &originFileName, const QString &destinationFileName)
+{
+    struct stat originStat;
+    struct stat destinationDirStat;
+    const auto destinationDir = QFileInfo(destinationFileName).absolutePath();
+    if (stat(originFileName.toLocal8Bit().constData(), &originStat) != 0
+        || stat(destinationDir.toLocal8Bit().constData(), &destinationDirStat) != 0) {
+        // let rename() report the actual error
+        return true;
+    }
+    return originStat.st_dev == destinationDirStat.st_dev;
+}
+
+enum class KernelCopyResult {
+    Done,
+    Unsupported,
+    Failed,
+};
+
+/*
+ * Copies the full content of \a sourceFd into \a destinationFd with the
+ * fastest mechanism the kernel and file systems offer.
+ * Unsupported is only returned if nothing has been written yet.
+ */
+static KernelCopyResult kernelCopy(int sourceFd, int destinationFd, qint64 size)
+{
+#ifdef FICLONE
+    if (ioctl(destinationFd, FICLONE, sourceFd) == 0) {
+        qCDebug(lcFileSystem) << "Cloned file extents with FICLONE";
+        return KernelCopyResult::Done;
+    }
+#endif
+
+    const auto isUnsupported = [](int error) {
+        return error == EXDEV || error == ENOSYS || error == EINVAL || error == EOPNOTSUPP || error == EBADF;
+    };
+
+    qint64 copied = 0;
+    bool useSendfile = false;
+    while (copied < size) {
+        const auto chunk = static_cast<size_t>(qMin<qint64>(size - copied, 1 << 30));
+        ssize_t written = -1;
+        if (!useSendfile) {
+            written = copy_file_range(sourceFd, nullptr, destinationFd, nullptr, chunk, 0);
+            if (written < 0 && copied == 0 && isUnsupported(errno)) {
+                useSendfile = true;
+                continue;
+            }
+        } else {
+            written = sendfile(destinationFd, sourceFd, nullptr, chunk);
+            if (written < 0 && copied == 0 && isUnsupported(errno)) {
+                return KernelCopyResult::Unsupported;
+            }
+        }
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return KernelCopyResult::Failed;
+        }
+        if (written == 0) {
+            // source was truncated while copying
+            break;
+        }
+        copied += written;
+    }
+    return KernelCopyResult::Done;
+}
+#endif
+
+/*
+ * The template of a hidden temporary file next to \a destinationFileName,
+ * ending in the XXXXXX that mkstemp() and QTemporaryFile replace.
+ */
+static QString temporaryFileTemplate(const QString &destinationFileName)
+{
+    const QFileInfo destination(destinationFileName);
+    constexpr int overhead = 1 + 2 + 6; // dot dot-tilde XXXXXX
+    const auto fileName = destination.fileName().left(254 - overhead);
+    return destination.absolutePath() + QStringLiteral("/.") + fileName + QStringLiteral(".~XXXXXX");
+}
+
+#ifdef Q_OS_LINUX
+/*
+ * Copies \a sourceFd into a temporary file next to \a destinationFileName,
+ * with the mode and times of the source, and renames it over the destination.
+ * So the destination is either left alone or replaced by the complete copy.
+ * The temporary file is removed on every error.
+ * Unsupported is only returned if the destination wasn't touched.
+ */
+static KernelCopyResult kernelCopyReplace(int sourceFd, const struct stat &sourceStat,
+    const QString &destinationFileName, int *error)
+{
+    auto temporaryName = QFile::encodeName(temporaryFileTemplate(destinationFileName));
+    const auto destinationFd = mkostemp(temporaryName.data(), O_CLOEXEC);
+    if (destinationFd < 0) {
+        *error = errno;
+        return KernelCopyResult::Failed;
+    }
+
+    auto result = kernelCopy(sourceFd, destinationFd, sourceStat.st_size);
+    *error = errno;
+    if (result == KernelCopyResult::Done) {
+        const struct timespec times[2] = { sourceStat.st_atim, sourceStat.st_mtim };
+        if (fchmod(destinationFd, sourceStat.st_mode & 0777) != 0 || futimens(destinationFd, times) != 0) {
+            *error = errno;
+            result = KernelCopyResult::Failed;
+        }
+    }
+    if (::close(destinationFd) != 0 && result == KernelCopyResult::Done) {
+        *error = errno;
+        result = KernelCopyResult::Failed;
+    }
+    if (result == KernelCopyResult::Done && ::rename(temporaryName.constData(), QFile::encodeName(destinationFileName).constData()) != 0) {
+        *error = errno;
+        result = KernelCopyResult::Failed;
+    }
+    if (result != KernelCopyResult::Done) {
+        ::unlink(temporaryName.constData());
+    }
+    return result;
+}
+#endif
+
+bool FileSystem::copyFile(const QString &sourceFileName,
+    const QString &destinationFileName,
+    QString *errorString)
+{
+#ifdef Q_OS_LINUX
+    const auto sourceFd = ::open(sourceFileName.toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd >= 0) {
+        struct stat sourceStat;
+        auto result = KernelCopyResult::Unsupported;
+        int copyErrno = 0;
+        if (fstat(sourceFd, &sourceStat) == 0 && S_ISREG(sourceStat.st_mode)) {
+            result = kernelCopyReplace(sourceFd, sourceStat, destinationFileName, &copyErrno);
+        }
+        ::close(sourceFd);
+        if (result == KernelCopyResult::Done) {
+            return true;
+        }
+        if (result == KernelCopyResult::Failed) {
+            const auto error = QString::fromLocal8Bit(strerror(copyErrno));
+            qCWarning(lcFileSystem) << "Error copying file" << sourceFileName
+                                    << "to" << destinationFileName
+                                    << "failed: " << error;
+            if (errorString) {
+                *errorString = error;
+            }
+            return false;
+        }
+    }
+#endif
+
+    QFile source(sourceFileName);
+    const auto fail = [&](const QString &error) {
+        qCWarning(lcFileSystem) << "Error copying file" << sourceFileName
+                                << "to" << destinationFileName
+                                << "failed: " << error;
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    };
+    if (!source.exists()) {
+        return fail(QCoreApplication::translate("FileSystem", "File \"%1\" does not exist").arg(QDir::toNativeSeparators(sourceFileName)));
+    }
+    if (!source.open(QIODevice::ReadOnly)) {
+        return fail(source.errorString());
+    }
+
+    // Like above: copy beside the destination, then replace it
+    QTemporaryFile temporary(temporaryFileTemplate(destinationFileName));
+    if (!temporary.open()) {
+        return fail(temporary.errorString());
+    }
+    QByteArray buffer(1024 * 1024, Qt::Uninitialized);
+    while (!source.atEnd()) {
+        const auto read = source.read(buffer.data(), buffer.size());
+        if (read < 0) {
+            return fail(source.errorString());
+        }
+        if (temporary.write(buffer.constData(), read) != read) {
+            return fail(temporary.errorString());
+        }
+    }
+    if (!temporary.flush() || !temporary.setPermissions(source.permissions())
+        || !temporary.setFileTime(source.fileTime(QFileDevice::FileModificationTime), QFileDevice::FileModificationTime)) {
+        return fail(temporary.errorString());
+    }
+    temporary.close();
+
+    QString error;
+    if (!uncheckedRenameReplace(temporary.fileName(), destinationFileName, &error)) {
+        return fail(error);
+    }
+    temporary.setAutoRemove(false);
+    return true;
+}
+
 bool FileSystem::uncheckedRenameReplace(const QString &originFileName,
     const QString &destinationFileName,
     QString *errorString)
@@ -224,6 +436,20 @@ bool FileSystem::uncheckedRenameReplace(const QString &originFileName,
     // We want a rename that also overwrites.  QFile::rename does not overwrite.
     // Qt 5.1 has QSaveFile::renameOverwrite we could use.
     // ### FIXME
+#ifdef Q_OS_LINUX
+    if (!isOnSameDevice(originFileName, destinationFileName)) {
+        // QFile::rename would fall back to a read/write loop, copyFile can clone the extents instead.
+        // It also only replaces the target once the copy is complete.
+        if (!copyFile(originFileName, destinationFileName, errorString)) {
+            qCWarning(lcFileSystem) << "Copying temp file to final across devices failed: " << *errorString;
+            return false;
+        }
+        if (!QFile::remove(originFileName)) {
+            qCWarning(lcFileSystem) << "Could not remove" << originFileName << "after copying it to" << destinationFileName;
+        }
+        return true;
+    }
+#endif
     success = true;
     bool destExists = fileExists(destinationFileName);
     if (destExists && !QFile::remove(destinationFileName)) {
@@ -140,6 +140,22 @@ namespace FileSystem {
         const QString &destinationFileName,
         QString *errorString);
 
+    /**
+     * Copy the file \a sourceFileName to \a destinationFileName, overwriting the
+     * destination if it already exists.
+     *
+     * The data goes to a temporary file next to the destination, which gets
+     * the permissions and modification time of the source and is then renamed
+     * over the destination. So on failure the destination is left as it was.
+     *
+     * On Linux this first tries to share the data extents (reflink via FICLONE,
+     * O(1) on btrfs/XFS), then falls back to copy_file_range(), sendfile() and
+     * finally a read/write loop. Other platforms use the read/write loop directly.
+     */
+    bool OCSYNC_EXPORT copyFile(const QString &sourceFileName,
+        const QString &destinationFileName,
+        QString *errorString = nullptr);
+
     /**
      * Removes a file.
      *
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "metrics.h"
+#include "asserts.h"
+
+#include <QLoggingCategory>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcMetrics, "nextcloud.common.metrics", QtInfoMsg)
+
+namespace {
+
+    QByteArray formatValue(double value)
+    {
+        if (std::isinf(value)) {
+            return value > 0 ? QByteArrayLiteral("+Inf") : QByteArrayLiteral("-Inf");
+        }
+        return QByteArray::number(value, 'g', 12);
+    }
+
+    const char *typeName(Metric::Type type)
+    {
+        switch (type) {
+        case Metric::Type::Counter:
+            return "counter";
+        case Metric::Type::Gauge:
+            return "gauge";
+        case Metric::Type::Histogram:
+            return "histogram";
+        }
+        return "unknown";
+    }
+
+    QByteArray labelSet(const QByteArray &labels, const QByteArray &extraLabel = {})
+    {
+        if (labels.isEmpty() && extraLabel.isEmpty()) {
+            return {};
+        }
+        if (labels.isEmpty() || extraLabel.isEmpty()) {
+            return '{' + labels + extraLabel + '}';
+        }
+        return '{' + labels + ',' + extraLabel + '}';
+    }
+
+}
+
+void MetricCounter::writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const
+{
+    out += name + "_total" + labelSet(labels) + ' ' + QByteArray::number(value()) + '\n';
+}
+
+void MetricGauge::writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const
+{
+    out += name + labelSet(labels) + ' ' + QByteArray::number(value()) + '\n';
+}
+
+MetricHistogram::MetricHistogram(std::vector<double> upperBounds)
+    : _upperBounds(std::move(upperBounds))
+    , _bucketCounts(new std::atomic<quint64>[_upperBounds.size() + 1])
+{
+    ASSERT(std::is_sorted(_upperBounds.cbegin(), _upperBounds.cend()));
+    for (std::size_t i = 0; i <= _upperBounds.size(); ++i) {
+        _bucketCounts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value)
+{
+    const auto bucket = std::lower_bound(_upperBounds.cbegin(), _upperBounds.cend(), value) - _upperBounds.cbegin();
+    _bucketCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    auto sum = _sum.load(std::memory_order_relaxed);
+    while (!_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+}
+
+void MetricHistogram::writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const
+{
+    // The buckets are cumulative in the text format
+    quint64 cumulative = 0;
+    for (std::size_t i = 0; i <= _upperBounds.size(); ++i) {
+        cumulative += _bucketCounts[i].load(std::memory_order_relaxed);
+        const auto upperBound = i < _upperBounds.size() ? formatValue(_upperBounds[i]) : QByteArrayLiteral("+Inf");
+        out += name + "_bucket" + labelSet(labels, "le=\"" + upperBound + '"') + ' ' + QByteArray::number(cumulative) + '\n';
+    }
+    // Taken after the buckets: concurrent observations may make the count
+    // a bit larger than the +Inf bucket, but never smaller
+    out += name + "_count" + labelSet(labels) + ' ' + QByteArray::number(qMax(cumulative, count())) + '\n';
+    out += name + "_sum" + labelSet(labels) + ' ' + formatValue(sum()) + '\n';
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+template <typename T, typename... Args>
+T &MetricsRegistry::metric(const QByteArray &name, const QByteArray &help, const QByteArray &labels, Args &&...args)
+{
+    QMutexLocker lock(&_mutex);
+    auto family = _families.find(name);
+    if (family == _families.end()) {
+        family = _families.emplace(name, Family{help, T::staticType, {}}).first;
+    }
+    ENFORCE(family->second._type == T::staticType, "A metric was registered twice with different types");
+    auto &metric = family->second._metrics[labels];
+    if (!metric) {
+        metric = std::make_unique<T>(std::forward<Args>(args)...);
+    }
+    return static_cast<T &>(*metric);
+}
+
+MetricCounter &MetricsRegistry::counter(const QByteArray &name, const QByteArray &help, const QByteArray &labels)
+{
+    return metric<MetricCounter>(name, help, labels);
+}
+
+MetricGauge &MetricsRegistry::gauge(const QByteArray &name, const QByteArray &help, const QByteArray &labels)
+{
+    return metric<MetricGauge>(name, help, labels);
+}
+
+MetricHistogram &MetricsRegistry::histogram(const QByteArray &name, const QByteArray &help, std::vector<double> upperBounds, const QByteArray &labels)
+{
+    return metric<MetricHistogram>(name, help, labels, std::move(upperBounds));
+}
+
+QByteArray MetricsRegistry::label(const QByteArray &name, const QByteArray &value)
+{
+    auto escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return name + "=\"" + escaped + '"';
+}
+
+QByteArray MetricsRegistry::toOpenMetrics() const
+{
+    QMutexLocker lock(&_mutex);
+    QByteArray out;
+    for (const auto &[name, family] : _families) {
+        out += "# TYPE " + name + ' ' + typeName(family._type) + '\n';
+        out += "# HELP " + name + ' ' + family._help + '\n';
+        for (const auto &[labels, metric] : family._metrics) {
+            metric->writeSamples(name, labels, out);
+        }
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+bool MetricsRegistry::writeOpenMetrics(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcMetrics) << "Could not write the metrics to" << fileName << file.errorString();
+        return false;
+    }
+    file.write(toOpenMetrics());
+    return file.commit();
+}
+
+namespace SyncMetrics {
+
+    const std::vector<double> &latencyBuckets()
+    {
+        static const std::vector<double> buckets = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+        return buckets;
+    }
+
+    MetricCounter &syncRuns()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_sync_runs", "Sync runs started.");
+        return metric;
+    }
+
+    MetricCounter &failedSyncRuns()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_sync_runs_failed", "Sync runs that finished with an error.");
+        return metric;
+    }
+
+    MetricCounter &discoveredDirectories()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_discovery_directories", "Directories processed by the discovery.");
+        return metric;
+    }
+
+    MetricCounter &discoveredItems()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_discovery_items", "Items the discovery found something to do for.");
+        return metric;
+    }
+
+    MetricCounter &discoveryArenaAllocations()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_discovery_arena_allocations", "Allocations of discovery temporaries served by the arenas of the directories.");
+        return metric;
+    }
+
+    MetricCounter &discoveryArenaBytes()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_discovery_arena_bytes", "Memory the arenas of the directories took from the heap.");
+        return metric;
+    }
+
+    MetricHistogram &propfindDuration()
+    {
+        static auto &metric = MetricsRegistry::instance().histogram("nextcloud_propfind_duration_seconds", "Duration of PROPFIND requests.", latencyBuckets());
+        return metric;
+    }
+
+    MetricCounter &networkRequests()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_network_requests", "Network requests finished.");
+        return metric;
+    }
+
+    MetricCounter &networkErrors()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_network_errors", "Network requests that finished with an error.");
+        return metric;
+    }
+
+    MetricCounter &uploadedBytes()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_upload_bytes", "File data sent to the server.");
+        return metric;
+    }
+
+    MetricCounter &downloadedBytes()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_download_bytes", "File data received from the server.");
+        return metric;
+    }
+
+    MetricGauge &activeJobs()
+    {
+        static auto &metric = MetricsRegistry::instance().gauge("nextcloud_propagator_active_jobs", "Propagation jobs using the network right now.");
+        return metric;
+    }
+
+    MetricGauge &maximumActiveJobs()
+    {
+        static auto &metric = MetricsRegistry::instance().gauge("nextcloud_propagator_max_active_jobs", "The number of propagation jobs allowed to use the network at once.");
+        return metric;
+    }
+
+    MetricCounter &propagatedItems()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_propagation_items", "Items propagated, successfully or not.");
+        return metric;
+    }
+
+    MetricCounter &propagationErrors()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_propagation_errors", "Items whose propagation failed.");
+        return metric;
+    }
+
+    MetricHistogram &journalCommitDuration()
+    {
+        static auto &metric = MetricsRegistry::instance().histogram("nextcloud_journal_commit_duration_seconds", "Duration of sync journal commits.", latencyBuckets());
+        return metric;
+    }
+
+    MetricCounter &checksumBytes()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_checksum_bytes", "File data checksummed.");
+        return metric;
+    }
+
+    MetricHistogram &checksumDuration()
+    {
+        static auto &metric = MetricsRegistry::instance().histogram("nextcloud_checksum_duration_seconds", "Duration of file checksum computations.", latencyBuckets());
+        return metric;
+    }
+
+    MetricCounter &watcherEvents()
+    {
+        static auto &metric = MetricsRegistry::instance().counter("nextcloud_watcher_events", "Changes reported by the file system watcher.");
+        return metric;
+    }
+
+}
+
+}
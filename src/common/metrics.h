@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+
+#include <QByteArray>
+#include <QMutex>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace OCC {
+
+/**
+ * @brief A metric of the MetricsRegistry
+ *
+ * Updating a metric is lock-free, so they can be updated from any thread.
+ */
+class OCSYNC_EXPORT Metric
+{
+public:
+    enum class Type {
+        Counter,
+        Gauge,
+        Histogram,
+    };
+
+    virtual ~Metric() = default;
+    [[nodiscard]] virtual Type type() const = 0;
+    /** Appends the samples of the metric family \a name in the OpenMetrics text format */
+    virtual void writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const = 0;
+};
+
+/** A value that only goes up, e.g. the bytes uploaded */
+class OCSYNC_EXPORT MetricCounter : public Metric
+{
+public:
+    void add(quint64 value = 1) { _value.fetch_add(value, std::memory_order_relaxed); }
+    [[nodiscard]] quint64 value() const { return _value.load(std::memory_order_relaxed); }
+
+    static constexpr Type staticType = Type::Counter;
+    [[nodiscard]] Type type() const override { return staticType; }
+    void writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const override;
+
+private:
+    std::atomic<quint64> _value{0};
+};
+
+/** A value that goes up and down, e.g. the number of running jobs */
+class OCSYNC_EXPORT MetricGauge : public Metric
+{
+public:
+    void set(qint64 value) { _value.store(value, std::memory_order_relaxed); }
+    void add(qint64 value) { _value.fetch_add(value, std::memory_order_relaxed); }
+    [[nodiscard]] qint64 value() const { return _value.load(std::memory_order_relaxed); }
+
+    static constexpr Type staticType = Type::Gauge;
+    [[nodiscard]] Type type() const override { return staticType; }
+    void writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const override;
+
+private:
+    std::atomic<qint64> _value{0};
+};
+
+/** The distribution of observed values, e.g. request latencies, in buckets with fixed upper bounds */
+class OCSYNC_EXPORT MetricHistogram : public Metric
+{
+public:
+    /** \a upperBounds must be sorted, the +Inf bucket is added */
+    explicit MetricHistogram(std::vector<double> upperBounds);
+
+    void observe(double value);
+    void observe(std::chrono::nanoseconds duration) { observe(std::chrono::duration<double>(duration).count()); }
+
+    [[nodiscard]] quint64 count() const { return _count.load(std::memory_order_relaxed); }
+    [[nodiscard]] double sum() const { return _sum.load(std::memory_order_relaxed); }
+
+    static constexpr Type staticType = Type::Histogram;
+    [[nodiscard]] Type type() const override { return staticType; }
+    void writeSamples(const QByteArray &name, const QByteArray &labels, QByteArray &out) const override;
+
+private:
+    std::vector<double> _upperBounds;
+    std::unique_ptr<std::atomic<quint64>[]> _bucketCounts; // not cumulative, the last one is +Inf
+    std::atomic<quint64> _count{0};
+    std::atomic<double> _sum{0};
+};
+
+/**
+ * @brief The metrics of the client, exported in the OpenMetrics text format
+ *
+ * Metrics are registered on first use and live as long as the process, so
+ * callers can keep the returned references.
+ *
+ * nextcloudcmd writes the metrics to the file given with --metrics, the GUI
+ * client serves them on a local socket when enabled in the config.
+ */
+class OCSYNC_EXPORT MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    /**
+     * \a name is the metric family name, without the _total suffix of counters.
+     *
+     * A family has one metric for each set of \a labels, e.g. `verb="GET",endpoint="dav_file"`;
+     * build them with label().
+     */
+    MetricCounter &counter(const QByteArray &name, const QByteArray &help, const QByteArray &labels = {});
+    MetricGauge &gauge(const QByteArray &name, const QByteArray &help, const QByteArray &labels = {});
+    MetricHistogram &histogram(const QByteArray &name, const QByteArray &help, std::vector<double> upperBounds, const QByteArray &labels = {});
+
+    /** Formats the label \a name with \a value, escaped as needed */
+    [[nodiscard]] static QByteArray label(const QByteArray &name, const QByteArray &value);
+
+    [[nodiscard]] QByteArray toOpenMetrics() const;
+    /** Replaces \a fileName atomically, so a scraper never reads a partial file */
+    bool writeOpenMetrics(const QString &fileName) const;
+
+private:
+    struct Family
+    {
+        QByteArray _help;
+        Metric::Type _type;
+        std::map<QByteArray, std::unique_ptr<Metric>> _metrics; // by labels
+    };
+
+    template <typename T, typename... Args>
+    T &metric(const QByteArray &name, const QByteArray &help, const QByteArray &labels, Args &&...args);
+
+    mutable QMutex _mutex;
+    std::map<QByteArray, Family> _families;
+};
+
+/**
+ * The metrics of the sync.
+ */
+namespace SyncMetrics {
+    /** Upper bounds in seconds for histograms of request and database latencies */
+    OCSYNC_EXPORT const std::vector<double> &latencyBuckets();
+
+    OCSYNC_EXPORT MetricCounter &syncRuns();
+    OCSYNC_EXPORT MetricCounter &failedSyncRuns();
+    OCSYNC_EXPORT MetricCounter &discoveredDirectories();
+    OCSYNC_EXPORT MetricCounter &discoveredItems();
+    OCSYNC_EXPORT MetricCounter &discoveryArenaAllocations();
+    OCSYNC_EXPORT MetricCounter &discoveryArenaBytes();
+    OCSYNC_EXPORT MetricHistogram &propfindDuration();
+    OCSYNC_EXPORT MetricCounter &networkRequests();
+    OCSYNC_EXPORT MetricCounter &networkErrors();
+    OCSYNC_EXPORT MetricCounter &uploadedBytes();
+    OCSYNC_EXPORT MetricCounter &downloadedBytes();
+    OCSYNC_EXPORT MetricGauge &activeJobs();
+    OCSYNC_EXPORT MetricGauge &maximumActiveJobs();
+    OCSYNC_EXPORT MetricCounter &propagatedItems();
+    OCSYNC_EXPORT MetricCounter &propagationErrors();
+    OCSYNC_EXPORT MetricHistogram &journalCommitDuration();
+    OCSYNC_EXPORT MetricCounter &checksumBytes();
+    OCSYNC_EXPORT MetricHistogram &checksumDuration();
+    OCSYNC_EXPORT MetricCounter &watcherEvents();
+}
+
+}
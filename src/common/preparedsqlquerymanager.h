@@ -63,6 +63,7 @@ public:
         GetFileRecordQueryByMangledName,
         GetFileRecordQueryByInode,
         GetFileRecordQueryByFileId,
+        GetFileRecordsQuery,
         GetFilesBelowPathQuery,
         GetAllFilesQuery,
         ListFilesInPathQuery,
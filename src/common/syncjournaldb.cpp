@@ -31,7 +31,9 @@
 #include "filesystembase.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/metrics.h"
 #include "common/preparedsqlquerymanager.h"
+#include "common/synctrace.h"
 
 #include "common/c_jhash.h"
 
@@ -452,6 +454,7 @@ bool SyncJournalDb::checkConnect()
                         "tmpfile VARCHAR(4096),"
                         "etag VARCHAR(32),"
                         "errorcount INTEGER,"
+                        "segments TEXT,"
                         "PRIMARY KEY(path)"
                         ");");
 
@@ -467,6 +470,7 @@ bool SyncJournalDb::checkConnect()
                         "size INTEGER(8),"
                         "modtime INTEGER(8),"
                         "contentChecksum TEXT,"
+                        "chunks TEXT,"
                         "PRIMARY KEY(path)"
                         ");");
 
@@ -507,6 +511,16 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table selectivesync"), createQuery);
     }
 
+    // create the localdiscovery table.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localdiscovery ("
+                        "path VARCHAR(4096),"
+                        "PRIMARY KEY(path)"
+                        ");");
+
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table localdiscovery"), createQuery);
+    }
+
     // create the checksumtype table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS checksumtype("
                         "id INTEGER PRIMARY KEY,"
@@ -796,6 +810,28 @@ bool SyncJournalDb::updateMetadataTableStructure()
         }
         commitInternal(QStringLiteral("update database structure: add contentChecksum col for uploadinfo"));
     }
+    if (!uploadInfoColumns.contains("chunks")) {
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE uploadinfo ADD COLUMN chunks TEXT;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add chunks column"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add chunks col for uploadinfo"));
+    }
+
+    auto downloadInfoColumns = tableColumns("downloadinfo");
+    if (downloadInfoColumns.isEmpty())
+        return false;
+    if (!downloadInfoColumns.contains("segments")) {
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE downloadinfo ADD COLUMN segments TEXT;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add segments column"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add segments col for downloadinfo"));
+    }
 
     auto conflictsColumns = tableColumns("conflicts");
     if (conflictsColumns.isEmpty())
@@ -934,6 +970,8 @@ qint64 SyncJournalDb::getPHash(const QByteArray &file)
 
 Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &_record)
 {
+    SyncTraceScope traceScope(SyncTrace::Category::Database, "setFileRecord",
+                              SyncTrace::isEnabled() ? QString::fromUtf8(_record._path) : QString());
     SyncJournalFileRecord record = _record;
     QMutexLocker locker(&_mutex);
 
@@ -1431,6 +1469,75 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     return true;
 }
 
+bool SyncJournalDb::getFileRecords(const QByteArrayList &filenames, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (filenames.isEmpty() || _metadataTableIsEmpty) {
+        return true; // no error, yet nothing found
+    }
+
+    if (!checkConnect()) {
+        return false;
+    }
+
+    // The paths are looked up in batches of a fixed size so the prepared query can be
+    // reused; the unused placeholders of the last batch repeat one of its hashes.
+    constexpr auto batchSize = 64;
+    static const auto queryString = [] {
+        QByteArray placeholders;
+        for (int i = 1; i <= batchSize; ++i) {
+            placeholders += (i > 1 ? ",?" : "?") + QByteArray::number(i);
+        }
+        return QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash IN (") + placeholders + ')';
+    }();
+
+    QVector<qint64> phashes;
+    phashes.reserve(filenames.size());
+    for (const auto &filename : filenames) {
+        if (!filename.isEmpty()) {
+            phashes.append(getPHash(filename));
+        }
+    }
+
+    for (int batchStart = 0; batchStart < phashes.size(); batchStart += batchSize) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetFileRecordsQuery, queryString, _db);
+        if (!query) {
+            qCDebug(lcDb) << "database error:" << query->error();
+            return false;
+        }
+
+        const auto batchEnd = qMin(batchStart + batchSize, phashes.size());
+        for (int i = 0; i < batchSize; ++i) {
+            query->bindValue(i + 1, phashes.at(qMin(batchStart + i, batchEnd - 1)));
+        }
+
+        if (!query->exec()) {
+            qCDebug(lcDb) << "database error:" << query->error();
+            close();
+            return false;
+        }
+
+        forever {
+            auto next = query->next();
+            if (!next.ok) {
+                qCWarning(lcDb) << "database error:" << query->error();
+                close();
+                return false;
+            }
+
+            if (!next.hasData) {
+                break;
+            }
+
+            SyncJournalFileRecord rec;
+            fillFileRecordFromGetQuery(rec, *query);
+            rowCallback(rec);
+        }
+    }
+    return true;
+}
+
 bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
 {
     QMutexLocker locker(&_mutex);
@@ -1685,12 +1792,94 @@ Optional<SyncJournalDb::HasHydratedDehydrated> SyncJournalDb::hasHydratedOrDehyd
     return result;
 }
 
+// Segments are stored as "start-end:done" separated by ','
+static QByteArray serializeDownloadSegments(const QVector<SyncJournalDb::DownloadSegment> &segments)
+{
+    QByteArray result;
+    for (const auto &segment : segments) {
+        if (!result.isEmpty()) {
+            result += ',';
+        }
+        result += QByteArray::number(segment._start) + '-' + QByteArray::number(segment._end) + ':' + QByteArray::number(segment._done);
+    }
+    return result;
+}
+
+static QVector<SyncJournalDb::DownloadSegment> parseDownloadSegments(const QByteArray &data)
+{
+    QVector<SyncJournalDb::DownloadSegment> segments;
+    if (data.isEmpty()) {
+        return segments;
+    }
+    for (const auto &entry : data.split(',')) {
+        const auto dash = entry.indexOf('-');
+        const auto colon = entry.indexOf(':', dash);
+        if (dash <= 0 || colon <= dash) {
+            qCWarning(lcDb) << "Invalid download segments" << data;
+            return {};
+        }
+        bool startOk = false, endOk = false, doneOk = false;
+        SyncJournalDb::DownloadSegment segment;
+        segment._start = entry.left(dash).toLongLong(&startOk);
+        segment._end = entry.mid(dash + 1, colon - dash - 1).toLongLong(&endOk);
+        segment._done = entry.mid(colon + 1).toLongLong(&doneOk);
+        if (!startOk || !endOk || !doneOk || segment._end < segment._start || segment._done < 0) {
+            qCWarning(lcDb) << "Invalid download segments" << data;
+            return {};
+        }
+        segments.append(segment);
+    }
+    return segments;
+}
+
+// Chunks are stored as "number:offset:size:done" separated by ','
+static QByteArray serializeUploadChunks(const QVector<SyncJournalDb::UploadChunk> &chunks)
+{
+    QByteArray result;
+    for (const auto &chunk : chunks) {
+        if (!result.isEmpty()) {
+            result += ',';
+        }
+        result += QByteArray::number(chunk._number) + ':' + QByteArray::number(chunk._offset) + ':'
+            + QByteArray::number(chunk._size) + ':' + (chunk._done ? '1' : '0');
+    }
+    return result;
+}
+
+static QVector<SyncJournalDb::UploadChunk> parseUploadChunks(const QByteArray &data)
+{
+    QVector<SyncJournalDb::UploadChunk> chunks;
+    if (data.isEmpty()) {
+        return chunks;
+    }
+    for (const auto &entry : data.split(',')) {
+        const auto fields = entry.split(':');
+        if (fields.size() != 4) {
+            qCWarning(lcDb) << "Invalid upload chunks" << data;
+            return {};
+        }
+        bool numberOk = false, offsetOk = false, sizeOk = false;
+        SyncJournalDb::UploadChunk chunk;
+        chunk._number = fields[0].toInt(&numberOk);
+        chunk._offset = fields[1].toLongLong(&offsetOk);
+        chunk._size = fields[2].toLongLong(&sizeOk);
+        chunk._done = fields[3] == "1";
+        if (!numberOk || !offsetOk || !sizeOk || chunk._number < 1 || chunk._offset < 0 || chunk._size < 0) {
+            qCWarning(lcDb) << "Invalid upload chunks" << data;
+            return {};
+        }
+        chunks.append(chunk);
+    }
+    return chunks;
+}
+
 static void toDownloadInfo(SqlQuery &query, SyncJournalDb::DownloadInfo *res)
 {
     bool ok = true;
     res->_tmpfile = query.stringValue(0);
     res->_etag = query.baValue(1);
     res->_errorCount = query.intValue(2);
+    res->_segments = parseDownloadSegments(query.baValue(3));
     res->_valid = ok;
 }
 
@@ -1719,7 +1908,7 @@ SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString &file)
     DownloadInfo res;
 
     if (checkConnect()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount FROM downloadinfo WHERE path=?1"), _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount, segments FROM downloadinfo WHERE path=?1"), _db);
         if (!query) {
             qCDebug(lcDb) << "database error:" << query->error();
             return res;
@@ -1750,8 +1939,8 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
 
     if (i._valid) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::SetDownloadInfoQuery, QByteArrayLiteral("INSERT OR REPLACE INTO downloadinfo "
-                                                                                                              "(path, tmpfile, etag, errorcount) "
-                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4 )"),
+                                                                                                              "(path, tmpfile, etag, errorcount, segments) "
+                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4, ?5 )"),
             _db);
         if (!query) {
             qCDebug(lcDb) << "database error:" << query->error();
@@ -1761,6 +1950,7 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
         query->bindValue(2, i._tmpfile);
         query->bindValue(3, i._etag);
         query->bindValue(4, i._errorCount);
+        query->bindValue(5, serializeDownloadSegments(i._segments));
         if (!query->exec()) {
             qCDebug(lcDb) << "database error:" << query->error();
         }
@@ -1788,7 +1978,7 @@ QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInf
 
     SqlQuery query(_db);
     // The selected values *must* match the ones expected by toDownloadInfo().
-    query.prepare("SELECT tmpfile, etag, errorcount, path FROM downloadinfo");
+    query.prepare("SELECT tmpfile, etag, errorcount, segments, path FROM downloadinfo");
 
     if (!query.exec()) {
         qCDebug(lcDb) << "database error:" << query.error();
@@ -1799,7 +1989,7 @@ QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInf
     QVector<SyncJournalDb::DownloadInfo> deleted_entries;
 
     while (query.next().hasData) {
-        const QString file = query.stringValue(3); // path
+        const QString file = query.stringValue(4); // path
         if (!keep.contains(file)) {
             superfluousPaths.append(file);
             DownloadInfo info;
@@ -1847,7 +2037,7 @@ SyncJournalDb::UploadInfo SyncJournalDb::getUploadInfo(const QString &file)
     UploadInfo res;
 
     if (checkConnect()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetUploadInfoQuery, QByteArrayLiteral("SELECT chunk, transferid, errorcount, size, modtime, contentChecksum FROM "
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetUploadInfoQuery, QByteArrayLiteral("SELECT chunk, transferid, errorcount, size, modtime, contentChecksum, chunks FROM "
                                                                                                             "uploadinfo WHERE path=?1"),
             _db);
         if (!query) {
@@ -1869,6 +2059,7 @@ SyncJournalDb::UploadInfo SyncJournalDb::getUploadInfo(const QString &file)
             res._size = query->int64Value(3);
             res._modtime = query->int64Value(4);
             res._contentChecksum = query->baValue(5);
+            res._chunks = parseUploadChunks(query->baValue(6));
             res._valid = ok;
         }
     }
@@ -1885,8 +2076,8 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
 
     if (i._valid) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::SetUploadInfoQuery, QByteArrayLiteral("INSERT OR REPLACE INTO uploadinfo "
-                                                                                                            "(path, chunk, transferid, errorcount, size, modtime, contentChecksum) "
-                                                                                                            "VALUES ( ?1 , ?2, ?3 , ?4 ,  ?5, ?6 , ?7 )"),
+                                                                                                            "(path, chunk, transferid, errorcount, size, modtime, contentChecksum, chunks) "
+                                                                                                            "VALUES ( ?1 , ?2, ?3 , ?4 ,  ?5, ?6 , ?7, ?8 )"),
             _db);
         if (!query) {
             qCDebug(lcDb) << "database error:" << query->error();
@@ -1900,6 +2091,7 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
         query->bindValue(5, i._size);
         query->bindValue(6, i._modtime);
         query->bindValue(7, i._contentChecksum);
+        query->bindValue(8, serializeUploadChunks(i._chunks));
 
         if (!query->exec()) {
             qCDebug(lcDb) << "database error:" << query->error();
@@ -2259,6 +2451,87 @@ void SyncJournalDb::setSelectiveSyncList(SyncJournalDb::SelectiveSyncListType ty
     commitInternal(QStringLiteral("setSelectiveSyncList"));
 }
 
+QStringList SyncJournalDb::getLocalDiscoveryPaths(bool *ok)
+{
+    QStringList result;
+    ASSERT(ok);
+
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        *ok = false;
+        return result;
+    }
+
+    SqlQuery query("SELECT path FROM localdiscovery", _db);
+    if (!query.exec()) {
+        qCDebug(lcDb) << "database error:" << query.error();
+        *ok = false;
+        return result;
+    }
+    forever {
+        auto next = query.next();
+        if (!next.ok) {
+            qCDebug(lcDb) << "database error:" << query.error();
+            *ok = false;
+            return result;
+        }
+        if (!next.hasData)
+            break;
+
+        result.append(query.stringValue(0));
+    }
+    *ok = true;
+
+    return result;
+}
+
+void SyncJournalDb::addLocalDiscoveryPaths(const QStringList &paths)
+{
+    QMutexLocker locker(&_mutex);
+    if (paths.isEmpty() || !checkConnect()) {
+        return;
+    }
+
+    startTransaction();
+
+    SqlQuery insQuery("INSERT OR IGNORE INTO localdiscovery VALUES (?1)", _db);
+    for (const auto &path : paths) {
+        insQuery.reset_and_clear_bindings();
+        insQuery.bindValue(1, path);
+        if (!insQuery.exec()) {
+            qCWarning(lcDb) << "SQL error when inserting into local discovery paths" << path << insQuery.error();
+        }
+    }
+
+    commitInternal(QStringLiteral("addLocalDiscoveryPaths"));
+}
+
+void SyncJournalDb::setLocalDiscoveryPaths(const QStringList &paths)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    startTransaction();
+
+    SqlQuery delQuery("DELETE FROM localdiscovery", _db);
+    if (!delQuery.exec()) {
+        qCWarning(lcDb) << "SQL error when deleting local discovery paths" << delQuery.error();
+    }
+
+    SqlQuery insQuery("INSERT OR IGNORE INTO localdiscovery VALUES (?1)", _db);
+    for (const auto &path : paths) {
+        insQuery.reset_and_clear_bindings();
+        insQuery.bindValue(1, path);
+        if (!insQuery.exec()) {
+            qCWarning(lcDb) << "SQL error when inserting into local discovery paths" << path << insQuery.error();
+        }
+    }
+
+    commitInternal(QStringLiteral("setLocalDiscoveryPaths"));
+}
+
 void SyncJournalDb::avoidRenamesOnNextSync(const QByteArray &path)
 {
     QMutexLocker locker(&_mutex);
@@ -2462,6 +2735,36 @@ void SyncJournalDb::setDataFingerprint(const QByteArray &dataFingerprint)
     }
 }
 
+void SyncJournalDb::setSyncToken(const QByteArray &syncToken)
+{
+    keyValueStoreSet(QStringLiteral("sync_token"), QString::fromUtf8(syncToken));
+}
+
+QByteArray SyncJournalDb::syncToken()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return QByteArray();
+    }
+
+    const auto query = _queryManager.get(PreparedSqlQueryManager::GetKeyValueStoreQuery, QByteArrayLiteral("SELECT value FROM key_value_store WHERE key=?1"), _db);
+    if (!query) {
+        qCDebug(lcDb) << "database error:" << query->error();
+        return QByteArray();
+    }
+
+    query->bindValue(1, QStringLiteral("sync_token"));
+    if (!query->exec()) {
+        qCDebug(lcDb) << "database error:" << query->error();
+        return QByteArray();
+    }
+
+    if (!query->next().hasData) {
+        return QByteArray();
+    }
+    return query->baValue(0);
+}
+
 void SyncJournalDb::setConflictRecord(const ConflictRecord &record)
 {
     QMutexLocker locker(&_mutex);
@@ -3055,8 +3358,12 @@ bool SyncJournalDb::isOpen()
 
 void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
+    SyncTraceScope traceScope(SyncTrace::Category::Database, "commit", context);
     qCDebug(lcDb) << "Transaction commit" << context << (startTrans ? "and starting new transaction" : "");
+    QElapsedTimer commitDuration;
+    commitDuration.start();
     commitTransaction();
+    SyncMetrics::journalCommitDuration().observe(std::chrono::nanoseconds(commitDuration.nsecsElapsed()));
 
     if (startTrans) {
         startTransaction();
@@ -3071,20 +3378,36 @@ SyncJournalDb::~SyncJournalDb()
 }
 
 
+bool operator==(const SyncJournalDb::DownloadSegment &lhs,
+    const SyncJournalDb::DownloadSegment &rhs)
+{
+    return lhs._start == rhs._start
+        && lhs._end == rhs._end
+        && lhs._done == rhs._done;
+}
+
 bool operator==(const SyncJournalDb::DownloadInfo &lhs,
     const SyncJournalDb::DownloadInfo &rhs)
 {
     return lhs._errorCount == rhs._errorCount
         && lhs._etag == rhs._etag
         && lhs._tmpfile == rhs._tmpfile
-        && lhs._valid == rhs._valid;
+        && lhs._valid == rhs._valid
+        && lhs._segments == rhs._segments;
+}
+
+bool operator==(const SyncJournalDb::UploadChunk &lhs,
+    const SyncJournalDb::UploadChunk &rhs)
+{
+    return lhs._number == rhs._number && lhs._offset == rhs._offset && lhs._size == rhs._size && lhs._done == rhs._done;
 }
 
 bool operator==(const SyncJournalDb::UploadInfo &lhs,
     const SyncJournalDb::UploadInfo &rhs)
 {
     return lhs._errorCount == rhs._errorCount && lhs._chunkUploadV1 == rhs._chunkUploadV1 && lhs._modtime == rhs._modtime && lhs._valid == rhs._valid
-        && lhs._size == rhs._size && lhs._transferid == rhs._transferid && lhs._contentChecksum == rhs._contentChecksum;
+        && lhs._size == rhs._size && lhs._transferid == rhs._transferid && lhs._contentChecksum == rhs._contentChecksum
+        && lhs._chunks == rhs._chunks;
 }
 
 QDebug& operator<<(QDebug &stream, const SyncJournalFileRecord::EncryptionStatus status)
@@ -67,6 +67,12 @@ public:
     [[nodiscard]] bool getFileRecordByE2eMangledName(const QString &mangledName, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     [[nodiscard]] bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /**
+     * Looks up the records of all \a filenames with a few queries instead of one per path.
+     *
+     * rowCallback is only called for the paths that have a record, in no particular order.
+     */
+    [[nodiscard]] bool getFileRecords(const QByteArrayList &filenames, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     [[nodiscard]] bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     [[nodiscard]] bool listFilesInPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
     [[nodiscard]] Result<void, QString> setFileRecord(const SyncJournalFileRecord &record);
@@ -109,13 +115,43 @@ public:
     [[nodiscard]] int wipeErrorBlacklist();
     int errorBlackListEntryCount();
 
+    /**
+     * A byte range of a segmented download, see DownloadInfo::_segments.
+     */
+    struct DownloadSegment
+    {
+        qint64 _start = 0; // offset of the first byte of the segment
+        qint64 _end = 0; // offset of the last byte of the segment
+        qint64 _done = 0; // bytes from _start that are already in the temporary file
+
+        [[nodiscard]] qint64 size() const { return _end - _start + 1; }
+        [[nodiscard]] bool isComplete() const { return _done >= size(); }
+    };
+
     struct DownloadInfo
     {
         QString _tmpfile;
         QByteArray _etag;
         int _errorCount = 0;
         bool _valid = false;
+        /**
+         * Set if the file is downloaded in several parallel segments.
+         * The size of the temporary file can't be used to resume then.
+         */
+        QVector<DownloadSegment> _segments;
+    };
+
+    /**
+     * A chunk of a chunked upload (v2) that was sent to the server, see UploadInfo::_chunks.
+     */
+    struct UploadChunk
+    {
+        int _number = 0; // the chunk's name in the upload folder
+        qint64 _offset = 0;
+        qint64 _size = 0;
+        bool _done = false; // whether the server confirmed the chunk
     };
+
     struct UploadInfo
     {
         int _chunkUploadV1 = 0;
@@ -125,6 +161,12 @@ public:
         int _errorCount = 0;
         bool _valid = false;
         QByteArray _contentChecksum;
+        /**
+         * The chunks that were started for a chunked upload (v2), in the order
+         * they were started. They may complete in any order, so on resume
+         * the server's chunks can't be assumed to be contiguous.
+         */
+        QVector<UploadChunk> _chunks;
         /**
          * Returns true if this entry refers to a chunked upload that can be continued.
          * (As opposed to a small file transfer which is stored in the db so we can detect the case
@@ -183,6 +225,13 @@ public:
     /* Write the selective sync list (remove all other entries of that list */
     void setSelectiveSyncList(SelectiveSyncListType type, const QStringList &list);
 
+    /* return the paths the next local discovery must check, see LocalDiscoveryTracker */
+    QStringList getLocalDiscoveryPaths(bool *ok);
+    /* Add to the paths the next local discovery must check */
+    void addLocalDiscoveryPaths(const QStringList &paths);
+    /* Write the paths the next local discovery must check (remove all other entries) */
+    void setLocalDiscoveryPaths(const QStringList &paths);
+
     /**
      * Make sure that on the next sync fileName and its parents are discovered from the server.
      *
@@ -246,6 +295,13 @@ public:
     void setDataFingerprint(const QByteArray &dataFingerprint);
     QByteArray dataFingerprint();
 
+    /**
+     * The WebDAV sync-token (RFC 6578) of the remote folder as of the last
+     * successful sync, empty if the server doesn't hand out any
+     */
+    void setSyncToken(const QByteArray &syncToken);
+    QByteArray syncToken();
+
 
     // Conflict record functions
 
@@ -452,10 +508,16 @@ private:
     PreparedSqlQueryManager _queryManager;
 };
 
+bool OCSYNC_EXPORT
+operator==(const SyncJournalDb::DownloadSegment &lhs,
+    const SyncJournalDb::DownloadSegment &rhs);
 bool OCSYNC_EXPORT
 operator==(const SyncJournalDb::DownloadInfo &lhs,
     const SyncJournalDb::DownloadInfo &rhs);
 bool OCSYNC_EXPORT
+operator==(const SyncJournalDb::UploadChunk &lhs,
+    const SyncJournalDb::UploadChunk &rhs);
+bool OCSYNC_EXPORT
 operator==(const SyncJournalDb::UploadInfo &lhs,
     const SyncJournalDb::UploadInfo &rhs);
 
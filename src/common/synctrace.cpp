@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "synctrace.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QThread>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSyncTrace, "nextcloud.common.synctrace", QtInfoMsg)
+
+std::atomic<bool> SyncTrace::_enabled{false};
+
+namespace {
+
+    /* The trace starts with a header:
+     *   quint32 magic, quint16 version, qint64 wall clock time of the start in ms since the epoch
+     * followed by records, each starting with its quint8 type:
+     *   NameRecord:   quint32 name id, QByteArray name
+     *   ThreadRecord: quint32 thread id, QByteArray thread name
+     *   EventRecord:  quint8 phase, quint8 category, quint32 name id, quint32 thread id,
+     *                 qint64 ns since the start, quint64 async id, QByteArray detail
+     * Names and threads are defined before the first event using them.
+     */
+    constexpr quint32 TraceMagic = 0x4e435452; // "NCTR"
+    constexpr quint16 TraceVersion = 1;
+    constexpr auto TraceStreamVersion = QDataStream::Qt_5_15;
+
+    enum RecordType : quint8 {
+        NameRecord = 1,
+        ThreadRecord = 2,
+        EventRecord = 3,
+    };
+
+    struct TraceThread
+    {
+        quint32 _generation = 0;
+        quint32 _id = 0;
+    };
+
+    struct TraceWriter
+    {
+        ~TraceWriter()
+        {
+            QMutexLocker lock(&_mutex);
+            _file.close();
+        }
+
+        QMutex _mutex;
+        QFile _file;
+        QDataStream _stream;
+        QElapsedTimer _clock;
+        QHash<const char *, quint32> _names;
+        quint32 _nextThreadId = 0;
+        // Tells the thread ids of an earlier trace apart
+        quint32 _generation = 0;
+    };
+
+    TraceWriter &traceWriter()
+    {
+        static TraceWriter writer;
+        return writer;
+    }
+
+    thread_local TraceThread currentTraceThread;
+
+    const char *categoryName(quint8 category)
+    {
+        switch (static_cast<SyncTrace::Category>(category)) {
+        case SyncTrace::Category::Sync:
+            return "sync";
+        case SyncTrace::Category::Discovery:
+            return "discovery";
+        case SyncTrace::Category::Network:
+            return "network";
+        case SyncTrace::Category::Propagation:
+            return "propagation";
+        case SyncTrace::Category::Database:
+            return "database";
+        case SyncTrace::Category::Checksum:
+            return "checksum";
+        }
+        return "unknown";
+    }
+
+    QString currentThreadName(quint32 id)
+    {
+        const auto thread = QThread::currentThread();
+        if (thread && !thread->objectName().isEmpty()) {
+            return thread->objectName();
+        }
+        if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+            return QStringLiteral("main");
+        }
+        return QStringLiteral("thread %1").arg(id);
+    }
+
+}
+
+bool SyncTrace::start(const QString &fileName)
+{
+    auto &writer = traceWriter();
+    QMutexLocker lock(&writer._mutex);
+    _enabled.store(false, std::memory_order_relaxed);
+    writer._file.close();
+    writer._names.clear();
+    writer._nextThreadId = 0;
+    ++writer._generation;
+
+    writer._file.setFileName(fileName);
+    if (!writer._file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcSyncTrace) << "Could not open the sync trace" << fileName << writer._file.errorString();
+        return false;
+    }
+    writer._stream.setDevice(&writer._file);
+    writer._stream.setVersion(TraceStreamVersion);
+    writer._stream << TraceMagic << TraceVersion << QDateTime::currentMSecsSinceEpoch();
+    writer._clock.start();
+
+    qCInfo(lcSyncTrace) << "Tracing sync runs into" << fileName;
+    _enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void SyncTrace::startFromEnvironment()
+{
+    if (isEnabled()) {
+        return;
+    }
+    static const auto fileName = qEnvironmentVariable("OWNCLOUD_SYNC_TRACE");
+    if (!fileName.isEmpty()) {
+        start(fileName);
+    }
+}
+
+void SyncTrace::stop()
+{
+    auto &writer = traceWriter();
+    QMutexLocker lock(&writer._mutex);
+    _enabled.store(false, std::memory_order_relaxed);
+    writer._stream.setDevice(nullptr);
+    writer._file.close();
+}
+
+void SyncTrace::flush()
+{
+    auto &writer = traceWriter();
+    QMutexLocker lock(&writer._mutex);
+    if (writer._file.isOpen()) {
+        writer._file.flush();
+    }
+}
+
+void SyncTrace::record(char phase, Category category, const char *name, quint64 id, const QString &detail)
+{
+    auto &writer = traceWriter();
+    QMutexLocker lock(&writer._mutex);
+    if (!writer._file.isOpen()) {
+        // Stopped since isEnabled() was checked
+        return;
+    }
+    const auto timestamp = writer._clock.nsecsElapsed();
+
+    auto &thread = currentTraceThread;
+    if (thread._generation != writer._generation) {
+        thread._generation = writer._generation;
+        thread._id = ++writer._nextThreadId;
+        writer._stream << quint8(ThreadRecord) << thread._id << currentThreadName(thread._id).toUtf8();
+    }
+
+    auto nameIt = writer._names.constFind(name);
+    if (nameIt == writer._names.cend()) {
+        nameIt = writer._names.insert(name, writer._names.size() + 1);
+        writer._stream << quint8(NameRecord) << nameIt.value() << QByteArray(name);
+    }
+
+    writer._stream << quint8(EventRecord) << quint8(phase) << quint8(category) << nameIt.value() << thread._id
+                   << qint64(timestamp) << id << detail.toUtf8();
+}
+
+bool SyncTrace::convertToChromeTrace(QIODevice *trace, QIODevice *json, QString *errorString)
+{
+    const auto fail = [errorString](const QString &error) {
+        if (errorString) {
+            *errorString = error;
+        }
+        return false;
+    };
+
+    QDataStream in(trace);
+    in.setVersion(TraceStreamVersion);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint64 startMsecs = 0;
+    in >> magic >> version >> startMsecs;
+    if (in.status() != QDataStream::Ok || magic != TraceMagic) {
+        return fail(QStringLiteral("Not a sync trace"));
+    }
+    if (version > TraceVersion) {
+        return fail(QStringLiteral("Unsupported sync trace version %1").arg(version));
+    }
+
+    auto firstEvent = true;
+    const auto writeEvent = [&](const QJsonObject &event) {
+        json->write(firstEvent ? "\n" : ",\n");
+        json->write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+        firstEvent = false;
+    };
+
+    json->write("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"startTime\":\"");
+    json->write(QDateTime::fromMSecsSinceEpoch(startMsecs).toString(Qt::ISODateWithMs).toUtf8());
+    json->write("\"},\"traceEvents\":[");
+    writeEvent({
+        {QStringLiteral("name"), QStringLiteral("process_name")},
+        {QStringLiteral("ph"), QStringLiteral("M")},
+        {QStringLiteral("pid"), 1},
+        {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), QCoreApplication::applicationName()}}},
+    });
+
+    QHash<quint32, QString> names;
+    while (!in.atEnd()) {
+        quint8 type = 0;
+        in >> type;
+        if (type == NameRecord) {
+            quint32 nameId = 0;
+            QByteArray name;
+            in >> nameId >> name;
+            names.insert(nameId, QString::fromUtf8(name));
+        } else if (type == ThreadRecord) {
+            quint32 threadId = 0;
+            QByteArray threadName;
+            in >> threadId >> threadName;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            writeEvent({
+                {QStringLiteral("name"), QStringLiteral("thread_name")},
+                {QStringLiteral("ph"), QStringLiteral("M")},
+                {QStringLiteral("pid"), 1},
+                {QStringLiteral("tid"), static_cast<qint64>(threadId)},
+                {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), QString::fromUtf8(threadName)}}},
+            });
+        } else if (type == EventRecord) {
+            quint8 phase = 0;
+            quint8 category = 0;
+            quint32 nameId = 0;
+            quint32 threadId = 0;
+            qint64 timestamp = 0;
+            quint64 id = 0;
+            QByteArray detail;
+            in >> phase >> category >> nameId >> threadId >> timestamp >> id >> detail;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            QJsonObject event{
+                {QStringLiteral("name"), names.value(nameId)},
+                {QStringLiteral("cat"), QString::fromLatin1(categoryName(category))},
+                {QStringLiteral("ph"), QString(QLatin1Char(static_cast<char>(phase)))},
+                {QStringLiteral("ts"), static_cast<double>(timestamp) / 1000.0},
+                {QStringLiteral("pid"), 1},
+                {QStringLiteral("tid"), static_cast<qint64>(threadId)},
+            };
+            if (phase == 'b' || phase == 'e') {
+                event.insert(QStringLiteral("id"), QStringLiteral("0x%1").arg(id, 0, 16));
+            }
+            if (!detail.isEmpty()) {
+                event.insert(QStringLiteral("args"), QJsonObject{{QStringLiteral("detail"), QString::fromUtf8(detail)}});
+            }
+            writeEvent(event);
+        } else {
+            return fail(QStringLiteral("Unknown record type %1 in the sync trace").arg(type));
+        }
+
+        if (in.status() != QDataStream::Ok) {
+            // Cut short, keep what was complete
+            break;
+        }
+    }
+
+    json->write("\n]}\n");
+    return true;
+}
+
+}
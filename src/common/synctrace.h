@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+
+#include <QString>
+
+#include <atomic>
+
+class QIODevice;
+
+namespace OCC {
+
+/**
+ * @brief Opt-in binary trace of sync runs
+ *
+ * Records spans for the sync run, the discovery of each directory, network
+ * requests, propagation jobs, journal writes and checksum computations. Each
+ * event carries the thread and a monotonic timestamp. The events are written
+ * in a compact binary format to the file named by the OWNCLOUD_SYNC_TRACE
+ * environment variable, or the one passed to start().
+ *
+ * convertToChromeTrace() turns a trace into the JSON format that Chrome's
+ * trace viewer and Perfetto open; nextcloudtracetojson does that from the
+ * command line.
+ *
+ * When tracing is off, each trace call costs one relaxed atomic load. Callers
+ * that have to build the detail string check isEnabled() first.
+ *
+ * @ingroup libsync
+ */
+class OCSYNC_EXPORT SyncTrace
+{
+public:
+    enum class Category : quint8 {
+        Sync,
+        Discovery,
+        Network,
+        Propagation,
+        Database,
+        Checksum,
+    };
+
+    [[nodiscard]] static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    /** Starts tracing into \a fileName, replacing an earlier trace. Returns false if the file can't be written. */
+    static bool start(const QString &fileName);
+    /** Starts tracing if OWNCLOUD_SYNC_TRACE names a file and tracing isn't on yet */
+    static void startFromEnvironment();
+    static void stop();
+    /** Writes the buffered events to the file */
+    static void flush();
+
+    /** Spans nested like function calls on one thread. \a name must stay valid, e.g. a string literal. */
+    static void begin(Category category, const char *name, const QString &detail = {})
+    {
+        if (isEnabled()) {
+            record('B', category, name, 0, detail);
+        }
+    }
+    static void end(Category category, const char *name, const QString &detail = {})
+    {
+        if (isEnabled()) {
+            record('E', category, name, 0, detail);
+        }
+    }
+
+    /** Spans that end in a later event, told apart by \a id, typically the address of the object doing the work */
+    static void asyncBegin(Category category, const char *name, const void *id, const QString &detail = {})
+    {
+        if (isEnabled()) {
+            record('b', category, name, reinterpret_cast<quintptr>(id), detail);
+        }
+    }
+    static void asyncEnd(Category category, const char *name, const void *id, const QString &detail = {})
+    {
+        if (isEnabled()) {
+            record('e', category, name, reinterpret_cast<quintptr>(id), detail);
+        }
+    }
+
+    /** Converts the binary \a trace to Chrome's JSON trace event format.
+     *
+     * A trace cut short, e.g. by a crash, is converted up to the last complete event.
+     */
+    static bool convertToChromeTrace(QIODevice *trace, QIODevice *json, QString *errorString = nullptr);
+
+private:
+    static void record(char phase, Category category, const char *name, quint64 id, const QString &detail);
+
+    static std::atomic<bool> _enabled;
+};
+
+/**
+ * @brief Traces the lifetime of the scope as a span
+ */
+class SyncTraceScope
+{
+public:
+    SyncTraceScope(SyncTrace::Category category, const char *name, const QString &detail = {})
+        : _category(category)
+        , _name(name)
+        , _active(SyncTrace::isEnabled())
+    {
+        if (_active) {
+            SyncTrace::begin(_category, _name, detail);
+        }
+    }
+    ~SyncTraceScope()
+    {
+        if (_active) {
+            SyncTrace::end(_category, _name);
+        }
+    }
+    Q_DISABLE_COPY(SyncTraceScope)
+
+private:
+    SyncTrace::Category _category;
+    const char *_name;
+    bool _active;
+};
+
+}
@@ -28,6 +28,7 @@
 #include "folder.h"
 #include "folderman.h"
 #include "logger.h"
+#include "metricsserver.h"
 #include "configfile.h"
 #include "socketapi/socketapi.h"
 #include "sslerrordialog.h"
@@ -386,6 +387,10 @@ Application::Application(int &argc, char **argv)
     _shellExtensionsServer.reset(new ShellExtensionsServer);
 #endif
 
+    if (ConfigFile().serveMetrics()) {
+        _metricsServer.reset(new MetricsServer);
+    }
+
     connect(this, &SharedTools::QtSingleApplication::messageReceived, this, &Application::slotParseMessage);
 
     // create accounts and folders from a legacy desktop client or from the current config file
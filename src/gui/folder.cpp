@@ -47,6 +47,8 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QApplication>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include <type_traits>
 
 namespace {
@@ -54,6 +56,24 @@ namespace {
 #define VERSION_C
 constexpr auto versionC = "version";
 #endif
+
+// Written on a clean shutdown when the local discovery can continue in the next run
+const auto watcherStoppedAtKey = QStringLiteral("watcher_stopped_at");
+const auto watcherStoppedRootModTimeKey = QStringLiteral("watcher_stopped_root_mtime");
+const auto lastFullLocalDiscoveryKey = QStringLiteral("last_full_local_discovery");
+
+std::chrono::milliseconds fullLocalDiscoveryInterval()
+{
+    static const auto interval = []() {
+        auto interval = OCC::ConfigFile().fullLocalDiscoveryInterval();
+        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
+        if (!env.isEmpty()) {
+            interval = std::chrono::milliseconds(env.toLongLong());
+        }
+        return interval;
+    }();
+    return interval;
+}
 }
 
 namespace OCC {
@@ -129,6 +149,7 @@ Folder::Folder(const FolderDefinition &definition,
         _localDiscoveryTracker.data(), &LocalDiscoveryTracker::slotSyncFinished);
     connect(_engine.data(), &SyncEngine::itemCompleted,
         _localDiscoveryTracker.data(), &LocalDiscoveryTracker::slotItemCompleted);
+    restoreLocalDiscoveryState();
 
     connect(_accountState->account().data(), &Account::capabilitiesChanged, this, &Folder::slotCapabilitiesChanged);
 
@@ -155,9 +176,12 @@ Folder::Folder(const FolderDefinition &definition,
 
 Folder::~Folder()
 {
-    // If wipeForRemoval() was called the vfs has already shut down.
-    if (_vfs)
+    // If wipeForRemoval() was called the vfs has already shut down
+    // and the journal is gone.
+    if (_vfs) {
+        saveLocalDiscoveryState();
         _vfs->stop();
+    }
 
     // Reset then engine first as it will abort and try to access members of the Folder
     _engine.reset();
@@ -562,38 +586,44 @@ int Folder::slotWipeErrorBlacklist()
 
 void Folder::slotWatchedPathChanged(const QStringView &path, const ChangeReason reason)
 {
-    if (!path.startsWith(this->path())) {
-        qCDebug(lcFolder) << "Changed path is not contained in folder, ignoring:" << path;
-        return;
-    }
+    slotWatchedPathsChanged({path.toString()}, reason);
+}
 
-    auto relativePath = path.mid(this->path().size());
+void Folder::slotWatchedPathsChanged(const QSet<QString> &paths, const ChangeReason reason)
+{
+    QVector<WatchedPathChange> changes;
+    QStringList touchedPaths;
+    changes.reserve(paths.size());
+    touchedPaths.reserve(paths.size());
 
-    if (_vfs) {
-        if (pathIsIgnored(path.toString())) {
-            const auto pinState = _vfs->pinState(relativePath.toString());
-            if (!pinState || *pinState != PinState::Excluded) {
-                if (!_vfs->setPinState(relativePath.toString(), PinState::Excluded)) {
-                    qCWarning(lcFolder) << "Could not set pin state of" << relativePath << "to excluded";
+    for (const auto &path : paths) {
+        if (!path.startsWith(this->path())) {
+            qCDebug(lcFolder) << "Changed path is not contained in folder, ignoring:" << path;
+            continue;
+        }
+
+        const auto relativePath = path.mid(this->path().size());
+
+        if (_vfs) {
+            if (pathIsIgnored(path)) {
+                const auto pinState = _vfs->pinState(relativePath);
+                if (!pinState || *pinState != PinState::Excluded) {
+                    if (!_vfs->setPinState(relativePath, PinState::Excluded)) {
+                        qCWarning(lcFolder) << "Could not set pin state of" << relativePath << "to excluded";
+                    }
                 }
-            }
-            return;
-        } else {
-            const auto pinState = _vfs->pinState(relativePath.toString());
-            if (pinState && *pinState == PinState::Excluded) {
-                if (!_vfs->setPinState(relativePath.toString(), PinState::Inherited)) {
-                    qCWarning(lcFolder) << "Could not switch pin state of" << relativePath << "from" << *pinState << "to inherited";
+                continue;
+            } else {
+                const auto pinState = _vfs->pinState(relativePath);
+                if (pinState && *pinState == PinState::Excluded) {
+                    if (!_vfs->setPinState(relativePath, PinState::Inherited)) {
+                        qCWarning(lcFolder) << "Could not switch pin state of" << relativePath << "from" << *pinState << "to inherited";
+                    }
                 }
             }
         }
-    }
 
-    // Add to list of locally modified paths
-    //
-    // We do this before checking for our own sync-related changes to make
-    // extra sure to not miss relevant changes.
-    auto relativePathBytes = relativePath.toUtf8();
-    _localDiscoveryTracker->addTouchedPath(relativePathBytes);
+        touchedPaths.append(relativePath);
 
 // The folder watcher fires a lot of bogus notifications during
 // a sync operation, both for actual user files and the database
@@ -603,52 +633,111 @@ void Folder::slotWatchedPathChanged(const QStringView &path, const ChangeReason
 // On OSX the folder watcher does not report changes done by our
 // own process. Therefore nothing needs to be done here!
 #else
-    // Use the path to figure out whether it was our own change
-    if (_engine->wasFileTouched(path.toString())) {
-        qCDebug(lcFolder) << "Changed path was touched by SyncEngine, ignoring:" << path;
+        // Use the path to figure out whether it was our own change
+        if (_engine->wasFileTouched(path)) {
+            qCDebug(lcFolder) << "Changed path was touched by SyncEngine, ignoring:" << path;
+            continue;
+        }
+#endif
+
+        changes.append({path, relativePath});
+    }
+
+    // Add to list of locally modified paths
+    //
+    // We do this before checking for our own sync-related changes to make
+    // extra sure to not miss relevant changes.
+    _localDiscoveryTracker->addTouchedPaths(touchedPaths);
+
+    if (changes.isEmpty()) {
+        return;
+    }
+
+    QHash<QString, int> changeIndexes;
+    QByteArrayList relativePaths;
+    changeIndexes.reserve(changes.size());
+    relativePaths.reserve(changes.size());
+    for (int i = 0; i < changes.size(); ++i) {
+        changeIndexes.insert(changes.at(i)._relativePath, i);
+        relativePaths.append(changes.at(i)._relativePath.toUtf8());
+    }
+    const auto recordsFound = _journal.getFileRecords(relativePaths, [&changes, &changeIndexes](const SyncJournalFileRecord &record) {
+        const auto it = changeIndexes.constFind(record.path());
+        if (it != changeIndexes.cend()) {
+            changes[it.value()]._record = record;
+        }
+    });
+    if (!recordsFound) {
+        qCWarning(lcFolder) << "could not get files from local DB" << relativePaths.size();
+    }
+
+    if (reason == ChangeReason::UnLock) {
+        finishWatchedPathChanges(changes, reason);
         return;
     }
-#endif
 
+    // Check that the mtime/size actually changed
+    const auto checkChanged = [](WatchedPathChange change) {
+        change._changed = !change._record.isValid() || FileSystem::fileChanged(change._path, change._record._fileSize, change._record._modtime);
+        return change;
+    };
 
-    SyncJournalFileRecord record;
-    if (!_journal.getFileRecord(relativePathBytes, &record)) {
-        qCWarning(lcFolder) << "could not get file from local DB" << relativePathBytes;
-    }
-    if (reason != ChangeReason::UnLock) {
-        // Check that the mtime/size actually changed or there was
-        // an attribute change (pin state) that caused the notification
-        bool spurious = false;
-        if (record.isValid()
-            && !FileSystem::fileChanged(path.toString(), record._fileSize, record._modtime) && _vfs) {
-            spurious = true;
-
-            if (auto pinState = _vfs->pinState(relativePath.toString())) {
-                if (*pinState == PinState::AlwaysLocal && record.isVirtualFile()) {
+    // A few paths are quicker to check right here; a burst of changes, like a
+    // large copy into the folder, is stat'ed on the thread pool.
+    constexpr auto maxChangesCheckedInline = 64;
+    if (changes.size() <= maxChangesCheckedInline) {
+        for (auto &change : changes) {
+            change = checkChanged(change);
+        }
+        finishWatchedPathChanges(changes, reason);
+        return;
+    }
+
+    const auto watcher = new QFutureWatcher<WatchedPathChange>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, reason] {
+        finishWatchedPathChanges(watcher->future().results().toVector(), reason);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::mapped(changes, checkChanged));
+}
+
+void Folder::finishWatchedPathChanges(const QVector<WatchedPathChange> &changes, const ChangeReason reason)
+{
+    auto changedExternally = false;
+    for (const auto &change : changes) {
+        if (reason != ChangeReason::UnLock && !change._changed && _vfs) {
+            // The mtime/size didn't change: check whether there was an attribute
+            // change (pin state) that caused the notification
+            auto spurious = true;
+            if (auto pinState = _vfs->pinState(change._relativePath)) {
+                if (*pinState == PinState::AlwaysLocal && change._record.isVirtualFile()) {
                     spurious = false;
                 }
-                if (*pinState == PinState::OnlineOnly && record.isFile()) {
+                if (*pinState == PinState::OnlineOnly && change._record.isFile()) {
                     spurious = false;
                 }
             } else {
                 spurious = false;
             }
-            if (spurious && !_vfs->isPlaceHolderInSync(path.toString())) {
+            if (spurious && !_vfs->isPlaceHolderInSync(change._path)) {
                 spurious = false;
             }
+            if (spurious) {
+                qCInfo(lcFolder) << "Ignoring spurious notification for file" << change._relativePath;
+                continue; // probably a spurious notification
+            }
         }
-        if (spurious) {
-            qCInfo(lcFolder) << "Ignoring spurious notification for file" << relativePath;
-            return; // probably a spurious notification
-        }
-    }
-    warnOnNewExcludedItem(record, relativePath);
+        warnOnNewExcludedItem(change._record, change._relativePath);
 
-    emit watchedFileChangedExternally(path.toString());
+        emit watchedFileChangedExternally(change._path);
+        changedExternally = true;
+    }
 
-    // Also schedule this folder for a sync, but only after some delay:
-    // The sync will not upload files that were changed too recently.
-    scheduleThisFolderSoon();
+    if (changedExternally) {
+        // Also schedule this folder for a sync, but only after some delay:
+        // The sync will not upload files that were changed too recently.
+        scheduleThisFolderSoon();
+    }
 }
 
 void Folder::slotFilesLockReleased(const QSet<QString> &files)
@@ -1057,24 +1146,17 @@ void Folder::startSync(const QStringList &pathList)
     setDirtyNetworkLimits();
     syncEngine().setSyncOptions(initializeSyncOptions());
 
-    static std::chrono::milliseconds fullLocalDiscoveryInterval = []() {
-        auto interval = ConfigFile().fullLocalDiscoveryInterval();
-        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
-        if (!env.isEmpty()) {
-            interval = std::chrono::milliseconds(env.toLongLong());
-        }
-        return interval;
-    }();
+    const auto fullLocalDiscoveryInterval = ::fullLocalDiscoveryInterval();
     bool hasDoneFullLocalDiscovery = _timeSinceLastFullLocalDiscovery.isValid();
     bool periodicFullLocalDiscoveryNow =
         fullLocalDiscoveryInterval.count() >= 0 // negative means we don't require periodic full runs
-        && _timeSinceLastFullLocalDiscovery.hasExpired(fullLocalDiscoveryInterval.count());
+        && _timeSinceLastFullLocalDiscovery.hasExpired((fullLocalDiscoveryInterval - _fullLocalDiscoveryAgeAtStart).count());
 
     if (singleItemDiscoveryOptions.isValid() && singleItemDiscoveryOptions.discoveryPath != QStringLiteral("/")) {
         qCInfo(lcFolder) << "Going to sync just one file";
         _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, {singleItemDiscoveryOptions.discoveryPath});
         _localDiscoveryTracker->startSyncPartialDiscovery();
-    } else if (_folderWatcher && _folderWatcher->isReliable()
+    } else if (_folderWatcher && _folderWatcher->isReliable() && (_folderWatcher->isReady() || _localDiscoveryContinued)
         && hasDoneFullLocalDiscovery
         && !periodicFullLocalDiscoveryNow) {
         qCInfo(lcFolder) << "Allowing local discovery to read from the database";
@@ -1121,13 +1203,13 @@ SyncOptions Folder::initializeSyncOptions() const
     opt._confirmExternalStorage = cfgFile.confirmExternalStorage();
     opt._moveFilesToTrash = cfgFile.moveToTrash();
     opt._vfs = _vfs;
-    opt._parallelNetworkJobs = _accountState->account()->isHttp2Supported() ? 20 : 6;
 
     // Chunk V2: Size of chunks must be between 5MB and 5GB, except for the last chunk which can be smaller
     opt.setMinChunkSize(cfgFile.minChunkSize());
     opt.setMaxChunkSize(cfgFile.maxChunkSize());
     opt._initialChunkSize = ::qBound(opt.minChunkSize(), cfgFile.chunkSize(), opt.maxChunkSize());
     opt._targetChunkUploadDuration = cfgFile.targetChunkUploadDuration();
+    opt._parallelChunkUploads = cfgFile.parallelChunkUploads();
 
     opt.fillFromEnvironmentVariables();
     opt.verifyChunkSizes();
@@ -1232,6 +1314,8 @@ void Folder::slotSyncFinished(bool success)
         && success) {
         if (_engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly) {
             _timeSinceLastFullLocalDiscovery.start();
+            _fullLocalDiscoveryAgeAtStart = {};
+            _localDiscoveryContinued = false;
         }
     }
 
@@ -1452,6 +1536,71 @@ void Folder::slotNextSyncFullLocalDiscovery()
     _timeSinceLastFullLocalDiscovery.invalidate();
 }
 
+void Folder::slotWatcherBecameReady()
+{
+    // Changes made while the watches were being set up may have been missed.
+    // When continuing from the previous run they are accepted like the ones
+    // made while the client wasn't running: the periodic full local
+    // discovery picks them up.
+    if (!_localDiscoveryContinued) {
+        slotNextSyncFullLocalDiscovery();
+    }
+}
+
+void Folder::restoreLocalDiscoveryState()
+{
+    _localDiscoveryTracker->setJournal(&_journal);
+
+    const auto stoppedAt = _journal.keyValueStoreGetInt(watcherStoppedAtKey, 0);
+    if (stoppedAt == 0) {
+        return;
+    }
+    // Clear the marker right away: it must not survive a crash of this run
+    _journal.keyValueStoreSet(watcherStoppedAtKey, 0);
+
+    // The watcher of the previous run reported every change until the clean
+    // shutdown. Changes made while the client wasn't running can't be seen;
+    // the root mtime catches entries added or removed at the top level, and
+    // the periodic full local discovery stays due when it would have been.
+    const auto rootModTime = _journal.keyValueStoreGetInt(watcherStoppedRootModTimeKey, -1);
+    const auto lastFullLocalDiscovery = _journal.keyValueStoreGetInt(lastFullLocalDiscoveryKey, 0);
+    const auto fullLocalDiscoveryAge = std::chrono::milliseconds(QDateTime::currentMSecsSinceEpoch() - lastFullLocalDiscovery);
+    const auto interval = fullLocalDiscoveryInterval();
+    if (rootModTime != FileSystem::getModTime(path())
+        || lastFullLocalDiscovery == 0
+        || fullLocalDiscoveryAge.count() < 0
+        || (interval.count() >= 0 && fullLocalDiscoveryAge >= interval)) {
+        qCInfo(lcFolder) << "Can't continue the local discovery of the previous run, stopped at"
+                         << QDateTime::fromMSecsSinceEpoch(stoppedAt);
+        return;
+    }
+
+    qCInfo(lcFolder) << "Continuing the local discovery of the previous run with"
+                     << _localDiscoveryTracker->localDiscoveryPaths().size() << "paths";
+    _timeSinceLastFullLocalDiscovery.start();
+    _fullLocalDiscoveryAgeAtStart = fullLocalDiscoveryAge;
+    _localDiscoveryContinued = true;
+}
+
+void Folder::saveLocalDiscoveryState()
+{
+    _localDiscoveryTracker->flushTouchedPaths();
+
+    // The next run may only rely on the journal if the watcher reported every
+    // change since the last full local discovery
+    if (!_folderWatcher || !_folderWatcher->isReliable()
+        || !(_folderWatcher->isReady() || _localDiscoveryContinued)
+        || !_timeSinceLastFullLocalDiscovery.isValid()) {
+        return;
+    }
+
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    _journal.keyValueStoreSet(lastFullLocalDiscoveryKey,
+        now - _timeSinceLastFullLocalDiscovery.elapsed() - _fullLocalDiscoveryAgeAtStart.count());
+    _journal.keyValueStoreSet(watcherStoppedRootModTimeKey, static_cast<qint64>(FileSystem::getModTime(path())));
+    _journal.keyValueStoreSet(watcherStoppedAtKey, now);
+}
+
 void Folder::setSilenceErrorsUntilNextSync(bool silenceErrors)
 {
     _silenceErrorsUntilNextSync = silenceErrors;
@@ -1603,10 +1752,12 @@ void Folder::registerFolderWatcher()
         return;
 
     _folderWatcher.reset(new FolderWatcher(this));
-    connect(_folderWatcher.data(), &FolderWatcher::pathChanged,
-        this, [this](const QString &path) { slotWatchedPathChanged(path, Folder::ChangeReason::Other); });
+    connect(_folderWatcher.data(), &FolderWatcher::pathsChanged,
+        this, [this](const QSet<QString> &paths) { slotWatchedPathsChanged(paths, Folder::ChangeReason::Other); });
     connect(_folderWatcher.data(), &FolderWatcher::lostChanges,
         this, &Folder::slotNextSyncFullLocalDiscovery);
+    connect(_folderWatcher.data(), &FolderWatcher::becameReady,
+        this, &Folder::slotWatcherBecameReady);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
         this, &Folder::slotWatcherUnreliable);
     if (_accountState->account()->capabilities().filesLockAvailable()) {
@@ -1624,8 +1775,9 @@ void Folder::disconnectFolderWatcher()
     if (!_folderWatcher) {
         return;
     }
-    disconnect(_folderWatcher.data(), &FolderWatcher::pathChanged, nullptr, nullptr);
+    disconnect(_folderWatcher.data(), &FolderWatcher::pathsChanged, nullptr, nullptr);
     disconnect(_folderWatcher.data(), &FolderWatcher::lostChanges, this, &Folder::slotNextSyncFullLocalDiscovery);
+    disconnect(_folderWatcher.data(), &FolderWatcher::becameReady, this, &Folder::slotWatcherBecameReady);
     disconnect(_folderWatcher.data(), &FolderWatcher::becameUnreliable, this, &Folder::slotWatcherUnreliable);
     if (_accountState->account()->capabilities().filesLockAvailable()) {
         disconnect(_folderWatcher.data(), &FolderWatcher::filesLockReleased, this, &Folder::slotFilesLockReleased);
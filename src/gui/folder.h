@@ -358,6 +358,12 @@ public slots:
        */
     void slotWatchedPathChanged(const QStringView &path, const OCC::Folder::ChangeReason reason);
 
+    /**
+     * Like slotWatchedPathChanged() for a batch of paths: the journal is queried
+     * once for all of them and large batches are stat'ed on the thread pool.
+     */
+    void slotWatchedPathsChanged(const QSet<QString> &paths, const OCC::Folder::ChangeReason reason);
+
     /*
     * Triggered when lock files were removed
     */
@@ -452,6 +458,9 @@ private slots:
     /** Warn users about an unreliable folder watcher */
     void slotWatcherUnreliable(const QString &message);
 
+    /** The folder watcher watches the whole folder now */
+    void slotWatcherBecameReady();
+
     /** Aborts any running sync and blocks it until hydration is finished.
      *
      * Hydration circumvents the regular SyncEngine and both mustn't be running
@@ -468,6 +477,17 @@ private slots:
     void slotCapabilitiesChanged();
 
 private:
+    /** A path reported by the folder watcher, see slotWatchedPathsChanged() */
+    struct WatchedPathChange
+    {
+        QString _path;
+        QString _relativePath;
+        SyncJournalFileRecord _record;
+        bool _changed = true; // whether size or mtime differ from _record
+    };
+
+    void finishWatchedPathChanges(const QVector<WatchedPathChange> &changes, const ChangeReason reason);
+
     void connectSyncRoot();
 
     bool reloadExcludes();
@@ -496,6 +516,11 @@ private:
 
     void correctPlaceholderFiles();
 
+    /** Picks up the local discovery paths and, if possible, the watcher continuity of the previous run */
+    void restoreLocalDiscoveryState();
+    /** Writes the pending local discovery paths and records whether the next run can continue with them */
+    void saveLocalDiscoveryState();
+
     void appendPathToSelectiveSyncList(const QString &path, const SyncJournalDb::SelectiveSyncListType listType);
     void removePathFromSelectiveSyncList(const QString &path, const SyncJournalDb::SelectiveSyncListType listType);
 
@@ -513,6 +538,10 @@ private:
     QElapsedTimer _timeSinceLastSyncDone;
     QElapsedTimer _timeSinceLastSyncStart;
     QElapsedTimer _timeSinceLastFullLocalDiscovery;
+    /// Age of the last full local discovery when it was carried over from the previous run
+    std::chrono::milliseconds _fullLocalDiscoveryAgeAtStart{0};
+    /// Whether the local discovery continues from the previous run, see restoreLocalDiscoveryState()
+    bool _localDiscoveryContinued = false;
     std::chrono::milliseconds _lastSyncDuration;
 
     /// The number of syncs that failed in a row.
@@ -29,6 +29,7 @@
 
 #include "folder.h"
 #include "filesystem.h"
+#include "common/metrics.h"
 
 #include <QFileInfo>
 #include <QFlags>
@@ -38,10 +39,12 @@
 
 #include <array>
 #include <cstdint>
+#include <utility>
 
 namespace
 {
 constexpr auto lockChangeDebouncingTimerIntervalMs = 500;
+constexpr auto changedPathsTimerIntervalMs = 100;
 }
 
 namespace OCC {
@@ -54,6 +57,12 @@ FolderWatcher::FolderWatcher(Folder *folder)
 {
     _lockChangeDebouncingTimer.setInterval(lockChangeDebouncingTimerIntervalMs);
 
+    // Bursts of notifications, like from copying a large tree into the folder,
+    // are handed on as a single batch
+    _changedPathsTimer.setInterval(changedPathsTimerIntervalMs);
+    _changedPathsTimer.setSingleShot(true);
+    connect(&_changedPathsTimer, &QTimer::timeout, this, &FolderWatcher::flushChangedPaths);
+
     if (_folder && _folder->accountState() && _folder->accountState()->account()) {
         connect(_folder->accountState()->account().data(), &Account::capabilitiesChanged, this, &FolderWatcher::folderAccountCapabilitiesChanged);
         folderAccountCapabilitiesChanged();
@@ -78,6 +87,11 @@ bool FolderWatcher::isReliable() const
     return _isReliable;
 }
 
+bool FolderWatcher::isReady() const
+{
+    return _d && _d->_ready;
+}
+
 void FolderWatcher::appendSubPaths(QDir dir, QStringList& subPaths) {
     QStringList newSubPaths = dir.entryList(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files);
     for (int i = 0; i < newSubPaths.size(); i++) {
@@ -191,6 +205,8 @@ void FolderWatcher::changeDetected(const QStringList &paths)
     //   - what if there is more than one file being updated frequently?
     //   - why do we skip the file altogether instead of e.g. reducing the upload frequency?
 
+    SyncMetrics::watcherEvents().add(paths.size());
+
     // Check if the same path was reported within the last second.
     const auto pathsSet = QSet<QString>{paths.begin(), paths.end()};
     if (pathsSet == _lastPaths && _timer.elapsed() < 1000) {
@@ -249,10 +265,25 @@ void FolderWatcher::changeDetected(const QStringList &paths)
         return;
     }
 
-    qCInfo(lcFolderWatcher) << "Detected changes in paths:" << changedPaths;
+    _changedPaths.unite(changedPaths);
+    if (!_changedPathsTimer.isActive()) {
+        _changedPathsTimer.start();
+    }
+}
+
+void FolderWatcher::flushChangedPaths()
+{
+    if (_changedPaths.isEmpty()) {
+        return;
+    }
+
+    const auto changedPaths = std::exchange(_changedPaths, {});
+    qCInfo(lcFolderWatcher) << "Detected changes in" << changedPaths.size() << "paths";
+    qCDebug(lcFolderWatcher) << "Changed paths:" << changedPaths;
     for (const auto &path : changedPaths) {
         emit pathChanged(path);
     }
+    emit pathsChanged(changedPaths);
 }
 
 void FolderWatcher::folderAccountCapabilitiesChanged()
@@ -69,6 +69,14 @@ public:
      */
     [[nodiscard]] bool isReliable() const;
 
+    /**
+     * Returns false while the watcher is still setting up the watches for
+     * the folder. Until then, changes in parts of the folder may be missed.
+     *
+     * On linux the watches are added in the background, directory by directory.
+     */
+    [[nodiscard]] bool isReady() const;
+
     /**
      * Triggers a change in the path and verifies a notification arrives.
      *
@@ -90,6 +98,10 @@ signals:
      *  of the contained files is changed. */
     void pathChanged(const QString &path);
 
+    /** Emitted with all the paths that changed within a short time window,
+     *  after pathChanged() was emitted for each of them. */
+    void pathsChanged(const QSet<QString> &paths);
+
     /*
     * Emitted when lock files were removed
     */
@@ -118,6 +130,15 @@ signals:
      */
     void becameUnreliable(const QString &message);
 
+    /**
+     * Emitted periodically while the watches are being set up, with the
+     * number of directories watched so far.
+     */
+    void registrationProgress(int watchedDirectories);
+
+    /** Emitted when isReady() turned true. */
+    void becameReady();
+
 protected slots:
     // called from the implementations to indicate a change in path
     void changeDetected(const QString &path);
@@ -127,6 +148,7 @@ protected slots:
 private slots:
     void startNotificationTestWhenReady();
     void lockChangeDebouncingTimerTimedOut();
+    void flushChangedPaths();
 
 protected:
     QHash<QString, int> _pendingPathes;
@@ -153,6 +175,10 @@ private:
 
     QTimer _lockChangeDebouncingTimer;
 
+    /** Changed paths collected until _changedPathsTimer fires, deduplicated */
+    QSet<QString> _changedPaths;
+    QTimer _changedPathsTimer;
+
     friend class FolderWatcherPrivate;
 };
 }
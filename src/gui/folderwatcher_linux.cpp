@@ -14,16 +14,40 @@
 
 #include "config.h"
 
+#include <sys/fanotify.h>
 #include <sys/inotify.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include "configfile.h"
 #include "folder.h"
 #include "folderwatcher_linux.h"
 
+#include <array>
 #include <cerrno>
+#include <climits>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QStringList>
 #include <QObject>
 #include <QVarLengthArray>
 
+#include <vector>
+
+namespace {
+constexpr auto watchMask = IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR;
+constexpr auto registrationProgressIntervalMs = 500;
+
+// Filter out journal changes - redundant with filtering in
+// FolderWatcher::pathIsIgnored.
+bool isJournalFileName(const QByteArray &fileName)
+{
+    return fileName.startsWith("._sync_")
+        || fileName.startsWith(".csync_journal.db")
+        || fileName.startsWith(".sync_");
+}
+}
+
 namespace OCC {
 
 FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
@@ -31,100 +55,168 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     , _parent(p)
     , _folder(path)
 {
+    // A single worker keeps the registrations in order, so a directory is
+    // always watched before the directories created inside it later
+    _registrationPool.setMaxThreadCount(1);
+
+    if (ConfigFile().useFanotify() && initFanotify(path)) {
+        return;
+    }
+
     _fd = inotify_init();
     if (_fd != -1) {
         _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
         connect(_socket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedNotification);
+
+        _ready = false;
+        const auto rootPath = QDir(path).absolutePath();
+        addFolderRecursive(-1, rootPath, rootPath);
     } else {
         qCWarning(lcFolderWatcher) << "notify_init() failed: " << strerror(errno);
     }
-
-    QMetaObject::invokeMethod(this, "slotAddFolderRecursive", Q_ARG(QString, path));
 }
 
-FolderWatcherPrivate::~FolderWatcherPrivate() = default;
-
-// attention: result list passed by reference!
-bool FolderWatcherPrivate::findFoldersBelow(const QDir &dir, QStringList &fullList)
+FolderWatcherPrivate::~FolderWatcherPrivate()
 {
-    bool ok = true;
-    if (!(dir.exists() && dir.isReadable())) {
-        qCDebug(lcFolderWatcher) << "Non existing path coming in: " << dir.absolutePath();
-        ok = false;
-    } else {
-        QStringList nameFilter;
-        nameFilter << QLatin1String("*");
-        QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
-        const QStringList paths = dir.entryList(nameFilter, filter);
+    _stopRegistration = true;
+    _registrationPool.waitForDone();
 
-        QStringList::const_iterator constIterator;
-        for (constIterator = paths.constBegin(); constIterator != paths.constEnd();
-             ++constIterator) {
-            const QString fullPath(dir.path() + QLatin1String("/") + (*constIterator));
-            fullList.append(fullPath);
-            ok = findFoldersBelow(QDir(fullPath), fullList);
+    _socket.reset();
+    for (const auto fd : {_fd, _fanotifyFd, _mountFd}) {
+        if (fd != -1) {
+            close(fd);
         }
     }
-
-    return ok;
 }
 
-void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
+int FolderWatcherPrivate::testWatchCount() const
 {
-    if (path.isEmpty())
-        return;
-
-    int wd = inotify_add_watch(_fd, path.toUtf8().constData(),
-        IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_ONLYDIR);
-    if (wd > -1) {
-        _watchToPath.insert(wd, path);
-        _pathToWatch.insert(path, wd);
-    } else {
-        // If we're running out of memory or inotify watches, become
-        // unreliable.
-        if (_parent->_isReliable && (errno == ENOMEM || errno == ENOSPC)) {
-            _parent->_isReliable = false;
-            emit _parent->becameUnreliable(
-                tr("This problem usually happens when the inotify watches are exhausted. "
-                   "Check the FAQ for details."));
-        }
-    }
+    QMutexLocker locker(&_watchesMutex);
+    return _watches.size();
 }
 
-void FolderWatcherPrivate::slotAddFolderRecursive(const QString &path)
+void FolderWatcherPrivate::addFolderRecursive(int parentWd, const QString &path, const QString &name)
 {
-    if (_pathToWatch.contains(path))
-        return;
+    _registrationPool.start([this, parentWd, path, name] {
+        registerFolderRecursive(parentWd, path, name);
+        QMetaObject::invokeMethod(this, [this] { slotRegistrationFinished(); }, Qt::QueuedConnection);
+    });
+}
 
-    int subdirs = 0;
+void FolderWatcherPrivate::registerFolderRecursive(int parentWd, const QString &path, const QString &name)
+{
     qCDebug(lcFolderWatcher) << "(+) Watcher:" << path;
 
-    QDir inPath(path);
-    inotifyRegisterPath(inPath.absolutePath());
+    struct PendingFolder
+    {
+        int _parentWd;
+        QString _path;
+        QString _name;
+    };
 
-    QStringList allSubfolders;
-    if (!findFoldersBelow(QDir(path), allSubfolders)) {
-        qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
-    }
-    QStringListIterator subfoldersIt(allSubfolders);
-    while (subfoldersIt.hasNext()) {
-        QString subfolder = subfoldersIt.next();
-        QDir folder(subfolder);
-        if (folder.exists() && !_pathToWatch.contains(folder.absolutePath())) {
-            subdirs++;
+    // Walk the tree depth first, so only the subdirectories of the folders on
+    // the current path are held in memory rather than the whole tree
+    std::vector<PendingFolder> pendingFolders{{parentWd, path, name}};
+    int watched = 0;
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
+    while (!pendingFolders.empty() && !_stopRegistration) {
+        auto folder = std::move(pendingFolders.back());
+        pendingFolders.pop_back();
+
+        const auto wd = inotify_add_watch(_fd, folder._path.toUtf8().constData(), watchMask);
+        if (wd == -1) {
+            // If we're running out of memory or inotify watches, become
+            // unreliable.
+            if (errno == ENOMEM || errno == ENOSPC) {
+                QMetaObject::invokeMethod(this, [this] { slotWatchLimitReached(); }, Qt::QueuedConnection);
+                break;
+            }
+            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder._path;
+            continue;
+        }
+        if (!insertWatch(folder._parentWd, folder._name.toUtf8(), wd)) {
+            continue;
+        }
+        ++watched;
+
+        QDirIterator subfolders(folder._path, QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden);
+        while (subfolders.hasNext()) {
+            const auto subfolder = subfolders.next();
             if (_parent->pathIsIgnored(subfolder)) {
-                qCDebug(lcFolderWatcher) << "* Not adding" << folder.path();
+                qCDebug(lcFolderWatcher) << "* Not adding" << subfolder;
                 continue;
             }
-            inotifyRegisterPath(folder.absolutePath());
-        } else {
-            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder.path();
+            pendingFolders.push_back({wd, subfolder, subfolders.fileName()});
+        }
+
+        if (progressTimer.elapsed() >= registrationProgressIntervalMs) {
+            progressTimer.restart();
+            const auto watchCount = testWatchCount();
+            QMetaObject::invokeMethod(this, [this, watchCount] {
+                qCInfo(lcFolderWatcher) << "Watching" << watchCount << "directories so far in" << _folder;
+                emit _parent->registrationProgress(watchCount);
+            }, Qt::QueuedConnection);
         }
     }
 
-    if (subdirs > 0) {
-        qCDebug(lcFolderWatcher) << "    `-> and" << subdirs << "subdirectories";
+    if (watched > 1) {
+        qCDebug(lcFolderWatcher) << "    `-> and" << watched - 1 << "subdirectories";
+    }
+}
+
+bool FolderWatcherPrivate::insertWatch(int parentWd, const QByteArray &name, int wd)
+{
+    QMutexLocker locker(&_watchesMutex);
+    if (_watches.contains(wd)) {
+        // Already watched, and so are the directories below it
+        return false;
+    }
+    if (parentWd != -1 && !_watches.contains(parentWd)) {
+        // The parent went away while its subdirectories were being walked
+        inotify_rm_watch(_fd, wd);
+        return false;
+    }
+
+    _watches.insert(wd, {parentWd, name});
+    if (parentWd != -1) {
+        _childWatches.insert({parentWd, name}, wd);
+    }
+    return true;
+}
+
+void FolderWatcherPrivate::slotRegistrationFinished()
+{
+    // The initial registration is the first one queued
+    if (_ready) {
+        return;
+    }
+    _ready = true;
+    qCInfo(lcFolderWatcher) << "Watching all" << testWatchCount() << "directories in" << _folder;
+    emit _parent->becameReady();
+}
+
+void FolderWatcherPrivate::slotWatchLimitReached()
+{
+    if (_parent->_isReliable) {
+        _parent->_isReliable = false;
+        emit _parent->becameUnreliable(
+            tr("This problem usually happens when the inotify watches are exhausted. "
+               "Check the FAQ for details."));
+    }
+}
+
+QString FolderWatcherPrivate::pathForWatch(int wd) const
+{
+    QByteArrayList names;
+    for (auto it = _watches.constFind(wd); it != _watches.cend(); it = _watches.constFind(it->_parent)) {
+        names.prepend(it->_name);
+        if (it->_parent == -1) {
+            return QString::fromUtf8(names.join('/'));
+        }
     }
+    return {};
 }
 
 void FolderWatcherPrivate::slotReceivedNotification(int fd)
@@ -169,51 +261,184 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
         if (event->len == 0 || event->wd <= -1)
             continue;
         QByteArray fileName(event->name);
-        // Filter out journal changes - redundant with filtering in
-        // FolderWatcher::pathIsIgnored.
-        if (fileName.startsWith("._sync_")
-            || fileName.startsWith(".csync_journal.db")
-            || fileName.startsWith(".sync_")) {
+        if (isJournalFileName(fileName)) {
             continue;
         }
-        const QString p = _watchToPath[event->wd] + '/' + fileName;
+
+        QString p;
+        {
+            QMutexLocker locker(&_watchesMutex);
+            const auto folderPath = pathForWatch(event->wd);
+            if (folderPath.isEmpty()) {
+                // The watch was removed already, together with its parent
+                continue;
+            }
+            p = folderPath + '/' + QString::fromUtf8(fileName);
+        }
         _parent->changeDetected(p);
 
         if ((event->mask & (IN_MOVED_TO | IN_CREATE))
             && QFileInfo(p).isDir()
             && !_parent->pathIsIgnored(p)) {
-            slotAddFolderRecursive(p);
+            addFolderRecursive(event->wd, p, QString::fromUtf8(fileName));
         }
         if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
-            removeFoldersBelow(p);
+            QMutexLocker locker(&_watchesMutex);
+            removeWatchesBelow(_childWatches.value({event->wd, fileName}, -1));
         }
     }
 }
 
-void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
+bool FolderWatcherPrivate::initFanotify(const QString &path)
 {
-    auto it = _pathToWatch.find(path);
-    if (it == _pathToWatch.end())
-        return;
+#ifdef FAN_REPORT_DFID_NAME
+    const auto fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+    if (fd == -1) {
+        qCInfo(lcFolderWatcher) << "fanotify_init() failed, falling back to inotify:" << strerror(errno);
+        return false;
+    }
 
-    QString pathSlash = path + '/';
+    const auto rootPath = QDir(path).absolutePath();
+    const auto rootPathBytes = rootPath.toUtf8();
+    constexpr auto mask = FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_CREATE | FAN_DELETE | FAN_ONDIR;
+    auto marked = false;
+#ifdef FAN_RENAME
+    // Since Linux 5.17 a rename is a single event with both the old and the new name
+    marked = fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask | FAN_RENAME, AT_FDCWD, rootPathBytes.constData()) == 0;
+#endif
+    if (!marked) {
+        marked = fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask | FAN_MOVED_FROM | FAN_MOVED_TO, AT_FDCWD, rootPathBytes.constData()) == 0;
+    }
+    const auto mountFd = marked ? open(rootPathBytes.constData(), O_DIRECTORY | O_RDONLY | O_CLOEXEC) : -1;
+    if (mountFd == -1) {
+        qCInfo(lcFolderWatcher) << "Could not watch" << rootPath << "with fanotify, falling back to inotify:" << strerror(errno);
+        close(fd);
+        return false;
+    }
 
-    // Remove the entry and all subentries
-    while (it != _pathToWatch.end()) {
-        auto itPath = it.key();
-        if (!itPath.startsWith(path))
+    _fanotifyFd = fd;
+    _mountFd = mountFd;
+    _rootPath = rootPath;
+    _canonicalRootPath = QFileInfo(rootPath).canonicalFilePath();
+    _socket.reset(new QSocketNotifier(_fanotifyFd, QSocketNotifier::Read));
+    connect(_socket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedFanotifyNotification);
+    qCInfo(lcFolderWatcher) << "Watching" << rootPath << "with fanotify";
+    return true;
+#else
+    Q_UNUSED(path)
+    qCInfo(lcFolderWatcher) << "Built without fanotify support, falling back to inotify";
+    return false;
+#endif
+}
+
+void FolderWatcherPrivate::slotReceivedFanotifyNotification(int fd)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    alignas(fanotify_event_metadata) std::array<char, 8192> buffer;
+    std::array<char, PATH_MAX> directoryPath;
+
+    // Resolves the directory handle and name of an event to a path in the
+    // folder, or an empty string for a path elsewhere on the filesystem
+    const auto eventPath = [this, &directoryPath](const fanotify_event_info_fid *info) -> QString {
+        const auto handle = reinterpret_cast<file_handle *>(const_cast<unsigned char *>(info->handle));
+        const QByteArray fileName(reinterpret_cast<const char *>(handle->f_handle + handle->handle_bytes));
+        if (isJournalFileName(fileName)) {
+            return {};
+        }
+
+        // Fails with ESTALE if the directory is gone already
+        const auto directoryFd = open_by_handle_at(_mountFd, handle, O_PATH | O_CLOEXEC);
+        if (directoryFd == -1) {
+            return {};
+        }
+        const auto procPath = QByteArray("/proc/self/fd/") + QByteArray::number(directoryFd);
+        const auto length = readlink(procPath.constData(), directoryPath.data(), directoryPath.size());
+        close(directoryFd);
+        if (length <= 0) {
+            return {};
+        }
+
+        auto path = QString::fromUtf8(directoryPath.data(), length);
+        if (fileName != ".") {
+            path += '/' + QString::fromUtf8(fileName);
+        }
+        if (path == _canonicalRootPath) {
+            return _rootPath;
+        }
+        if (!path.startsWith(_canonicalRootPath) || path.at(_canonicalRootPath.size()) != '/') {
+            return {};
+        }
+        return _rootPath + path.mid(_canonicalRootPath.size());
+    };
+
+    while (true) {
+        auto length = read(fd, buffer.data(), buffer.size());
+        if (length <= 0) {
+            // EAGAIN: all events were read
             break;
-        if (itPath != path && !itPath.startsWith(pathSlash)) {
-            // order is 'foo', 'foo bar', 'foo/bar'
-            ++it;
-            continue;
         }
 
-        auto wid = it.value();
-        inotify_rm_watch(_fd, wid);
-        _watchToPath.remove(wid);
-        it = _pathToWatch.erase(it);
-        qCDebug(lcFolderWatcher) << "Removed watch for" << itPath;
+        auto metadata = reinterpret_cast<fanotify_event_metadata *>(buffer.data());
+        for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                qCWarning(lcFolderWatcher) << "Unexpected fanotify metadata version" << metadata->vers;
+                return;
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                qCWarning(lcFolderWatcher) << "fanotify event queue overflowed";
+                emit _parent->lostChanges();
+                continue;
+            }
+
+            // A rename carries both the old and the new name
+            const auto event = reinterpret_cast<const char *>(metadata);
+            for (auto offset = static_cast<quint32>(metadata->metadata_len); offset + sizeof(fanotify_event_info_fid) <= metadata->event_len;) {
+                const auto info = reinterpret_cast<const fanotify_event_info_fid *>(event + offset);
+                if (info->hdr.len == 0) {
+                    break;
+                }
+                offset += info->hdr.len;
+
+                const auto type = info->hdr.info_type;
+                if (type != FAN_EVENT_INFO_TYPE_DFID_NAME
+#ifdef FAN_RENAME
+                    && type != FAN_EVENT_INFO_TYPE_OLD_DFID_NAME && type != FAN_EVENT_INFO_TYPE_NEW_DFID_NAME
+#endif
+                ) {
+                    continue;
+                }
+                const auto path = eventPath(info);
+                if (!path.isEmpty() && !_parent->pathIsIgnored(path)) {
+                    _parent->changeDetected(path);
+                }
+            }
+        }
+    }
+#else
+    Q_UNUSED(fd)
+#endif
+}
+
+void FolderWatcherPrivate::removeWatchesBelow(int wd)
+{
+    const auto watch = _watches.constFind(wd);
+    if (watch == _watches.cend())
+        return;
+
+    qCDebug(lcFolderWatcher) << "Removing watches for" << pathForWatch(wd);
+    _childWatches.remove({watch->_parent, watch->_name});
+
+    // Remove the entry and all subentries
+    QVector<int> pendingWatches{wd};
+    while (!pendingWatches.isEmpty()) {
+        const auto current = pendingWatches.takeLast();
+        auto child = _childWatches.lowerBound({current, QByteArray()});
+        while (child != _childWatches.end() && child.key().first == current) {
+            pendingWatches.append(child.value());
+            child = _childWatches.erase(child);
+        }
+        inotify_rm_watch(_fd, current);
+        _watches.remove(current);
     }
 }
 
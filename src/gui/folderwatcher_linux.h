@@ -19,7 +19,12 @@
 #include <QString>
 #include <QSocketNotifier>
 #include <QHash>
-#include <QDir>
+#include <QMap>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <atomic>
+#include <utility>
 
 #include "folderwatcher.h"
 
@@ -29,6 +34,16 @@ namespace OCC {
 
 /**
  * @brief Linux (inotify) API implementation of FolderWatcher
+ *
+ * When enabled in the config file and permitted, fanotify is used instead:
+ * a single mark on the whole filesystem replaces the watches, and the
+ * changed paths are resolved from the file handles in the events.
+ *
+ * Otherwise the inotify watches are added on a worker thread, walking the directory tree one
+ * directory at a time, so a large folder doesn't block the GUI. Until the
+ * initial walk is done, _ready is false and changes in the directories that
+ * aren't watched yet are missed.
+ *
  * @ingroup gui
  */
 class FolderWatcherPrivate : public QObject
@@ -39,28 +54,65 @@ public:
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
     ~FolderWatcherPrivate() override;
 
-    [[nodiscard]] int testWatchCount() const { return _pathToWatch.size(); }
+    [[nodiscard]] int testWatchCount() const;
 
-    /// On linux the watcher is ready when the ctor finished.
+    /// On linux the watcher is ready when the initial registration of the watches finished.
     bool _ready = true;
 
 protected slots:
     void slotReceivedNotification(int fd);
-    void slotAddFolderRecursive(const QString &path);
+    void slotReceivedFanotifyNotification(int fd);
+
+private slots:
+    void slotRegistrationFinished();
+    void slotWatchLimitReached();
 
 protected:
-    bool findFoldersBelow(const QDir &dir, QStringList &fullList);
-    void inotifyRegisterPath(const QString &path);
-    void removeFoldersBelow(const QString &path);
+    /// Queues adding watches for \a path and all directories below it
+    void addFolderRecursive(int parentWd, const QString &path, const QString &name);
+
+    /// Records the watch \a wd for the directory \a name below \a parentWd, false if it is known already
+    bool insertWatch(int parentWd, const QByteArray &name, int wd);
+
+    // Need _watchesMutex to be locked
+    [[nodiscard]] QString pathForWatch(int wd) const;
+    void removeWatchesBelow(int wd);
 
 private:
+    /**
+     * A watched directory: the directories form a tree through the parent's
+     * watch descriptor, so full paths don't need to be stored for every watch.
+     */
+    struct Watch
+    {
+        int _parent = -1; ///< watch descriptor of the parent directory, -1 for the root
+        QByteArray _name; ///< name within the parent directory, the full path for the root
+    };
+
+    bool initFanotify(const QString &path);
+
+    // Runs on the worker thread
+    void registerFolderRecursive(int parentWd, const QString &path, const QString &name);
+
     FolderWatcher *_parent = nullptr;
 
     QString _folder;
-    QHash<int, QString> _watchToPath;
-    QMap<QString, int> _pathToWatch;
+
+    mutable QMutex _watchesMutex;
+    QHash<int, Watch> _watches;
+    QMap<std::pair<int, QByteArray>, int> _childWatches; ///< (parent wd, name) -> wd, ordered so the children of a watch are adjacent
+
+    QThreadPool _registrationPool;
+    std::atomic<bool> _stopRegistration{false};
+
     QScopedPointer<QSocketNotifier> _socket;
-    int _fd = 0;
+    int _fd = -1;
+
+    // fanotify
+    int _fanotifyFd = -1;
+    int _mountFd = -1; ///< for resolving the file handles
+    QString _rootPath; ///< the watched folder, without trailing slash
+    QString _canonicalRootPath; ///< as resolved from the file handles
 };
 }
 
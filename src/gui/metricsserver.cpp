@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "metricsserver.h"
+#include "common/metrics.h"
+#include "common/utility.h"
+#include "theme.h"
+#include "config.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QStandardPaths>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcMetricsServer, "nextcloud.gui.metricsserver", QtInfoMsg)
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent)
+{
+    const auto path = socketPath();
+    QLocalServer::removeServer(path);
+    if (!Utility::isWindows()) {
+        QFileInfo info(path);
+        if (!info.dir().exists()) {
+            info.dir().mkpath(QStringLiteral("."));
+        }
+    }
+    // The metrics tell about the user's files, keep them to the user
+    _localServer.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!_localServer.listen(path)) {
+        qCWarning(lcMetricsServer) << "Could not serve the metrics at" << path << _localServer.errorString();
+    } else {
+        qCInfo(lcMetricsServer) << "Serving the metrics at" << path;
+    }
+
+    connect(&_localServer, &QLocalServer::newConnection, this, &MetricsServer::slotNewConnection);
+}
+
+MetricsServer::~MetricsServer()
+{
+    _localServer.close();
+}
+
+QString MetricsServer::socketPath()
+{
+    if (Utility::isWindows()) {
+        return QLatin1String(R"(\\.\pipe\)")
+            + QLatin1String(APPLICATION_EXECUTABLE)
+            + QLatin1String("-metrics-")
+            + QString::fromLocal8Bit(qgetenv("USERNAME"));
+    }
+    const auto runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    return runtimeDir + QLatin1Char('/') + Theme::instance()->appName() + QStringLiteral("/metrics");
+}
+
+void MetricsServer::slotNewConnection()
+{
+    while (auto socket = _localServer.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        socket->write(MetricsRegistry::instance().toOpenMetrics());
+        socket->disconnectFromServer();
+    }
+}
+
+} // namespace OCC
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QLocalServer>
+
+namespace OCC {
+
+/**
+ * @brief Serves the sync metrics on a local socket
+ *
+ * Every connection gets the metrics in the OpenMetrics text format and is
+ * closed, e.g. `socat - UNIX-CONNECT:$XDG_RUNTIME_DIR/Nextcloud/metrics`.
+ * Only created when serveMetrics is set in the config.
+ *
+ * @ingroup gui
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+    ~MetricsServer() override;
+
+    static QString socketPath();
+
+private slots:
+    void slotNewConnection();
+
+private:
+    QLocalServer _localServer;
+};
+
+} // namespace OCC
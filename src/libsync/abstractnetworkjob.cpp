@@ -31,6 +31,8 @@
 #include <QRegularExpression>
 
 #include "common/asserts.h"
+#include "common/metrics.h"
+#include "common/synctrace.h"
 #include "networkjobs.h"
 #include "account.h"
 #include "owncloudpropagator.h"
@@ -160,6 +162,11 @@ QNetworkReply *AbstractNetworkJob::sendRequest(const QByteArray &verb,
 
 void AbstractNetworkJob::adoptRequest(QNetworkReply *reply)
 {
+    if (SyncTrace::isEnabled()) {
+        SyncTrace::asyncBegin(SyncTrace::Category::Network, "request", reply,
+                              QString::fromLatin1(HttpLogger::requestVerb(*reply)) + QLatin1Char(' ') + reply->request().url().path());
+    }
+    _timing.start(reply, this);
     addTimer(reply);
     setReply(reply);
     setupConnections(reply);
@@ -180,6 +187,23 @@ void AbstractNetworkJob::slotFinished()
 {
     _timer.stop();
 
+    _timing.finish();
+    if (SyncTrace::isEnabled()) {
+        SyncTrace::asyncEnd(SyncTrace::Category::Network, "request", _reply.data(),
+                            QString::number(_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt())
+                                + QLatin1Char(' ') + _timing.toString());
+    }
+    HttpLogger::logTiming(*_reply, _timing);
+
+    SyncMetrics::networkRequests().add();
+    if (_reply->error() != QNetworkReply::NoError) {
+        SyncMetrics::networkErrors().add();
+    }
+    if (_timing.verb() == "PROPFIND") {
+        SyncMetrics::propfindDuration().observe(_timing.total());
+    }
+    _timing.recordMetrics();
+
     if (_reply->error() == QNetworkReply::SslHandshakeFailedError) {
         qCWarning(lcNetworkJob) << "SslHandshakeFailedError: " << errorString() << " : can be caused by a webserver wanting SSL client certificates";
     }
@@ -18,6 +18,7 @@
 #include "owncloudlib.h"
 
 #include "accountfwd.h"
+#include "requesttiming.h"
 #include "common/asserts.h"
 
 #include <QObject>
@@ -75,6 +76,9 @@ public:
     /* Content of the X-Request-ID header. (Only set after the request is sent) */
     QByteArray requestId();
 
+    /** Where the time of the current request went, complete once it finished */
+    [[nodiscard]] const RequestTiming &timing() const { return _timing; }
+
     [[nodiscard]] qint64 timeoutMsec() const { return _timer.interval(); }
     [[nodiscard]] bool timedOut() const { return _timedout; }
 
@@ -214,6 +218,7 @@ private:
     QPointer<QNetworkReply> _reply; // (QPointer because the NetworkManager may be destroyed before the jobs at exit)
     QString _path;
     QTimer _timer;
+    RequestTiming _timing;
     int _redirectCount = 0;
     int _http2ResendCount = 0;
 
@@ -308,6 +308,10 @@ public:
     bool isHttp2Supported() { return _http2Supported; }
     void setHttp2Supported(bool value) { _http2Supported = value; }
 
+    /** False once the server rejected a PROPFIND with "Depth: infinity", see DiscoverySingleDirectoryJob */
+    [[nodiscard]] bool isDepthInfinityPropfindSupported() const { return _depthInfinityPropfindSupported; }
+    void setDepthInfinityPropfindSupported(bool value) { _depthInfinityPropfindSupported = value; }
+
     void clearCookieJar();
     void lendCookieJarTo(QNetworkAccessManager *guest);
     QString cookieJarPath();
@@ -516,6 +520,7 @@ private:
     QSharedPointer<QNetworkAccessManager> _am;
     QScopedPointer<AbstractCredentials> _credentials;
     bool _http2Supported = false;
+    bool _depthInfinityPropfindSupported = true;
 
     /// Certificates that were explicitly rejected by the user
     QList<QSslCertificate> _rejectedCertificates;
@@ -24,6 +24,7 @@
 #include "account.h"
 #include "common/utility.h"
 #include "common/checksums.h"
+#include "common/metrics.h"
 #include "networkjobs.h"
 
 #include <QFileInfo>
@@ -367,12 +368,13 @@ void BulkPropagatorJob::slotPutFinishedOneFile(const BulkUploadItem &singleFile,
     if (singleFile._item->_httpErrorCode != 200) {
         commonErrorHandling(singleFile._item, fileReply[QStringLiteral("message")].toString());
         const auto exceptionParsed = getExceptionFromReply(job->reply());
-        singleFile._item->_errorExceptionName = exceptionParsed.first;
-        singleFile._item->_errorExceptionMessage = exceptionParsed.second;
+        singleFile._item->mutableDetails()._errorExceptionName = exceptionParsed.first;
+        singleFile._item->mutableDetails()._errorExceptionMessage = exceptionParsed.second;
         return;
     }
 
     singleFile._item->_status = SyncFileItem::Success;
+    SyncMetrics::uploadedBytes().add(singleFile._fileSize);
 
     // Check the file again post upload.
     // Two cases must be considered separately: If the upload is finished,
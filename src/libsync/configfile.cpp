@@ -72,6 +72,9 @@ static constexpr char chunkSizeC[] = "chunkSize";
 static constexpr char minChunkSizeC[] = "minChunkSize";
 static constexpr char maxChunkSizeC[] = "maxChunkSize";
 static constexpr char targetChunkUploadDurationC[] = "targetChunkUploadDuration";
+static constexpr char parallelChunkUploadsC[] = "parallelChunkUploads";
+static constexpr char useFanotifyC[] = "useFanotify";
+static constexpr char serveMetricsC[] = "serveMetrics";
 static constexpr char automaticLogDirC[] = "logToTemporaryLogDir";
 static constexpr char logDirC[] = "logDir";
 static constexpr char logDebugC[] = "logDebug";
@@ -265,6 +268,24 @@ chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
     return millisecondsValue(settings, targetChunkUploadDurationC, chrono::minutes(1));
 }
 
+int ConfigFile::parallelChunkUploads() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(parallelChunkUploadsC), 3).toInt();
+}
+
+bool ConfigFile::useFanotify() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(useFanotifyC), false).toBool();
+}
+
+bool ConfigFile::serveMetrics() const
+{
+    QSettings settings(configFile(), QSettings::IniFormat);
+    return settings.value(QLatin1String(serveMetricsC), false).toBool();
+}
+
 void ConfigFile::setOptionalServerNotifications(bool show)
 {
     QSettings settings(configFile(), QSettings::IniFormat);
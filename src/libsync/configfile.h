@@ -175,6 +175,13 @@ public:
     [[nodiscard]] qint64 maxChunkSize() const;
     [[nodiscard]] qint64 minChunkSize() const;
     [[nodiscard]] std::chrono::milliseconds targetChunkUploadDuration() const;
+    [[nodiscard]] int parallelChunkUploads() const;
+
+    // whether the folder watcher should try fanotify before inotify (linux only)
+    [[nodiscard]] bool useFanotify() const;
+
+    // whether the sync metrics are served on a local socket
+    [[nodiscard]] bool serveMetrics() const;
 
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
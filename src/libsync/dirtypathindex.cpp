@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "dirtypathindex.h"
+
+#include <algorithm>
+
+namespace OCC {
+
+namespace {
+
+    QString withoutTrailingSlashes(QString path)
+    {
+        while (path.endsWith(QLatin1Char('/'))) {
+            path.chop(1);
+        }
+        return path;
+    }
+
+    // The parent of a top level path is the sync folder itself, ""
+    QString parentPath(const QString &path)
+    {
+        const auto slash = path.lastIndexOf(QLatin1Char('/'));
+        return slash == -1 ? QString() : path.left(slash);
+    }
+
+    QString fileName(const QString &path)
+    {
+        return path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+    }
+
+}
+
+void DirtyPathIndex::insert(const QString &rawPath)
+{
+    markPath(withoutTrailingSlashes(rawPath), Mark::Touched, Mark::ParentOfTouched);
+}
+
+void DirtyPathIndex::insertFolder(const QString &rawPath)
+{
+    markPath(withoutTrailingSlashes(rawPath), Mark::ParentOfTouched, Mark::ParentOfTouched);
+}
+
+void DirtyPathIndex::markPath(const QString &touchedPath, Mark mark, Mark parentMark)
+{
+    const auto touchedParent = parentPath(touchedPath);
+    auto path = touchedPath;
+    QString createdChild; // a child of path whose node was just created
+
+    forever {
+        auto it = _nodes.find(path);
+        const auto created = it == _nodes.end();
+        if (created) {
+            it = _nodes.insert(path, Node());
+        }
+        it->_mark = std::max(it->_mark, mark);
+        if (!createdChild.isNull()) {
+            it->_dirtyChildren.append(createdChild);
+        }
+
+        // The ancestors of a node that already existed are marked already
+        if (path.isEmpty() || (!created && mark == Mark::AncestorOfTouched)) {
+            return;
+        }
+
+        createdChild = created ? fileName(path) : QString();
+        path = parentPath(path);
+        mark = path == touchedParent ? parentMark : Mark::AncestorOfTouched;
+    }
+}
+
+void DirtyPathIndex::clear()
+{
+    _nodes.clear();
+}
+
+bool DirtyPathIndex::contains(const QString &rawPath) const
+{
+    const auto path = withoutTrailingSlashes(rawPath);
+    return _nodes.contains(path) || isInsideTouched(path);
+}
+
+bool DirtyPathIndex::needsListing(const QString &rawPath) const
+{
+    const auto path = withoutTrailingSlashes(rawPath);
+    const auto it = _nodes.constFind(path);
+    if (it != _nodes.cend() && it->_mark != Mark::AncestorOfTouched) {
+        return true;
+    }
+    return isInsideTouched(path);
+}
+
+QStringList DirtyPathIndex::dirtyChildren(const QString &rawPath) const
+{
+    return _nodes.value(withoutTrailingSlashes(rawPath))._dirtyChildren;
+}
+
+bool DirtyPathIndex::isInsideTouched(const QString &path) const
+{
+    auto ancestor = path;
+    while (!ancestor.isEmpty()) {
+        ancestor = parentPath(ancestor);
+        const auto it = _nodes.constFind(ancestor);
+        if (it != _nodes.cend() && it->_mark == Mark::Touched) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace OCC {
+
+/**
+ * @brief Index of the local paths that changed since the last sync
+ *
+ * Used by the SyncEngine to decide which parts of the tree a partial local
+ * discovery has to look at. Every touched path is marked together with its
+ * ancestors: the parent of a touched path has to be listed on disk to find it,
+ * while the folders further up only have to be descended into and can take
+ * their entries from the journal. All lookups walk up the given path, so they
+ * cost O(depth) hash lookups independent of how many paths were touched.
+ *
+ * Paths are relative to the sync folder, use '/' as separator and the empty
+ * path is the sync folder itself.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT DirtyPathIndex
+{
+public:
+    /** Marks \a path and everything below it as changed. */
+    void insert(const QString &path);
+
+    /**
+     * Marks the folder at \a path as changed itself, e.g. its permissions:
+     * its entries and those of its parent have to be read, its subfolders not.
+     */
+    void insertFolder(const QString &path);
+
+    void clear();
+
+    [[nodiscard]] bool isEmpty() const { return _nodes.isEmpty(); }
+
+    /** Whether \a path was touched, is inside a touched folder or is an ancestor of a touched path. */
+    [[nodiscard]] bool contains(const QString &path) const;
+
+    /**
+     * Whether the entries of the folder at \a path have to be read from disk:
+     * it was touched, is inside a touched folder or directly contains a touched path.
+     */
+    [[nodiscard]] bool needsListing(const QString &path) const;
+
+    /** The names of the children of \a path that lead to touched paths further below. */
+    [[nodiscard]] QStringList dirtyChildren(const QString &path) const;
+
+private:
+    // Ordered so that a stronger mark can replace a weaker one
+    enum class Mark {
+        AncestorOfTouched,
+        ParentOfTouched,
+        Touched,
+    };
+
+    struct Node
+    {
+        Mark _mark = Mark::AncestorOfTouched;
+        QStringList _dirtyChildren;
+    };
+
+    void markPath(const QString &path, Mark mark, Mark parentMark);
+    [[nodiscard]] bool isInsideTouched(const QString &path) const;
+
+    QHash<QString, Node> _nodes;
+};
+
+}
@@ -29,8 +29,11 @@
 #include <QFileInfo>
 #include <QFile>
 #include <QThreadPool>
+#include <QScopeGuard>
 #include <common/checksums.h>
 #include <common/constants.h>
+#include <common/metrics.h>
+#include <common/synctrace.h>
 #include "csync_exclude.h"
 #include "csync.h"
 
@@ -84,9 +87,19 @@ ProcessDirectoryJob::ProcessDirectoryJob(DiscoveryPhase *data, PinState basePinS
 void ProcessDirectoryJob::start()
 {
     qCInfo(lcDisco) << "STARTING" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
+    SyncTrace::asyncBegin(SyncTrace::Category::Discovery, "directory", this, _currentFolder._original);
+    SyncMetrics::discoveredDirectories().add();
 
     _discoveryData->_noCaseConflictRecordsInDb = _discoveryData->_statedb->caseClashConflictRecordPaths().isEmpty();
 
+    // The server's change set may show that there is nothing to list here. The root
+    // is always listed, it brings the root etag, the data-fingerprint and the sync token.
+    if (_queryServer == NormalQuery && !_currentFolder._server.isEmpty()
+        && !_discoveryData->_shouldListRemotely(_currentFolder._server)) {
+        _queryServer = ParentNotChanged;
+        qCDebug(lcDisco) << "no remote changes listed here" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
+    }
+
     if (_queryServer == NormalQuery) {
         _serverJob = startAsyncServerQuery();
     } else {
@@ -100,6 +113,13 @@ void ProcessDirectoryJob::start()
             && !_discoveryData->isInSelectiveSyncBlackList(_currentFolder._original)) {
             _queryLocal = ParentNotChanged;
             qCDebug(lcDisco) << "adjusted discovery policy" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
+        } else if (!_discoveryData->_shouldListLocally(_currentFolder._local)
+            && (_currentFolder._local == _currentFolder._original || !_discoveryData->_shouldListLocally(_currentFolder._original))
+            && !_discoveryData->isInSelectiveSyncBlackList(_currentFolder._original)) {
+            // Only subfolders contain changes: take the entries from the db and
+            // descend into those subfolders, see processFileAnalyzeLocalInfo()
+            _queryLocal = ParentNotChanged;
+            qCDebug(lcDisco) << "only descending into touched subfolders" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
         }
     }
 
@@ -124,7 +144,13 @@ void ProcessDirectoryJob::process()
     // However, if foo and foo.owncloud exists locally, there'll be "foo"
     // with local, db, server entries and "foo.owncloud" with only a local
     // entry.
-    std::map<QString, Entries> entries;
+    // Declared before the entries so it runs after they are destroyed
+    const auto releaseArena = qScopeGuard([this] {
+        SyncMetrics::discoveryArenaAllocations().add(_arena.allocationCount());
+        SyncMetrics::discoveryArenaBytes().add(_arena.bytesReserved());
+        _arena.release();
+    });
+    EntriesMap entries{ArenaAllocator<EntriesMap::value_type>(&_arena)};
     for (auto &e : _serverNormalQueryEntries) {
         entries[e.name].serverEntry = std::move(e);
     }
@@ -254,7 +280,7 @@ void ProcessDirectoryJob::process()
     QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
 }
 
-bool ProcessDirectoryJob::handleExcluded(const QString &path, const Entries &entries, const std::map<QString, Entries> &allEntries, bool isHidden)
+bool ProcessDirectoryJob::handleExcluded(const QString &path, const Entries &entries, const EntriesMap &allEntries, bool isHidden)
 {
     const auto isDirectory = entries.localEntry.isDirectory || entries.serverEntry.isDirectory;
 
@@ -460,7 +486,7 @@ bool ProcessDirectoryJob::handleExcluded(const QString &path, const Entries &ent
     return true;
 }
 
-bool ProcessDirectoryJob::canRemoveCaseClashConflictedCopy(const QString &path, const std::map<QString, Entries> &allEntries)
+bool ProcessDirectoryJob::canRemoveCaseClashConflictedCopy(const QString &path, const EntriesMap &allEntries)
 {
     const auto conflictRecord = _discoveryData->_statedb->caseConflictRecordByPath(path.toUtf8());
     const auto originalBaseFileName = QFileInfo(QString(_discoveryData->_localDir + "/" + conflictRecord.initialBasePath)).fileName();
@@ -661,7 +687,7 @@ void ProcessDirectoryJob::postProcessServerNew(const SyncFileItemPtr &item,
         }
     }
 
-    if (opts._vfs->mode() != Vfs::Off && !item->_encryptedFileName.isEmpty()) {
+    if (opts._vfs->mode() != Vfs::Off && !item->details()._encryptedFileName.isEmpty()) {
         // We are syncing a file for the first time (local entry is invalid) and it is encrypted file that will be virtual once synced
         // to avoid having error of "file has changed during sync" when trying to hydrate it explicitly - we must remove Constants::e2EeTagSize bytes from the end
         // as explicit hydration does not care if these bytes are present in the placeholder or not, but, the size must not change in the middle of the sync
@@ -687,40 +713,44 @@ void ProcessDirectoryJob::processFileAnalyzeRemoteInfo(const SyncFileItemPtr &it
     item->_lastShareStateFetchedTimestamp = QDateTime::currentMSecsSinceEpoch();
     item->_type = serverEntry.isDirectory ? ItemTypeDirectory : ItemTypeFile;
     item->_etag = serverEntry.etag;
-    item->_directDownloadUrl = serverEntry.directDownloadUrl;
-    item->_directDownloadCookies = serverEntry.directDownloadCookies;
+    if (!serverEntry.directDownloadUrl.isEmpty()) {
+        item->mutableDetails()._directDownloadUrl = serverEntry.directDownloadUrl;
+        item->mutableDetails()._directDownloadCookies = serverEntry.directDownloadCookies;
+    }
     item->_e2eEncryptionStatus = serverEntry.isE2eEncrypted() ? SyncFileItem::EncryptionStatus::Encrypted : SyncFileItem::EncryptionStatus::NotEncrypted;
     if (serverEntry.isE2eEncrypted()) {
         item->_e2eEncryptionServerCapability = EncryptionStatusEnums::fromEndToEndEncryptionApiVersion(_discoveryData->_account->capabilities().clientSideEncryptionVersion());
     }
-    item->_encryptedFileName = [=] {
-        if (serverEntry.e2eMangledName.isEmpty()) {
-            return QString();
-        }
-
+    if (!serverEntry.e2eMangledName.isEmpty()) {
         Q_ASSERT(_discoveryData->_remoteFolder.startsWith('/'));
         Q_ASSERT(_discoveryData->_remoteFolder.endsWith('/'));
 
         const auto rootPath = _discoveryData->_remoteFolder.mid(1);
         Q_ASSERT(serverEntry.e2eMangledName.startsWith(rootPath));
-        return serverEntry.e2eMangledName.mid(rootPath.length());
-    }();
+        item->mutableDetails()._encryptedFileName = serverEntry.e2eMangledName.mid(rootPath.length());
+    } else if (item->hasDetails()) {
+        // The name may come from the db, the server doesn't know it anymore
+        item->mutableDetails()._encryptedFileName.clear();
+    }
     item->_locked = serverEntry.locked;
-    item->_lockOwnerDisplayName = serverEntry.lockOwnerDisplayName;
-    item->_lockOwnerId = serverEntry.lockOwnerId;
-    item->_lockOwnerType = serverEntry.lockOwnerType;
-    item->_lockEditorApp = serverEntry.lockEditorApp;
-    item->_lockTime = serverEntry.lockTime;
-    item->_lockTimeout = serverEntry.lockTimeout;
-
-    qCDebug(lcDisco()) << "item lock for:" << item->_file
-                       << item->_locked
-                       << item->_lockOwnerDisplayName
-                       << item->_lockOwnerId
-                       << item->_lockOwnerType
-                       << item->_lockEditorApp
-                       << item->_lockTime
-                       << item->_lockTimeout;
+    if (item->_locked == SyncFileItem::LockStatus::LockedItem || item->hasDetails()) {
+        auto &details = item->mutableDetails();
+        details._lockOwnerDisplayName = serverEntry.lockOwnerDisplayName;
+        details._lockOwnerId = serverEntry.lockOwnerId;
+        details._lockOwnerType = serverEntry.lockOwnerType;
+        details._lockEditorApp = serverEntry.lockEditorApp;
+        details._lockTime = serverEntry.lockTime;
+        details._lockTimeout = serverEntry.lockTimeout;
+
+        qCDebug(lcDisco()) << "item lock for:" << item->_file
+                           << item->_locked
+                           << details._lockOwnerDisplayName
+                           << details._lockOwnerId
+                           << details._lockOwnerType
+                           << details._lockEditorApp
+                           << details._lockTime
+                           << details._lockTimeout;
+    }
 
     // Check for missing server data
     {
@@ -1074,7 +1104,12 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
         // conflict we don't need to recurse into it. (local c1.owncloud, c1/ ; remote: c1)
         if (item->_instruction == CSYNC_INSTRUCTION_CONFLICT && !item->isDirectory())
             recurse = false;
-        if (_queryLocal != NormalQuery && _queryServer != NormalQuery)
+        // A folder that wasn't listed may still lead to touched paths or remote changes
+        const auto descendIntoTouched = recurse && _queryLocal == ParentNotChanged && _discoveryData->_shouldDiscoverLocaly(path._local);
+        const auto descendIntoRemoteChanges = recurse && recurseQueryServer == ParentNotChanged && _discoveryData->_hasRemoteChanges(path._server);
+        if (descendIntoRemoteChanges)
+            recurseQueryServer = NormalQuery;
+        if (_queryLocal != NormalQuery && _queryServer != NormalQuery && !descendIntoTouched && !descendIntoRemoteChanges)
             recurse = false;
 
         if ((item->_direction == SyncFileItem::Down || item->_instruction == CSYNC_INSTRUCTION_CONFLICT || item->_instruction == CSYNC_INSTRUCTION_NEW || item->_instruction == CSYNC_INSTRUCTION_SYNC) &&
@@ -1104,7 +1139,7 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
             }
         }
 
-        auto recurseQueryLocal = _queryLocal == ParentNotChanged ? ParentNotChanged : localEntry.isDirectory || item->_instruction == CSYNC_INSTRUCTION_RENAME ? NormalQuery : ParentDontExist;
+        auto recurseQueryLocal = descendIntoTouched ? NormalQuery : _queryLocal == ParentNotChanged ? ParentNotChanged : localEntry.isDirectory || item->_instruction == CSYNC_INSTRUCTION_RENAME ? NormalQuery : ParentDontExist;
         processFileFinalize(item, path, recurse, recurseQueryLocal, recurseQueryServer);
     };
 
@@ -2063,6 +2098,7 @@ int ProcessDirectoryJob::processSubJobs(int nbJobs)
                 _dirItem->_instruction = CSYNC_INSTRUCTION_NONE;
             }
         }
+        SyncTrace::asyncEnd(SyncTrace::Category::Discovery, "directory", this);
         emit finished();
     }
 
@@ -2112,7 +2148,7 @@ void ProcessDirectoryJob::chopVirtualFileSuffix(QString &str) const
 
 DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
 {
-    if (_dirItem && _dirItem->isEncrypted() && _dirItem->_encryptedFileName.isEmpty()) {
+    if (_dirItem && _dirItem->isEncrypted() && _dirItem->details()._encryptedFileName.isEmpty()) {
         _discoveryData->_topLevelE2eeFolderPaths.insert(_discoveryData->_remoteFolder + _dirItem->_file);
     }
     auto serverJob = new DiscoverySingleDirectoryJob(_discoveryData->_account,
@@ -2150,6 +2186,9 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
             _serverQueryDone = true;
             if (!serverJob->_dataFingerprint.isEmpty() && _discoveryData->_dataFingerprint.isEmpty())
                 _discoveryData->_dataFingerprint = serverJob->_dataFingerprint;
+            if (!serverJob->_syncToken.isEmpty() && _discoveryData->_syncToken.isEmpty())
+                _discoveryData->_syncToken = serverJob->_syncToken;
+            _discoveryData->_prefetchedListings.insert(serverJob->_prefetchedListings);
             if (_localQueryDone)
                 this->process();
         } else {
@@ -2176,10 +2215,42 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
     });
     connect(serverJob, &DiscoverySingleDirectoryJob::firstDirectoryPermissions, this,
         [this](const RemotePermissions &perms) { _rootPermissions = perms; });
-    serverJob->start();
+
+    const auto prefetched = _discoveryData->_prefetchedListings.constFind(_currentFolder._server);
+    if (prefetched != _discoveryData->_prefetchedListings.cend()) {
+        qCDebug(lcDisco) << "using the prefetched listing of" << _currentFolder._server;
+        serverJob->start(*prefetched);
+        _discoveryData->_prefetchedListings.erase(prefetched);
+    } else {
+        if (shouldListDepthInfinity()) {
+            serverJob->setDepthInfinity();
+        }
+        serverJob->start();
+    }
     return serverJob;
 }
 
+bool ProcessDirectoryJob::shouldListDepthInfinity() const
+{
+    if (!_discoveryData->_account->isDepthInfinityPropfindSupported()) {
+        return false;
+    }
+    // Only worth it where the whole subtree gets listed anyway: on the initial
+    // sync and in folders that are new on the server
+    if (_dirItem) {
+        if (_dirItem->_instruction != CSYNC_INSTRUCTION_NEW || _dirItem->_direction != SyncFileItem::Down || _dirItem->isEncrypted()) {
+            return false;
+        }
+    } else if (_discoveryData->_statedb->getFileRecordCount() != 0) {
+        return false;
+    }
+    // Don't fetch the subtrees selective sync leaves out
+    const auto prefix = _currentFolder._server.isEmpty() ? QString() : _currentFolder._server + QLatin1Char('/');
+    return std::none_of(_discoveryData->_selectiveSyncBlackList.cbegin(), _discoveryData->_selectiveSyncBlackList.cend(), [&prefix](const QString &path) {
+        return path.startsWith(prefix);
+    });
+}
+
 void ProcessDirectoryJob::startAsyncLocalQuery()
 {
     QString localPath = _discoveryData->_localDir + _currentFolder._local;
@@ -16,10 +16,13 @@
 
 #include <QObject>
 #include "discoveryphase.h"
+#include "monotonicarena.h"
 #include "syncfileitem.h"
 #include "common/asserts.h"
 #include "common/syncjournaldb.h"
 
+#include <map>
+
 class ExcludedFiles;
 
 namespace OCC {
@@ -136,6 +139,8 @@ private:
         RemoteInfo serverEntry;
         LocalInfo localEntry;
     };
+    /// The entries of the directory by name, the map nodes live in _arena
+    using EntriesMap = std::map<QString, Entries, std::less<QString>, ArenaAllocator<std::pair<const QString, Entries>>>;
 
     /** Iterate over entries inside the directory (non-recursively).
      *
@@ -147,9 +152,9 @@ private:
 
     // return true if the file is excluded.
     // path is the full relative path of the file. localName is the base name of the local entry.
-    bool handleExcluded(const QString &path, const Entries &entries, const std::map<QString, Entries> &allEntries, bool isHidden);
+    bool handleExcluded(const QString &path, const Entries &entries, const EntriesMap &allEntries, bool isHidden);
 
-    bool canRemoveCaseClashConflictedCopy(const QString &path, const std::map<QString, Entries> &allEntries);
+    bool canRemoveCaseClashConflictedCopy(const QString &path, const EntriesMap &allEntries);
 
     // check if the path is an e2e encrypted and the e2ee is not set up, and insert it into a corresponding list in the sync journal
     void checkAndUpdateSelectiveSyncListsForE2eeFolders(const QString &path);
@@ -229,6 +234,9 @@ private:
      */
     DiscoverySingleDirectoryJob *startAsyncServerQuery();
 
+    /** Whether the server query should fetch the whole subtree, see DiscoverySingleDirectoryJob::setDepthInfinity() */
+    [[nodiscard]] bool shouldListDepthInfinity() const;
+
     /** Discover the local directory
       *
       * Fills _localNormalQueryEntries.
@@ -295,6 +303,13 @@ private:
     DiscoveryPhase *_discoveryData;
 
     PathTuple _currentFolder;
+
+    /** Backs the temporaries of process(), released once it is done with them
+     *
+     * A directory's entries are all created and dropped together, the arena
+     * saves the heap from a node allocation for each of them.
+     */
+    MonotonicArena _arena;
     bool _childModified = false; // the directory contains modified item what would prevent deletion
     bool _childIgnored = false; // The directory contains ignored item that would prevent deletion
     PinState _pinState = PinState::Unspecified; // The directory's pin-state, see computePinState()
@@ -36,6 +36,9 @@
 #include <QTextCodec>
 #include <cstring>
 #include <QDateTime>
+#include <QTimer>
+
+#include <algorithm>
 
 
 namespace OCC {
@@ -268,7 +271,8 @@ bool DiscoveryPhase::isRenamed(const QString &p) const
 
 void DiscoveryPhase::scheduleMoreJobs()
 {
-    auto limit = qMax(1, _syncOptions._parallelNetworkJobs);
+    // Discovery only sends PROPFINDs: over HTTP/2 it may use the whole stream budget
+    auto limit = _syncOptions.requestBudget(_account->isHttp2Supported());
     if (_currentRootJob && _currentlyActiveJobs < limit) {
         _currentRootJob->processSubJobs(limit - _currentlyActiveJobs);
     }
@@ -402,8 +406,10 @@ void DiscoverySingleDirectoryJob::start()
           << "http://owncloud.org/ns:checksums"
           << "http://nextcloud.org/ns:is-encrypted";
 
-    if (_isRootPath)
-        props << "http://owncloud.org/ns:data-fingerprint";
+    if (_isRootPath) {
+        props << "http://owncloud.org/ns:data-fingerprint"
+              << "sync-token";
+    }
     if (_account->serverVersionInt() >= Account::makeServerVersion(10, 0, 0)) {
         // Server older than 10.0 have performances issue if we ask for the share-types on every PROPFIND
         props << "http://owncloud.org/ns:share-types";
@@ -420,6 +426,9 @@ void DiscoverySingleDirectoryJob::start()
     props << "http://nextcloud.org/ns:is-mount-root";
 
     lsColJob->setProperties(props);
+    if (_depthInfinity) {
+        lsColJob->setDepth("infinity");
+    }
 
     QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
         this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
@@ -430,6 +439,20 @@ void DiscoverySingleDirectoryJob::start()
     _lsColJob = lsColJob;
 }
 
+void DiscoverySingleDirectoryJob::start(const PrefetchedListing &listing)
+{
+    Q_ASSERT(!listing._href.isEmpty());
+    // Still finish asynchronously, like a PROPFIND would
+    QTimer::singleShot(0, this, [this, listing] {
+        _responseTimestamp = listing._responseTimestamp;
+        directoryListingIteratedSlot(listing._href, listing._properties);
+        for (const auto &child : listing._children) {
+            directoryListingIteratedSlot(child.first, child.second);
+        }
+        lsJobFinishedWithoutErrorSlot();
+    });
+}
+
 void DiscoverySingleDirectoryJob::abort()
 {
     if (_lsColJob && _lsColJob->reply()) {
@@ -557,9 +580,18 @@ static void propertyMapToRemoteInfo(const QMap<QString, QString> &map, RemotePer
 
 void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &file, const QMap<QString, QString> &map)
 {
+    if (_depthInfinity && _ignoredFirst) {
+        addPrefetchedEntry(file, map);
+        if (file.left(file.lastIndexOf('/')) != _href) {
+            // Not a direct child, only its own folder's job will need it
+            return;
+        }
+    }
+
     if (!_ignoredFirst) {
         // The first entry is for the folder itself, we should process it differently.
         _ignoredFirst = true;
+        _href = file;
         if (map.contains("permissions")) {
             auto perm = RemotePermissions::fromServerString(map.value("permissions"),
                                                             _account->serverHasMountRootProperty() ? RemotePermissions::MountedPermissionAlgorithm::UseMountRootProperty : RemotePermissions::MountedPermissionAlgorithm::WildGuessMountedSubProperty,
@@ -575,6 +607,9 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
                 _dataFingerprint = "[empty]";
             }
         }
+        if (map.contains("sync-token")) {
+            _syncToken = map.value("sync-token").toUtf8();
+        }
         if (map.contains(QStringLiteral("fileid"))) {
             _localFileId = map.value(QStringLiteral("fileid")).toUtf8();
         }
@@ -611,8 +646,75 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
     }
 }
 
+void DiscoverySingleDirectoryJob::addPrefetchedEntry(const QString &file, const QMap<QString, QString> &map)
+{
+    // Maps an href below the folder itself to the path relative to the remote root folder
+    const auto pathOf = [this](const QString &href) {
+        const auto path = _subPath.mid(_remoteRootFolderPath.size());
+        const auto relative = href.mid(_href.size());
+        return path.isEmpty() ? relative.mid(1) : path + relative;
+    };
+
+    const auto parentHref = file.left(file.lastIndexOf('/'));
+    if (parentHref != _href) {
+        _receivedDeepEntry = true;
+        _prefetchedListings[pathOf(parentHref)]._children.append({file, map});
+    }
+    if (map.value(QStringLiteral("resourcetype")).contains(QStringLiteral("collection"))) {
+        auto &listing = _prefetchedListings[pathOf(file)];
+        listing._href = file;
+        listing._properties = map;
+    }
+}
+
+void DiscoverySingleDirectoryJob::dropUnusablePrefetchedListings()
+{
+    if (_prefetchedListings.isEmpty()) {
+        return;
+    }
+    if (!_receivedDeepEntry) {
+        // Subfolders but nothing inside them: sabre/dav answers "Depth: infinity" with
+        // depth 1 when it's disabled on the server instead of rejecting it. The
+        // subfolders may well have contents, they have to be listed on their own.
+        qCInfo(lcDiscovery) << "Depth infinity PROPFIND was answered with depth 1 for" << _subPath;
+        _account->setDepthInfinityPropfindSupported(false);
+        _prefetchedListings.clear();
+        return;
+    }
+    if (isE2eEncrypted()) {
+        // The metadata of each encrypted folder is needed to make sense of its entries
+        _prefetchedListings.clear();
+        return;
+    }
+
+    QStringList encryptedFolders;
+    for (auto it = _prefetchedListings.cbegin(); it != _prefetchedListings.cend(); ++it) {
+        if (it->_properties.value(QStringLiteral("is-encrypted")) == QStringLiteral("1")) {
+            encryptedFolders.append(it.key());
+        }
+    }
+    for (auto it = _prefetchedListings.begin(); it != _prefetchedListings.end();) {
+        const auto &path = it.key();
+        const auto insideEncryptedFolder = std::any_of(encryptedFolders.cbegin(), encryptedFolders.cend(), [&path](const QString &folder) {
+            return path == folder || path.startsWith(folder + QLatin1Char('/'));
+        });
+        // Without the folder's own entry the listing isn't one
+        if (it->_href.isEmpty() || insideEncryptedFolder) {
+            it = _prefetchedListings.erase(it);
+        } else {
+            it->_responseTimestamp = _responseTimestamp;
+            ++it;
+        }
+    }
+}
+
 void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 {
+    if (_lsColJob) {
+        _responseTimestamp = _lsColJob->responseTimestamp();
+    }
+    dropUnusablePrefetchedListings();
+
     if (!_ignoredFirst) {
         // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingIteratedSlot
         // which means somehow the server XML was bogus
@@ -624,14 +726,14 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
         deleteLater();
         return;
     } else if (isE2eEncrypted() && _account->capabilities().clientSideEncryptionAvailable()) {
-        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
         fetchE2eMetadata();
         return;
     } else if (isE2eEncrypted() && !_account->capabilities().clientSideEncryptionAvailable()) {
-        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+        emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
         emit finished(_results);
     }
-    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
+    emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_responseTimestamp), Qt::RFC2822Date));
     emit finished(_results);
     deleteLater();
 }
@@ -648,6 +750,31 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot(QNetworkReply *r)
 
     qCWarning(lcDiscovery) << "LSCOL job error" << r->errorString() << httpCode << r->error();
 
+    if (_depthInfinity && r->error() != QNetworkReply::OperationCanceledError) {
+        // Most servers don't allow "Depth: infinity", they reply with 403. Whatever the
+        // reason, list this folder the usual way: a real error will show up again.
+        qCInfo(lcDiscovery) << "Depth infinity PROPFIND failed, falling back to depth 1 for" << _subPath;
+        if (httpCode == 403 || httpCode == 400 || httpCode == 501) {
+            _account->setDepthInfinityPropfindSupported(false);
+        }
+        _depthInfinity = false;
+        _ignoredFirst = false;
+        _href.clear();
+        _results.clear();
+        _prefetchedListings.clear();
+        _receivedDeepEntry = false;
+        _firstEtag.clear();
+        _fileId.clear();
+        _localFileId.clear();
+        _isExternalStorage = false;
+        _encryptionStatusCurrent = SyncFileItem::EncryptionStatus::NotEncrypted;
+        _size = 0;
+        _dataFingerprint.clear();
+        _syncToken.clear();
+        start();
+        return;
+    }
+
     if (r->error() == QNetworkReply::NoError && invalidContentType) {
         msg = tr("Server error: PROPFIND reply is not XML formatted!");
     }
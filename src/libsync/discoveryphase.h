@@ -134,6 +134,21 @@ public:
 
 class FolderMetadata;
 
+/**
+ * @brief The PROPFIND response entries of one folder, taken from the
+ * "Depth: infinity" PROPFIND of an ancestor
+ *
+ * See DiscoverySingleDirectoryJob::setDepthInfinity().
+ */
+struct PrefetchedListing
+{
+    // the folder itself, empty until its entry was seen
+    QString _href;
+    QMap<QString, QString> _properties;
+    QVector<QPair<QString, QMap<QString, QString>>> _children;
+    QByteArray _responseTimestamp;
+};
+
 /**
  * @brief Run a PROPFIND on a directory and process the results for Discovery
  *
@@ -153,7 +168,16 @@ public:
                                          QObject *parent = nullptr);
     // Specify that this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
+    /**
+     * Request the whole subtree with "Depth: infinity" instead of only the direct
+     * children. The listings of the subfolders are left in _prefetchedListings so
+     * that their jobs don't need a request of their own. Servers rejecting the
+     * depth are asked again with "Depth: 1".
+     */
+    void setDepthInfinity() { _depthInfinity = true; }
     void start();
+    /** Processes a listing some ancestor prefetched instead of sending a PROPFIND. */
+    void start(const PrefetchedListing &listing);
     void abort();
     [[nodiscard]] bool isFileDropDetected() const;
     [[nodiscard]] bool encryptedMetadataNeedUpdate() const;
@@ -177,6 +201,8 @@ private slots:
 private:
 
     [[nodiscard]] bool isE2eEncrypted() const { return _encryptionStatusCurrent != SyncFileItem::EncryptionStatus::NotEncrypted; }
+    void addPrefetchedEntry(const QString &file, const QMap<QString, QString> &map);
+    void dropUnusablePrefetchedListings();
 
     QVector<RemoteInfo> _results;
     QString _subPath;
@@ -201,12 +227,22 @@ private:
     int64_t _size = 0;
     QString _error;
     QPointer<LsColJob> _lsColJob;
+    QByteArray _responseTimestamp;
+    // Set if the whole subtree is requested, see setDepthInfinity()
+    bool _depthInfinity = false;
+    // The href of the directory itself, to tell its children from deeper entries
+    QString _href;
+    // Whether the reply had entries below the direct children, see dropUnusablePrefetchedListings()
+    bool _receivedDeepEntry = false;
 
     // store top level E2EE folder paths as they are used later when discovering nested folders
     QSet<QString> _topLevelE2eeFolderPaths;
 
 public:
     QByteArray _dataFingerprint;
+    QByteArray _syncToken;
+    // The subfolder listings of a Depth:infinity request, by path relative to the remote root folder
+    QHash<QString, PrefetchedListing> _prefetchedListings;
 };
 
 class DiscoveryPhase : public QObject
@@ -319,6 +355,13 @@ public:
     QStringList _leadingAndTrailingSpacesFilesAllowed;
     bool _ignoreHiddenFiles = false;
     std::function<bool(const QString &)> _shouldDiscoverLocaly;
+    std::function<bool(const QString &)> _shouldListLocally;
+    std::function<bool(const QString &)> _shouldListRemotely;
+    std::function<bool(const QString &)> _hasRemoteChanges;
+
+    // Folder listings that came with the Depth:infinity PROPFIND of an ancestor.
+    // Taken out when the folder's job starts.
+    QHash<QString, PrefetchedListing> _prefetchedListings;
 
     void startJob(ProcessDirectoryJob *);
 
@@ -327,6 +370,7 @@ public:
 
     // output
     QByteArray _dataFingerprint;
+    QByteArray _syncToken; // the token the next sync can ask for changes with
     bool _anotherSyncNeeded = false;
     QHash<QString, long long> _filesNeedingScheduledSync;
     QVector<QString> _filesUnscheduleSync;
@@ -33,6 +33,13 @@
 #include <sddl.h>
 #endif
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#endif
+
 namespace
 {
 constexpr std::array<const char *, 2> lockFilePatterns = {{".~lock.", "~$"}};
@@ -316,6 +323,24 @@ bool FileSystem::removeRecursively(const QString &path, const std::function<void
     return allRemoved;
 }
 
+bool FileSystem::preallocate(QFile &file, qint64 size)
+{
+#ifdef Q_OS_LINUX
+    if (size <= 0 || !file.isOpen() || file.handle() < 0) {
+        return false;
+    }
+    if (fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, size) != 0) {
+        qCDebug(lcFileSystem) << "Could not preallocate" << size << "bytes for" << file.fileName() << strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+
 bool FileSystem::getInode(const QString &filename, quint64 *inode)
 {
     csync_file_stat_t fs;
@@ -92,6 +92,15 @@ namespace FileSystem {
      */
     qint64 OWNCLOUDSYNC_EXPORT getSize(const QString &filename);
 
+    /**
+     * @brief Reserve disk space for \a size bytes of the open \a file
+     *
+     * The file size visible to readers is not changed. Only implemented on
+     * Linux (fallocate with FALLOC_FL_KEEP_SIZE), returns false elsewhere or
+     * if the file system does not support it.
+     */
+    bool OWNCLOUDSYNC_EXPORT preallocate(QFile &file, qint64 size);
+
     /**
      * @brief Retrieve a file inode with csync
      */
@@ -13,6 +13,7 @@
  */
 
 #include "httplogger.h"
+#include "requesttiming.h"
 
 #include <QRegularExpression>
 #include <QLoggingCategory>
@@ -115,6 +116,15 @@ void HttpLogger::logRequest(QNetworkReply *reply, QNetworkAccessManager::Operati
     });
 }
 
+void HttpLogger::logTiming(const QNetworkReply &reply, const RequestTiming &timing)
+{
+    if (!lcNetworkHttp().isInfoEnabled()) {
+        return;
+    }
+    qCInfo(lcNetworkHttp).noquote() << reply.request().rawHeader(XRequestId()) << ": Timing:" << timing.verb()
+                                    << RequestTiming::endpointName(timing.endpoint()) << reply.url().toString() << timing.toString();
+}
+
 QByteArray HttpLogger::requestVerb(QNetworkAccessManager::Operation operation, const QNetworkRequest &request)
 {
     switch (operation) {
@@ -19,9 +19,16 @@
 #include <QUrl>
 
 namespace OCC {
+class RequestTiming;
+
 namespace HttpLogger {
     void OWNCLOUDSYNC_EXPORT logRequest(QNetworkReply *reply, QNetworkAccessManager::Operation operation, QIODevice *device);
 
+    /**
+    * Logs where the time of the finished \a reply went, next to its request and response
+    */
+    void OWNCLOUDSYNC_EXPORT logTiming(const QNetworkReply &reply, const RequestTiming &timing);
+
     /**
     * Helper to construct the HTTP verb used in the request
     */
@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "internedpath.h"
+
+#include <QHash>
+#include <QtAlgorithms>
+#include <QReadWriteLock>
+#include <QStringView>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace OCC {
+
+namespace {
+
+    class PathTable
+    {
+    public:
+        static PathTable &instance()
+        {
+            // Never destroyed, handles in other static objects may outlive it otherwise
+            static auto *table = new PathTable;
+            return *table;
+        }
+
+        struct Node
+        {
+            std::atomic<quint32> _refs{0}; // handles and child nodes
+            quint32 _parent = nullId; // nullId while the node is free
+            quint32 _name = 0;
+            quint32 _depth = 0;
+        };
+
+        struct NodeInfo
+        {
+            quint32 _parent;
+            quint32 _depth;
+        };
+
+        PathTable()
+        {
+            // The root: the empty path, it is never counted nor freed
+            nodeAt(allocateNode())._parent = 0;
+            _names.push_back({QString(), 0});
+            _nameIds.insert(QStringView(), 0);
+        }
+
+        /** The counted id of the path, or nullId; when \a insert the missing components are added */
+        quint32 lookup(const QString &path, bool insert)
+        {
+            if (path.isEmpty()) {
+                return 0;
+            }
+            {
+                QReadLocker locker(&_lock);
+                const auto id = walk(path, false);
+                if (id != nullId || !insert) {
+                    addReference(id);
+                    return id;
+                }
+            }
+            QWriteLocker locker(&_lock);
+            const auto id = walk(path, true);
+            addReference(id);
+            return id;
+        }
+
+        /** The counted id of \a name inside \a parent, added if needed */
+        quint32 child(quint32 parent, const QString &name)
+        {
+            {
+                QReadLocker locker(&_lock);
+                const auto id = childLocked(parent, QStringView(name), false);
+                if (id != nullId) {
+                    addReference(id);
+                    return id;
+                }
+            }
+            QWriteLocker locker(&_lock);
+            const auto id = childLocked(parent, QStringView(name), true);
+            addReference(id);
+            return id;
+        }
+
+        NodeInfo node(quint32 id) const
+        {
+            QReadLocker locker(&_lock);
+            const auto &node = nodeAt(id);
+            return {node._parent, node._depth};
+        }
+
+        QString name(quint32 id) const
+        {
+            QReadLocker locker(&_lock);
+            return _names[nodeAt(id)._name]._string;
+        }
+
+        QString toString(quint32 id) const
+        {
+            QReadLocker locker(&_lock);
+            QVarLengthArray<quint32, 32> components;
+            qsizetype length = 0;
+            for (auto current = id; current != 0; current = nodeAt(current)._parent) {
+                components.append(current);
+                length += _names[nodeAt(current)._name]._string.size() + 1;
+            }
+            QString result;
+            result.reserve(qMax<qsizetype>(length - 1, 0));
+            for (auto it = components.crbegin(); it != components.crend(); ++it) {
+                if (it != components.crbegin()) {
+                    result += QLatin1Char('/');
+                }
+                result += _names[nodeAt(*it)._name]._string;
+            }
+            return result;
+        }
+
+        /** Counts a new handle or child of \a id, which the caller keeps alive meanwhile */
+        void addReference(quint32 id)
+        {
+            if (id != 0 && id != nullId) {
+                nodeAt(id)._refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void dropReference(quint32 id)
+        {
+            if (nodeAt(id)._refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            QWriteLocker locker(&_lock);
+            collectLocked(id);
+        }
+
+        quint32 pathCount() const
+        {
+            QReadLocker locker(&_lock);
+            return _nodeCount - static_cast<quint32>(_freeNodes.size());
+        }
+
+        quint32 nameCount() const
+        {
+            QReadLocker locker(&_lock);
+            return static_cast<quint32>(_names.size() - _freeNames.size());
+        }
+
+        static constexpr quint32 nullId = 0xffffffff;
+
+    private:
+        // The nodes live in chunks that are never moved, so the reference
+        // counts can be changed without the lock. Chunk i holds
+        // 2^(firstChunkBits + i) nodes.
+        static constexpr int firstChunkBits = 10;
+        static constexpr int chunkCount = 32 - firstChunkBits + 1;
+
+        static std::pair<int, quint64> chunkIndex(quint32 id)
+        {
+            const auto index = quint64(id) + (quint64(1) << firstChunkBits);
+            const auto chunk = 63 - qCountLeadingZeroBits(index) - firstChunkBits;
+            return {static_cast<int>(chunk), index - (quint64(1) << (chunk + firstChunkBits))};
+        }
+
+        Node &nodeAt(quint32 id) const
+        {
+            const auto [chunk, offset] = chunkIndex(id);
+            return _chunks[chunk][offset];
+        }
+
+        static quint32 chunkStart(int chunk) { return static_cast<quint32>((quint64(1) << (chunk + firstChunkBits)) - (quint64(1) << firstChunkBits)); }
+
+        // The free ids are min-heaps: the lowest ones are reused first, so
+        // the ids in use gather at the start and trim() can release the end.
+        static quint32 takeLowest(std::vector<quint32> &heap)
+        {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            const auto id = heap.back();
+            heap.pop_back();
+            return id;
+        }
+
+        static void putBack(std::vector<quint32> &heap, quint32 id)
+        {
+            heap.push_back(id);
+            std::push_heap(heap.begin(), heap.end(), std::greater<>());
+        }
+
+        // Callers hold the lock for writing
+        quint32 allocateNode()
+        {
+            quint32 id = 0;
+            if (!_freeNodes.empty()) {
+                id = takeLowest(_freeNodes);
+            } else {
+                Q_ASSERT(_nodeCount < nullId);
+                id = _nodeCount++;
+                const auto [chunk, offset] = chunkIndex(id);
+                if (offset == 0) {
+                    _chunks[chunk] = std::make_unique<Node[]>(quint64(1) << (chunk + firstChunkBits));
+                }
+            }
+            ++_usedInChunk[chunkIndex(id).first];
+            return id;
+        }
+
+        quint32 allocateName(QStringView name)
+        {
+            quint32 nameId = 0;
+            if (!_freeNames.empty()) {
+                nameId = takeLowest(_freeNames);
+                _names[nameId] = {name.toString(), 0};
+            } else {
+                nameId = static_cast<quint32>(_names.size());
+                _names.push_back({name.toString(), 0});
+            }
+            // The view points into the string's data, which stays put when _names grows
+            _nameIds.insert(QStringView(_names[nameId]._string), nameId);
+            return nameId;
+        }
+
+        // Gives the unused chunks at the end, the unused names at the end and
+        // the unused hash buckets back. Only runs when the last chunk became
+        // unused or the free ids doubled since the last time, so it costs
+        // O(1) per freed path.
+        void maybeTrim()
+        {
+            auto topChunk = chunkIndex(_nodeCount - 1).first;
+            const auto freeIds = _freeNodes.size() + _freeNames.size();
+            if ((topChunk == 0 || _usedInChunk[topChunk] != 0) && freeIds < _trimThreshold) {
+                return;
+            }
+
+            while (topChunk > 0 && _usedInChunk[topChunk] == 0) {
+                _chunks[topChunk].reset();
+                _nodeCount = chunkStart(topChunk);
+                --topChunk;
+            }
+            _freeNodes.erase(std::remove_if(_freeNodes.begin(), _freeNodes.end(), [this](quint32 id) { return id >= _nodeCount; }), _freeNodes.end());
+            std::make_heap(_freeNodes.begin(), _freeNodes.end(), std::greater<>());
+            _freeNodes.shrink_to_fit();
+
+            auto nameCount = _names.size();
+            while (nameCount > 1 && _names[nameCount - 1]._refs == 0) {
+                --nameCount;
+            }
+            _names.resize(nameCount);
+            _names.shrink_to_fit();
+            _freeNames.erase(std::remove_if(_freeNames.begin(), _freeNames.end(), [nameCount](quint32 id) { return id >= nameCount; }), _freeNames.end());
+            std::make_heap(_freeNames.begin(), _freeNames.end(), std::greater<>());
+            _freeNames.shrink_to_fit();
+
+            if (_children.size() * 4 < _children.capacity()) {
+                _children.squeeze();
+            }
+            if (_nameIds.size() * 4 < _nameIds.capacity()) {
+                _nameIds.squeeze();
+            }
+
+            _trimThreshold = qMax(minTrimThreshold, 2 * (_freeNodes.size() + _freeNames.size()));
+        }
+
+        // Frees \a id and then its parents as long as nothing references them.
+        // A handle may have been taken again since the count dropped to zero,
+        // or another thread freed the node already.
+        void collectLocked(quint32 id)
+        {
+            while (id != 0 && id < _nodeCount) {
+                auto &node = nodeAt(id);
+                if (node._parent == nullId || node._refs.load(std::memory_order_acquire) != 0) {
+                    return;
+                }
+                const auto parent = node._parent;
+                _children.remove(childKey(parent, node._name));
+                releaseName(node._name);
+                node._parent = nullId;
+                putBack(_freeNodes, id);
+                --_usedInChunk[chunkIndex(id).first];
+                if (parent == 0 || nodeAt(parent)._refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    break;
+                }
+                id = parent;
+            }
+            maybeTrim();
+        }
+
+        void releaseName(quint32 nameId)
+        {
+            if (nameId == 0 || --_names[nameId]._refs != 0) {
+                return;
+            }
+            _nameIds.remove(QStringView(_names[nameId]._string));
+            _names[nameId]._string = QString();
+            putBack(_freeNames, nameId);
+        }
+
+        static quint64 childKey(quint32 parent, quint32 nameId) { return (quint64(parent) << 32) | nameId; }
+
+        // Callers hold the lock, for writing when \a insert
+        quint32 walk(const QString &path, bool insert)
+        {
+            quint32 id = 0;
+            qsizetype start = 0;
+            while (true) {
+                const auto slash = path.indexOf(QLatin1Char('/'), start);
+                const auto end = slash == -1 ? path.size() : slash;
+                id = childLocked(id, QStringView(path).mid(start, end - start), insert);
+                if (id == nullId || slash == -1) {
+                    return id;
+                }
+                start = slash + 1;
+            }
+        }
+
+        quint32 childLocked(quint32 parent, QStringView name, bool insert)
+        {
+            auto nameId = _nameIds.value(name, nullId);
+            if (nameId == nullId) {
+                if (!insert) {
+                    return nullId;
+                }
+                nameId = allocateName(name);
+            }
+            const auto key = childKey(parent, nameId);
+            auto id = _children.value(key, nullId);
+            if (id == nullId && insert) {
+                id = allocateNode();
+                auto &node = nodeAt(id);
+                node._refs.store(0, std::memory_order_relaxed);
+                node._parent = parent;
+                node._name = nameId;
+                node._depth = nodeAt(parent)._depth + 1;
+                if (nameId != 0) {
+                    ++_names[nameId]._refs;
+                }
+                addReference(parent);
+                _children.insert(key, id);
+            }
+            return id;
+        }
+
+        struct Name
+        {
+            QString _string;
+            quint32 _refs; // nodes using the name
+        };
+
+        static constexpr size_t minTrimThreshold = 4096;
+
+        mutable QReadWriteLock _lock;
+        std::unique_ptr<Node[]> _chunks[chunkCount];
+        quint32 _usedInChunk[chunkCount] = {};
+        quint32 _nodeCount = 0; // ids below are in a chunk, used or free
+        std::vector<quint32> _freeNodes;
+        std::vector<Name> _names;
+        std::vector<quint32> _freeNames;
+        size_t _trimThreshold = minTrimThreshold;
+        QHash<QStringView, quint32> _nameIds; // views of the strings in _names
+        QHash<quint64, quint32> _children; // by parent id and name id
+    };
+
+}
+
+InternedPath InternedPath::fromString(const QString &path)
+{
+    return InternedPath(PathTable::instance().lookup(path, true));
+}
+
+InternedPath InternedPath::find(const QString &path)
+{
+    return InternedPath(PathTable::instance().lookup(path, false));
+}
+
+InternedPath InternedPath::child(const QString &name) const
+{
+    Q_ASSERT(!isNull());
+    return InternedPath(PathTable::instance().child(_id, name));
+}
+
+QString InternedPath::toString() const
+{
+    if (isNull() || isRoot()) {
+        return {};
+    }
+    return PathTable::instance().toString(_id);
+}
+
+QString InternedPath::name() const
+{
+    if (isNull() || isRoot()) {
+        return {};
+    }
+    return PathTable::instance().name(_id);
+}
+
+InternedPath InternedPath::parent() const
+{
+    if (isNull() || isRoot()) {
+        return *this;
+    }
+    // We keep our parent alive
+    const auto parentId = PathTable::instance().node(_id)._parent;
+    retain(parentId);
+    return InternedPath(parentId);
+}
+
+int InternedPath::depth() const
+{
+    if (isNull()) {
+        return 0;
+    }
+    return static_cast<int>(PathTable::instance().node(_id)._depth);
+}
+
+bool InternedPath::isAncestorOf(const InternedPath &other) const
+{
+    if (isNull() || other.isNull()) {
+        return false;
+    }
+    const auto &table = PathTable::instance();
+    const auto depth = this->depth();
+    auto current = table.node(other._id);
+    if (current._depth <= static_cast<quint32>(depth)) {
+        return false;
+    }
+    // Walk up to our depth, then it has to be us
+    auto currentId = other._id;
+    while (current._depth > static_cast<quint32>(depth)) {
+        currentId = current._parent;
+        current = table.node(currentId);
+    }
+    return currentId == _id;
+}
+
+void InternedPath::addReference(quint32 id)
+{
+    PathTable::instance().addReference(id);
+}
+
+void InternedPath::dropReference(quint32 id)
+{
+    PathTable::instance().dropReference(id);
+}
+
+quint32 InternedPath::pathCount()
+{
+    return PathTable::instance().pathCount();
+}
+
+quint32 InternedPath::nameCount()
+{
+    return PathTable::instance().nameCount();
+}
+
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QHashFunctions>
+#include <QString>
+
+#include <utility>
+
+namespace OCC {
+
+/**
+ * @brief Handle to a path in a process-wide table of paths
+ *
+ * Each path is stored once, as a node with the handle of its parent and the
+ * name of its last component, and the names are stored once too. So a deep
+ * tree of files costs a few bytes per path instead of a string each, and
+ * state keyed by path shares the storage wherever it lives.
+ *
+ * Handles are reference counted integers: copying and comparing them is
+ * O(1), parent() is O(1) and isAncestorOf() is O(depth). Paths are split at
+ * '/' and kept as given, toString() returns exactly the string that was
+ * interned. The default handle is the empty path, the root of relative paths.
+ *
+ * A path stays in the table while there is a handle to it or to one of the
+ * paths below it, names stay while a path uses them. The table is thread
+ * safe.
+ *
+ * Only state that outlives a sync run and is looked up by path uses it:
+ * the sync counts of SyncFileStatusTracker and TouchedFiles. The paths of
+ * SyncFileItem and the discovery's PathTuple stay QStrings. Nearly every
+ * use of them needs the string, for the journal, the file system, the VFS
+ * plugins or the UI, and toString() would rebuild it each time under the
+ * table lock. Their copies already share one buffer through implicit
+ * sharing, so the table would save little there.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT InternedPath
+{
+public:
+    InternedPath() = default;
+    InternedPath(const InternedPath &other)
+        : _id(other._id)
+    {
+        retain(_id);
+    }
+    InternedPath(InternedPath &&other) noexcept
+        : _id(std::exchange(other._id, rootId))
+    {
+    }
+    InternedPath &operator=(const InternedPath &other)
+    {
+        retain(other._id);
+        release(_id);
+        _id = other._id;
+        return *this;
+    }
+    InternedPath &operator=(InternedPath &&other) noexcept
+    {
+        std::swap(_id, other._id);
+        return *this;
+    }
+    ~InternedPath() { release(_id); }
+
+    /** The handle of \a path, added to the table if needed */
+    [[nodiscard]] static InternedPath fromString(const QString &path);
+    /** The handle of \a path if it is in the table, a null handle otherwise */
+    [[nodiscard]] static InternedPath find(const QString &path);
+
+    /** The handle of \a name inside this path, added to the table if needed */
+    [[nodiscard]] InternedPath child(const QString &name) const;
+
+    [[nodiscard]] QString toString() const;
+    /** The last component, empty for the root */
+    [[nodiscard]] QString name() const;
+    /** The path without its last component, the root for the root */
+    [[nodiscard]] InternedPath parent() const;
+    /** The number of components, 0 for the root */
+    [[nodiscard]] int depth() const;
+
+    [[nodiscard]] bool isRoot() const { return _id == rootId; }
+    /** find() didn't know the path */
+    [[nodiscard]] bool isNull() const { return _id == nullId; }
+    /** Whether this path is a proper ancestor of \a other */
+    [[nodiscard]] bool isAncestorOf(const InternedPath &other) const;
+
+    [[nodiscard]] quint32 id() const { return _id; }
+
+    friend bool operator==(const InternedPath &lhs, const InternedPath &rhs) { return lhs._id == rhs._id; }
+    friend bool operator!=(const InternedPath &lhs, const InternedPath &rhs) { return lhs._id != rhs._id; }
+
+    /** The number of paths and of distinct names in the table, including the root */
+    [[nodiscard]] static quint32 pathCount();
+    [[nodiscard]] static quint32 nameCount();
+
+private:
+    static constexpr quint32 rootId = 0;
+    static constexpr quint32 nullId = 0xffffffff;
+
+    // Takes over a reference the table already counted
+    explicit InternedPath(quint32 id)
+        : _id(id)
+    {
+    }
+
+    // The root and the null handle aren't counted
+    static void retain(quint32 id)
+    {
+        if (id != rootId && id != nullId) {
+            addReference(id);
+        }
+    }
+    static void release(quint32 id)
+    {
+        if (id != rootId && id != nullId) {
+            dropReference(id);
+        }
+    }
+    static void addReference(quint32 id);
+    static void dropReference(quint32 id);
+
+    quint32 _id = rootId;
+};
+
+inline size_t qHash(const InternedPath &path, size_t seed = 0) noexcept
+{
+    return QT_PREPEND_NAMESPACE(qHash)(path.id(), seed);
+}
+
+}
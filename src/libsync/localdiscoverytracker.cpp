@@ -15,6 +15,7 @@
 #include "localdiscoverytracker.h"
 
 #include "syncfileitem.h"
+#include "common/syncjournaldb.h"
 
 #include <QLoggingCategory>
 
@@ -22,23 +23,73 @@ using namespace OCC;
 
 Q_LOGGING_CATEGORY(lcLocalDiscoveryTracker, "sync.localdiscoverytracker", QtInfoMsg)
 
-LocalDiscoveryTracker::LocalDiscoveryTracker() = default;
+namespace {
+// How long touched paths may wait before they are written to the journal
+constexpr auto touchedPathsFlushInterval = std::chrono::seconds(10);
+}
+
+LocalDiscoveryTracker::LocalDiscoveryTracker()
+{
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(touchedPathsFlushInterval);
+    connect(&_flushTimer, &QTimer::timeout, this, &LocalDiscoveryTracker::flushTouchedPaths);
+}
+
+void LocalDiscoveryTracker::setJournal(SyncJournalDb *journal)
+{
+    _journal = journal;
+
+    bool ok = false;
+    const auto paths = _journal->getLocalDiscoveryPaths(&ok);
+    if (!ok) {
+        qCWarning(lcLocalDiscoveryTracker) << "could not read the local discovery paths from the journal";
+        return;
+    }
+    qCInfo(lcLocalDiscoveryTracker) << "restored" << paths.size() << "paths from the journal";
+    _localDiscoveryPaths.insert(paths.cbegin(), paths.cend());
+}
 
 void LocalDiscoveryTracker::addTouchedPath(const QString &relativePath)
 {
     qCDebug(lcLocalDiscoveryTracker) << "inserted touched" << relativePath;
-    _localDiscoveryPaths.insert(relativePath);
+    addTouchedPaths({relativePath});
+}
+
+void LocalDiscoveryTracker::addTouchedPaths(const QStringList &relativePaths)
+{
+    qCDebug(lcLocalDiscoveryTracker) << "inserted" << relativePaths.size() << "touched paths";
+    _localDiscoveryPaths.insert(relativePaths.cbegin(), relativePaths.cend());
+    if (_journal) {
+        // The watcher reports changes in small batches, don't write each of them
+        _unsavedPaths.append(relativePaths);
+        if (!_flushTimer.isActive()) {
+            _flushTimer.start();
+        }
+    }
+}
+
+void LocalDiscoveryTracker::flushTouchedPaths()
+{
+    _flushTimer.stop();
+    if (!_journal || _unsavedPaths.isEmpty()) {
+        return;
+    }
+    _journal->addLocalDiscoveryPaths(_unsavedPaths);
+    _unsavedPaths.clear();
 }
 
 void LocalDiscoveryTracker::startSyncFullDiscovery()
 {
     _localDiscoveryPaths.clear();
     _previousLocalDiscoveryPaths.clear();
+    persistPaths();
     qCDebug(lcLocalDiscoveryTracker) << "full discovery";
 }
 
 void LocalDiscoveryTracker::startSyncPartialDiscovery()
 {
+    flushTouchedPaths();
+
     if (lcLocalDiscoveryTracker().isDebugEnabled()) {
         QStringList paths;
         for (auto &path : _localDiscoveryPaths)
@@ -92,4 +143,18 @@ void LocalDiscoveryTracker::slotSyncFinished(bool success)
         qCDebug(lcLocalDiscoveryTracker) << "sync failed, keeping last sync's local discovery path list";
     }
     _previousLocalDiscoveryPaths.clear();
+    persistPaths();
+}
+
+void LocalDiscoveryTracker::persistPaths()
+{
+    // The paths of a running sync stay in the journal until it finished,
+    // so a crash meanwhile doesn't lose them
+    if (!_journal) {
+        return;
+    }
+    // These include the unsaved ones
+    _flushTimer.stop();
+    _unsavedPaths.clear();
+    _journal->setLocalDiscoveryPaths({_localDiscoveryPaths.cbegin(), _localDiscoveryPaths.cend()});
 }
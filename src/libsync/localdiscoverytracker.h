@@ -20,10 +20,13 @@
 #include <QObject>
 #include <QByteArray>
 #include <QSharedPointer>
+#include <QStringList>
+#include <QTimer>
 
 namespace OCC {
 
 class SyncFileItem;
+class SyncJournalDb;
 using SyncFileItemPtr = QSharedPointer<SyncFileItem>;
 
 /**
@@ -38,6 +41,10 @@ using SyncFileItemPtr = QSharedPointer<SyncFileItem>;
  * Then localDiscoveryPaths() can be used to determine paths to rediscover
  * and send to SyncEngine::setLocalDiscoveryOptions().
  *
+ * With setJournal(), the paths are also kept in the journal, so they
+ * survive a restart or a crash of the client. Touched paths are written in
+ * batches, see flushTouchedPaths().
+ *
  * This class is primarily used from Folder and separate primarily for
  * readability and testing purposes.
  *
@@ -52,6 +59,12 @@ class OWNCLOUDSYNC_EXPORT LocalDiscoveryTracker : public QObject
 public:
     LocalDiscoveryTracker();
 
+    /**
+     * Persists the paths in \a journal from now on, and adds the ones
+     * left there by an earlier run.
+     */
+    void setJournal(SyncJournalDb *journal);
+
     /** Adds a path that must be locally rediscovered later.
      *
      * This should be a full relative file path, example:
@@ -59,6 +72,17 @@ public:
      */
     void addTouchedPath(const QString &relativePath);
 
+    /** Adds a batch of paths, like addTouchedPath() for each of them. */
+    void addTouchedPaths(const QStringList &relativePaths);
+
+    /**
+     * Writes the touched paths that aren't in the journal yet.
+     *
+     * Happens by itself a few seconds after a path was touched and when a
+     * sync starts; call it before the journal is closed.
+     */
+    void flushTouchedPaths();
+
     /** Call when a sync run starts that rediscovers all local files */
     void startSyncFullDiscovery();
 
@@ -81,6 +105,15 @@ public slots:
     void slotSyncFinished(bool success);
 
 private:
+    /** Writes the paths still to be rediscovered to the journal */
+    void persistPaths();
+
+    SyncJournalDb *_journal = nullptr;
+
+    /// Touched paths not written to the journal yet, and the timer that writes them
+    QStringList _unsavedPaths;
+    QTimer _flushTimer;
+
     /**
      * The paths that should be checked by the next local discovery.
      *
@@ -17,6 +17,7 @@
 #include "config.h"
 
 #include <QDir>
+#include <QElapsedTimer>
 #include <QRegularExpression>
 #include <QStringList>
 #include <QtGlobal>
@@ -37,6 +38,13 @@ namespace {
 
 constexpr int CrashLogSize = 20;
 constexpr auto MaxLogLinesCount = 50000;
+constexpr auto LogQueueCapacity = 16384;
+// Messages formatted and written in one go
+constexpr auto LogBlockSize = 512;
+// How long the worker sleeps when nothing asks to be written sooner
+constexpr auto WorkerIdleIntervalMs = 100;
+// How long a warning or error waits for room in the queue before it is dropped too
+constexpr auto MaxEnqueueWaitMs = 1000;
 
 static bool compressLog(const QString &originalName, const QString &targetName)
 {
@@ -76,10 +84,12 @@ Logger *Logger::instance()
 
 Logger::Logger(QObject *parent)
     : QObject(parent)
+    , _queue(LogQueueCapacity)
 {
-    qSetMessagePattern(QStringLiteral("%{time yyyy-MM-dd hh:mm:ss:zzz} [ %{type} %{category} %{file}:%{line} "
-                                      "]%{if-debug}\t[ %{function} ]%{endif}:\t%{message}"));
+    setLogPattern(QStringLiteral("yyyy-MM-dd hh:mm:ss:zzz"),
+                  QStringLiteral("[ %{type} %{category} %{file}:%{line} ]%{if-debug}\t[ %{function} ]%{endif}:\t%{message}"));
     _crashLog.resize(CrashLogSize);
+    _worker = std::thread([this] { runWorker(); });
 #ifndef NO_MSG_HANDLER
     qInstallMessageHandler([](QtMsgType type, const QMessageLogContext &ctx, const QString &message) {
         Logger::instance()->doLog(type, ctx, message);
@@ -89,12 +99,25 @@ Logger::Logger(QObject *parent)
 
 Logger::~Logger()
 {
-    if (_logstream) {
-        _logstream->flush();
-    }
 #ifndef NO_MSG_HANDLER
     qInstallMessageHandler(nullptr);
 #endif
+    {
+        QMutexLocker lock(&_workerMutex);
+        _stopping = true;
+    }
+    _workerWakeUp.wakeOne();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+
+    // The worker is gone, this thread is the only consumer now
+    writeQueuedEntries();
+    compressPendingLogs();
+    QMutexLocker lock(&_mutex);
+    if (_logstream) {
+        _logstream->flush();
+    }
 }
 
 
@@ -116,8 +139,6 @@ bool Logger::isLoggingToFile() const
 
 void Logger::doLog(QtMsgType type, const QMessageLogContext &ctx, const QString &message)
 {
-    static long long int linesCounter = 0;
-    const auto &msg = qFormatLogMessage(type, ctx, message);
 #if defined Q_OS_WIN && (defined NEXTCLOUD_DEV || defined QT_DEBUG)
     // write logs to Output window of Visual Studio
     {
@@ -142,36 +163,192 @@ void Logger::doLog(QtMsgType type, const QMessageLogContext &ctx, const QString
         OutputDebugString(msgW.c_str());
     }
 #endif
+    LogEntry entry;
+    entry._msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    entry._type = type;
+    entry._line = ctx.line;
+    entry._category = QByteArray(ctx.category);
+    entry._file = QByteArray(ctx.file);
+    entry._function = QByteArray(ctx.function);
+    entry._message = message;
+    enqueue(std::move(entry));
+
+    if (type == QtFatalMsg) {
+        flush();
+        QMutexLocker lock(&_mutex);
+        closeNoLock();
+#if defined(Q_OS_WIN)
+        // Make application terminate in a way that can be caught by the crash reporter
+        Utility::crash();
+#endif
+    }
+}
+
+void Logger::enqueue(LogEntry &&entry)
+{
+    const auto isVerbose = entry._type == QtDebugMsg || entry._type == QtInfoMsg;
+    // The worker can't wait for itself to make room
+    const auto mayWait = !isVerbose && std::this_thread::get_id() != _worker.get_id();
+
+    QElapsedTimer waitTimer;
+    while (!_queue.tryPush(std::move(entry))) {
+        if (mayWait && !waitTimer.isValid()) {
+            waitTimer.start();
+        }
+        if (!mayWait || waitTimer.hasExpired(MaxEnqueueWaitMs)) {
+            _droppedLines.fetch_add(1, std::memory_order_relaxed);
+            wakeWorker();
+            return;
+        }
+        wakeWorker();
+        std::this_thread::yield();
+    }
+
+    if (!isVerbose || _queue.size() >= _queue.capacity() / 4) {
+        wakeWorker();
+    }
+}
+
+void Logger::wakeWorker()
+{
+    // A wake up missed because the worker wasn't waiting yet only delays it by the idle interval
+    _workerWakeUp.wakeOne();
+}
+
+void Logger::flush()
+{
+    if (!_worker.joinable() || std::this_thread::get_id() == _worker.get_id()) {
+        return;
+    }
+
+    const auto target = _queue.pushCount();
+    QMutexLocker lock(&_workerMutex);
+    while (_writtenCount < target && !_stopping) {
+        _workerWakeUp.wakeOne();
+        _linesWritten.wait(&_workerMutex, WorkerIdleIntervalMs);
+    }
+}
+
+void Logger::runWorker()
+{
+    for (;;) {
+        writeQueuedEntries();
+        compressPendingLogs();
+
+        QMutexLocker lock(&_workerMutex);
+        if (_stopping) {
+            return;
+        }
+        if (_queue.isEmpty()) {
+            _workerWakeUp.wait(&_workerMutex, WorkerIdleIntervalMs);
+        }
+    }
+}
+
+bool Logger::writeQueuedEntries()
+{
+    QString timestampFormat;
     {
         QMutexLocker lock(&_mutex);
+        timestampFormat = _timestampFormat;
+    }
+
+    auto wroteLines = false;
+    QStringList lines;
+    lines.reserve(LogBlockSize);
+    LogEntry entry;
+    for (;;) {
+        lines.clear();
+        while (lines.size() < LogBlockSize && _queue.tryPop(entry)) {
+            lines.append(formatEntry(entry, timestampFormat));
+        }
+
+        const auto droppedLines = _droppedLines.load(std::memory_order_relaxed);
+        if (droppedLines != _reportedDroppedLines) {
+            LogEntry droppedEntry;
+            droppedEntry._msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+            droppedEntry._type = QtWarningMsg;
+            droppedEntry._category = QByteArrayLiteral("nextcloud.sync.logger");
+            droppedEntry._message = QStringLiteral("%1 messages were dropped, they were logged faster than they could be written")
+                                        .arg(droppedLines - _reportedDroppedLines);
+            lines.append(formatEntry(droppedEntry, timestampFormat));
+            _reportedDroppedLines = droppedLines;
+        }
+
+        if (lines.isEmpty()) {
+            break;
+        }
+        writeLines(lines);
+        wroteLines = true;
+    }
+
+    QMutexLocker lock(&_workerMutex);
+    _writtenCount = _queue.popCount();
+    _linesWritten.wakeAll();
+    return wroteLines;
+}
+
+void Logger::writeLines(const QStringList &lines)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        for (const auto &line : lines) {
+            if (_linesCounter >= MaxLogLinesCount) {
+                _linesCounter = 0;
+                closeNoLock();
+                enterNextLogFileNoLock();
+            }
+            ++_linesCounter;
+
+            _crashLogIndex = (_crashLogIndex + 1) % CrashLogSize;
+            _crashLog[_crashLogIndex] = line;
 
-        if (linesCounter >= MaxLogLinesCount) {
-            linesCounter = 0;
             if (_logstream) {
-                _logstream->flush();
+                (*_logstream) << line << '\n';
             }
-            closeNoLock();
-            enterNextLogFileNoLock();
         }
-        ++linesCounter;
-
-        _crashLogIndex = (_crashLogIndex + 1) % CrashLogSize;
-        _crashLog[_crashLogIndex] = msg;
+        // Write through once the burst is over, so flush() means the lines are in the file
+        if (_logstream && (_doFileFlush || _queue.isEmpty())) {
+            _logstream->flush();
+        }
+    }
 
-        if (_logstream) {
-            (*_logstream) << msg << "\n";
-            if (_doFileFlush)
-                _logstream->flush();
+    if (isSignalConnected(QMetaMethod::fromSignal(&Logger::logWindowLog))) {
+        for (const auto &line : lines) {
+            emit logWindowLog(line);
         }
-        if (type == QtFatalMsg) {
-            closeNoLock();
-#if defined(Q_OS_WIN)
-            // Make application terminate in a way that can be caught by the crash reporter
-            Utility::crash();
-#endif
+    }
+}
+
+QString Logger::formatEntry(const LogEntry &entry, const QString &timestampFormat)
+{
+    const auto cString = [](const QByteArray &data) {
+        return data.isNull() ? nullptr : data.constData();
+    };
+    const QMessageLogContext ctx(cString(entry._file), entry._line, cString(entry._function), cString(entry._category));
+    auto line = qFormatLogMessage(entry._type, ctx, entry._message);
+    if (!timestampFormat.isEmpty()) {
+        line.prepend(QDateTime::fromMSecsSinceEpoch(entry._msecsSinceEpoch).toString(timestampFormat) + QLatin1Char(' '));
+    }
+    return line;
+}
+
+void Logger::compressPendingLogs()
+{
+    QStringList logsToCompress;
+    {
+        QMutexLocker lock(&_mutex);
+        logsToCompress.swap(_logsToCompress);
+    }
+
+    for (const auto &logToCompress : qAsConst(logsToCompress)) {
+        const auto compressedName = logToCompress + QStringLiteral(".gz");
+        if (compressLog(logToCompress, compressedName)) {
+            QFile::remove(logToCompress);
+        } else {
+            QFile::remove(compressedName);
         }
     }
-    emit logWindowLog(msg);
 }
 
 void Logger::closeNoLock()
@@ -199,24 +376,37 @@ void Logger::setLogFile(const QString &name)
 
 void Logger::setLogExpire(int expire)
 {
+    QMutexLocker locker(&_mutex);
     _logExpire = expire;
 }
 
 QString Logger::logDir() const
 {
+    QMutexLocker locker(&_mutex);
     return _logDirectory;
 }
 
 void Logger::setLogDir(const QString &dir)
 {
+    QMutexLocker locker(&_mutex);
     _logDirectory = dir;
 }
 
 void Logger::setLogFlush(bool flush)
 {
+    QMutexLocker locker(&_mutex);
     _doFileFlush = flush;
 }
 
+void Logger::setLogPattern(const QString &timestampFormat, const QString &messagePattern)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _timestampFormat = timestampFormat;
+    }
+    qSetMessagePattern(messagePattern);
+}
+
 void Logger::setLogDebug(bool debug)
 {
     const QSet<QString> rules = {debug ? QStringLiteral("nextcloud.*.debug=true") : QString()};
@@ -321,12 +511,9 @@ void Logger::enterNextLogFileNoLock()
         if (logToCompress.isEmpty() && files.size() > 0 && !files.last().endsWith(".gz"))
             logToCompress = dir.absoluteFilePath(files.last());
         if (!logToCompress.isEmpty()) {
-            QString compressedName = logToCompress + ".gz";
-            if (compressLog(logToCompress, compressedName)) {
-                QFile::remove(logToCompress);
-            } else {
-                QFile::remove(compressedName);
-            }
+            // Compressed by the worker, no need to hold up the logging for that
+            _logsToCompress.append(logToCompress);
+            wakeWorker();
         }
     }
 }
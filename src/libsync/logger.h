@@ -20,15 +20,26 @@
 #include <QDateTime>
 #include <QFile>
 #include <QTextStream>
+#include <QWaitCondition>
 #include <qmutex.h>
 
 #include "common/utility.h"
+#include "mpscringbuffer.h"
 #include "owncloudlib.h"
 
+#include <atomic>
+#include <thread>
+
 namespace OCC {
 
 /**
  * @brief The Logger class
+ *
+ * Logging threads only queue the message with its context. A background
+ * thread formats the queued messages, writes them in blocks, rotates and
+ * compresses the log files. When the queue is full, debug and info
+ * messages are dropped and counted; more severe ones wait for room.
+ *
  * @ingroup libsync
  */
 class OWNCLOUDSYNC_EXPORT Logger : public QObject
@@ -54,6 +65,18 @@ public:
 
     void setLogFlush(bool flush);
 
+    /** Waits until the messages logged so far are written */
+    void flush();
+
+    /** The number of messages dropped because the queue was full */
+    quint64 droppedLineCount() const { return _droppedLines.load(std::memory_order_relaxed); }
+
+    /** Sets the message pattern, see qSetMessagePattern(). The time of the message
+     * is formatted with \a timestampFormat and put in front, the pattern itself
+     * shouldn't use %{time}: the messages are formatted after they were logged.
+     */
+    void setLogPattern(const QString &timestampFormat, const QString &messagePattern);
+
     bool logDebug() const { return _logDebug; }
     void setLogDebug(bool debug);
 
@@ -91,9 +114,28 @@ public slots:
     void enterNextLogFile();
 
 private:
+    struct LogEntry
+    {
+        qint64 _msecsSinceEpoch = 0;
+        QtMsgType _type = QtDebugMsg;
+        int _line = 0;
+        QByteArray _category;
+        QByteArray _file;
+        QByteArray _function;
+        QString _message;
+    };
+
     Logger(QObject *parent = nullptr);
     ~Logger() override;
 
+    void enqueue(LogEntry &&entry);
+    void wakeWorker();
+    void runWorker();
+    bool writeQueuedEntries();
+    void writeLines(const QStringList &lines);
+    void compressPendingLogs();
+    static QString formatEntry(const LogEntry &entry, const QString &timestampFormat);
+
     void closeNoLock();
     void dumpCrashLog();
     void enterNextLogFileNoLock();
@@ -110,6 +152,22 @@ private:
     QSet<QString> _logRules;
     QVector<QString> _crashLog;
     int _crashLogIndex = 0;
+    QString _timestampFormat;
+    QStringList _logsToCompress;
+
+    MpscRingBuffer<LogEntry> _queue;
+    std::atomic<quint64> _droppedLines{0};
+
+    // Only used by the worker thread
+    quint64 _reportedDroppedLines = 0;
+    long long _linesCounter = 0;
+
+    std::thread _worker;
+    QMutex _workerMutex;
+    QWaitCondition _workerWakeUp;
+    QWaitCondition _linesWritten;
+    std::size_t _writtenCount = 0;
+    bool _stopping = false;
 };
 
 } // namespace OCC
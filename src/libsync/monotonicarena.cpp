@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "monotonicarena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace OCC {
+
+namespace {
+
+    // The data of a block starts after its header, aligned for any type
+    constexpr std::size_t headerSize = (sizeof(void *) + sizeof(std::size_t) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+}
+
+MonotonicArena::MonotonicArena(std::size_t initialBlockSize)
+    : _initialBlockSize(std::max<std::size_t>(initialBlockSize, 256))
+    , _nextBlockSize(_initialBlockSize)
+{
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    release();
+}
+
+void *MonotonicArena::allocate(std::size_t size, std::size_t alignment)
+{
+    Q_ASSERT(alignment && (alignment & (alignment - 1)) == 0);
+    size = std::max<std::size_t>(size, 1);
+
+    auto address = (reinterpret_cast<std::uintptr_t>(_current) + alignment - 1) & ~(alignment - 1);
+    if (!_current || address + size > reinterpret_cast<std::uintptr_t>(_end)) {
+        addBlock(size + alignment);
+        address = (reinterpret_cast<std::uintptr_t>(_current) + alignment - 1) & ~(alignment - 1);
+    }
+    _current = reinterpret_cast<char *>(address + size);
+
+    ++_allocationCount;
+    _bytesAllocated += size;
+    return reinterpret_cast<void *>(address);
+}
+
+void MonotonicArena::addBlock(std::size_t minimumSize)
+{
+    const auto size = std::max(_nextBlockSize, minimumSize);
+    auto block = static_cast<Block *>(::operator new(headerSize + size));
+    block->_next = _blocks;
+    block->_size = size;
+    _blocks = block;
+    _current = reinterpret_cast<char *>(block) + headerSize;
+    _end = _current + size;
+    _bytesReserved += headerSize + size;
+    _nextBlockSize = std::min(_nextBlockSize * 2, maxBlockSize);
+}
+
+void MonotonicArena::release()
+{
+    while (_blocks) {
+        auto next = _blocks->_next;
+        ::operator delete(_blocks);
+        _blocks = next;
+    }
+    _current = nullptr;
+    _end = nullptr;
+    _nextBlockSize = _initialBlockSize;
+    _allocationCount = 0;
+    _bytesAllocated = 0;
+    _bytesReserved = 0;
+}
+
+}
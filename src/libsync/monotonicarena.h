@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+namespace OCC {
+
+/**
+ * @brief Memory for short-lived objects that are all freed at once
+ *
+ * Allocations are carved from large blocks in order and never freed one by
+ * one: release() or the destructor frees all blocks. That makes allocating
+ * cheap and keeps many small temporaries from fragmenting the heap.
+ *
+ * Objects in the arena must be destroyed before it is released. Not thread
+ * safe.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT MonotonicArena
+{
+public:
+    /** The first block has \a initialBlockSize bytes, the following ones grow up to maxBlockSize */
+    explicit MonotonicArena(std::size_t initialBlockSize = 16 * 1024);
+    ~MonotonicArena();
+
+    MonotonicArena(const MonotonicArena &) = delete;
+    MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+    /** \a alignment must be a power of two */
+    [[nodiscard]] void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+    /** Frees all blocks, the counters start over */
+    void release();
+
+    /** Number of allocate() calls */
+    [[nodiscard]] quint64 allocationCount() const { return _allocationCount; }
+    /** Bytes handed out by allocate() */
+    [[nodiscard]] quint64 bytesAllocated() const { return _bytesAllocated; }
+    /** Bytes taken from the heap for the blocks */
+    [[nodiscard]] quint64 bytesReserved() const { return _bytesReserved; }
+
+    static constexpr std::size_t maxBlockSize = 1024 * 1024;
+
+private:
+    struct Block
+    {
+        Block *_next;
+        std::size_t _size; // without this header
+    };
+
+    void addBlock(std::size_t minimumSize);
+
+    Block *_blocks = nullptr;
+    char *_current = nullptr;
+    char *_end = nullptr;
+    std::size_t _initialBlockSize;
+    std::size_t _nextBlockSize;
+
+    quint64 _allocationCount = 0;
+    quint64 _bytesAllocated = 0;
+    quint64 _bytesReserved = 0;
+};
+
+/**
+ * @brief Allocator for standard containers that takes its memory from a MonotonicArena
+ *
+ * Deallocating does nothing, the memory comes back when the arena is
+ * released. The containers must not outlive the arena.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MonotonicArena *arena) noexcept
+        : _arena(arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+        : _arena(other.arena())
+    {
+    }
+
+    [[nodiscard]] T *allocate(std::size_t n)
+    {
+        return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) noexcept { }
+
+    [[nodiscard]] MonotonicArena *arena() const noexcept { return _arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept
+    {
+        return _arena == other.arena();
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const noexcept
+    {
+        return _arena != other.arena();
+    }
+
+private:
+    MonotonicArena *_arena;
+};
+
+}
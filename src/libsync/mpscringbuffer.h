@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace OCC {
+
+/**
+ * @brief Bounded lock-free queue with many producers and a single consumer
+ *
+ * Every cell carries a sequence number telling whether it is free for the
+ * producer claiming that position or holds a value for the consumer, so
+ * producers only contend on one atomic increment and never block each other
+ * or the consumer. When the queue is full tryPush() fails instead of waiting:
+ * what to do then is up to the caller.
+ *
+ * tryPop() and isEmpty() must only be called from one thread at a time.
+ *
+ * @ingroup libsync
+ */
+template <typename T>
+class MpscRingBuffer
+{
+public:
+    /** The capacity is rounded up to the next power of two */
+    explicit MpscRingBuffer(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i) {
+            _cells[i]._sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer &) = delete;
+    MpscRingBuffer &operator=(const MpscRingBuffer &) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return _mask + 1; }
+
+    /** Approximate number of queued values, exact when no push or pop is running */
+    [[nodiscard]] std::size_t size() const
+    {
+        const auto dequeuePos = _dequeuePos.load(std::memory_order_relaxed);
+        const auto enqueuePos = _enqueuePos.load(std::memory_order_relaxed);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    /** The number of values pushed so far; a value is popped once popCount() passed its position */
+    [[nodiscard]] std::size_t pushCount() const { return _enqueuePos.load(std::memory_order_acquire); }
+    [[nodiscard]] std::size_t popCount() const { return _dequeuePos.load(std::memory_order_acquire); }
+
+    bool tryPush(T &&value)
+    {
+        auto pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            auto &cell = _cells[pos & _mask];
+            const auto sequence = cell._sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell._value = std::move(value);
+                    cell._sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The consumer didn't free this cell yet
+                return false;
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T &value)
+    {
+        const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+        auto &cell = _cells[pos & _mask];
+        const auto sequence = cell._sequence.load(std::memory_order_acquire);
+        if (sequence != pos + 1) {
+            // Empty, or the producer of this cell isn't done writing it
+            return false;
+        }
+        value = std::move(cell._value);
+        cell._value = T();
+        cell._sequence.store(pos + _mask + 1, std::memory_order_release);
+        _dequeuePos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool isEmpty() const
+    {
+        const auto pos = _dequeuePos.load(std::memory_order_relaxed);
+        return _cells[pos & _mask]._sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> _sequence{0};
+        T _value{};
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask = 0;
+    // Separate cache lines, producers and the consumer don't slow each other down
+    alignas(64) std::atomic<std::size_t> _enqueuePos{0};
+    alignas(64) std::atomic<std::size_t> _dequeuePos{0};
+};
+
+}
@@ -50,6 +50,7 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcEtagJob, "nextcloud.sync.networkjob.etag", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcLsColJob, "nextcloud.sync.networkjob.lscol", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSyncCollectionJob, "nextcloud.sync.networkjob.synccollection", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcCheckServerJob, "nextcloud.sync.networkjob.checkserver", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcCheckRedirectCostFreeUrlJob, "nextcloud.sync.networkjob.checkredirectcostfreeurl", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropfindJob, "nextcloud.sync.networkjob.propfind", QtInfoMsg)
@@ -361,7 +362,7 @@ void LsColJob::start()
     }
 
     QNetworkRequest req;
-    req.setRawHeader("Depth", "1");
+    req.setRawHeader("Depth", _depth);
     QByteArray xml("<?xml version=\"1.0\" ?>\n"
                    "<d:propfind xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">\n"
                    "  <d:prop>\n"
@@ -602,6 +603,135 @@ bool CheckRedirectCostFreeUrlJob::finished()
 }
 /*********************************************************************************************/
 
+SyncCollectionJob::SyncCollectionJob(AccountPtr account, const QString &path, const QByteArray &syncToken, QObject *parent)
+    : AbstractNetworkJob(account, path, parent)
+    , _syncToken(syncToken)
+{
+}
+
+void SyncCollectionJob::start()
+{
+    QNetworkRequest req;
+    // RFC 6578 only defines the report for Depth 0, sync-level tells the server to report the whole tree
+    req.setRawHeader("Depth", "0");
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QByteArrayLiteral("application/xml; charset=utf-8"));
+    const QByteArray xml("<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+                         "<d:sync-collection xmlns:d=\"DAV:\">\n"
+                         "  <d:sync-token>" + QString::fromUtf8(_syncToken).toHtmlEscaped().toUtf8() + "</d:sync-token>\n"
+                         "  <d:sync-level>infinite</d:sync-level>\n"
+                         "  <d:prop>\n"
+                         "    <d:getetag />\n"
+                         "    <d:resourcetype />\n"
+                         "  </d:prop>\n"
+                         "</d:sync-collection>\n");
+    auto *buf = new QBuffer(this);
+    buf->setData(xml);
+    buf->open(QIODevice::ReadOnly);
+    sendRequest("REPORT", makeDavUrl(path()), req, buf);
+    AbstractNetworkJob::start();
+}
+
+bool SyncCollectionJob::finished()
+{
+    qCInfo(lcSyncCollectionJob) << "REPORT of" << reply()->request().url() << "FINISHED WITH STATUS"
+                                << replyStatusString();
+
+    const auto httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply()->error() != QNetworkReply::NoError || httpCode != 207) {
+        // Among others, 403 with a {DAV:}valid-sync-token precondition if the server forgot the token
+        emit finishedWithError(reply());
+        return true;
+    }
+
+    QVector<Change> changes;
+    QByteArray syncToken;
+    if (!parse(reply()->readAll(), reply()->request().url().path(), &changes, &syncToken) || syncToken.isEmpty()) {
+        emit finishedWithError(reply());
+        return true;
+    }
+    qCInfo(lcSyncCollectionJob) << changes.size() << "changes since the last sync token";
+    emit finishedWithChanges(changes, syncToken);
+    return true;
+}
+
+bool SyncCollectionJob::parse(const QByteArray &xml, const QString &expectedPath, QVector<Change> *changes, QByteArray *syncToken)
+{
+    auto basePath = expectedPath;
+    while (basePath.endsWith(QLatin1Char('/'))) {
+        basePath.chop(1);
+    }
+
+    QXmlStreamReader reader(xml);
+    bool insideMultiStatus = false;
+    bool insideResponse = false;
+    bool insidePropstat = false;
+    QString currentHref;
+    QString currentStatus;
+    bool currentIsCollection = false;
+
+    while (!reader.atEnd()) {
+        const auto type = reader.readNext();
+        if (reader.namespaceUri() != QLatin1String("DAV:")) {
+            continue;
+        }
+        const auto name = reader.name();
+        if (type == QXmlStreamReader::StartElement) {
+            if (name == QLatin1String("multistatus")) {
+                insideMultiStatus = true;
+            } else if (name == QLatin1String("response")) {
+                insideResponse = true;
+                currentHref.clear();
+                currentStatus.clear();
+                currentIsCollection = false;
+            } else if (name == QLatin1String("href") && insideResponse) {
+                currentHref = QUrl::fromLocalFile(QUrl::fromPercentEncoding(reader.readElementText().toUtf8()))
+                                  .adjusted(QUrl::NormalizePathSegments)
+                                  .path();
+            } else if (name == QLatin1String("propstat")) {
+                insidePropstat = true;
+            } else if (name == QLatin1String("status") && insideResponse && !insidePropstat) {
+                currentStatus = reader.readElementText();
+            } else if (name == QLatin1String("collection") && insidePropstat) {
+                currentIsCollection = true;
+            } else if (name == QLatin1String("sync-token") && insideMultiStatus && !insideResponse) {
+                *syncToken = reader.readElementText().toUtf8();
+            }
+        } else if (type == QXmlStreamReader::EndElement) {
+            if (name == QLatin1String("propstat")) {
+                insidePropstat = false;
+            } else if (name == QLatin1String("response")) {
+                insideResponse = false;
+                while (currentHref.endsWith(QLatin1Char('/'))) {
+                    currentHref.chop(1);
+                }
+                if (currentHref != basePath && !currentHref.startsWith(basePath + QLatin1Char('/'))) {
+                    qCWarning(lcSyncCollectionJob) << "Invalid href" << currentHref << "expected starting with" << basePath;
+                    return false;
+                }
+                if (currentStatus.contains(QLatin1String(" 507"))) {
+                    qCWarning(lcSyncCollectionJob) << "The server truncated the changes";
+                    return false;
+                }
+                const auto path = currentHref.mid(basePath.size() + 1);
+                if (!path.isEmpty()) {
+                    changes->append({path, currentIsCollection, currentStatus.contains(QLatin1String(" 404"))});
+                }
+            }
+        }
+    }
+
+    if (reader.hasError()) {
+        qCWarning(lcSyncCollectionJob) << "ERROR" << reader.errorString() << xml;
+        return false;
+    } else if (!insideMultiStatus) {
+        qCWarning(lcSyncCollectionJob) << "ERROR no WebDAV response?" << xml;
+        return false;
+    }
+    return true;
+}
+
+/*********************************************************************************************/
+
 PropfindJob::PropfindJob(AccountPtr account, const QString &path, QObject *parent)
     : AbstractNetworkJob(account, path, parent)
 {
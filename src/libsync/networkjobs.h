@@ -158,6 +158,9 @@ public:
     void setProperties(QList<QByteArray> properties);
     [[nodiscard]] QList<QByteArray> properties() const;
 
+    /** The "Depth" header of the PROPFIND, "1" by default. */
+    void setDepth(const QByteArray &depth) { _depth = depth; }
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
@@ -169,9 +172,50 @@ private slots:
 
 private:
     QList<QByteArray> _properties;
+    QByteArray _depth = "1";
     QUrl _url; // Used instead of path() if the url is specified in the constructor
 };
 
+/**
+ * @brief Asks the server which resources changed since a sync token
+ *
+ * Sends a WebDAV sync-collection REPORT (RFC 6578) for the whole tree below
+ * the path. Servers supporting it hand out the first token in the
+ * {DAV:}sync-token property of the collection.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT SyncCollectionJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+public:
+    struct Change
+    {
+        QString path; // relative to the path of the job
+        bool isDirectory = false;
+        bool isRemoved = false;
+    };
+
+    explicit SyncCollectionJob(AccountPtr account, const QString &path, const QByteArray &syncToken, QObject *parent = nullptr);
+    void start() override;
+
+    /**
+     * Parses the multistatus response of the REPORT. Fails for truncated results,
+     * which the client can't continue from.
+     */
+    static bool parse(const QByteArray &xml, const QString &expectedPath, QVector<Change> *changes, QByteArray *syncToken);
+
+signals:
+    void finishedWithChanges(const QVector<OCC::SyncCollectionJob::Change> &changes, const QByteArray &syncToken);
+    void finishedWithError(QNetworkReply *reply);
+
+private slots:
+    bool finished() override;
+
+private:
+    QByteArray _syncToken;
+};
+
 /**
  * @brief The PropfindJob class
  *
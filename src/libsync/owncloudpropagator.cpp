@@ -29,6 +29,7 @@
 #include "common/utility.h"
 #include "account.h"
 #include "common/asserts.h"
+#include "common/metrics.h"
 #include "discoveryphase.h"
 #include "syncfileitem.h"
 #include "foldermetadata.h"
@@ -46,8 +47,12 @@
 #include <QObject>
 #include <QTimerEvent>
 #include <QRegularExpression>
+#include <QMetaEnum>
 #include <qmath.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcPropagator, "nextcloud.sync.propagator", QtInfoMsg)
@@ -81,6 +86,15 @@ qint64 freeSpaceLimit()
     return value;
 }
 
+namespace {
+
+// Items whose journal changes are committed in one transaction
+constexpr auto journalCommitBatchSize = 100;
+// How long pending journal changes may stay uncommitted
+constexpr auto journalCommitDelay = std::chrono::seconds(1);
+
+}
+
 OwncloudPropagator::~OwncloudPropagator() = default;
 
 
@@ -98,9 +112,7 @@ int OwncloudPropagator::maximumActiveTransferJob()
 /* The maximum number of active jobs in parallel  */
 int OwncloudPropagator::hardMaximumActiveJob()
 {
-    if (!_syncOptions._parallelNetworkJobs)
-        return 1;
-    return _syncOptions._parallelNetworkJobs;
+    return _syncOptions.requestBudget(_account->isHttp2Supported());
 }
 
 PropagateItemJob::~PropagateItemJob()
@@ -229,6 +241,11 @@ void PropagateItemJob::done(const SyncFileItem::Status statusArg, const QString
     ENFORCE(_state != Finished);
     _state = Finished;
 
+    if (SyncTrace::isEnabled()) {
+        SyncTrace::asyncEnd(SyncTrace::Category::Propagation, metaObject()->className(), this,
+                            QString::fromLatin1(QMetaEnum::fromType<SyncFileItem::Status>().valueToKey(statusArg)));
+    }
+
     _item->_status = statusArg;
 
     reportClientStatuses();
@@ -284,6 +301,11 @@ void PropagateItemJob::done(const SyncFileItem::Status statusArg, const QString
         break;
     }
 
+    SyncMetrics::propagatedItems().add();
+    if (_item->hasErrorStatus()) {
+        SyncMetrics::propagationErrors().add();
+    }
+
     if (_item->hasErrorStatus())
         qCWarning(lcPropagator) << "Could not complete propagation of" << _item->destination() << "by" << this << "with status" << _item->_status << "and error:" << _item->_errorString;
     else
@@ -333,9 +355,9 @@ void PropagateItemJob::reportClientStatuses()
         if (_item->_direction == SyncFileItem::Up) {
             const auto isCodeBadReqOrUnsupportedMediaType =
                 (_item->_httpErrorCode == HttpErrorCodeBadRequest || _item->_httpErrorCode == HttpErrorCodeUnsupportedMediaType);
-            const auto isExceptionInfoPresent = !_item->_errorExceptionName.isEmpty() && !_item->_errorExceptionMessage.isEmpty();
-            if (isCodeBadReqOrUnsupportedMediaType && isExceptionInfoPresent && _item->_errorExceptionName.contains(QStringLiteral("UnsupportedMediaType"))
-                && _item->_errorExceptionMessage.contains(QStringLiteral("virus"), Qt::CaseInsensitive)) {
+            const auto isExceptionInfoPresent = !_item->details()._errorExceptionName.isEmpty() && !_item->details()._errorExceptionMessage.isEmpty();
+            if (isCodeBadReqOrUnsupportedMediaType && isExceptionInfoPresent && _item->details()._errorExceptionName.contains(QStringLiteral("UnsupportedMediaType"))
+                && _item->details()._errorExceptionMessage.contains(QStringLiteral("virus"), Qt::CaseInsensitive)) {
                 propagator()->account()->reportClientStatus(ClientStatusReportingStatus::UploadError_Virus_Detected);
             } else {
                 propagator()->account()->reportClientStatus(ClientStatusReportingStatus::UploadError_ServerError);
@@ -434,60 +456,36 @@ void OwncloudPropagator::resetDelayedUploadTasks()
 
 void OwncloudPropagator::adjustDeletedFoldersWithNewChildren(SyncFileItemVector &items)
 {
-    /* 
+    /*
        process each item that is new and is a directory and make sure every parent in its tree has the instruction CSYNC_INSTRUCTION_NEW
        instead of CSYNC_INSTRUCTION_REMOVE
-       NOTE: We are iterating backwards to take advantage of optimization later, when searching for the parent of current it
+       NOTE: The items are sorted so that the contents of a directory directly follow it: a stack of the
+       directories the current item is in is all it takes to find its parents
     */
-    for (auto it = std::crbegin(items); it != std::crend(items); ++it) {
-        if ((*it)->_instruction != CSYNC_INSTRUCTION_NEW || (*it)->_direction != SyncFileItem::Up || !(*it)->isDirectory() || (*it)->_file == QStringLiteral("/")) {
-            continue;
+    QVector<QPair<QString /* destination with a trailing '/' */, SyncFileItem *>> directories;
+    for (const auto &item : qAsConst(items)) {
+        const auto destination = item->destination();
+        while (!directories.isEmpty() && !destination.startsWith(directories.last().first)) {
+            directories.removeLast();
         }
 
-        // #1 get root folder name for the current item that we need to reupload
-        const auto folderPathSplit = (*it)->_file.split(QLatin1Char('/'), Qt::SkipEmptyParts);
-        if (folderPathSplit.isEmpty()) {
-            continue;
-        }
-        const auto itemRootFolderName = folderPathSplit.first();
-        if (itemRootFolderName.isEmpty()) {
-            continue;
-        }
-        // #2 iterate backwards (for optimization) and find the root folder by name
-        const auto itemRootFolderReverseIt = std::find_if(it, std::crend(items), [&itemRootFolderName](const auto &currentItem) {
-            return currentItem->_file == itemRootFolderName;
-        });
+        if (item->_instruction == CSYNC_INSTRUCTION_NEW && item->_direction == SyncFileItem::Up && item->isDirectory() && item->_file != QStringLiteral("/")) {
+            for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+                const auto parent = it->second;
+                if (parent->_instruction == CSYNC_INSTRUCTION_REMOVE && parent->_direction == SyncFileItem::Down) {
+                    qCWarning(lcPropagator) << "WARNING: New directory to upload " << item->_file
+                        << "is in the removed directories tree " << parent->_file
+                        << " This should not happen! But, we are going to reupload the entire folder structure.";
 
-        if (itemRootFolderReverseIt == std::rend(items)) {
-            continue;
+                    parent->_instruction = CSYNC_INSTRUCTION_NEW;
+                    parent->_direction = SyncFileItem::Up;
+                }
+            }
         }
 
-        // #3 convert reverse iterator to normal iterator
-        const auto itemFolderIt = (itemRootFolderReverseIt + 1).base();
-
-        // #4 if the root folder is set to be removed, then we will need to fix this by reuploading every folder in
-        // the tree, including the root
-        if (itemFolderIt == std::end(items)) {
-            continue;
+        if (item->isDirectory()) {
+            directories.append(qMakePair(destination + QLatin1Char('/'), item.data()));
         }
-
-        auto nextFolderInTreeIt = itemFolderIt;
-        do {
-            // #5 Iterate forward from the CSYNC_INSTRUCTION_NEW folder's root, and make sure every folder in it's tree is set to CSYNC_INSTRUCTION_NEW
-            if ((*nextFolderInTreeIt)->isDirectory()
-                && (*nextFolderInTreeIt)->_instruction == CSYNC_INSTRUCTION_REMOVE
-                && (*nextFolderInTreeIt)->_direction == SyncFileItem::Down
-                && (*it)->_file.startsWith(QString((*nextFolderInTreeIt)->_file) + QLatin1Char('/'))) {
-
-                qCWarning(lcPropagator) << "WARNING: New directory to upload " << (*it)->_file
-                    << "is in the removed directories tree " << (*nextFolderInTreeIt)->_file
-                    << " This should not happen! But, we are going to reupload the entire folder structure.";
-
-                (*nextFolderInTreeIt)->_instruction = CSYNC_INSTRUCTION_NEW;
-                (*nextFolderInTreeIt)->_direction = SyncFileItem::Up;
-            }
-            ++nextFolderInTreeIt;
-        } while (nextFolderInTreeIt != std::end(items) && (*nextFolderInTreeIt)->_file != (*it)->_file);
     }
 }
 
@@ -528,12 +526,6 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
             items.end());
     }
 
-    QStringList files;
-
-    for (const auto &item : items) {
-        files.push_back(item->_file);
-    }
-
     // process each item that is new and is a directory and make sure every parent in its tree has the instruction NEW instead of REMOVE
     adjustDeletedFoldersWithNewChildren(items);
 
@@ -541,13 +533,25 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
     _rootJob.reset(new PropagateRootDirectory(this));
     QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
-    QVector<PropagatorJob *> directoriesToRemove;
+    QVector<PropagatorJob *> directoriesToRemove; // in the order they are found, run in reverse
     QString removedDirectory;
     QString maybeConflictDirectory;
-    foreach (const SyncFileItemPtr &item, items) {
+    QString skippedUploadsDirectory;
+    for (const auto &item : qAsConst(items)) {
+        // The contents of a directory directly follow it, so the items inside
+        // skippedUploadsDirectory come right after it, see startDirectoryPropagation()
+        if (!skippedUploadsDirectory.isEmpty()) {
+            if (item->destination().startsWith(skippedUploadsDirectory)) {
+                item->_instruction = CSYNC_INSTRUCTION_NONE;
+                _anotherSyncNeeded = true;
+            } else {
+                skippedUploadsDirectory.clear();
+            }
+        }
+
         if (!removedDirectory.isEmpty() && item->_file.startsWith(removedDirectory)) {
             // this is an item in a directory which is going to be removed.
-            auto *delDirJob = qobject_cast<PropagateDirectory *>(directoriesToRemove.first());
+            auto *delDirJob = qobject_cast<PropagateDirectory *>(directoriesToRemove.last());
 
             const auto isNewDirectory = item->isDirectory() &&
                     (item->_instruction == CSYNC_INSTRUCTION_NEW || item->_instruction == CSYNC_INSTRUCTION_TYPE_CHANGE);
@@ -597,7 +601,7 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
                                       directories,
                                       directoriesToRemove,
                                       removedDirectory,
-                                      items);
+                                      skippedUploadsDirectory);
         } else if (!directories.top().second->_item->_isFileDropDetected) {
             startFilePropagation(item,
                                  directories,
@@ -607,8 +611,9 @@ void OwncloudPropagator::start(SyncFileItemVector &&items)
         }
     }
 
-    foreach (PropagatorJob *it, directoriesToRemove) {
-        _rootJob->appendDirDeletionJob(it);
+    // The deepest and last removals go first
+    for (auto it = directoriesToRemove.crbegin(); it != directoriesToRemove.crend(); ++it) {
+        _rootJob->appendDirDeletionJob(*it);
     }
 
     connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
@@ -621,7 +626,7 @@ void OwncloudPropagator::startDirectoryPropagation(const SyncFileItemPtr &item,
                                                    QStack<QPair<QString, PropagateDirectory *>> &directories,
                                                    QVector<PropagatorJob *> &directoriesToRemove,
                                                    QString &removedDirectory,
-                                                   const SyncFileItemVector &items)
+                                                   QString &skippedUploadsDirectory)
 {
     auto directoryPropagationJob = std::make_unique<PropagateDirectory>(this, item);
 
@@ -632,18 +637,13 @@ void OwncloudPropagator::startDirectoryPropagation(const SyncFileItemPtr &item,
         // checkForPermissions() has already run and used the permissions
         // of the file we're about to delete to decide whether uploading
         // to the new dir is ok...
-        foreach (const SyncFileItemPtr &dirItem, items) {
-            if (dirItem->destination().startsWith(item->destination() + "/")) {
-                dirItem->_instruction = CSYNC_INSTRUCTION_NONE;
-                _anotherSyncNeeded = true;
-            }
-        }
+        skippedUploadsDirectory = item->destination() + "/";
     }
 
     if (item->_instruction == CSYNC_INSTRUCTION_REMOVE) {
         // We do the removal of directories at the end, because there might be moves from
         // these directories that will happen later.
-        directoriesToRemove.prepend(directoryPropagationJob.get());
+        directoriesToRemove.append(directoryPropagationJob.get());
         removedDirectory = item->_file + "/";
 
         // We should not update the etag of parent directories of the removed directory
@@ -680,7 +680,7 @@ void OwncloudPropagator::startFilePropagation(const SyncFileItemPtr &item,
         // will delete directories, so defer execution
         auto job = createJob(item);
         if (job) {
-            directoriesToRemove.prepend(job);
+            directoriesToRemove.append(job);
         }
         removedDirectory = item->_file + "/";
     } else {
@@ -730,18 +730,18 @@ void OwncloudPropagator::processE2eeMetadataMigration(const SyncFileItemPtr &ite
             const auto rootE2eeFolderPathFullRemotePath = fullRemotePath(rootE2eeFolderPath);
             const auto updateMetadataJob = new UpdateMigratedE2eeMetadataJob(this, topLevelitem, rootE2eeFolderPathFullRemotePath, remotePath());
             if (item != topLevelitem) {
-                updateMetadataJob->addSubJobItem(item->_encryptedFileName, item);
+                updateMetadataJob->addSubJobItem(item->details()._encryptedFileName, item);
             }
             currentDirJob->appendJob(updateMetadataJob);
         } else {
             if (item != topLevelitem) {
                 // simply append subJob item so we can set its encryption status when corresponging subjob finishes
-                existingUpdateJob->addSubJobItem(item->_encryptedFileName, item);
+                existingUpdateJob->addSubJobItem(item->details()._encryptedFileName, item);
             }
         }
     } else {
         // migrating to v1.2
-        const auto remoteFilename = item->_encryptedFileName.isEmpty() ? item->_file : item->_encryptedFileName;
+        const auto remoteFilename = item->details()._encryptedFileName.isEmpty() ? item->_file : item->details()._encryptedFileName;
         const auto currentDirJob = directories.top().second;
         currentDirJob->appendJob(new UpdateE2eeFolderMetadataJob(this, item, remoteFilename));
     }
@@ -865,6 +865,16 @@ void OwncloudPropagator::scheduleNextJobImpl()
 
     _jobScheduled = false;
 
+    SyncMetrics::activeJobs().set(_activeJobList.count());
+    SyncMetrics::maximumActiveJobs().set(hardMaximumActiveJob());
+
+    // The contents of a new remote directory wait for its MKCOL: create the
+    // directories first, so the transfers don't hold them back.
+    if (_readyRemoteMkdirs > 0 && _activeJobList.count() < hardMaximumActiveJob() && _rootJob->scheduleDirectoryCreation()) {
+        scheduleNextJob();
+        return;
+    }
+
     if (_activeJobList.count() < maximumActiveTransferJob()) {
         if (_rootJob->scheduleSelfOrChild()) {
             scheduleNextJob();
@@ -875,7 +885,10 @@ void OwncloudPropagator::scheduleNextJobImpl()
         // one that is likely finished quickly, we can launch another one.
         // When a job finishes another one will "move up" to be one of the first 3 and then
         // be counted too.
-        for (int i = 0; i < maximumActiveTransferJob() && i < _activeJobList.count(); i++) {
+        // Over HTTP/2 the jobs don't compete for connections, all of them are counted
+        // so quick jobs can fill the stream budget while the transfers are running.
+        const auto countedJobs = _account->isHttp2Supported() ? _activeJobList.count() : maximumActiveTransferJob();
+        for (int i = 0; i < countedJobs && i < _activeJobList.count(); i++) {
             if (_activeJobList.at(i)->isLikelyFinishedQuickly()) {
                 likelyFinishedQuicklyCount++;
             }
@@ -1080,6 +1093,29 @@ Result<Vfs::ConvertToPlaceholderResult, QString> OwncloudPropagator::staticUpdat
     return Vfs::ConvertToPlaceholderResult::Ok;
 }
 
+void OwncloudPropagator::commitJournalBatched(const QString &context)
+{
+    if (++_uncommittedJournalChanges >= journalCommitBatchSize) {
+        _journal->commit(context);
+        _uncommittedJournalChanges = 0;
+        _journalCommitTimer.stop();
+        return;
+    }
+    if (!_journalCommitTimer.isActive()) {
+        _journalCommitTimer.start(journalCommitDelay);
+    }
+}
+
+void OwncloudPropagator::commitPendingJournalChanges()
+{
+    _journalCommitTimer.stop();
+    if (_uncommittedJournalChanges == 0) {
+        return;
+    }
+    _journal->commit(QStringLiteral("batched changes"));
+    _uncommittedJournalChanges = 0;
+}
+
 bool OwncloudPropagator::isDelayedUploadItem(const SyncFileItemPtr &item) const
 {
     const auto checkFileShouldBeEncrypted = [this] (const SyncFileItemPtr &item) -> bool {
@@ -1282,6 +1318,54 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     return false;
 }
 
+bool PropagatorCompositeJob::scheduleDirectoryCreation()
+{
+    if (_state == Finished) {
+        return false;
+    }
+
+    const auto mustWait = std::any_of(_runningJobs.cbegin(), _runningJobs.cend(), [](PropagatorJob *runningJob) {
+        return runningJob->parallelism() == WaitForFinished;
+    });
+    if (!mustWait) {
+        for (int i = 0; i < _jobsToDo.size(); ++i) {
+            const auto job = _jobsToDo.at(i);
+            if (job->parallelism() != FullParallelism) {
+                break;
+            }
+            const auto directoryJob = qobject_cast<PropagateDirectory *>(job);
+            if (!directoryJob || !directoryJob->isRemoteMkdirPending()) {
+                continue;
+            }
+            _state = Running;
+            _jobsToDo.remove(i);
+            _runningJobs.append(directoryJob);
+            // Only starts the MKCOL, the contents wait for it
+            return possiblyRunNextJob(directoryJob);
+        }
+    }
+
+    for (auto runningJob : qAsConst(_runningJobs)) {
+        const auto directoryJob = qobject_cast<PropagateDirectory *>(runningJob);
+        if (directoryJob && directoryJob->scheduleDirectoryCreation()) {
+            return true;
+        }
+        if (runningJob->parallelism() == WaitForFinished) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void PropagatorCompositeJob::markDirectoryCreationsReady()
+{
+    for (const auto job : qAsConst(_jobsToDo)) {
+        if (const auto directoryJob = qobject_cast<PropagateDirectory *>(job)) {
+            directoryJob->markRemoteMkdirReady();
+        }
+    }
+}
+
 void PropagatorCompositeJob::slotSubJobFinished(SyncFileItem::Status status)
 {
     auto *subJob = dynamic_cast<PropagatorJob *>(sender());
@@ -1379,9 +1463,16 @@ bool PropagateDirectory::scheduleSelfOrChild()
 
     if (_state == NotYetStarted) {
         _state = Running;
+        if (!_firstJob) {
+            _subJobs.markDirectoryCreationsReady();
+        }
     }
 
     if (_firstJob && _firstJob->_state == NotYetStarted) {
+        if (_remoteMkdirReady) {
+            _remoteMkdirReady = false;
+            --propagator()->_readyRemoteMkdirs;
+        }
         return _firstJob->scheduleSelfOrChild();
     }
 
@@ -1393,6 +1484,29 @@ bool PropagateDirectory::scheduleSelfOrChild()
     return _subJobs.scheduleSelfOrChild();
 }
 
+bool PropagateDirectory::scheduleDirectoryCreation()
+{
+    // The contents can only be created once the directory itself exists
+    if (_state != Running || _firstJob) {
+        return false;
+    }
+    return _subJobs.scheduleDirectoryCreation();
+}
+
+bool PropagateDirectory::isRemoteMkdirPending() const
+{
+    return _firstJob && _firstJob->_state == NotYetStarted && _firstJob->parallelism() == FullParallelism
+        && qobject_cast<PropagateRemoteMkdir *>(_firstJob.data());
+}
+
+void PropagateDirectory::markRemoteMkdirReady()
+{
+    if (!_remoteMkdirReady && isRemoteMkdirPending()) {
+        _remoteMkdirReady = true;
+        ++propagator()->_readyRemoteMkdirs;
+    }
+}
+
 void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
 {
     _firstJob.take()->deleteLater();
@@ -1410,6 +1524,7 @@ void PropagateDirectory::slotFirstJobFinished(SyncFileItem::Status status)
         return;
     }
 
+    _subJobs.markDirectoryCreationsReady();
     propagator()->scheduleNextJob();
 }
 
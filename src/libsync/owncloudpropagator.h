@@ -33,6 +33,7 @@
 #include "syncoptions.h"
 
 #include "common/syncjournaldb.h"
+#include "common/synctrace.h"
 #include "common/utility.h"
 #include "common/vfs.h"
 
@@ -219,6 +220,7 @@ public:
             return false;
         }
         qCInfo(lcPropagator) << "Starting" << _item->_instruction << "propagation of" << _item->destination() << "by" << this;
+        SyncTrace::asyncBegin(SyncTrace::Category::Propagation, metaObject()->className(), this, _item->destination());
 
         _state = Running;
         QMetaObject::invokeMethod(this, "start"); // We could be in a different thread (neon jobs)
@@ -268,6 +270,22 @@ public:
     bool scheduleSelfOrChild() override;
     [[nodiscard]] JobParallelism parallelism() const override;
 
+    /**
+     * Starts the next remote directory creation of the subtree whose parent
+     * already exists on the server, ahead of the other jobs.
+     *
+     * Breadth-first: the directories of this level come before the ones
+     * below the running directories. Like scheduleSelfOrChild(), it doesn't
+     * get past jobs that have to run on their own.
+     */
+    bool scheduleDirectoryCreation();
+
+    /**
+     * Called once the jobs to do can be started: counts the directories
+     * among them whose creation scheduleDirectoryCreation() may start.
+     */
+    void markDirectoryCreationsReady();
+
     /*
      * Abort synchronously or asynchronously - some jobs
      * require to be finished without immediete abort (abort on job might
@@ -333,6 +351,14 @@ public:
 
     bool scheduleSelfOrChild() override;
     [[nodiscard]] JobParallelism parallelism() const override;
+
+    /** See PropagatorCompositeJob::scheduleDirectoryCreation() */
+    bool scheduleDirectoryCreation();
+    /** Whether this directory is still to be created on the server */
+    [[nodiscard]] bool isRemoteMkdirPending() const;
+    /** Counts the pending creation in OwncloudPropagator::_readyRemoteMkdirs, the parent exists now */
+    void markRemoteMkdirReady();
+
     void abort(PropagatorJob::AbortType abortType) override
     {
         if (_firstJob)
@@ -357,6 +383,9 @@ public:
         return _subJobs.committedDiskSpace();
     }
 
+private:
+    bool _remoteMkdirReady = false;
+
 private slots:
 
     void slotFirstJobFinished(OCC::SyncFileItem::Status status);
@@ -445,6 +474,8 @@ public:
         , _bulkUploadBlackList(bulkUploadBlackList)
     {
         qRegisterMetaType<PropagatorJob::AbortType>("PropagatorJob::AbortType");
+        _journalCommitTimer.setSingleShot(true);
+        connect(&_journalCommitTimer, &QTimer::timeout, this, &OwncloudPropagator::commitPendingJournalChanges);
     }
 
     ~OwncloudPropagator() override;
@@ -455,7 +486,7 @@ public:
                                    QStack<QPair<QString, PropagateDirectory*>> &directories,
                                    QVector<PropagatorJob *> &directoriesToRemove,
                                    QString &removedDirectory,
-                                   const SyncFileItemVector &items);
+                                   QString &skippedUploadsDirectory);
 
     void startFilePropagation(const SyncFileItemPtr &item,
                               QStack<QPair<QString, PropagateDirectory*>> &directories,
@@ -482,6 +513,12 @@ public:
      */
     QList<PropagateItemJob *> _activeJobList;
 
+    /** The directories whose parent exists on the server and whose MKCOL
+        was not started yet. scheduleNextJob() only looks for them in the job
+        tree when there are any.
+     */
+    int _readyRemoteMkdirs = 0;
+
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded = false;
 
@@ -510,7 +547,7 @@ public:
     qint64 _chunkSize;
     qint64 smallFileSize();
 
-    /* The maximum number of active jobs in parallel  */
+    /* The maximum number of active jobs in parallel, see SyncOptions::requestBudget() */
     int hardMaximumActiveJob();
 
     /** Check whether a download would clash with an existing file
@@ -629,6 +666,14 @@ public:
                                                                                  SyncJournalDb * const journal,
                                                                                  Vfs::UpdateMetadataTypes updateType);
 
+    /** Commit the journal changes of a finished item together with the ones of other items.
+     *
+     * Committing costs an fsync, which dominates when many quick items such as remote
+     * deletes finish. The changes are committed once a batch is full, shortly after
+     * the last change, or when the propagation finishes.
+     */
+    void commitJournalBatched(const QString &context);
+
     Q_REQUIRED_RESULT bool isDelayedUploadItem(const SyncFileItemPtr &item) const;
 
     Q_REQUIRED_RESULT const std::deque<SyncFileItemPtr>& delayedTasks() const
@@ -658,6 +703,7 @@ private slots:
     /** Emit the finished signal and make sure it is only emitted once */
     void emitFinished(OCC::SyncFileItem::Status status)
     {
+        commitPendingJournalChanges();
         if (!_finishedEmited) {
             emit finished(status);
         }
@@ -667,6 +713,8 @@ private slots:
 
     void scheduleNextJobImpl();
 
+    void commitPendingJournalChanges();
+
 signals:
     void newItem(const OCC::SyncFileItemPtr &);
     void itemCompleted(const OCC::SyncFileItemPtr &item, OCC::ErrorCategory category);
@@ -701,6 +749,9 @@ private:
     SyncOptions _syncOptions;
     bool _jobScheduled = false;
 
+    int _uncommittedJournalChanges = 0;
+    QTimer _journalCommitTimer;
+
     const QString _localDir; // absolute path to the local directory. ends with '/'
     const QString _remoteFolder; // remote folder, ends with '/'
 
@@ -24,6 +24,7 @@
 #include "propagatorjobs.h"
 #include <common/asserts.h>
 #include <common/constants.h>
+#include <common/metrics.h>
 #include "clientsideencryptionjobs.h"
 #include "propagatedownloadencrypted.h"
 #include "common/vfs.h"
@@ -33,8 +34,29 @@
 #include <QFileInfo>
 #include <QDir>
 
+#include <algorithm>
 #include <cmath>
 
+namespace {
+constexpr qint64 readChunkSize = 16 * 1024;
+constexpr qint64 downloadWriteBufferSize = 1024 * 1024;
+// How much a segmented download receives between saving its progress to the journal
+constexpr qint64 segmentProgressSaveInterval = 64 * 1024 * 1024;
+
+QVector<OCC::SyncJournalDb::DownloadSegment> splitIntoDownloadSegments(qint64 size, int count)
+{
+    QVector<OCC::SyncJournalDb::DownloadSegment> segments;
+    const auto segmentSize = (size + count - 1) / count;
+    for (qint64 start = 0; start < size; start += segmentSize) {
+        OCC::SyncJournalDb::DownloadSegment segment;
+        segment._start = start;
+        segment._end = qMin(start + segmentSize, size) - 1;
+        segments.append(segment);
+    }
+    return segments;
+}
+}
+
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcGetJob, "nextcloud.sync.networkjob.get", QtInfoMsg)
@@ -110,8 +132,11 @@ GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, QIODevice *device,
 
 void GETFileJob::start()
 {
-    if (_resumeStart > 0) {
+    if (_resumeStart > 0 || _rangeEnd >= 0) {
         _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-';
+        if (_rangeEnd >= 0) {
+            _headers["Range"] += QByteArray::number(_rangeEnd);
+        }
         _headers["Accept-Ranges"] = "bytes";
         qCDebug(lcGetJob) << "Retry with range " << _headers["Range"];
     }
@@ -202,6 +227,17 @@ void GETFileJob::slotMetaDataChanged()
         return;
     }
 
+    const QByteArray ranges = reply()->rawHeader("Content-Range");
+    if (_rangeEnd >= 0 && ranges.isEmpty()) {
+        // other jobs write to the same device, restarting from scratch is not an option
+        qCWarning(lcGetJob) << "Server ignored the range request" << _resumeStart << _rangeEnd;
+        _rangeIgnored = true;
+        _errorString = tr("Server does not support range requests");
+        _errorStatus = SyncFileItem::SoftError;
+        reply()->abort();
+        return;
+    }
+
     bool ok = false;
     _contentLength = reply()->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
     if (ok && _expectedContentLength != -1 && _contentLength != _expectedContentLength) {
@@ -214,7 +250,6 @@ void GETFileJob::slotMetaDataChanged()
     }
 
     qint64 start = 0;
-    QByteArray ranges = reply()->rawHeader("Content-Range");
     if (!ranges.isEmpty()) {
         static const QRegularExpression rx("bytes (\\d+)-");
         const auto rxMatch = rx.match(ranges);
@@ -226,6 +261,8 @@ void GETFileJob::slotMetaDataChanged()
         qCWarning(lcGetJob) << "Wrong content-range: " << ranges << " while expecting start was" << _resumeStart;
         if (ranges.isEmpty()) {
             // device doesn't support range, just try again from scratch
+            _writeBuffer.resize(0);
+            _inlineChecksumCalculator.reset();
             _device->close();
             if (!_device->open(QIODevice::WriteOnly)) {
                 _errorString = _device->errorString();
@@ -247,9 +284,104 @@ void GETFileJob::slotMetaDataChanged()
         _lastModified = Utility::qDateTimeToTime_t(lastModified.toDateTime());
     }
 
+    if (!_inlineChecksumFallbackType.isNull()) {
+        startInlineChecksum();
+    }
+
     _saveBodyToFile = true;
 }
 
+QByteArray GETFileJob::transmissionChecksumHeader() const
+{
+    if (!reply()) {
+        return {};
+    }
+    auto checksumHeader = findBestChecksum(reply()->rawHeader(checkSumHeaderC));
+    const auto contentMd5Header = reply()->rawHeader(contentMd5HeaderC);
+    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty()) {
+        checksumHeader = "MD5:" + contentMd5Header;
+    }
+    return checksumHeader;
+}
+
+void GETFileJob::setComputeChecksumInline(const QByteArray &fallbackChecksumType)
+{
+    // an empty but non-null type means: only the server's checksum type
+    _inlineChecksumFallbackType = fallbackChecksumType.isNull() ? QByteArray("") : fallbackChecksumType;
+}
+
+void GETFileJob::startInlineChecksum()
+{
+    _inlineChecksumCalculator.reset();
+    _inlineChecksumType.clear();
+    _inlineChecksum.clear();
+
+    auto checksumType = parseChecksumHeaderType(transmissionChecksumHeader());
+    if (checksumType.isEmpty()) {
+        checksumType = _inlineChecksumFallbackType;
+    }
+    if (checksumType.isEmpty()) {
+        return;
+    }
+
+    const auto file = qobject_cast<QFile *>(_device);
+    if (!file) {
+        return;
+    }
+
+    auto calculator = std::make_unique<ChecksumCalculator>(checksumType);
+    if (!calculator->isValid()) {
+        qCDebug(lcGetJob) << "Can't compute" << checksumType << "checksum inline";
+        return;
+    }
+
+    if (_resumeStart > 0) {
+        // seed with the part of the file we already have
+        QFile existingPart(file->fileName());
+        if (!existingPart.open(QIODevice::ReadOnly)) {
+            qCWarning(lcGetJob) << "Could not read" << file->fileName() << "to compute the checksum, will validate after the download" << existingPart.errorString();
+            return;
+        }
+        QByteArray buffer(readChunkSize * 64, Qt::Uninitialized);
+        qint64 remaining = _resumeStart;
+        while (remaining > 0) {
+            const auto readBytes = existingPart.read(buffer.data(), qMin(qint64(buffer.size()), remaining));
+            if (readBytes <= 0) {
+                qCWarning(lcGetJob) << "Could not read the first" << _resumeStart << "bytes of" << file->fileName() << "to compute the checksum";
+                return;
+            }
+            calculator->addData(buffer.constData(), readBytes);
+            remaining -= readBytes;
+        }
+    }
+
+    qCDebug(lcGetJob) << "Computing" << checksumType << "checksum while downloading, resuming at" << _resumeStart;
+    _inlineChecksumType = checksumType;
+    _inlineChecksumCalculator = std::move(calculator);
+}
+
+void GETFileJob::finishInlineChecksum()
+{
+    if (!_inlineChecksumCalculator) {
+        return;
+    }
+    if (_errorStatus == SyncFileItem::NoStatus && reply() && reply()->error() == QNetworkReply::NoError) {
+        _inlineChecksum = _inlineChecksumCalculator->result();
+    }
+    if (_inlineChecksum.isEmpty()) {
+        _inlineChecksumType.clear();
+    }
+    _inlineChecksumCalculator.reset();
+}
+
+void GETFileJob::setWriteBufferSize(qint64 size)
+{
+    _writeBufferSize = size;
+    if (_writeBufferSize > 0) {
+        _writeBuffer.reserve(_writeBufferSize);
+    }
+}
+
 void GETFileJob::setBandwidthManager(BandwidthManager *bwm)
 {
     _bandwidthManager = bwm;
@@ -276,23 +408,57 @@ void GETFileJob::giveBandwidthQuota(qint64 q)
 
 qint64 GETFileJob::currentDownloadPosition()
 {
-    if (_device && _device->pos() > 0 && _device->pos() > qint64(_resumeStart)) {
-        return _device->pos();
+    if (_device && _device->pos() + _writeBuffer.size() > qint64(_resumeStart)) {
+        return _device->pos() + _writeBuffer.size();
     }
     return _resumeStart;
 }
 
 qint64 GETFileJob::writeToDevice(const QByteArray &data)
 {
-    return _device->write(data);
+    if (_inlineChecksumCalculator) {
+        // hash while the data is still in cache
+        _inlineChecksumCalculator->addData(data.constData(), data.size());
+    }
+
+    if (_writeBufferSize <= 0) {
+        return _device->write(data);
+    }
+
+    if (_writeBuffer.size() + data.size() > _writeBufferSize && !flushWriteBuffer()) {
+        return -1;
+    }
+    if (data.size() >= _writeBufferSize) {
+        return _device->write(data);
+    }
+    _writeBuffer.append(data);
+    return data.size();
+}
+
+bool GETFileJob::flushWriteBuffer()
+{
+    if (_writeBuffer.isEmpty() || !_device || !_device->isOpen()) {
+        return true;
+    }
+
+    const auto writtenBytes = _device->write(_writeBuffer);
+    const auto success = writtenBytes == _writeBuffer.size();
+    if (!success) {
+        qCWarning(lcGetJob) << "Error while writing to file" << writtenBytes << _writeBuffer.size() << _device->errorString();
+    }
+    // keeps the capacity for the next block
+    _writeBuffer.resize(0);
+    return success;
 }
 
 void GETFileJob::slotReadyRead()
 {
     if (!reply())
         return;
-    int bufferSize = qMin(1024 * 8ll, reply()->bytesAvailable());
-    QByteArray buffer(bufferSize, Qt::Uninitialized);
+    if (_readBuffer.isEmpty()) {
+        _readBuffer.resize(readChunkSize);
+    }
+    const auto bufferSize = qMin(qint64(_readBuffer.size()), reply()->bytesAvailable());
 
     while (reply()->bytesAvailable() > 0 && _saveBodyToFile) {
         if (_bandwidthChoked) {
@@ -309,7 +475,7 @@ void GETFileJob::slotReadyRead()
             _bandwidthQuota -= toRead;
         }
 
-        const qint64 readBytes = reply()->read(buffer.data(), toRead);
+        const qint64 readBytes = reply()->read(_readBuffer.data(), toRead);
         if (readBytes < 0) {
             _errorString = networkReplyErrorString(*reply());
             _errorStatus = SyncFileItem::NormalError;
@@ -317,8 +483,10 @@ void GETFileJob::slotReadyRead()
             reply()->abort();
             return;
         }
+        SyncMetrics::downloadedBytes().add(readBytes);
 
-        const qint64 writtenBytes = writeToDevice(buffer.left(readBytes));
+        // no copy: writeToDevice() does not keep a reference beyond the call
+        const qint64 writtenBytes = writeToDevice(QByteArray::fromRawData(_readBuffer.constData(), readBytes));
         if (writtenBytes != readBytes) {
             _errorString = _device->errorString();
             _errorStatus = SyncFileItem::NormalError;
@@ -334,6 +502,11 @@ void GETFileJob::slotReadyRead()
             _bandwidthManager->unregisterDownloadJob(this);
         }
         if (!_hasEmittedFinishedSignal) {
+            if (!flushWriteBuffer()) {
+                _errorString = _device->errorString();
+                _errorStatus = SyncFileItem::NormalError;
+            }
+            finishInlineChecksum();
             qCInfo(lcGetJob) << "GET of" << reply()->request().url().toString() << "FINISHED WITH STATUS"
                              << replyStatusString()
                              << reply()->rawHeader("Content-Range") << reply()->rawHeader("Content-Length");
@@ -352,6 +525,8 @@ void GETFileJob::cancel()
         networkReply->abort();
     }
     if (_device && _device->isOpen()) {
+        // keep what we already received, the download can resume from there
+        flushWriteBuffer();
         _device->close();
     }
 }
@@ -643,6 +818,7 @@ void PropagateDownloadFile::startDownload()
 
     QString tmpFileName;
     QByteArray expectedEtagForResume;
+    QVector<SyncJournalDb::DownloadSegment> segments;
     const SyncJournalDb::DownloadInfo progressInfo = propagator()->_journal->getDownloadInfo(_item->_file);
     if (progressInfo._valid) {
         // if the etag has changed meanwhile, remove the already downloaded part.
@@ -652,6 +828,7 @@ void PropagateDownloadFile::startDownload()
         } else {
             tmpFileName = progressInfo._tmpfile;
             expectedEtagForResume = progressInfo._etag;
+            segments = progressInfo._segments;
         }
     }
 
@@ -660,7 +837,20 @@ void PropagateDownloadFile::startDownload()
     }
     _tmpFile.setFileName(propagator()->fullLocalPath(tmpFileName));
 
+    if (!_tmpFile.exists()) {
+        segments.clear();
+    }
     _resumeStart = _tmpFile.size();
+    if (!segments.isEmpty()) {
+        // The file may already have its final size while a segment before its end is
+        // still missing, only the recorded progress counts.
+        _resumeStart = 0;
+        for (const auto &segment : std::as_const(segments)) {
+            _resumeStart += qMin(segment._done, segment.size());
+        }
+    } else if (_resumeStart == 0 && canDownloadInSegments()) {
+        segments = splitIntoDownloadSegments(_item->_size, propagator()->syncOptions()._downloadSegments);
+    }
     if (_resumeStart > 0 && _resumeStart == _item->_size) {
         qCInfo(lcPropagateDownload) << "File is already complete, no need to download";
         downloadFinished();
@@ -722,36 +912,50 @@ void PropagateDownloadFile::startDownload()
         return;
     }
 
+    // Reserve the blocks for the whole file upfront so it doesn't get fragmented
+    // by growing write by write. The file size itself is unchanged.
+    if (_item->_size > _resumeStart) {
+        FileSystem::preallocate(_tmpFile, _item->_size);
+    }
+
     {
         SyncJournalDb::DownloadInfo pi;
         pi._etag = _item->_etag;
         pi._tmpfile = tmpFileName;
         pi._valid = true;
+        pi._segments = segments;
         propagator()->_journal->setDownloadInfo(_item->_file, pi);
         propagator()->_journal->commit("download file start");
     }
 
+    if (!segments.isEmpty()) {
+        startSegmentedDownload(segments);
+        return;
+    }
+
     QMap<QByteArray, QByteArray> headers;
 
-    if (_item->_directDownloadUrl.isEmpty()) {
+    if (_item->details()._directDownloadUrl.isEmpty()) {
         // Normal job, download from oC instance
         _job = new GETFileJob(propagator()->account(),
-            propagator()->fullRemotePath(isEncrypted() ? _item->_encryptedFileName : _item->_file),
+            propagator()->fullRemotePath(isEncrypted() ? _item->details()._encryptedFileName : _item->_file),
             &_tmpFile, headers, expectedEtagForResume, _resumeStart, this);
     } else {
         // We were provided a direct URL, use that one
-        qCInfo(lcPropagateDownload) << "directDownloadUrl given for " << _item->_file << _item->_directDownloadUrl;
+        qCInfo(lcPropagateDownload) << "directDownloadUrl given for " << _item->_file << _item->details()._directDownloadUrl;
 
-        if (!_item->_directDownloadCookies.isEmpty()) {
-            headers["Cookie"] = _item->_directDownloadCookies.toUtf8();
+        if (!_item->details()._directDownloadCookies.isEmpty()) {
+            headers["Cookie"] = _item->details()._directDownloadCookies.toUtf8();
         }
 
-        QUrl url = QUrl::fromUserInput(_item->_directDownloadUrl);
+        QUrl url = QUrl::fromUserInput(_item->details()._directDownloadUrl);
         _job = new GETFileJob(propagator()->account(),
             url,
             &_tmpFile, headers, expectedEtagForResume, _resumeStart, this);
     }
     _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    _job->setWriteBufferSize(downloadWriteBufferSize);
+    _job->setComputeChecksumInline(propagator()->account()->capabilities().preferredUploadChecksumType());
     connect(_job.data(), &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
     connect(_job.data(), &GETFileJob::downloadProgress, this, &PropagateDownloadFile::slotDownloadProgress);
     propagator()->_activeJobList.append(this);
@@ -812,10 +1016,10 @@ void PropagateDownloadFile::slotGetFinished()
             propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
         }
 
-        if (!_item->_directDownloadUrl.isEmpty() && err != QNetworkReply::OperationCanceledError) {
+        if (!_item->details()._directDownloadUrl.isEmpty() && err != QNetworkReply::OperationCanceledError) {
             // If this was with a direct download, retry without direct download
-            qCWarning(lcPropagateDownload) << "Direct download of" << _item->_directDownloadUrl << "failed. Retrying through owncloud.";
-            _item->_directDownloadUrl.clear();
+            qCWarning(lcPropagateDownload) << "Direct download of" << _item->details()._directDownloadUrl << "failed. Retrying through owncloud.";
+            _item->mutableDetails()._directDownloadUrl.clear();
             start();
             return;
         }
@@ -854,22 +1058,7 @@ void PropagateDownloadFile::slotGetFinished()
         return;
     }
 
-    _item->_responseTimeStamp = job->responseTimestamp();
-
-    if (!job->etag().isEmpty()) {
-        // The etag will be empty if we used a direct download URL.
-        // (If it was really empty by the server, the GETFileJob will have errored
-        _item->_etag = parseEtag(job->etag());
-    }
-    if (job->lastModified()) {
-        // It is possible that the file was modified on the server since we did the discovery phase
-        // so make sure we have the up-to-date time
-        _item->_modtime = job->lastModified();
-        Q_ASSERT(_item->_modtime > 0);
-        if (_item->_modtime <= 0) {
-            qCWarning(lcPropagateDownload()) << "invalid modified time" << _item->_file << _item->_modtime;
-        }
-    }
+    processReplyHeaders(job);
 
     _tmpFile.close();
     _tmpFile.flush();
@@ -916,6 +1105,31 @@ void PropagateDownloadFile::slotGetFinished()
         return;
     }
 
+    _inlineChecksumType = job->inlineChecksumType();
+    _inlineChecksum = job->inlineChecksum();
+
+    validateTransmissionChecksum(job->transmissionChecksumHeader());
+}
+
+void PropagateDownloadFile::processReplyHeaders(GETFileJob *job)
+{
+    _item->_responseTimeStamp = job->responseTimestamp();
+
+    if (!job->etag().isEmpty()) {
+        // The etag will be empty if we used a direct download URL.
+        // (If it was really empty by the server, the GETFileJob will have errored
+        _item->_etag = parseEtag(job->etag());
+    }
+    if (job->lastModified()) {
+        // It is possible that the file was modified on the server since we did the discovery phase
+        // so make sure we have the up-to-date time
+        _item->_modtime = job->lastModified();
+        Q_ASSERT(_item->_modtime > 0);
+        if (_item->_modtime <= 0) {
+            qCWarning(lcPropagateDownload()) << "invalid modified time" << _item->_file << _item->_modtime;
+        }
+    }
+
     // Did the file come with conflict headers? If so, store them now!
     // If we download conflict files but the server doesn't send conflict
     // headers, the record will be established by SyncEngine::conflictRecordMaintenance.
@@ -936,7 +1150,10 @@ void PropagateDownloadFile::slotGetFinished()
         // successfully, much further down. Here we just grab the headers because the
         // job will be deleted later.
     }
+}
 
+void PropagateDownloadFile::validateTransmissionChecksum(const QByteArray &checksumHeader)
+{
     // Do checksum validation for the download. If there is no checksum header, the validator
     // will also emit the validated() signal to continue the flow in slot transmissionChecksumValidated()
     // as this is (still) also correct.
@@ -945,11 +1162,258 @@ void PropagateDownloadFile::slotGetFinished()
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
-    validator->start(_tmpFile.fileName(), checksumHeader);
+    if (!checksumHeader.isEmpty() && !_inlineChecksum.isEmpty() && parseChecksumHeaderType(checksumHeader) == _inlineChecksumType) {
+        // computed while downloading, no need to read the file again
+        validator->start(checksumHeader, _inlineChecksumType, _inlineChecksum);
+    } else {
+        validator->start(_tmpFile.fileName(), checksumHeader);
+    }
+}
+
+bool PropagateDownloadFile::canDownloadInSegments() const
+{
+    const auto &options = propagator()->syncOptions();
+    return !_segmentedDownloadUnsupported
+        && options._downloadSegments > 1
+        && _item->_size >= options._minSegmentedDownloadSize
+        && _item->details()._directDownloadUrl.isEmpty()
+        && !isEncrypted();
+}
+
+void PropagateDownloadFile::startSegmentedDownload(const QVector<SyncJournalDb::DownloadSegment> &segments)
+{
+    _segments.clear();
+    _runningSegments = 0;
+    _segmentErrorStatus = SyncFileItem::NoStatus;
+    _segmentErrorString.clear();
+    _segmentErrorCategory = ErrorCategory::NoError;
+    _discardSegments = false;
+    _segmentsChecksumHeader.clear();
+    _savedSegmentProgress = 0;
+
+    // Every segment writes through its own handle at its own offset
+    for (const auto &range : segments) {
+        Segment segment;
+        segment._range = range;
+        segment._finished = range.isComplete();
+        if (!segment._finished) {
+            segment._file = std::make_unique<QFile>(_tmpFile.fileName());
+            if (!segment._file->open(QIODevice::ReadWrite | QIODevice::Unbuffered)
+                || !segment._file->seek(range._start + range._done)) {
+                qCWarning(lcPropagateDownload) << "could not open temporary file" << _tmpFile.fileName() << "for segment" << range._start << range._end;
+                const auto errorString = segment._file->errorString();
+                _segments.clear();
+                _tmpFile.close();
+                done(SyncFileItem::NormalError, errorString, ErrorCategory::GenericError);
+                return;
+            }
+        }
+        _segments.push_back(std::move(segment));
+    }
+
+    qCInfo(lcPropagateDownload) << "Downloading" << _item->_file << "in" << _segments.size() << "segments, resuming at" << _resumeStart;
+
+    for (auto &segment : _segments) {
+        if (segment._finished) {
+            continue;
+        }
+        const auto offset = segment._range._start + segment._range._done;
+        // All segments must come from the same version of the file, hence the expected etag.
+        auto job = new GETFileJob(propagator()->account(), propagator()->fullRemotePath(_item->_file),
+            segment._file.get(), {}, _item->_etag, offset, this);
+        job->setRangeEnd(segment._range._end);
+        job->setExpectedContentLength(segment._range._end - offset + 1);
+        job->setBandwidthManager(&propagator()->_bandwidthManager);
+        job->setWriteBufferSize(downloadWriteBufferSize);
+        connect(job, &GETFileJob::finishedSignal, this, [this, job] { segmentFinished(job); });
+        connect(job, &GETFileJob::downloadProgress, this, [this, job](qint64 received, qint64) { segmentProgress(job, received); });
+        segment._job = job;
+        ++_runningSegments;
+    }
+
+    propagator()->_activeJobList.append(this);
+    for (const auto &segment : _segments) {
+        if (segment._job) {
+            segment._job->start();
+        }
+    }
+}
+
+void PropagateDownloadFile::segmentProgress(GETFileJob *job, qint64 received)
+{
+    qint64 total = 0;
+    for (auto &segment : _segments) {
+        if (segment._job == job) {
+            segment._received = received;
+        }
+        total += segment._received;
+    }
+    _downloadProgress = total;
+    propagator()->reportProgress(*_item, _resumeStart + _downloadProgress);
+
+    if (_downloadProgress - _savedSegmentProgress >= segmentProgressSaveInterval) {
+        _savedSegmentProgress = _downloadProgress;
+        saveSegmentProgress();
+    }
+}
+
+void PropagateDownloadFile::segmentFinished(GETFileJob *job)
+{
+    const auto it = std::find_if(_segments.begin(), _segments.end(), [job](const Segment &segment) {
+        return segment._job == job;
+    });
+    if (it == _segments.end() || it->_finished) {
+        return;
+    }
+    auto &segment = *it;
+    segment._finished = true;
+    --_runningSegments;
+
+    // The job flushed its buffer, the file position is where the received data ends
+    segment._range._done = qBound(segment._range._done, segment._file->pos() - segment._range._start, segment._range.size());
+    segment._file->close();
+
+    const auto err = job->reply()->error();
+    if (err == QNetworkReply::NoError && segment._range.isComplete()) {
+        processReplyHeaders(job);
+        if (_segmentsChecksumHeader.isEmpty()) {
+            _segmentsChecksumHeader = job->transmissionChecksumHeader();
+        }
+    } else if (_segmentErrorStatus == SyncFileItem::NoStatus) {
+        _item->_httpErrorCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        _item->_requestId = job->requestId();
+
+        if (err == QNetworkReply::NoError) {
+            qCWarning(lcPropagateDownload) << "segment" << segment._range._start << segment._range._end << "of" << _item->_file
+                                           << "ended after" << segment._range._done << "bytes";
+            propagator()->_anotherSyncNeeded = true;
+            _segmentErrorStatus = SyncFileItem::SoftError;
+            _segmentErrorString = tr("The file could not be downloaded completely.");
+            _segmentErrorCategory = ErrorCategory::GenericError;
+        } else {
+            if (job->rangeIgnored()) {
+                _segmentedDownloadUnsupported = true;
+            } else if (_item->_httpErrorCode == 416 || _item->_httpErrorCode == 404) {
+                // start over next time, or not at all if the file is gone
+                _discardSegments = true;
+                propagator()->_anotherSyncNeeded = true;
+            }
+
+            QNetworkReply *reply = job->reply();
+            if (err == QNetworkReply::OperationCanceledError && reply->property(owncloudCustomSoftErrorStringC).isValid()) {
+                job->setErrorString(reply->property(owncloudCustomSoftErrorStringC).toString());
+                job->setErrorStatus(SyncFileItem::SoftError);
+            } else if (_item->_httpErrorCode == 416) {
+                job->setErrorStatus(SyncFileItem::SoftError);
+            } else if (_item->_httpErrorCode == 404) {
+                job->setErrorString(tr("File was deleted from server"));
+                job->setErrorStatus(SyncFileItem::SoftError);
+                propagator()->_journal->schedulePathForRemoteDiscovery(_item->_file);
+            }
+
+            QByteArray errorBody;
+            _segmentErrorString = _item->_httpErrorCode >= 400 ? job->errorStringParsingBody(&errorBody)
+                                                               : job->errorString();
+            _segmentErrorStatus = job->errorStatus();
+            if (_segmentErrorStatus == SyncFileItem::NoStatus) {
+                _segmentErrorStatus = classifyError(err, _item->_httpErrorCode,
+                    &propagator()->_anotherSyncNeeded, errorBody);
+            }
+            _segmentErrorCategory = errorCategoryFromNetworkError(err);
+        }
+
+        if (_runningSegments > 0 && (_segmentedDownloadUnsupported || _discardSegments)) {
+            // No point in continuing the other segments. Otherwise they
+            // go on, so the next attempt has less to download.
+            abortRunningSegments();
+            return;
+        }
+    }
+
+    if (_runningSegments == 0) {
+        allSegmentsFinished();
+    } else if (!_discardSegments && !_segmentedDownloadUnsupported) {
+        // so a crash or a kill doesn't lose what this segment downloaded
+        saveSegmentProgress();
+    }
+}
+
+void PropagateDownloadFile::abortRunningSegments()
+{
+    // Aborting may finish the segments synchronously, which modifies _segments
+    QVector<QPointer<GETFileJob>> jobs;
+    for (const auto &segment : _segments) {
+        if (!segment._finished && segment._job) {
+            jobs.append(segment._job);
+        }
+    }
+    for (const auto &job : std::as_const(jobs)) {
+        if (job && job->reply()) {
+            job->reply()->abort();
+        }
+    }
+}
+
+void PropagateDownloadFile::saveSegmentProgress()
+{
+    auto info = propagator()->_journal->getDownloadInfo(_item->_file);
+    if (!info._valid) {
+        return;
+    }
+    info._segments.clear();
+    for (auto &segment : _segments) {
+        if (!segment._finished && segment._file && segment._file->isOpen()) {
+            // Only what is written to the file counts, the job may still buffer more
+            segment._range._done = qBound(segment._range._done, segment._file->pos() - segment._range._start, segment._range.size());
+        }
+        info._segments.append(segment._range);
+    }
+    propagator()->_journal->setDownloadInfo(_item->_file, info);
+    propagator()->_journal->commit("download segment finished");
+}
+
+void PropagateDownloadFile::allSegmentsFinished()
+{
+    propagator()->_activeJobList.removeOne(this);
+    _tmpFile.close();
+
+    if (_segmentedDownloadUnsupported && !propagator()->_abortRequested) {
+        qCInfo(lcPropagateDownload) << "Server does not support range requests, downloading" << _item->_file << "in one request";
+        _segments.clear();
+        FileSystem::remove(_tmpFile.fileName());
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        startDownload();
+        return;
+    }
+
+    if (_segmentErrorStatus != SyncFileItem::NoStatus) {
+        if (_discardSegments || _segmentedDownloadUnsupported) {
+            FileSystem::remove(_tmpFile.fileName());
+            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        } else {
+            saveSegmentProgress();
+        }
+        done(_segmentErrorStatus, _segmentErrorString, _segmentErrorCategory);
+        return;
+    }
+
+    saveSegmentProgress();
+    _resumeStart = 0;
+    _downloadProgress = 0;
+
+    const auto expectedSize = _segments.empty() ? 0 : _segments.back()._range._end + 1;
+    if (_tmpFile.size() != expectedSize) {
+        qCWarning(lcPropagateDownload) << "segmented download of" << _item->_file << "has" << _tmpFile.size() << "bytes instead of" << expectedSize;
+        FileSystem::remove(_tmpFile.fileName());
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("The file could not be downloaded completely."), ErrorCategory::GenericError);
+        return;
+    }
+
+    // The segments finish in any order, so the checksum is computed over the
+    // reassembled file.
+    validateTransmissionChecksum(_segmentsChecksumHeader);
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg,
@@ -957,7 +1421,7 @@ void PropagateDownloadFile::slotChecksumFail(const QString &errMsg,
 {
     if (reason == ValidateChecksumHeader::FailureReason::ChecksumMismatch && propagator()->account()->isChecksumRecalculateRequestSupported()) {
             const QByteArray calculatedChecksumHeader(calculatedChecksumType + ':' + calculatedChecksum);
-            const QString fullRemotePathForFile(propagator()->fullRemotePath(isEncrypted() ? _item->_encryptedFileName : _item->_file));
+            const QString fullRemotePathForFile(propagator()->fullRemotePath(isEncrypted() ? _item->details()._encryptedFileName : _item->_file));
             auto *job = new SimpleFileJob(propagator()->account(), fullRemotePathForFile);
             QObject::connect(job, &SimpleFileJob::finishedSignal, this,
                 [this, calculatedChecksumHeader, errMsg](const QNetworkReply *reply) { processChecksumRecalculate(reply, calculatedChecksumHeader, errMsg);
@@ -1081,9 +1545,7 @@ namespace { // Anonymous namespace for the recall feature
             QString targetPath = makeRecallFileName(recalledFile);
 
             qCDebug(lcPropagateDownload) << "Copy recall file: " << recalledFile << " -> " << targetPath;
-            // Remove the target first, QFile::copy will not overwrite it.
-            FileSystem::remove(targetPath);
-            QFile::copy(recalledFile, targetPath);
+            FileSystem::copyFile(recalledFile, targetPath);
         }
     }
 
@@ -1114,6 +1576,10 @@ void PropagateDownloadFile::transmissionChecksumValidated(const QByteArray &chec
         return contentChecksumComputed(checksumType, checksum);
     }
 
+    if (theContentChecksumType == _inlineChecksumType && !_inlineChecksum.isEmpty()) {
+        return contentChecksumComputed(_inlineChecksumType, _inlineChecksum);
+    }
+
     // Compute the content checksum.
     auto computeChecksum = new ComputeChecksum(this);
     computeChecksum->setChecksumType(theContentChecksumType);
@@ -1225,7 +1691,7 @@ void PropagateDownloadFile::downloadFinished()
         }
     }
 
-    if (_item->_locked == SyncFileItem::LockStatus::LockedItem && (_item->_lockOwnerType != SyncFileItem::LockOwnerType::UserLock || _item->_lockOwnerId != propagator()->account()->davUser())) {
+    if (_item->_locked == SyncFileItem::LockStatus::LockedItem && (_item->details()._lockOwnerType != SyncFileItem::LockOwnerType::UserLock || _item->details()._lockOwnerId != propagator()->account()->davUser())) {
         qCDebug(lcPropagateDownload()) << _tmpFile.fileName() << "file is locked: making it read only";
         FileSystem::setFileReadOnly(_tmpFile.fileName(), true);
     } else {
@@ -1369,7 +1835,7 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
     if (isEncrypted()) {
         propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
     } else {
-        propagator()->_journal->setDownloadInfo(_item->_encryptedFileName, SyncJournalDb::DownloadInfo());
+        propagator()->_journal->setDownloadInfo(_item->details()._encryptedFileName, SyncJournalDb::DownloadInfo());
     }
 
     propagator()->_journal->commit("download file start2");
@@ -1383,10 +1849,10 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
         handleRecallFile(fn, propagator()->localPath(), *propagator()->_journal);
     }
 
-    const auto isLockOwnedByCurrentUser = _item->_lockOwnerId == propagator()->account()->davUser();
+    const auto isLockOwnedByCurrentUser = _item->details()._lockOwnerId == propagator()->account()->davUser();
 
-    const auto isUserLockOwnedByCurrentUser = (_item->_lockOwnerType == SyncFileItem::LockOwnerType::UserLock && isLockOwnedByCurrentUser);
-    const auto isTokenLockOwnedByCurrentUser = (_item->_lockOwnerType == SyncFileItem::LockOwnerType::TokenLock && isLockOwnedByCurrentUser);
+    const auto isUserLockOwnedByCurrentUser = (_item->details()._lockOwnerType == SyncFileItem::LockOwnerType::UserLock && isLockOwnedByCurrentUser);
+    const auto isTokenLockOwnedByCurrentUser = (_item->details()._lockOwnerType == SyncFileItem::LockOwnerType::TokenLock && isLockOwnedByCurrentUser);
 
     if (_item->_locked == SyncFileItem::LockStatus::LockedItem && !isUserLockOwnedByCurrentUser && !isTokenLockOwnedByCurrentUser) {
         qCDebug(lcPropagateDownload()) << fn << "file is locked: making it read only";
@@ -1415,6 +1881,7 @@ void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
 {
     if (_job && _job->reply())
         _job->reply()->abort();
+    abortRunningSegments();
 
     if (abortType == AbortType::Asynchronous) {
         emit abortFinished();
@@ -18,11 +18,14 @@
 #include "networkjobs.h"
 #include "clientsideencryption.h"
 #include <common/checksums.h>
+#include <common/checksumcalculator.h>
 #include "foldermetadata.h"
 
 #include <QBuffer>
 #include <QFile>
 
+#include <vector>
+
 #if !defined(Q_OS_MACOS) || __MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_15
 #include <filesystem>
 #endif
@@ -43,6 +46,8 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     QByteArray _expectedEtagForResume;
     qint64 _expectedContentLength;
     qint64 _resumeStart;
+    qint64 _rangeEnd = -1;
+    bool _rangeIgnored = false;
     SyncFileItem::Status _errorStatus;
     QUrl _directDownloadUrl;
     QByteArray _etag;
@@ -56,6 +61,17 @@ class OWNCLOUDSYNC_EXPORT GETFileJob : public AbstractNetworkJob
     /// Will be set to true once we've seen a 2xx response header
     bool _saveBodyToFile = false;
 
+    /// Reused for every read from the reply
+    QByteArray _readBuffer;
+    /// Data not yet written to _device, see setWriteBufferSize()
+    QByteArray _writeBuffer;
+    qint64 _writeBufferSize = 0;
+
+    QByteArray _inlineChecksumFallbackType;
+    QByteArray _inlineChecksumType;
+    QByteArray _inlineChecksum;
+    std::unique_ptr<ChecksumCalculator> _inlineChecksumCalculator;
+
 protected:
     qint64 _contentLength;
 
@@ -85,6 +101,8 @@ public:
                 _bandwidthManager->unregisterDownloadJob(this);
             }
             if (!_hasEmittedFinishedSignal) {
+                flushWriteBuffer();
+                finishInlineChecksum();
                 emit finishedSignal();
             }
             _hasEmittedFinishedSignal = true;
@@ -96,6 +114,47 @@ public:
 
     void newReplyHook(QNetworkReply *reply) override;
 
+    /**
+     * Collect the received data in memory and write it to the device in blocks
+     * of up to \a size bytes instead of one write per network read.
+     *
+     * The buffer is flushed before finishedSignal() is emitted and on cancel().
+     * Default: 0, every chunk is written through immediately.
+     */
+    void setWriteBufferSize(qint64 size);
+
+    /**
+     * Only request the bytes up to and including the offset \a rangeEnd.
+     *
+     * Used by segmented downloads where several jobs write into the same file
+     * at different offsets: if the server ignores the Range header the job
+     * fails and rangeIgnored() is set instead of restarting from scratch.
+     * Default: -1, everything from resumeStart() on.
+     */
+    void setRangeEnd(qint64 rangeEnd) { _rangeEnd = rangeEnd; }
+    [[nodiscard]] bool rangeIgnored() const { return _rangeIgnored; }
+
+    /**
+     * Compute a checksum of the data while it is written to the device.
+     *
+     * The type of the transmission checksum sent by the server is used,
+     * \a fallbackChecksumType if the server didn't send one. When resuming,
+     * the already downloaded part of the device is hashed first, so the
+     * result always covers the complete file.
+     * Only supported for QFile devices.
+     */
+    void setComputeChecksumInline(const QByteArray &fallbackChecksumType);
+
+    /**
+     * The checksum type and value computed while writing, see setComputeChecksumInline().
+     * Empty if none was computed. Only valid once finishedSignal() was emitted.
+     */
+    [[nodiscard]] QByteArray inlineChecksumType() const { return _inlineChecksumType; }
+    [[nodiscard]] QByteArray inlineChecksum() const { return _inlineChecksum; }
+
+    /// The transmission checksum header the server sent with the reply, empty if none
+    [[nodiscard]] QByteArray transmissionChecksumHeader() const;
+
     void setBandwidthManager(BandwidthManager *bwm);
     void setChoked(bool c);
     void setBandwidthLimited(bool b);
@@ -120,6 +179,11 @@ public:
 
 protected:
     virtual qint64 writeToDevice(const QByteArray &data);
+    bool flushWriteBuffer();
+
+private:
+    void startInlineChecksum();
+    void finishInlineChecksum();
 
 signals:
     void finishedSignal();
@@ -176,6 +240,8 @@ private:
     +-> startDownload() <--------------------------+
           |                                        |
           +-> run a GETFileJob                     | checksum identical?
+          |   (one per segment for large files,    |
+          |   done?-> allSegmentsFinished())       |
                                                    |
       done?-> slotGetFinished()                    |
                 |                                  |
@@ -252,10 +318,48 @@ private:
     void deleteExistingFolder();
     [[nodiscard]] bool isEncrypted() const { return _isEncrypted; }
 
+    /// Takes the etag, mtime and conflict headers of a successful GET reply
+    void processReplyHeaders(GETFileJob *job);
+    /// Validates the downloaded file against the server's checksum header
+    void validateTransmissionChecksum(const QByteArray &checksumHeader);
+
+    /// Whether the file is big enough and allowed to be downloaded in parallel segments
+    [[nodiscard]] bool canDownloadInSegments() const;
+    /// Runs one GETFileJob with a bounded range for every incomplete segment
+    void startSegmentedDownload(const QVector<SyncJournalDb::DownloadSegment> &segments);
+    void segmentFinished(GETFileJob *job);
+    void segmentProgress(GETFileJob *job, qint64 received);
+    void allSegmentsFinished();
+    void abortRunningSegments();
+    /// Stores the progress of each segment in the journal so they can be resumed,
+    /// called when a segment finishes and every segmentProgressSaveInterval bytes
+    void saveSegmentProgress();
+
     qint64 _resumeStart = 0;
     qint64 _downloadProgress = 0;
     QPointer<GETFileJob> _job;
     QFile _tmpFile;
+    QByteArray _inlineChecksumType;
+    QByteArray _inlineChecksum;
+
+    struct Segment
+    {
+        SyncJournalDb::DownloadSegment _range;
+        QPointer<GETFileJob> _job;
+        std::unique_ptr<QFile> _file; // the job's own handle on _tmpFile
+        qint64 _received = 0;
+        bool _finished = false;
+    };
+    std::vector<Segment> _segments;
+    int _runningSegments = 0;
+    SyncFileItem::Status _segmentErrorStatus = SyncFileItem::NoStatus;
+    QString _segmentErrorString;
+    ErrorCategory _segmentErrorCategory = ErrorCategory::NoError;
+    bool _discardSegments = false;
+    qint64 _savedSegmentProgress = 0; // _downloadProgress at the last saveSegmentProgress()
+    bool _segmentedDownloadUnsupported = false;
+    QByteArray _segmentsChecksumHeader;
+
     bool _deleteExisting = false;
     bool _isEncrypted = false;
     FolderMetadata::EncryptedFile _encryptedInfo;
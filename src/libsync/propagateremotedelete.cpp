@@ -33,8 +33,8 @@ void PropagateRemoteDelete::start()
     if (propagator()->_abortRequested)
         return;
 
-    if (!_item->_encryptedFileName.isEmpty() || _item->isEncrypted()) {
-        if (!_item->_encryptedFileName.isEmpty()) {
+    if (!_item->details()._encryptedFileName.isEmpty() || _item->isEncrypted()) {
+        if (!_item->details()._encryptedFileName.isEmpty()) {
             _deleteEncryptedHelper = new PropagateRemoteDeleteEncrypted(propagator(), _item, this);
         } else {
             _deleteEncryptedHelper = new PropagateRemoteDeleteEncryptedRootFolder(propagator(), _item, this);
@@ -127,7 +127,7 @@ void PropagateRemoteDelete::slotDeleteJobFinished()
         return;
     }
 
-    propagator()->_journal->commit("Remote Remove");
+    propagator()->commitJournalBatched(QStringLiteral("Remote Remove"));
 
     done(SyncFileItem::Success, {}, ErrorCategory::NoError);
 }
@@ -32,9 +32,9 @@ PropagateRemoteDeleteEncrypted::PropagateRemoteDeleteEncrypted(OwncloudPropagato
 
 void PropagateRemoteDeleteEncrypted::start()
 {
-    Q_ASSERT(!_item->_encryptedFileName.isEmpty());
+    Q_ASSERT(!_item->details()._encryptedFileName.isEmpty());
 
-    const QFileInfo info(_item->_encryptedFileName);
+    const QFileInfo info(_item->details()._encryptedFileName);
     fetchMetadataForPath(info.path());
 }
 
@@ -49,7 +49,7 @@ void PropagateRemoteDeleteEncrypted::slotFetchMetadataJobFinished(int statusCode
     Q_UNUSED(message);
     if (statusCode == 404) {
         qCDebug(PROPAGATE_REMOVE_ENCRYPTED) << "Metadata not found, but let's proceed with removing the file anyway.";
-        deleteRemoteItem(_item->_encryptedFileName);
+        deleteRemoteItem(_item->details()._encryptedFileName);
         return;
     }
 
@@ -77,7 +77,7 @@ void PropagateRemoteDeleteEncrypted::slotFetchMetadataJobFinished(int statusCode
 
     if (!found) {
         // file is not found in the metadata, but we still need to remove it
-        deleteRemoteItem(_item->_encryptedFileName);
+        deleteRemoteItem(_item->details()._encryptedFileName);
         return;
     }
 
@@ -89,5 +89,5 @@ void PropagateRemoteDeleteEncrypted::slotUpdateMetadataJobFinished(int statusCod
 {
     Q_UNUSED(statusCode);
     Q_UNUSED(message);
-    deleteRemoteItem(_item->_encryptedFileName);
+    deleteRemoteItem(_item->details()._encryptedFileName);
 }
@@ -86,7 +86,7 @@ void PropagateRemoteMove::start()
     if (origin == _item->_renameTarget) {
         // The parent has been renamed already so there is nothing more to do.
 
-        if (!_item->_encryptedFileName.isEmpty()) {
+        if (!_item->details()._encryptedFileName.isEmpty()) {
             // when renaming non-encrypted folder that contains encrypted folder, nested files of its encrypted folder are incorrectly displayed in the Settings dialog
             // encrypted name is displayed instead of a local folder name, unless the sync folder is removed, then added again and re-synced
             // we are fixing it by modifying the "_encryptedFileName" in such a way so it will have a renamed root path at the beginning of it as expected
@@ -105,11 +105,11 @@ void PropagateRemoteMove::start()
 
             const auto remoteParentPath = parentRec._e2eMangledName.isEmpty() ? parentPath : parentRec._e2eMangledName;
 
-            const auto lastSlashPosition = _item->_encryptedFileName.lastIndexOf('/');
-            const auto encryptedName = lastSlashPosition >= 0 ? _item->_encryptedFileName.mid(lastSlashPosition + 1) : QString();
+            const auto lastSlashPosition = _item->details()._encryptedFileName.lastIndexOf('/');
+            const auto encryptedName = lastSlashPosition >= 0 ? _item->details()._encryptedFileName.mid(lastSlashPosition + 1) : QString();
 
             if (!encryptedName.isEmpty()) {
-                _item->_encryptedFileName = remoteParentPath + "/" + encryptedName;
+                _item->mutableDetails()._encryptedFileName = remoteParentPath + "/" + encryptedName;
             }
         }
 
@@ -291,7 +291,7 @@ void PropagateRemoteMove::finalize()
     }
 
     if (!FileSystem::fileExists(targetFile)) {
-        propagator()->_journal->commit("Remote Rename");
+        propagator()->commitJournalBatched(QStringLiteral("Remote Rename"));
         done(SyncFileItem::Success, {}, ErrorCategory::NoError);
         return;
     }
@@ -318,7 +318,12 @@ void PropagateRemoteMove::finalize()
         }
     }
 
-    propagator()->_journal->commit("Remote Rename");
+    if (_item->isDirectory()) {
+        // The moved subtree is rewritten, don't risk losing that
+        propagator()->_journal->commit("Remote Rename");
+    } else {
+        propagator()->commitJournalBatched(QStringLiteral("Remote Rename"));
+    }
     done(SyncFileItem::Success, {}, ErrorCategory::NoError);
 }
 
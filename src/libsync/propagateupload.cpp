@@ -113,8 +113,8 @@ bool PollJob::finished()
         _item->_status = classifyError(err, _item->_httpErrorCode);
         _item->_errorString = errorString();
         const auto exceptionParsed = getExceptionFromReply(reply());
-        _item->_errorExceptionName = exceptionParsed.first;
-        _item->_errorExceptionMessage = exceptionParsed.second;
+        _item->mutableDetails()._errorExceptionName = exceptionParsed.first;
+        _item->mutableDetails()._errorExceptionMessage = exceptionParsed.second;
 
         if (_item->_status == SyncFileItem::FatalError || _item->_httpErrorCode >= 400) {
             if (_item->_status != SyncFileItem::FatalError
@@ -412,16 +412,26 @@ private:
     [[nodiscard]] QUrl chunkUrl(const int chunk) const;
     [[nodiscard]] QByteArray destinationHeader() const;
 
+    // A chunk PUT that is still running
+    struct InFlightChunk {
+        int _index = 0; /// index of the chunk in _chunks
+        int _parallelChunks = 1; /// chunks in flight when this one was started, itself included
+        qint64 _progress = 0; /// bytes of the chunk that were sent so far
+    };
+
     void startNewUpload();
     void startNextChunk();
+    bool startChunk(int index);
     void finishUpload();
 
     QMap<qint64, ServerChunkInfo> _serverChunks;
 
-    qint64 _sent = 0; /// amount of data (bytes) that was already sent
+    QVector<SyncJournalDb::UploadChunk> _chunks; /// chunks that were started, ordered by offset
+    QHash<PUTFileJob *, InFlightChunk> _inFlightChunks;
+
+    qint64 _sent = 0; /// end of the data (bytes) that was already handed to a chunk
     uint _transferId = 0; /// transfer id (part of the url)
-    int _currentChunk = 1; /// Id of the next chunk that will be sent
-    qint64 _currentChunkSize = 0; /// current chunk size
+    int _currentChunk = 1; /// Id of the next new chunk that will be sent
     bool _removeJobError = false; /// If not null, there was an error removing the job
 };
 }
@@ -131,7 +131,7 @@ void PropagateUploadEncrypted::slotFetchMetadataJobFinished(int statusCode, cons
 
     encryptedFile.initializationVector = EncryptionHelper::generateRandom(16);
 
-    _item->_encryptedFileName =  Utility::trailingSlashPath(_remoteParentPath) + encryptedFile.encryptedFilename;
+    _item->mutableDetails()._encryptedFileName =  Utility::trailingSlashPath(_remoteParentPath) + encryptedFile.encryptedFilename;
     _item->_e2eEncryptionStatusRemote = metadata->existingMetadataEncryptionStatus();
     _item->_e2eEncryptionServerCapability =
         EncryptionStatusEnums::fromEndToEndEncryptionApiVersion(_propagator->account()->capabilities().clientSideEncryptionVersion());
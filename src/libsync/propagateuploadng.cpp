@@ -20,6 +20,7 @@
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
 #include "common/utility.h"
+#include "common/metrics.h"
 #include "filesystem.h"
 #include "propagatorjobs.h"
 #include "syncengine.h"
@@ -30,6 +31,8 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -77,6 +80,8 @@ QUrl PropagateUploadFileNG::chunkUrl(const int chunk) const
     +---->  startNextChunk()  ---finished?  --+
                   ^               |          |
                   +---------------+          |
+              (up to _parallelChunkUploads   |
+               PUTs may be in flight)        |
                                              |
     +----------------------------------------+
     |
@@ -153,9 +158,24 @@ void PropagateUploadFileNG::slotPropfindFinished()
     // Chunked upload v2: numbers range from 1 to 10000
     _currentChunk = 1;
     _sent = 0;
+    // Chunks may have been uploaded in parallel and finished in any order, so check
+    // each recorded chunk. The ones that are missing or incomplete are sent again.
+    _chunks = propagator()->_journal->getUploadInfo(_item->_file)._chunks;
+    for (auto &chunk : _chunks) {
+        const auto it = _serverChunks.constFind(chunk._number);
+        chunk._done = it != _serverChunks.cend() && it->size == chunk._size;
+        if (chunk._done) {
+            _serverChunks.erase(it);
+        }
+        _sent = qMax(_sent, chunk._offset + chunk._size);
+        _currentChunk = qMax(_currentChunk, chunk._number + 1);
+    }
+
+    // Chunks we have no record of can only be trusted if they directly follow the recorded ones.
     while (_serverChunks.contains(_currentChunk)) {
-        _sent += _serverChunks[_currentChunk].size;
-        _serverChunks.remove(_currentChunk);
+        const auto size = _serverChunks.take(_currentChunk).size;
+        _chunks.append({_currentChunk, _sent, size, true});
+        _sent += size;
         ++_currentChunk;
     }
 
@@ -175,7 +195,8 @@ void PropagateUploadFileNG::slotPropfindFinished()
         return;
     }
 
-    qCInfo(lcPropagateUploadNG) << "Resuming " << _item->_file << " from chunk " << _currentChunk << "; sent =" << _sent;
+    qCInfo(lcPropagateUploadNG) << "Resuming " << _item->_file << " from chunk " << _currentChunk << "; sent =" << _sent
+                                << "; chunks to resend =" << std::count_if(_chunks.cbegin(), _chunks.cend(), [](const auto &chunk) { return !chunk._done; });
 
     if (!_serverChunks.isEmpty()) {
         qCInfo(lcPropagateUploadNG) << "To Delete" << _serverChunks.keys();
@@ -257,6 +278,7 @@ void PropagateUploadFileNG::startNewUpload()
     _transferId = uint(Utility::rand() ^ uint(_item->_modtime) ^ (uint(_fileToUpload._size) << 16) ^ qHash(_fileToUpload._file));
     _sent = 0;
     _currentChunk = 1; // Chunked upload v2: numbers range from 1 to 10000
+    _chunks.clear();
 
     propagator()->reportProgress(*_item, 0);
 
@@ -346,16 +368,64 @@ void PropagateUploadFileNG::startNextChunk()
 
     const auto fileSize = _fileToUpload._size;
     ENFORCE(fileSize >= _sent, "Sent data exceeds file size")
-    // prevent situation that chunk size is bigger then required one to send
-    _currentChunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
 
-    if (_currentChunkSize == 0) {
+    // Keep several chunks of the file in flight, but don't take more than our share of
+    // the transfer slots: the first chunk is always started so the upload makes progress.
+    const auto maxParallelChunks = qMax(1, propagator()->syncOptions()._parallelChunkUploads);
+    auto startedChunk = false;
+    while (_inFlightChunks.isEmpty()
+           || (_inFlightChunks.size() < maxParallelChunks
+               && propagator()->_activeJobList.count() < propagator()->maximumActiveTransferJob())) {
+        // Chunks that the server doesn't have (yet) after a resume go first
+        int index = -1;
+        for (int i = 0; i < _chunks.size(); ++i) {
+            const auto inFlight = std::any_of(_inFlightChunks.cbegin(), _inFlightChunks.cend(), [i](const InFlightChunk &chunk) {
+                return chunk._index == i;
+            });
+            if (!_chunks.at(i)._done && !inFlight) {
+                index = i;
+                break;
+            }
+        }
+
+        if (index < 0) {
+            // prevent situation that chunk size is bigger then required one to send
+            const auto chunkSize = qMin(propagator()->_chunkSize, fileSize - _sent);
+            if (chunkSize == 0) {
+                break;
+            }
+            _chunks.append({_currentChunk, _sent, chunkSize, false});
+            _sent += chunkSize;
+            _currentChunk++;
+            index = _chunks.size() - 1;
+        }
+
+        if (!startChunk(index)) {
+            return;
+        }
+        startedChunk = true;
+    }
+
+    if (_inFlightChunks.isEmpty()) {
         finishUpload();
         return;
     }
 
+    if (startedChunk) {
+        // Remember which ranges of the file the chunks cover, a resume can't
+        // rely on the chunks on the server being contiguous.
+        auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
+        uploadInfo._chunks = _chunks;
+        propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
+        propagator()->_journal->commit("Upload info");
+    }
+}
+
+bool PropagateUploadFileNG::startChunk(const int index)
+{
+    const auto &chunk = _chunks.at(index);
     const auto fileName = _fileToUpload._path;
-    auto device = std::make_unique<UploadDevice>(fileName, _sent, _currentChunkSize, &propagator()->_bandwidthManager);
+    auto device = std::make_unique<UploadDevice>(fileName, chunk._offset, chunk._size, &propagator()->_bandwidthManager);
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
 
@@ -366,20 +436,20 @@ void PropagateUploadFileNG::startNextChunk()
         }
         // Soft error because this is likely caused by the user modifying his files while syncing
         abortWithError(SyncFileItem::SoftError, device->errorString());
-        return;
+        return false;
     }
 
     QMap<QByteArray, QByteArray> headers;
-    headers["OC-Chunk-Offset"] = QByteArray::number(_sent);
+    headers["OC-Chunk-Offset"] = QByteArray::number(chunk._offset);
     headers["Destination"] = destinationHeader();
 
-    _sent += _currentChunkSize;
-    const auto url = chunkUrl(_currentChunk);
+    const auto url = chunkUrl(chunk._number);
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
     const auto devicePtr = device.get(); // for connections later
-    const auto job = new PUTFileJob(propagator()->account(), url, std::move(device), headers, _currentChunk, this);
+    const auto job = new PUTFileJob(propagator()->account(), url, std::move(device), headers, chunk._number, this);
     _jobs.append(job);
+    _inFlightChunks.insert(job, {index, int(_inFlightChunks.size()) + 1, 0});
     connect(job, &PUTFileJob::finishedSignal, this, &PropagateUploadFileNG::slotPutFinished);
     connect(job, &PUTFileJob::uploadProgress,
         this, &PropagateUploadFileNG::slotUploadProgress);
@@ -388,7 +458,7 @@ void PropagateUploadFileNG::startNextChunk()
     connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
     job->start();
     propagator()->_activeJobList.append(this);
-    _currentChunk++;
+    return true;
 }
 
 void PropagateUploadFileNG::slotPutFinished()
@@ -400,8 +470,12 @@ void PropagateUploadFileNG::slotPutFinished()
 
     propagator()->_activeJobList.removeOne(this);
 
-    if (_finished) {
-        // We have sent the finished signal already. We don't need to handle any remaining jobs
+    const auto parallelChunksAtEnd = _inFlightChunks.size();
+    const auto inFlightChunk = _inFlightChunks.take(job);
+
+    if (_finished || _aborting) {
+        // We have sent the finished signal already, or another chunk's error is aborting
+        // the chunks still in flight. We don't need to handle any remaining jobs
         return;
     }
 
@@ -412,13 +486,17 @@ void PropagateUploadFileNG::slotPutFinished()
         _item->_requestId = job->requestId();
         commonErrorHandling(job);
         const auto exceptionParsed = getExceptionFromReply(job->reply());
-        _item->_errorExceptionName = exceptionParsed.first;
-        _item->_errorExceptionMessage = exceptionParsed.second;
+        _item->mutableDetails()._errorExceptionName = exceptionParsed.first;
+        _item->mutableDetails()._errorExceptionMessage = exceptionParsed.second;
         return;
     }
 
     ENFORCE(_sent <= _fileToUpload._size, "can't send more than size");
 
+    auto &chunk = _chunks[inFlightChunk._index];
+    chunk._done = true;
+    SyncMetrics::uploadedBytes().add(chunk._size);
+
     // Adjust the chunk size for the time taken.
     //
     // Dynamic chunk sizing is enabled if the server configured a
@@ -426,7 +504,12 @@ void PropagateUploadFileNG::slotPutFinished()
     auto targetDuration = propagator()->syncOptions()._targetChunkUploadDuration;
     if (targetDuration.count() > 0) {
         auto uploadTime = ++job->msSinceStart(); // add one to avoid div-by-zero
-        qint64 predictedGoodSize = (_currentChunkSize * targetDuration) / uploadTime;
+        qint64 predictedGoodSize = (chunk._size * targetDuration) / uploadTime;
+
+        // The chunks in flight share the bandwidth: scale the prediction from the
+        // average number of parallel chunks during this upload to the current one.
+        const auto averageParallelChunks = (inFlightChunk._parallelChunks + parallelChunksAtEnd) / 2.0;
+        predictedGoodSize = qint64(predictedGoodSize * averageParallelChunks / parallelChunksAtEnd);
 
         // The whole targeting is heuristic. The predictedGoodSize will fluctuate
         // quite a bit because of external factors (like available bandwidth)
@@ -439,13 +522,14 @@ void PropagateUploadFileNG::slotPutFinished()
         // Adjust the dynamic chunk size _chunkSize used for sizing of the item's chunks to be send
         propagator()->_chunkSize = ::qBound(propagator()->syncOptions().minChunkSize(), targetSize, propagator()->syncOptions().maxChunkSize());
 
-        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << _currentChunkSize << "bytes took" << uploadTime.count()
-                                  << "ms, desired is" << targetDuration.count() << "ms, expected good chunk size is"
-                                  << predictedGoodSize << "bytes and nudged next chunk size to "
+        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << chunk._size << "bytes took" << uploadTime.count()
+                                  << "ms with" << parallelChunksAtEnd << "chunks in flight, desired is" << targetDuration.count()
+                                  << "ms, expected good chunk size is" << predictedGoodSize << "bytes and nudged next chunk size to "
                                   << propagator()->_chunkSize << "bytes";
     }
 
-    _finished = _sent == _item->_size;
+    _finished = _sent == _item->_size && _inFlightChunks.isEmpty()
+        && std::all_of(_chunks.cbegin(), _chunks.cend(), [](const SyncJournalDb::UploadChunk &chunk) { return chunk._done; });
 
     // Check if the file still exists
     const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
@@ -481,6 +565,7 @@ void PropagateUploadFileNG::slotPutFinished()
         // Reset the error count on successful chunk upload
         auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
         uploadInfo._errorCount = 0;
+        uploadInfo._chunks = _chunks;
         propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
         propagator()->_journal->commit("Upload info");
     }
@@ -500,8 +585,8 @@ void PropagateUploadFileNG::slotMoveJobFinished()
     if (err != QNetworkReply::NoError) {
         commonErrorHandling(job);
         const auto exceptionParsed = getExceptionFromReply(job->reply());
-        _item->_errorExceptionName = exceptionParsed.first;
-        _item->_errorExceptionMessage = exceptionParsed.second;
+        _item->mutableDetails()._errorExceptionName = exceptionParsed.first;
+        _item->mutableDetails()._errorExceptionMessage = exceptionParsed.second;
         return;
     }
 
@@ -559,7 +644,21 @@ void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
     if (sent == 0 && total == 0) {
         return;
     }
-    propagator()->reportProgress(*_item, _sent + sent - total);
+
+    if (const auto it = _inFlightChunks.find(qobject_cast<PUTFileJob *>(sender())); it != _inFlightChunks.end()) {
+        it->_progress = sent;
+    }
+
+    qint64 progress = 0;
+    for (const auto &chunk : qAsConst(_chunks)) {
+        if (chunk._done) {
+            progress += chunk._size;
+        }
+    }
+    for (const auto &inFlightChunk : qAsConst(_inFlightChunks)) {
+        progress += inFlightChunk._progress;
+    }
+    propagator()->reportProgress(*_item, progress);
 }
 
 void PropagateUploadFileNG::abort(PropagatorJob::AbortType abortType)
@@ -23,6 +23,7 @@
 #include "filesystem.h"
 #include "propagatorjobs.h"
 #include "common/checksums.h"
+#include "common/metrics.h"
 #include "syncengine.h"
 #include "propagateremotedelete.h"
 #include "common/asserts.h"
@@ -219,10 +220,11 @@ void PropagateUploadFileV1::slotPutFinished()
     if (err != QNetworkReply::NoError) {
         commonErrorHandling(job);
         const auto exceptionParsed = getExceptionFromReply(job->reply());
-        _item->_errorExceptionName = exceptionParsed.first;
-        _item->_errorExceptionMessage = exceptionParsed.second;
+        _item->mutableDetails()._errorExceptionName = exceptionParsed.first;
+        _item->mutableDetails()._errorExceptionMessage = exceptionParsed.second;
         return;
     }
+    SyncMetrics::uploadedBytes().add(job->device()->size());
 
     // The server needs some time to process the request and provide us with a poll URL
     if (_item->_httpErrorCode == 202) {
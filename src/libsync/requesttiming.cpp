@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "requesttiming.h"
+#include "httplogger.h"
+#include "common/metrics.h"
+
+#include <QNetworkReply>
+#include <QStringList>
+#include <QUrl>
+
+namespace OCC {
+
+namespace {
+
+    QString formatDuration(std::chrono::nanoseconds duration)
+    {
+        return QString::number(std::chrono::duration<double, std::milli>(duration).count(), 'f', 1) + QStringLiteral("ms");
+    }
+
+}
+
+RequestTiming::Endpoint RequestTiming::endpointFor(const QByteArray &verb, const QUrl &url)
+{
+    const auto path = url.path();
+    if (path.contains(QLatin1String("/ocs/"))) {
+        return Endpoint::Ocs;
+    }
+    if (path.contains(QLatin1String("/remote.php/dav/uploads/"))) {
+        return Endpoint::Chunk;
+    }
+    if (path.contains(QLatin1String("/remote.php/dav/")) || path.contains(QLatin1String("/remote.php/webdav/"))) {
+        if (verb == "PROPFIND" || verb == "MKCOL" || verb == "REPORT" || verb == "SEARCH") {
+            return Endpoint::DavDirectory;
+        }
+        return Endpoint::DavFile;
+    }
+    return Endpoint::Other;
+}
+
+const char *RequestTiming::endpointName(Endpoint endpoint)
+{
+    switch (endpoint) {
+    case Endpoint::DavFile:
+        return "dav_file";
+    case Endpoint::DavDirectory:
+        return "dav_directory";
+    case Endpoint::Chunk:
+        return "chunk";
+    case Endpoint::Ocs:
+        return "ocs";
+    case Endpoint::Other:
+        break;
+    }
+    return "other";
+}
+
+const char *RequestTiming::phaseName(Phase phase)
+{
+    switch (phase) {
+    case Queued:
+        return "queued";
+    case Connect:
+        return "connect";
+    case Send:
+        return "send";
+    case Wait:
+        return "wait";
+    case Transfer:
+        return "transfer";
+    case PhaseCount:
+        break;
+    }
+    return "unknown";
+}
+
+void RequestTiming::start(QNetworkReply *reply, QObject *context)
+{
+    _clock.start();
+    _events.fill(-1);
+    _bytesSent = 0;
+    _bytesReceived = 0;
+    _reply = reply;
+    _verb = HttpLogger::requestVerb(*reply);
+    _endpoint = endpointFor(_verb, reply->request().url());
+    mark(Dispatched);
+
+    // A redirect or resend starts over with a new reply, the old one no longer counts
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    QObject::connect(reply, &QNetworkReply::socketStartedConnecting, context, [this, reply] {
+        if (reply == _reply) {
+            mark(ConnectStarted);
+        }
+    });
+#endif
+    QObject::connect(reply, &QNetworkReply::uploadProgress, context, [this, reply](qint64 bytesSent, qint64 bytesTotal) {
+        if (reply == _reply && bytesSent > 0) {
+            mark(SendStarted);
+            _bytesSent = qMax(_bytesSent, bytesSent);
+        }
+#if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
+        // Without requestSent(), the last byte of the body is the closest there is
+        if (reply == _reply && bytesTotal > 0 && bytesSent == bytesTotal) {
+            mark(Sent);
+        }
+#else
+        Q_UNUSED(bytesTotal)
+#endif
+    });
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    QObject::connect(reply, &QNetworkReply::requestSent, context, [this, reply] {
+        if (reply == _reply) {
+            mark(Sent);
+        }
+    });
+#endif
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, context, [this, reply] {
+        if (reply == _reply) {
+            mark(FirstByte);
+        }
+    });
+    QObject::connect(reply, &QNetworkReply::downloadProgress, context, [this, reply](qint64 bytesReceived, qint64) {
+        if (reply == _reply) {
+            _bytesReceived = qMax(_bytesReceived, bytesReceived);
+        }
+    });
+}
+
+void RequestTiming::finish()
+{
+    mark(Finished);
+}
+
+qint64 RequestTiming::sendStart() const
+{
+    return _events[SendStarted] >= 0 ? _events[SendStarted] : _events[Sent];
+}
+
+qint64 RequestTiming::between(qint64 from, qint64 to) const
+{
+    return from >= 0 && to >= from ? to - from : -1;
+}
+
+std::chrono::nanoseconds RequestTiming::duration(Phase phase) const
+{
+    const auto connected = _events[ConnectStarted] >= 0;
+    qint64 result = -1;
+    switch (phase) {
+    case Queued:
+        result = between(_events[Dispatched], connected ? _events[ConnectStarted] : sendStart());
+        break;
+    case Connect:
+        result = connected ? between(_events[ConnectStarted], sendStart()) : -1;
+        break;
+    case Send:
+        result = between(sendStart(), _events[Sent]);
+        break;
+    case Wait:
+        result = between(_events[Sent], _events[FirstByte]);
+        break;
+    case Transfer:
+        result = between(_events[FirstByte], _events[Finished]);
+        break;
+    case PhaseCount:
+        break;
+    }
+    return std::chrono::nanoseconds(result);
+}
+
+std::chrono::nanoseconds RequestTiming::total() const
+{
+    return std::chrono::nanoseconds(between(_events[Dispatched], isFinished() ? _events[Finished] : _clock.nsecsElapsed()));
+}
+
+void RequestTiming::recordMetrics() const
+{
+    auto &registry = MetricsRegistry::instance();
+    const auto labels = MetricsRegistry::label("verb", _verb) + ',' + MetricsRegistry::label("endpoint", endpointName(_endpoint));
+
+    registry.histogram("nextcloud_http_request_duration_seconds", "Duration of network requests.", SyncMetrics::latencyBuckets(), labels)
+        .observe(total());
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const auto phaseDuration = duration(static_cast<Phase>(phase));
+        if (phaseDuration.count() < 0) {
+            continue;
+        }
+        registry.histogram("nextcloud_http_request_phase_seconds", "Duration of the phases of network requests.", SyncMetrics::latencyBuckets(),
+                    labels + ',' + MetricsRegistry::label("phase", phaseName(static_cast<Phase>(phase))))
+            .observe(phaseDuration);
+    }
+    registry.counter("nextcloud_http_sent_bytes", "Bytes sent in request bodies.", labels).add(_bytesSent);
+    registry.counter("nextcloud_http_received_bytes", "Bytes received in response bodies.", labels).add(_bytesReceived);
+}
+
+QString RequestTiming::toString() const
+{
+    QStringList parts;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const auto phaseDuration = duration(static_cast<Phase>(phase));
+        if (phaseDuration.count() >= 0) {
+            parts.append(QString::fromLatin1(phaseName(static_cast<Phase>(phase))) + QLatin1Char(' ') + formatDuration(phaseDuration));
+        }
+    }
+    parts.append(QStringLiteral("total %1").arg(formatDuration(total())));
+    parts.append(QStringLiteral("sent %1 B").arg(_bytesSent));
+    parts.append(QStringLiteral("received %1 B").arg(_bytesReceived));
+    return parts.join(QStringLiteral(", "));
+}
+
+}
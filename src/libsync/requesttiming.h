@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QString>
+
+#include <array>
+#include <chrono>
+
+class QNetworkReply;
+class QUrl;
+
+namespace OCC {
+
+/**
+ * @brief Where the time of a network request went
+ *
+ * The request is split into phases:
+ * - Queued: handed to the network access manager, waiting for a connection
+ * - Connect: host lookup, TCP connect and TLS handshake of a new connection.
+ *   Qt doesn't report when each of them ends, so they are one phase.
+ * - Send: the request and its body go out
+ * - Wait: the server works, until the response headers arrive
+ * - Transfer: the response body comes in
+ *
+ * A phase that didn't happen, like Connect on a reused connection, or that
+ * the reply didn't report has no duration. Before Qt 6.3, QNetworkReply
+ * doesn't report the connection and the sent request: there is no Connect
+ * phase, and the request counts as sent with the last byte of its body.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT RequestTiming
+{
+public:
+    enum class Endpoint {
+        DavFile,
+        DavDirectory,
+        Chunk,
+        Ocs,
+        Other,
+    };
+
+    enum Phase {
+        Queued,
+        Connect,
+        Send,
+        Wait,
+        Transfer,
+        PhaseCount,
+    };
+
+    /** Guesses what kind of endpoint \a verb on \a url talks to */
+    [[nodiscard]] static Endpoint endpointFor(const QByteArray &verb, const QUrl &url);
+    [[nodiscard]] static const char *endpointName(Endpoint endpoint);
+    [[nodiscard]] static const char *phaseName(Phase phase);
+
+    /** Starts timing \a reply, which was just handed to the network access manager.
+     *
+     * \a context is the owner of this timing, the signals of \a reply are
+     * disconnected when it is deleted.
+     */
+    void start(QNetworkReply *reply, QObject *context);
+    /** Ends the timing, when the reply finished */
+    void finish();
+
+    [[nodiscard]] bool isFinished() const { return _events[Finished] >= 0; }
+    [[nodiscard]] QByteArray verb() const { return _verb; }
+    [[nodiscard]] Endpoint endpoint() const { return _endpoint; }
+
+    /** The duration of \a phase, negative if it didn't happen or isn't known */
+    [[nodiscard]] std::chrono::nanoseconds duration(Phase phase) const;
+    [[nodiscard]] std::chrono::nanoseconds total() const;
+    [[nodiscard]] qint64 bytesSent() const { return _bytesSent; }
+    [[nodiscard]] qint64 bytesReceived() const { return _bytesReceived; }
+
+    /** Adds the phases and bytes of the finished request to the metrics, by verb and endpoint */
+    void recordMetrics() const;
+
+    /** E.g. "queued 0.2ms, connect 31.0ms, send 0.1ms, wait 48.3ms, transfer 2.0ms, total 81.6ms, sent 0 B, received 3541 B" */
+    [[nodiscard]] QString toString() const;
+
+private:
+    enum Event {
+        Dispatched,
+        ConnectStarted,
+        SendStarted,
+        Sent,
+        FirstByte,
+        Finished,
+        EventCount,
+    };
+
+    void mark(Event event)
+    {
+        if (_events[event] < 0) {
+            _events[event] = _clock.nsecsElapsed();
+        }
+    }
+    [[nodiscard]] qint64 sendStart() const;
+    [[nodiscard]] qint64 between(qint64 from, qint64 to) const;
+
+    QElapsedTimer _clock;
+    QPointer<QNetworkReply> _reply;
+    std::array<qint64, EventCount> _events{-1, -1, -1, -1, -1, -1};
+    qint64 _bytesSent = 0;
+    qint64 _bytesReceived = 0;
+    QByteArray _verb;
+    Endpoint _endpoint = Endpoint::Other;
+};
+
+}
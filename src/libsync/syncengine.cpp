@@ -19,7 +19,10 @@
 #include "owncloudpropagator.h"
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
+#include "common/metrics.h"
+#include "common/synctrace.h"
 #include "discoveryphase.h"
+#include "networkjobs.h"
 #include "creds/abstractcredentials.h"
 #include "common/syncfilestatus.h"
 #include "csync_exclude.h"
@@ -94,6 +97,7 @@ SyncEngine::SyncEngine(AccountPtr account,
     , _journal(journal)
     , _progressInfo(new ProgressInfo)
     , _syncOptions(syncOptions)
+    , _touchedFiles(s_touchedFilesMaxAgeMs)
 {
     qRegisterMetaType<SyncFileItem>("SyncFileItem");
     qRegisterMetaType<SyncFileItemPtr>("SyncFileItemPtr");
@@ -330,6 +334,7 @@ void SyncEngine::caseClashConflictRecordMaintenance()
 
 void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
 {
+    SyncMetrics::discoveredItems().add();
     emit itemDiscovered(item);
 
     if (Utility::isConflictFile(item->_file))
@@ -389,7 +394,7 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
                     ? SyncFileItem::LockOwnerType::TokenLock
                     : SyncFileItem::LockOwnerType::UserLock;
                 if (item->_locked == SyncFileItem::LockStatus::LockedItem
-                    && (item->_lockOwnerType != lockOwnerTypeToSkipReadonly || item->_lockOwnerId != account()->davUser())) {
+                    && (item->details()._lockOwnerType != lockOwnerTypeToSkipReadonly || item->details()._lockOwnerId != account()->davUser())) {
                     qCDebug(lcEngine()) << filePath << "file is locked: making it read only";
                     FileSystem::setFileReadOnly(filePath, true);
                 } else {
@@ -434,12 +439,12 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
 
             SyncJournalFileLockInfo lockInfo;
             lockInfo._locked = item->_locked == SyncFileItem::LockStatus::LockedItem;
-            lockInfo._lockTime = item->_lockTime;
-            lockInfo._lockTimeout = item->_lockTimeout;
-            lockInfo._lockOwnerId = item->_lockOwnerId;
-            lockInfo._lockOwnerType = static_cast<qint64>(item->_lockOwnerType);
-            lockInfo._lockOwnerDisplayName = item->_lockOwnerDisplayName;
-            lockInfo._lockEditorApp = item->_lockOwnerDisplayName;
+            lockInfo._lockTime = item->details()._lockTime;
+            lockInfo._lockTimeout = item->details()._lockTimeout;
+            lockInfo._lockOwnerId = item->details()._lockOwnerId;
+            lockInfo._lockOwnerType = static_cast<qint64>(item->details()._lockOwnerType);
+            lockInfo._lockOwnerDisplayName = item->details()._lockOwnerDisplayName;
+            lockInfo._lockEditorApp = item->details()._lockOwnerDisplayName;
 
             if (!_journal->updateLocalMetadata(item->_file, item->_modtime, item->_size, item->_inode, lockInfo)) {
                 qCWarning(lcEngine) << "Could not update local metadata for file" << item->_file;
@@ -528,6 +533,10 @@ void SyncEngine::startSync()
     s_anySyncRunning = true;
     _syncRunning = true;
     _anotherSyncNeeded = NoFollowUpSync;
+
+    SyncTrace::startFromEnvironment();
+    SyncTrace::asyncBegin(SyncTrace::Category::Sync, "sync", this, _localPath);
+    SyncMetrics::syncRuns().add();
     _clearTouchedFilesTimer.stop();
 
     _hasNoneFiles = false;
@@ -650,6 +659,19 @@ void SyncEngine::startSync()
         qCDebug(lcEngine) << "shouldDiscoverLocaly" << path << (result ? "true" : "false");
         return result;
     };
+    _discoveryPhase->_shouldListLocally = [this](const QString &path) {
+        const auto result = shouldListLocally(path);
+        qCDebug(lcEngine) << "shouldListLocally" << path << (result ? "true" : "false");
+        return result;
+    };
+    _discoveryPhase->_shouldListRemotely = [this](const QString &path) {
+        const auto result = shouldListRemotely(path);
+        qCDebug(lcEngine) << "shouldListRemotely" << path << (result ? "true" : "false");
+        return result;
+    };
+    _discoveryPhase->_hasRemoteChanges = [this](const QString &path) {
+        return hasRemoteChanges(path);
+    };
     _discoveryPhase->setSelectiveSyncBlackList(selectiveSyncBlackList);
     _discoveryPhase->setSelectiveSyncWhiteList(_journal->getSelectiveSyncList(SyncJournalDb::SelectiveSyncWhiteList, &ok));
     if (!ok) {
@@ -730,6 +752,11 @@ void SyncEngine::startSync()
             _discoveryPhase.data()
         );
     } else {
+        const auto syncToken = _journal->syncToken();
+        if (!syncToken.isEmpty()) {
+            fetchRemoteChanges(syncToken);
+            return;
+        }
         discoveryJob = new ProcessDirectoryJob(
             _discoveryPhase.data(),
             PinState::AlwaysLocal,
@@ -737,12 +764,66 @@ void SyncEngine::startSync()
             _discoveryPhase.data()
         );
     }
-    
+
+    startDiscoveryJob(discoveryJob);
+}
+
+void SyncEngine::startDiscoveryJob(ProcessDirectoryJob *discoveryJob)
+{
     _discoveryPhase->startJob(discoveryJob);
     connect(discoveryJob, &ProcessDirectoryJob::etag, this, &SyncEngine::slotRootEtagReceived);
     connect(_discoveryPhase.data(), &DiscoveryPhase::addErrorToGui, this, &SyncEngine::addErrorToGui);
 }
 
+void SyncEngine::fetchRemoteChanges(const QByteArray &syncToken)
+{
+    // The job goes away with the discovery phase if the sync is aborted
+    auto job = new SyncCollectionJob(_account, _remotePath, syncToken, _discoveryPhase.data());
+    const auto startRootJob = [this] {
+        startDiscoveryJob(new ProcessDirectoryJob(
+            _discoveryPhase.data(),
+            PinState::AlwaysLocal,
+            _journal->keyValueStoreGetInt("last_sync", 0),
+            _discoveryPhase.data()));
+    };
+    connect(job, &SyncCollectionJob::finishedWithChanges, this, [this, startRootJob](const QVector<SyncCollectionJob::Change> &changes, const QByteArray &newSyncToken) {
+        if (!_discoveryPhase) {
+            return;
+        }
+        qCInfo(lcEngine) << "Discovering" << changes.size() << "remote changes reported since the last sync";
+        _remoteChanges.clear();
+        for (const auto &change : changes) {
+            // The etag of a known folder changes with everything inside it, and
+            // what changed inside is reported on its own. Only folders the
+            // database doesn't know are new and need listing in full. A known
+            // folder may have changed itself too, e.g. its permissions or share
+            // state, so it and its parent are still listed.
+            SyncJournalFileRecord record;
+            if (change.isDirectory && !change.isRemoved
+                && _journal->getFileRecord(change.path, &record) && record.isValid() && record.isDirectory()) {
+                _remoteChanges.insertFolder(change.path);
+                continue;
+            }
+            _remoteChanges.insert(change.path);
+        }
+        _useRemoteChanges = true;
+        // Changes after this point are reported to the next sync
+        _discoveryPhase->_syncToken = newSyncToken;
+        startRootJob();
+    });
+    connect(job, &SyncCollectionJob::finishedWithError, this, [this, startRootJob](QNetworkReply *reply) {
+        if (!_discoveryPhase) {
+            return;
+        }
+        // Most likely the server forgot the token or stopped supporting
+        // sync-collection: fall back to comparing etags, that also fetches a new token
+        qCInfo(lcEngine) << "Could not fetch the remote changes, discovering the whole remote tree" << (reply ? reply->errorString() : QString());
+        _journal->setSyncToken({});
+        startRootJob();
+    });
+    job->start();
+}
+
 void SyncEngine::slotFolderDiscovered(bool local, const QString &folder)
 {
     // Don't wanna overload the UI
@@ -892,6 +973,12 @@ void SyncEngine::slotPropagationFinished(OCC::SyncFileItem::Status status)
 
     if ((status == SyncFileItem::Success || status == SyncFileItem::BlacklistedError) && _discoveryPhase) {
         _journal->setDataFingerprint(_discoveryPhase->_dataFingerprint);
+        // Only runs that listed the root know a token, single item discoveries don't.
+        // Items that failed or were skipped sit in folders whose etag was left stale;
+        // keeping the old token makes the next sync report them again.
+        if (status == SyncFileItem::Success && !_discoveryPhase->_syncToken.isEmpty()) {
+            _journal->setSyncToken(_discoveryPhase->_syncToken);
+        }
     }
 
     conflictRecordMaintenance();
@@ -922,6 +1009,15 @@ void SyncEngine::finalize(bool success)
     }
     s_anySyncRunning = false;
     _syncRunning = false;
+    // The propagator only updates the gauge while it schedules jobs
+    SyncMetrics::activeJobs().set(0);
+    if (!success) {
+        SyncMetrics::failedSyncRuns().add();
+    }
+    if (SyncTrace::isEnabled()) {
+        SyncTrace::asyncEnd(SyncTrace::Category::Sync, "sync", this, success ? QStringLiteral("success") : QStringLiteral("failure"));
+        SyncTrace::flush();
+    }
     emit finished(success);
 
     if (_account->shouldSkipE2eeMetadataChecksumValidation()) {
@@ -935,6 +1031,8 @@ void SyncEngine::finalize(bool success)
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
     _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
+    _remoteChanges.clear();
+    _useRemoteChanges = false;
 
     _clearTouchedFilesTimer.start();
     _leadingAndTrailingSpacesFilesAllowed.clear();
@@ -1133,28 +1231,7 @@ void SyncEngine::promptUserBeforePropagation(T &&lambda)
 
 void SyncEngine::slotAddTouchedFile(const QString &fn)
 {
-    QElapsedTimer now;
-    now.start();
-    QString file = QDir::cleanPath(fn);
-
-    // Iterate from the oldest and remove anything older than 15 seconds.
-    while (true) {
-        auto first = _touchedFiles.begin();
-        if (first == _touchedFiles.end())
-            break;
-        // Compare to our new QElapsedTimer instead of using elapsed().
-        // This avoids querying the current time from the OS for every loop.
-        auto elapsed = std::chrono::milliseconds(now.msecsSinceReference() - first.key().msecsSinceReference());
-        if (elapsed <= s_touchedFilesMaxAgeMs) {
-            // We found the first path younger than the maximum age, keep the rest.
-            break;
-        }
-
-        _touchedFiles.erase(first);
-    }
-
-    // This should be the largest QElapsedTimer yet, use constEnd() as hint.
-    _touchedFiles.insert(_touchedFiles.constEnd(), now, file);
+    _touchedFiles.add(fn);
 }
 
 void SyncEngine::slotClearTouchedFiles()
@@ -1169,34 +1246,15 @@ void SyncEngine::addAcceptedInvalidFileName(const QString& filePath)
 
 bool SyncEngine::wasFileTouched(const QString &fn) const
 {
-    // Start from the end (most recent) and look for our path. Check the time just in case.
-    auto begin = _touchedFiles.constBegin();
-    for (auto it = _touchedFiles.constEnd(); it != begin; --it) {
-        if ((it-1).value() == fn)
-            return std::chrono::milliseconds((it-1).key().elapsed()) <= s_touchedFilesMaxAgeMs;
-    }
-    return false;
+    return _touchedFiles.contains(fn);
 }
 
 void SyncEngine::setLocalDiscoveryOptions(LocalDiscoveryStyle style, std::set<QString> paths)
 {
     _localDiscoveryStyle = style;
-    _localDiscoveryPaths = std::move(paths);
-
-    // Normalize to make sure that no path is a contained in another.
-    // Note: for simplicity, this code consider anything less than '/' as a path separator, so for
-    // example, this will remove "foo.bar" if "foo" is in the list. This will mean we might have
-    // some false positive, but that's Ok.
-    // This invariant is used in SyncEngine::shouldDiscoverLocally
-    QString prev;
-    auto it = _localDiscoveryPaths.begin();
-    while(it != _localDiscoveryPaths.end()) {
-        if (!prev.isNull() && it->startsWith(prev) && (prev.endsWith('/') || *it == prev || it->at(prev.size()) <= '/')) {
-            it = _localDiscoveryPaths.erase(it);
-        } else {
-            prev = *it;
-            ++it;
-        }
+    _localDiscoveryPaths.clear();
+    for (const auto &path : paths) {
+        _localDiscoveryPaths.insert(path);
     }
 }
 
@@ -1222,28 +1280,54 @@ bool SyncEngine::shouldDiscoverLocally(const QString &path) const
     // - subfolders like "A/X/Y" will be discovered (so data inside a new or renamed folder will be
     //   discovered in full)
     // Check out TestLocalDiscovery::testLocalDiscoveryDecision()
+    return _localDiscoveryPaths.contains(path);
+}
+
+bool SyncEngine::shouldListRemotely(const QString &path) const
+{
+    if (!_useRemoteChanges || _remoteChanges.needsListing(path))
+        return true;
 
-    auto it = _localDiscoveryPaths.lower_bound(path);
-    if (it == _localDiscoveryPaths.end() || !it->startsWith(path)) {
-        // Maybe a subfolder of something in the list?
-        if (it != _localDiscoveryPaths.begin() && path.startsWith(*(--it))) {
-            return it->endsWith('/') || (path.size() > it->size() && path.at(it->size()) <= '/');
+    // Folders scheduled for remote discovery, e.g. after selective sync changes,
+    // have their etag invalidated in the database and are always listed
+    SyncJournalFileRecord record;
+    if (!_journal->getFileRecord(path, &record) || !record.isValid() || record._etag == "_invalid_")
+        return true;
+
+    // Only something further below changed. If a folder leading there is
+    // unknown to the database, it is new and listing is the only way to find it.
+    const auto children = _remoteChanges.dirtyChildren(path);
+    for (const auto &child : children) {
+        SyncJournalFileRecord childRecord;
+        if (!_journal->getFileRecord(path + QLatin1Char('/') + child, &childRecord) || !childRecord.isValid() || !childRecord.isDirectory()) {
+            return true;
         }
-        return false;
     }
+    return false;
+}
 
-    // maybe an exact match or an empty path?
-    if (it->size() == path.size() || path.isEmpty())
+bool SyncEngine::hasRemoteChanges(const QString &path) const
+{
+    return _useRemoteChanges && _remoteChanges.contains(path);
+}
+
+bool SyncEngine::shouldListLocally(const QString &path) const
+{
+    if (_localDiscoveryStyle == LocalDiscoveryStyle::FilesystemOnly)
         return true;
 
-    // Maybe a parent folder of something in the list?
-    // check for a prefix + / match
-    forever {
-        if (it->size() > path.size() && it->at(path.size()) == '/')
+    if (_localDiscoveryPaths.needsListing(path))
+        return true;
+
+    // Only something further below was touched. If a folder leading there is
+    // unknown to the database, it is new and listing is the only way to find it.
+    const auto children = _localDiscoveryPaths.dirtyChildren(path);
+    for (const auto &child : children) {
+        const auto childPath = path.isEmpty() ? child : path + QLatin1Char('/') + child;
+        SyncJournalFileRecord record;
+        if (!_journal->getFileRecord(childPath, &record) || !record.isValid() || !record.isDirectory()) {
             return true;
-        ++it;
-        if (it == _localDiscoveryPaths.end() || !it->startsWith(path))
-            return false;
+        }
     }
     return false;
 }
@@ -30,6 +30,8 @@
 #include "progressdispatcher.h"
 #include "common/utility.h"
 #include "syncfilestatustracker.h"
+#include "touchedfiles.h"
+#include "dirtypathindex.h"
 #include "accountfwd.h"
 #include "discoveryphase.h"
 #include "common/checksums.h"
@@ -116,6 +118,35 @@ public:
      */
     [[nodiscard]] bool shouldDiscoverLocally(const QString &path) const;
 
+    /**
+     * Returns whether the entries of the given folder-relative folder have to be
+     * read from the filesystem given the local discovery options.
+     *
+     * Folders that only lead to touched paths further below take their entries
+     * from the database instead, as long as the database knows the subfolders
+     * leading there.
+     *
+     * Example: If dirs contains 'foo/bar/touched_file', 'foo/bar' has to be listed
+     *     but '' and 'foo' don't.
+     */
+    [[nodiscard]] bool shouldListLocally(const QString &path) const;
+
+    /**
+     * Returns whether the given folder-relative folder has to be listed on the
+     * server.
+     *
+     * If the server reported its changes since the last sync (see
+     * SyncJournalDb::syncToken()), only the folders directly containing changes
+     * are listed. Otherwise every folder whose etag changed is.
+     */
+    [[nodiscard]] bool shouldListRemotely(const QString &path) const;
+
+    /**
+     * Returns whether the server reported changes at or below the given
+     * folder-relative path. Always false if the server didn't report changes.
+     */
+    [[nodiscard]] bool hasRemoteChanges(const QString &path) const;
+
     /** Access the last sync run's local discovery style */
     [[nodiscard]] LocalDiscoveryStyle lastLocalDiscoveryStyle() const { return _lastLocalDiscoveryStyle; }
 
@@ -150,8 +181,9 @@ public slots:
      * Control whether local discovery should read from filesystem or db.
      *
      * If style is DatabaseAndFilesystem, paths a set of file paths relative to
-     * the synced folder. All the parent directories of these paths will not
-     * be read from the db and scanned on the filesystem.
+     * the synced folder. The direct parent directories of these paths will not
+     * be read from the db and scanned on the filesystem. Further ancestors are
+     * only descended into, see shouldListLocally().
      *
      * Note, the style and paths are only retained for the next sync and
      * revert afterwards. Use _lastLocalDiscoveryStyle to discover the last
@@ -247,6 +279,11 @@ private slots:
     void remnantReadOnlyFolderDiscovered(const OCC::SyncFileItemPtr &item);
 
 private:
+    void startDiscoveryJob(ProcessDirectoryJob *discoveryJob);
+
+    /** Asks the server what changed since \a syncToken, then starts the discovery */
+    void fetchRemoteChanges(const QByteArray &syncToken);
+
     // Some files need a sync run to be executed at a specified time after
     // their status is scheduled to change (e.g. lock status will expire in
     // 20 minutes.)
@@ -391,7 +428,7 @@ private:
     AnotherSyncNeeded _anotherSyncNeeded = NoFollowUpSync;
 
     /** Stores the time since a job touched a file. */
-    QMultiMap<QElapsedTimer, QString> _touchedFiles;
+    TouchedFiles _touchedFiles;
 
     QElapsedTimer _lastUpdateProgressCallbackCall;
 
@@ -404,7 +441,11 @@ private:
     /** The kind of local discovery the last sync run used */
     LocalDiscoveryStyle _lastLocalDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
     LocalDiscoveryStyle _localDiscoveryStyle = LocalDiscoveryStyle::FilesystemOnly;
-    std::set<QString> _localDiscoveryPaths;
+    DirtyPathIndex _localDiscoveryPaths;
+
+    /** The remote changes since the last sync, if the server reported them */
+    DirtyPathIndex _remoteChanges;
+    bool _useRemoteChanges = false;
 
     QStringList _leadingAndTrailingSpacesFilesAllowed;
 
@@ -116,15 +116,16 @@ SyncJournalFileRecord SyncFileItem::toSyncJournalFileRecordWithInode(const QStri
     rec._lastShareStateFetchedTimestamp = _lastShareStateFetchedTimestamp;
     rec._serverHasIgnoredFiles = _serverHasIgnoredFiles;
     rec._checksumHeader = _checksumHeader;
-    rec._e2eMangledName = _encryptedFileName.toUtf8();
+    const auto &details = this->details();
+    rec._e2eMangledName = details._encryptedFileName.toUtf8();
     rec._e2eEncryptionStatus = EncryptionStatusEnums::toDbEncryptionStatus(_e2eEncryptionStatus);
     rec._lockstate._locked = _locked == LockStatus::LockedItem;
-    rec._lockstate._lockOwnerDisplayName = _lockOwnerDisplayName;
-    rec._lockstate._lockOwnerId = _lockOwnerId;
-    rec._lockstate._lockOwnerType = static_cast<qint64>(_lockOwnerType);
-    rec._lockstate._lockEditorApp = _lockEditorApp;
-    rec._lockstate._lockTime = _lockTime;
-    rec._lockstate._lockTimeout = _lockTimeout;
+    rec._lockstate._lockOwnerDisplayName = details._lockOwnerDisplayName;
+    rec._lockstate._lockOwnerId = details._lockOwnerId;
+    rec._lockstate._lockOwnerType = static_cast<qint64>(details._lockOwnerType);
+    rec._lockstate._lockEditorApp = details._lockEditorApp;
+    rec._lockstate._lockTime = details._lockTime;
+    rec._lockstate._lockTimeout = details._lockTimeout;
 
     // Update the inode if possible
     rec._inode = _inode;
@@ -153,16 +154,12 @@ SyncFileItemPtr SyncFileItem::fromSyncJournalFileRecord(const SyncJournalFileRec
     item->_remotePerm = rec._remotePerm;
     item->_serverHasIgnoredFiles = rec._serverHasIgnoredFiles;
     item->_checksumHeader = rec._checksumHeader;
-    item->_encryptedFileName = rec.e2eMangledName();
+    if (!rec._e2eMangledName.isEmpty()) {
+        item->mutableDetails()._encryptedFileName = rec.e2eMangledName();
+    }
     item->_e2eEncryptionStatus = EncryptionStatusEnums::fromDbEncryptionStatus(rec._e2eEncryptionStatus);
     item->_e2eEncryptionServerCapability = item->_e2eEncryptionStatus;
-    item->_locked = rec._lockstate._locked ? LockStatus::LockedItem : LockStatus::UnlockedItem;
-    item->_lockOwnerDisplayName = rec._lockstate._lockOwnerDisplayName;
-    item->_lockOwnerId = rec._lockstate._lockOwnerId;
-    item->_lockOwnerType = static_cast<LockOwnerType>(rec._lockstate._lockOwnerType);
-    item->_lockEditorApp = rec._lockstate._lockEditorApp;
-    item->_lockTime = rec._lockstate._lockTime;
-    item->_lockTimeout = rec._lockstate._lockTimeout;
+    item->updateLockStateFromDbRecord(rec);
     item->_sharedByMe = rec._sharedByMe;
     item->_isShared = rec._isShared;
     item->_lastShareStateFetchedTimestamp = rec._lastShareStateFetchedTimestamp;
@@ -198,26 +195,29 @@ SyncFileItemPtr SyncFileItem::fromProperties(const QString &filePath, const QMap
     }
     item->_locked =
         properties.value(QStringLiteral("lock")) == QStringLiteral("1") ? SyncFileItem::LockStatus::LockedItem : SyncFileItem::LockStatus::UnlockedItem;
-    item->_lockOwnerDisplayName = properties.value(QStringLiteral("lock-owner-displayname"));
-    item->_lockOwnerId = properties.value(QStringLiteral("lock-owner"));
-    item->_lockEditorApp = properties.value(QStringLiteral("lock-owner-editor"));
-
-    {
-        auto ok = false;
-        const auto intConvertedValue = properties.value(QStringLiteral("lock-owner-type")).toULongLong(&ok);
-        item->_lockOwnerType = ok ? static_cast<SyncFileItem::LockOwnerType>(intConvertedValue) : SyncFileItem::LockOwnerType::UserLock;
-    }
-
-    {
-        auto ok = false;
-        const auto intConvertedValue = properties.value(QStringLiteral("lock-time")).toULongLong(&ok);
-        item->_lockTime = ok ? intConvertedValue : 0;
-    }
-
-    {
-        auto ok = false;
-        const auto intConvertedValue = properties.value(QStringLiteral("lock-timeout")).toULongLong(&ok);
-        item->_lockTimeout = ok ? intConvertedValue : 0;
+    if (item->_locked == SyncFileItem::LockStatus::LockedItem) {
+        auto &details = item->mutableDetails();
+        details._lockOwnerDisplayName = properties.value(QStringLiteral("lock-owner-displayname"));
+        details._lockOwnerId = properties.value(QStringLiteral("lock-owner"));
+        details._lockEditorApp = properties.value(QStringLiteral("lock-owner-editor"));
+
+        {
+            auto ok = false;
+            const auto intConvertedValue = properties.value(QStringLiteral("lock-owner-type")).toULongLong(&ok);
+            details._lockOwnerType = ok ? static_cast<SyncFileItem::LockOwnerType>(intConvertedValue) : SyncFileItem::LockOwnerType::UserLock;
+        }
+
+        {
+            auto ok = false;
+            const auto intConvertedValue = properties.value(QStringLiteral("lock-time")).toULongLong(&ok);
+            details._lockTime = ok ? intConvertedValue : 0;
+        }
+
+        {
+            auto ok = false;
+            const auto intConvertedValue = properties.value(QStringLiteral("lock-timeout")).toULongLong(&ok);
+            details._lockTimeout = ok ? intConvertedValue : 0;
+        }
     }
 
     const auto date = QDateTime::fromString(properties.value(QStringLiteral("getlastmodified")), Qt::RFC2822Date);
@@ -244,12 +244,32 @@ SyncFileItemPtr SyncFileItem::fromProperties(const QString &filePath, const QMap
 void SyncFileItem::updateLockStateFromDbRecord(const SyncJournalFileRecord &dbRecord)
 {
     _locked = dbRecord._lockstate._locked ? LockStatus::LockedItem : LockStatus::UnlockedItem;
-    _lockOwnerId = dbRecord._lockstate._lockOwnerId;
-    _lockOwnerDisplayName = dbRecord._lockstate._lockOwnerDisplayName;
-    _lockOwnerType = static_cast<LockOwnerType>(dbRecord._lockstate._lockOwnerType);
-    _lockEditorApp = dbRecord._lockstate._lockEditorApp;
-    _lockTime = dbRecord._lockstate._lockTime;
-    _lockTimeout = dbRecord._lockstate._lockTimeout;
+    if (_locked == LockStatus::UnlockedItem && !hasDetails()) {
+        // No lock details to clear
+        return;
+    }
+    auto &details = mutableDetails();
+    details._lockOwnerId = dbRecord._lockstate._lockOwnerId;
+    details._lockOwnerDisplayName = dbRecord._lockstate._lockOwnerDisplayName;
+    details._lockOwnerType = static_cast<LockOwnerType>(dbRecord._lockstate._lockOwnerType);
+    details._lockEditorApp = dbRecord._lockstate._lockEditorApp;
+    details._lockTime = dbRecord._lockstate._lockTime;
+    details._lockTimeout = dbRecord._lockstate._lockTimeout;
+}
+
+const SyncFileItem::Details &SyncFileItem::details() const
+{
+    static const Details noDetails;
+    const auto details = _details.constData();
+    return details ? *details : noDetails;
+}
+
+SyncFileItem::Details &SyncFileItem::mutableDetails()
+{
+    if (!_details) {
+        _details.reset(new Details);
+    }
+    return *_details;
 }
 
 }
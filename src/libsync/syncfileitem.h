@@ -19,6 +19,8 @@
 #include <QString>
 #include <QDateTime>
 #include <QMetaType>
+#include <QSharedData>
+#include <QSharedDataPointer>
 #include <QSharedPointer>
 
 #include <csync.h>
@@ -122,6 +124,35 @@ public:
 
     Q_ENUM(LockOwnerType)
 
+    /**
+     * The fields that few items have: the end-to-end encrypted name, the
+     * server exception of an error, the direct download and the lock.
+     *
+     * Most items of a large sync have none of them, so they aren't kept inline:
+     * they are allocated when one of them is first set, see mutableDetails().
+     * Copies of an item share them until one of the copies changes them.
+     */
+    struct Details : public QSharedData
+    {
+        /// Whether there's end to end encryption on this file.
+        /// If the file is encrypted, the _encryptedFilename is
+        /// the encrypted name on the server.
+        QString _encryptedFileName;
+
+        QString _errorExceptionName; // Contains a server exception string only in case of error
+        QString _errorExceptionMessage; // Contains a server exception message string only in case of error
+
+        QString _directDownloadUrl;
+        QString _directDownloadCookies;
+
+        QString _lockOwnerId;
+        QString _lockOwnerDisplayName;
+        QString _lockEditorApp;
+        qint64 _lockTime = 0;
+        qint64 _lockTimeout = 0;
+        LockOwnerType _lockOwnerType = LockOwnerType::UserLock;
+    };
+
     [[nodiscard]] SyncJournalFileRecord toSyncJournalFileRecordWithInode(const QString &localFileName) const;
 
     /** Creates a basic SyncFileItem from a DB record
@@ -236,6 +267,12 @@ public:
 
     [[nodiscard]] bool isEncrypted() const { return _e2eEncryptionStatus != EncryptionStatus::NotEncrypted; }
 
+    /** The rarely set fields, all empty if none was set */
+    [[nodiscard]] const Details &details() const;
+    /** The rarely set fields for changing them, allocated if needed */
+    Details &mutableDetails();
+    [[nodiscard]] bool hasDetails() const { return _details.constData() != nullptr; }
+
     void updateLockStateFromDbRecord(const SyncJournalFileRecord &dbRecord);
 
     // Variables useful for everybody
@@ -258,11 +295,6 @@ public:
      */
     QString _originalFile;
 
-    /// Whether there's end to end encryption on this file.
-    /// If the file is encrypted, the _encryptedFilename is
-    /// the encrypted name on the server.
-    QString _encryptedFileName;
-
     ItemType _type BITFIELD(3);
     Direction _direction BITFIELD(3);
     bool _serverHasIgnoredFiles BITFIELD(1);
@@ -289,8 +321,6 @@ public:
     quint16 _httpErrorCode = 0;
     RemotePermissions _remotePerm;
     QString _errorString; // Contains a string only in case of error
-    QString _errorExceptionName; // Contains a server exception string only in case of error
-    QString _errorExceptionMessage; // Contains a server exception message string only in case of error
     QByteArray _responseTimeStamp;
     QByteArray _requestId; // X-Request-Id of the failed request
     quint32 _affectedItems = 1; // the number of affected items by the operation on this item.
@@ -316,20 +346,12 @@ public:
     qint64 _previousSize = 0;
     time_t _previousModtime = 0;
 
-    QString _directDownloadUrl;
-    QString _directDownloadCookies;
+    time_t _lastShareStateFetchedTimestamp = 0;
 
+    // The small fields are kept together, so they don't need padding
     LockStatus _locked = LockStatus::UnlockedItem;
-    QString _lockOwnerId;
-    QString _lockOwnerDisplayName;
-    LockOwnerType _lockOwnerType = LockOwnerType::UserLock;
-    QString _lockEditorApp;
-    qint64 _lockTime = 0;
-    qint64 _lockTimeout = 0;
 
     bool _isShared = false;
-    time_t _lastShareStateFetchedTimestamp = 0;
-
     bool _sharedByMe = false;
 
     bool _isFileDropDetected = false;
@@ -338,6 +360,9 @@ public:
 
     bool _isAnyInvalidCharChild = false;
     bool _isAnyCaseClashChild = false;
+
+private:
+    QSharedDataPointer<Details> _details;
 };
 
 inline bool operator<(const SyncFileItemPtr &item1, const SyncFileItemPtr &item2)
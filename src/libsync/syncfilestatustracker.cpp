@@ -185,28 +185,25 @@ void SyncFileStatusTracker::slotCheckAndRemoveSilentlyExcluded(const QString &fo
     }
 }
 
-void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
+void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const InternedPath &relativePath, const QString &path, SharedFlag sharedFlag)
 {
     // Will return 0 (and increase to 1) if the path wasn't in the map yet
     int count = _syncCount[relativePath]++;
     if (!count) {
         SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
-            : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        emit fileStatusChanged(getSystemDestination(relativePath), status);
+            ? fileStatus(path)
+            : resolveSyncAndErrorStatus(path, sharedFlag);
+        emit fileStatusChanged(getSystemDestination(path), status);
 
         // We passed from OK to SYNC, increment the parent to keep it marked as
         // SYNC while we propagate ourselves and our own children.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            incSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            incSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+        ASSERT(!path.endsWith('/'));
+        if (!relativePath.isRoot())
+            incSyncCountAndEmitStatusChanged(relativePath.parent(), path.left(qMax(path.lastIndexOf('/'), 0)), UnknownShared);
     }
 }
 
-void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
+void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const InternedPath &relativePath, const QString &path, SharedFlag sharedFlag)
 {
     int count = --_syncCount[relativePath];
     if (!count) {
@@ -214,17 +211,14 @@ void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &rela
         _syncCount.remove(relativePath);
 
         SyncFileStatus status = sharedFlag == UnknownShared
-            ? fileStatus(relativePath)
-            : resolveSyncAndErrorStatus(relativePath, sharedFlag);
-        emit fileStatusChanged(getSystemDestination(relativePath), status);
+            ? fileStatus(path)
+            : resolveSyncAndErrorStatus(path, sharedFlag);
+        emit fileStatusChanged(getSystemDestination(path), status);
 
         // We passed from SYNC to OK, decrement our parent.
-        ASSERT(!relativePath.endsWith('/'));
-        int lastSlashIndex = relativePath.lastIndexOf('/');
-        if (lastSlashIndex != -1)
-            decSyncCountAndEmitStatusChanged(relativePath.left(lastSlashIndex), UnknownShared);
-        else if (!relativePath.isEmpty())
-            decSyncCountAndEmitStatusChanged(QString(), UnknownShared);
+        ASSERT(!path.endsWith('/'));
+        if (!relativePath.isRoot())
+            decSyncCountAndEmitStatusChanged(relativePath.parent(), path.left(qMax(path.lastIndexOf('/'), 0)), UnknownShared);
     }
 }
 
@@ -254,7 +248,8 @@ void SyncFileStatusTracker::slotAboutToPropagate(SyncFileItemVector &items)
             && item->_instruction != CSYNC_INSTRUCTION_IGNORE
             && item->_instruction != CSYNC_INSTRUCTION_ERROR) {
             // Mark this path as syncing for instructions that will result in propagation.
-            incSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
+            const auto destination = item->destination();
+            incSyncCountAndEmitStatusChanged(InternedPath::fromString(destination), destination, sharedFlag);
         } else {
             emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
         }
@@ -301,7 +296,8 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
         && item->_instruction != CSYNC_INSTRUCTION_IGNORE
         && item->_instruction != CSYNC_INSTRUCTION_ERROR) {
         // decSyncCount calls *must* be symmetric with incSyncCount calls in slotAboutToPropagate
-        decSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
+        const auto destination = item->destination();
+        decSyncCountAndEmitStatusChanged(InternedPath::fromString(destination), destination, sharedFlag);
     } else {
         emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
     }
@@ -310,15 +306,16 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
 void SyncFileStatusTracker::slotSyncFinished()
 {
     // Clear the sync counts to reduce the impact of unsymetrical inc/dec calls (e.g. when directory job abort)
-    QHash<QString, int> oldSyncCount;
+    QHash<InternedPath, int> oldSyncCount;
     std::swap(_syncCount, oldSyncCount);
     for (auto it = oldSyncCount.begin(); it != oldSyncCount.end(); ++it) {
+        const auto path = it.key().toString();
         // Don't announce folders, fileStatus expect only paths without '/', otherwise it asserts
-        if (it.key().endsWith('/')) {
+        if (path.endsWith('/')) {
             continue;
         }
 
-        emit fileStatusChanged(getSystemDestination(it.key()), fileStatus(it.key()));
+        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
     }
 }
 
@@ -332,7 +329,8 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     // If it's a new file and that we're not syncing it yet,
     // don't show any icon and wait for the filesystem watcher to trigger a sync.
     SyncFileStatus status(isPathKnown ? SyncFileStatus::StatusUpToDate : SyncFileStatus::StatusNone);
-    if (_syncCount.value(relativePath)) {
+    const auto internedPath = InternedPath::find(relativePath);
+    if (!internedPath.isNull() && _syncCount.value(internedPath)) {
         status.set(SyncFileStatus::StatusSync);
     } else {
         // After a sync finished, we need to show the users issues from that last sync like the activity list does.
@@ -18,6 +18,7 @@
 
 // #include "ownsql.h"
 #include "syncfileitem.h"
+#include "internedpath.h"
 #include "common/syncfilestatus.h"
 #include <map>
 #include <QSet>
@@ -69,8 +70,9 @@ private:
 
     void invalidateParentPaths(const QString &path);
     QString getSystemDestination(const QString &relativePath);
-    void incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
-    void decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
+    // \a path is \a relativePath as a string: the parents cut it, no level rebuilds it from the path table
+    void incSyncCountAndEmitStatusChanged(const InternedPath &relativePath, const QString &path, SharedFlag sharedState);
+    void decSyncCountAndEmitStatusChanged(const InternedPath &relativePath, const QString &path, SharedFlag sharedState);
 
     SyncEngine *_syncEngine;
 
@@ -80,7 +82,8 @@ private:
     // Counts the number direct children currently being synced (has unfinished propagation jobs).
     // We'll show a file/directory as SYNC as long as its sync count is > 0.
     // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
-    QHash<QString, int> _syncCount;
+    // Keyed by interned path, so the parents share the storage of their names.
+    QHash<InternedPath, int> _syncCount;
 };
 }
 
@@ -47,6 +47,14 @@ void SyncOptions::setMaxChunkSize(const qint64 maxChunkSize)
     _maxChunkSize = ::qBound(_minChunkSize, maxChunkSize, _maxChunkSize);
 }
 
+int SyncOptions::requestBudget(bool http2) const
+{
+    if (_parallelNetworkJobs <= 0) {
+        return 1;
+    }
+    return http2 ? qMax(1, _http2StreamBudget) : _parallelNetworkJobs;
+}
+
 void SyncOptions::fillFromEnvironmentVariables()
 {
     QByteArray chunkSizeEnv = qgetenv("OWNCLOUD_CHUNK_SIZE");
@@ -65,9 +73,25 @@ void SyncOptions::fillFromEnvironmentVariables()
     if (!targetChunkUploadDurationEnv.isEmpty())
         _targetChunkUploadDuration = std::chrono::milliseconds(targetChunkUploadDurationEnv.toUInt());
 
+    int parallelChunkUploads = qgetenv("OWNCLOUD_PARALLEL_CHUNK_UPLOADS").toInt();
+    if (parallelChunkUploads > 0)
+        _parallelChunkUploads = parallelChunkUploads;
+
     int maxParallel = qgetenv("OWNCLOUD_MAX_PARALLEL").toInt();
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    int http2StreamBudget = qgetenv("OWNCLOUD_HTTP2_STREAMS").toInt();
+    if (http2StreamBudget > 0)
+        _http2StreamBudget = http2StreamBudget;
+
+    int downloadSegments = qgetenv("OWNCLOUD_DOWNLOAD_SEGMENTS").toInt();
+    if (downloadSegments > 0)
+        _downloadSegments = downloadSegments;
+
+    QByteArray minSegmentedDownloadSizeEnv = qgetenv("OWNCLOUD_MIN_SEGMENTED_DOWNLOAD_SIZE");
+    if (!minSegmentedDownloadSizeEnv.isEmpty())
+        _minSegmentedDownloadSize = minSegmentedDownloadSizeEnv.toLongLong();
 }
 
 void SyncOptions::verifyChunkSizes()
@@ -63,9 +63,35 @@ public:
      */
     std::chrono::milliseconds _targetChunkUploadDuration = std::chrono::minutes(1);
 
+    /** The number of chunks of a single file that may be uploaded in parallel.
+     *
+     * The chunks still count against maximumActiveTransferJob().
+     */
+    int _parallelChunkUploads = 1;
+
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** The maximum number of requests in flight over an HTTP/2 connection.
+     *
+     * HTTP/2 multiplexes the requests as streams over a single connection, so
+     * the limit of _parallelNetworkJobs, which is about connections, doesn't
+     * apply. The default matches the SETTINGS_MAX_CONCURRENT_STREAMS common
+     * servers announce. Transfers are still limited by
+     * OwncloudPropagator::maximumActiveTransferJob(), the rest of the budget
+     * goes to the metadata requests: PROPFIND, MKCOL, DELETE, MOVE.
+     */
+    int _http2StreamBudget = 100;
+
+    /** The number of parallel range requests a large file is downloaded with.
+     *
+     * Set to 1 to always download files in a single request.
+     */
+    int _downloadSegments = 4;
+
+    /** Files smaller than this (in Bytes) are always downloaded in a single request */
+    qint64 _minSegmentedDownloadSize = 512LL * 1000LL * 1000LL; // 512 MB
+
     static constexpr auto chunkV2MinChunkSize = 5LL * 1000LL * 1000LL; // 5 MB
     static constexpr auto chunkV2MaxChunkSize = 5LL * 1000LL * 1000LL * 1000LL; // 5 GB
 
@@ -77,10 +103,18 @@ public:
     [[nodiscard]] qint64 maxChunkSize() const;
     void setMaxChunkSize(const qint64 maxChunkSize);
 
+    /** The number of requests that may be in flight at once.
+     *
+     * That's _http2StreamBudget over HTTP/2 and _parallelNetworkJobs otherwise.
+     * Setting _parallelNetworkJobs to 0 disables parallelism in both cases.
+     */
+    [[nodiscard]] int requestBudget(bool http2) const;
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _parallelChunkUploads, _parallelNetworkJobs,
+     * _http2StreamBudget, _downloadSegments, _minSegmentedDownloadSize.
      */
     void fillFromEnvironmentVariables();
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "touchedfiles.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+using namespace std::chrono_literals;
+
+namespace OCC {
+
+namespace {
+
+    // Whether QDir::cleanPath() would return the path unchanged. The paths reported
+    // by the propagator almost always are clean, and checking is much cheaper than
+    // building a cleaned copy for every write.
+    bool isCleanPath(const QString &path)
+    {
+        qsizetype segmentStart = 0;
+        for (qsizetype i = 0; i <= path.size(); ++i) {
+            if (i < path.size() && path.at(i) != QLatin1Char('/')) {
+#ifdef Q_OS_WIN
+                if (path.at(i) == QLatin1Char('\\')) {
+                    return false;
+                }
+#endif
+                continue;
+            }
+            const auto segment = QStringView(path).mid(segmentStart, i - segmentStart);
+            // an empty segment other than the leading one is a "//" or a trailing '/'
+            if ((segment.isEmpty() && i != 0) || segment == QLatin1String(".") || segment == QLatin1String("..")) {
+                return false;
+            }
+            segmentStart = i + 1;
+        }
+        return true;
+    }
+
+}
+
+TouchedFiles::TouchedFiles(std::chrono::milliseconds maxAge)
+    : _maxAge(maxAge)
+    , _bucketDuration(qMax(1ms, maxAge / 8))
+{
+}
+
+std::chrono::milliseconds TouchedFiles::now()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return std::chrono::milliseconds(timer.msecsSinceReference());
+}
+
+void TouchedFiles::add(const QString &path)
+{
+    add(path, now());
+}
+
+void TouchedFiles::add(const QString &path, std::chrono::milliseconds now)
+{
+    expire(now);
+
+    const auto file = InternedPath::fromString(isCleanPath(path) ? path : QDir::cleanPath(path));
+    const auto bucketIndex = now / _bucketDuration;
+
+    if (const auto it = _lastTouched.find(file); it != _lastTouched.end()) {
+        const auto queued = it.value() / _bucketDuration == bucketIndex;
+        it.value() = now;
+        if (queued) {
+            // Touched again within the same bucket
+            return;
+        }
+    } else {
+        _lastTouched.insert(file, now);
+    }
+
+    if (_buckets.empty() || _buckets.back()._index != bucketIndex) {
+        _buckets.push_back({bucketIndex, {}});
+    }
+    _buckets.back()._paths.append(file);
+}
+
+bool TouchedFiles::contains(const QString &path) const
+{
+    return contains(path, now());
+}
+
+bool TouchedFiles::contains(const QString &path, std::chrono::milliseconds now) const
+{
+    const auto file = InternedPath::find(path);
+    if (file.isNull()) {
+        return false;
+    }
+    const auto it = _lastTouched.constFind(file);
+    return it != _lastTouched.cend() && now - it.value() <= _maxAge;
+}
+
+void TouchedFiles::clear()
+{
+    _lastTouched.clear();
+    _buckets.clear();
+}
+
+void TouchedFiles::expire(std::chrono::milliseconds now)
+{
+    // Drop the buckets in which even the most recent touch is too old. A path
+    // that was touched again since is queued in a newer bucket and stays.
+    while (!_buckets.empty() && (_buckets.front()._index + 1) * _bucketDuration <= now - _maxAge) {
+        for (const auto &path : qAsConst(_buckets.front()._paths)) {
+            const auto it = _lastTouched.find(path);
+            if (it != _lastTouched.end() && now - it.value() > _maxAge) {
+                _lastTouched.erase(it);
+            }
+        }
+        _buckets.pop_front();
+    }
+}
+
+}
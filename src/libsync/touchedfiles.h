@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) by Nextcloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "owncloudlib.h"
+#include "internedpath.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <chrono>
+#include <deque>
+
+namespace OCC {
+
+/**
+ * @brief Remembers the files the sync client touched recently
+ *
+ * Used by the SyncEngine to tell the file watcher notifications caused by the
+ * client itself apart from external changes. add() and contains() don't
+ * depend on the number of paths: the last touch time of each path is kept in
+ * a hash, and the paths are also queued in time buckets so expired entries
+ * can be dropped a bucket at a time without scanning the whole set. The paths
+ * are kept as InternedPath handles, which share their storage with the sync
+ * counts of the SyncFileStatusTracker.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT TouchedFiles
+{
+public:
+    explicit TouchedFiles(std::chrono::milliseconds maxAge);
+
+    /** Records that the file at \a path was just touched. The path is cleaned like QDir::cleanPath(). */
+    void add(const QString &path);
+    void add(const QString &path, std::chrono::milliseconds now);
+
+    /** Whether \a path was touched no longer than maxAge ago. */
+    [[nodiscard]] bool contains(const QString &path) const;
+    [[nodiscard]] bool contains(const QString &path, std::chrono::milliseconds now) const;
+
+    void clear();
+
+    /** The number of paths currently remembered, including expired ones not dropped yet. */
+    [[nodiscard]] int size() const { return _lastTouched.size(); }
+
+    /** The monotonic clock add() and contains() use when no time is given. */
+    static std::chrono::milliseconds now();
+
+private:
+    struct Bucket
+    {
+        qint64 _index = 0;
+        QVector<InternedPath> _paths;
+    };
+
+    void expire(std::chrono::milliseconds now);
+
+    std::chrono::milliseconds _maxAge;
+    std::chrono::milliseconds _bucketDuration;
+    QHash<InternedPath, std::chrono::milliseconds> _lastTouched;
+    std::deque<Bucket> _buckets; // oldest first
+};
+
+}
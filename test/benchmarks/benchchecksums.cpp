@@ -0,0 +1,48 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "common/checksumcalculator.h"
+#include "common/checksumconsts.h"
+#include "common/checksumkernels.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+
+using namespace OCC;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const QList<QByteArray> checksumTypes = {checkSumAdlerC, checkSumMD5C, checkSumSHA1C, checkSumSHA2C, checkSumSHA3C};
+    const QList<qint64> bufferSizes = {4 * 1024, 64 * 1024, 500 * 1024, 4 * 1024 * 1024};
+    constexpr qint64 bytesPerRun = 1024 * 1024 * 1024;
+
+    QByteArray data(bufferSizes.last(), Qt::Uninitialized);
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 2654435761u) >> 24);
+    }
+
+    qDebug() << "ADLER32 KERNEL" << ChecksumKernels::adler32KernelName();
+
+    for (const auto &checksumType : checksumTypes) {
+        for (const auto bufferSize : bufferSizes) {
+            ChecksumCalculator calculator(checksumType);
+            QElapsedTimer timer;
+            timer.start();
+            for (qint64 done = 0; done < bytesPerRun; done += bufferSize) {
+                calculator.addData(data.constData(), bufferSize);
+            }
+            const auto checksum = calculator.result();
+            const auto elapsedNs = qMax<qint64>(timer.nsecsElapsed(), 1);
+            const auto gigabytesPerSecond = static_cast<double>(bytesPerRun) / static_cast<double>(elapsedNs);
+            qDebug().noquote() << checksumType << "buffer" << bufferSize << "bytes:" << QString::number(gigabytesPerSecond, 'f', 2) << "GB/s" << checksum;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+namespace {
+
+constexpr auto latencyMs = 50;
+
+void addFolders(FileInfo &remote, const QString &path, int depth)
+{
+    constexpr auto foldersPerFolder = 4;
+    constexpr auto filesPerFolder = 3;
+    for (int i = 0; i < filesPerFolder; ++i) {
+        remote.insert(path + QStringLiteral("file%1").arg(i), 1);
+    }
+    if (depth == 0) {
+        return;
+    }
+    for (int i = 0; i < foldersPerFolder; ++i) {
+        const auto folder = path + QStringLiteral("dir%1").arg(i);
+        remote.mkdir(folder);
+        addFolders(remote, folder + QLatin1Char('/'), depth - 1);
+    }
+}
+
+// The initial sync of a remote tree, with every PROPFIND delayed like on a
+// distant server
+bool initialSync(bool depthInfinity)
+{
+    FakeFolder fakeFolder{FileInfo{}};
+    fakeFolder.fakeQnam()->setDepthInfinitySupported(depthInfinity);
+    fakeFolder.account()->setDepthInfinityPropfindSupported(depthInfinity);
+    addFolders(fakeFolder.remoteModifier(), QString(), 4);
+
+    int propfinds = 0;
+    fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+        if (request.attribute(QNetworkRequest::CustomVerbAttribute).toString() != QLatin1String("PROPFIND")) {
+            return nullptr;
+        }
+        ++propfinds;
+        return new DelayedReply<FakePropfindReply>(latencyMs, fakeFolder.remoteModifier(), op, request, &fakeFolder.syncEngine());
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    const auto result = fakeFolder.syncOnce();
+    qDebug().noquote() << (depthInfinity ? "Depth infinity:" : "Depth 1:") << propfinds << "PROPFINDs," << timer.elapsed() << "ms with"
+                       << latencyMs << "ms latency";
+    return result && fakeFolder.currentLocalState() == fakeFolder.currentRemoteState();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const auto result1 = initialSync(false);
+    const auto result2 = initialSync(true);
+    return (result1 && result2) ? 0 : -1;
+}
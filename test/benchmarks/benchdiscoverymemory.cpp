@@ -0,0 +1,122 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "syncenginetestutils.h"
+#include "common/metrics.h"
+#include <syncengine.h>
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_LINUX)
+#include <sys/resource.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+
+#if defined(Q_OS_LINUX)
+// A field of /proc/self/status in KiB, or -1
+qint64 procStatusKiB(const QByteArray &field)
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const auto prefix = field + ':';
+    for (const auto &line : status.readAll().split('\n')) {
+        if (line.startsWith(prefix)) {
+            return line.mid(prefix.size()).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+#endif
+
+// Starts measuring the peak resident set size over again, false where we can't
+bool resetPeakRss()
+{
+#if defined(Q_OS_LINUX)
+    QFile clearRefs(QStringLiteral("/proc/self/clear_refs"));
+    return clearRefs.open(QIODevice::WriteOnly | QIODevice::Unbuffered) && clearRefs.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+// Peak resident set size in KiB since the last resetPeakRss(), or -1 where we can't tell
+qint64 peakRssKiB()
+{
+#if defined(Q_OS_LINUX)
+    return procStatusKiB("VmHWM");
+#elif defined(Q_OS_MACOS)
+    struct rusage usage = {};
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss / 1024 : -1; // bytes on macOS
+#elif defined(Q_OS_UNIX)
+    struct rusage usage = {};
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+#else
+    return -1;
+#endif
+}
+
+// Current resident set size in KiB, or -1 where we can't tell
+qint64 rssKiB()
+{
+#if defined(Q_OS_LINUX)
+    return procStatusKiB("VmRSS");
+#else
+    return -1;
+#endif
+}
+
+}
+
+// A full discovery of a tree of 1M files: all directories are listed on both
+// sides and every entry has a local, a remote and a database record, which is
+// when discovery holds the most temporaries. Setting up the tree writes the
+// files to disk and takes a while.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    constexpr auto directoryCount = 1000;
+    constexpr auto filesPerDirectory = 1000;
+
+    FileInfo tree;
+    for (int dir = 0; dir < directoryCount; ++dir) {
+        const auto path = QStringLiteral("dir%1").arg(dir);
+        tree.mkdir(path);
+        for (int file = 0; file < filesPerDirectory; ++file) {
+            tree.insert(path + QStringLiteral("/file%1").arg(file), 1);
+        }
+    }
+    FakeFolder fakeFolder{tree};
+
+    const auto allocationsBefore = SyncMetrics::discoveryArenaAllocations().value();
+    const auto bytesBefore = SyncMetrics::discoveryArenaBytes().value();
+    fakeFolder.syncJournal().forceRemoteDiscoveryNextSync();
+    fakeFolder.syncEngine().setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
+
+    // The constructor of FakeFolder synced the same tree already: only the
+    // peak of the measured sync counts
+    const auto peakReset = resetPeakRss();
+    const auto rssBefore = rssKiB();
+
+    QElapsedTimer timer;
+    timer.start();
+    const auto result = fakeFolder.syncOnce();
+    const auto elapsedMs = timer.elapsed();
+
+    qDebug() << "Discovered" << directoryCount * (filesPerDirectory + 1) << "entries in" << elapsedMs << "ms";
+    qDebug() << "Arena allocations:" << SyncMetrics::discoveryArenaAllocations().value() - allocationsBefore << "taking"
+             << (SyncMetrics::discoveryArenaBytes().value() - bytesBefore) / 1024 << "KiB from the heap in total";
+    if (peakReset) {
+        qDebug() << "Peak RSS during the sync:" << peakRssKiB() << "KiB, before the sync" << rssBefore << "KiB";
+    } else {
+        qDebug() << "Peak RSS:" << peakRssKiB() << "KiB, including the setup sync: the peak can't be reset on this platform";
+    }
+    return result ? 0 : -1;
+}
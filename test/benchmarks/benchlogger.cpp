@@ -0,0 +1,62 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "logger.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QTemporaryDir>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace OCC;
+
+Q_LOGGING_CATEGORY(lcBenchLogger, "nextcloud.bench.logger", QtDebugMsg)
+
+// Logs debug messages from a few threads into a log file, like a sync with
+// debug logging enabled does, and reports the time the logging threads spend.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    constexpr auto threadCount = 4;
+    constexpr auto messagesPerThread = 250000;
+
+    QTemporaryDir logDir;
+    auto logger = Logger::instance();
+    logger->setLogFile(logDir.filePath(QStringLiteral("bench.log")));
+    logger->setLogDebug(true);
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < threadCount; ++thread) {
+        threads.emplace_back([thread] {
+            for (int i = 0; i < messagesPerThread; ++i) {
+                qCDebug(lcBenchLogger) << "Propagating item" << i << "of thread" << thread << "with etag" << QStringLiteral("\"5f3c1a2b%1\"").arg(i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    const auto loggingNs = qMax<qint64>(timer.nsecsElapsed(), 1);
+    logger->flush();
+    const auto writtenNs = timer.nsecsElapsed();
+
+    constexpr auto messageCount = threadCount * messagesPerThread;
+    // The logger writes to the message handler output, report on stdout directly
+    std::cout << messageCount << " messages logged in " << loggingNs / 1000000 << " ms ("
+              << static_cast<double>(loggingNs) / messageCount << " ns/message on the logging threads), written after "
+              << writtenNs / 1000000 << " ms, " << logger->droppedLineCount() << " dropped" << std::endl;
+
+    logger->setLogFile(QString());
+    return 0;
+}
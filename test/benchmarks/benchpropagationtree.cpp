@@ -0,0 +1,78 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "account.h"
+#include "owncloudpropagator.h"
+#include "common/syncjournaldb.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDebug>
+
+#include <algorithm>
+
+using namespace OCC;
+
+namespace {
+
+SyncFileItemPtr makeItem(const QString &file, ItemType type, SyncInstructions instruction, SyncFileItem::Direction direction)
+{
+    SyncFileItemPtr item(new SyncFileItem);
+    item->_file = file;
+    item->_type = type;
+    item->_instruction = instruction;
+    item->_direction = direction;
+    return item;
+}
+
+}
+
+// Builds the job tree for a sync of 1M items in which thousands of directories
+// are removed, created or replaced by files.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    constexpr auto directoryCount = 4000;
+    constexpr auto filesPerDirectory = 249;
+
+    SyncFileItemVector items;
+    items.reserve(directoryCount * (filesPerDirectory + 1));
+    for (int dir = 0; dir < directoryCount; ++dir) {
+        const auto path = QStringLiteral("folder%1/sub%2").arg(dir / 100).arg(dir);
+        auto instruction = CSYNC_INSTRUCTION_NEW;
+        auto direction = SyncFileItem::Down;
+        if (dir % 4 == 1) {
+            instruction = CSYNC_INSTRUCTION_REMOVE;
+        } else if (dir % 4 == 2) {
+            instruction = CSYNC_INSTRUCTION_TYPE_CHANGE;
+            direction = SyncFileItem::Up;
+        }
+        items.append(makeItem(path, ItemTypeDirectory, instruction, direction));
+        for (int file = 0; file < filesPerDirectory; ++file) {
+            items.append(makeItem(path + QStringLiteral("/file%1").arg(file), ItemTypeFile, instruction, direction));
+        }
+    }
+    for (int parent = 0; parent < directoryCount / 100; ++parent) {
+        items.append(makeItem(QStringLiteral("folder%1").arg(parent), ItemTypeDirectory, CSYNC_INSTRUCTION_NONE, SyncFileItem::None));
+    }
+    std::sort(items.begin(), items.end());
+    const auto itemCount = items.size();
+
+    QTemporaryDir dir;
+    SyncJournalDb journal(dir.path() + QStringLiteral("/.sync_bench.db"));
+    QSet<QString> bulkUploadBlackList;
+    OwncloudPropagator propagator(Account::create(), dir.path(), QStringLiteral("/"), &journal, bulkUploadBlackList);
+    propagator.setSyncOptions(SyncOptions());
+
+    QElapsedTimer timer;
+    timer.start();
+    propagator.start(std::move(items));
+    qDebug().noquote() << "Propagation tree of" << itemCount << "items built in" << timer.elapsed() << "ms";
+    return 0;
+}
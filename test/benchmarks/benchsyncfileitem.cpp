@@ -0,0 +1,212 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "syncfileitem.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <algorithm>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+
+// Heap bytes in use, or -1 where we can't tell
+qint64 heapInUse()
+{
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+    return static_cast<qint64>(mallinfo2().uordblks);
+#endif
+#endif
+    return -1;
+}
+
+// The data members of SyncFileItem before the rarely set ones moved to
+// SyncFileItem::Details, in the same order and with the same types
+struct InlineSyncFileItem
+{
+    InlineSyncFileItem()
+        : _type(ItemTypeSkip)
+        , _direction(SyncFileItem::None)
+        , _serverHasIgnoredFiles(false)
+        , _hasBlacklistEntry(false)
+        , _errorMayBeBlacklisted(false)
+        , _status(SyncFileItem::NoStatus)
+        , _isRestoration(false)
+        , _isSelectiveSync(false)
+    {
+    }
+
+    QString _file;
+    QString _renameTarget;
+    QString _originalFile;
+    QString _encryptedFileName;
+    ItemType _type BITFIELD(3);
+    SyncFileItem::Direction _direction BITFIELD(3);
+    bool _serverHasIgnoredFiles BITFIELD(1);
+    bool _hasBlacklistEntry BITFIELD(1);
+    bool _errorMayBeBlacklisted BITFIELD(1);
+    SyncFileItem::Status _status BITFIELD(4);
+    bool _isRestoration BITFIELD(1);
+    bool _isSelectiveSync BITFIELD(1);
+    SyncFileItem::EncryptionStatus _e2eEncryptionStatus = SyncFileItem::EncryptionStatus::NotEncrypted;
+    SyncFileItem::EncryptionStatus _e2eEncryptionServerCapability = SyncFileItem::EncryptionStatus::NotEncrypted;
+    SyncFileItem::EncryptionStatus _e2eEncryptionStatusRemote = SyncFileItem::EncryptionStatus::NotEncrypted;
+    quint16 _httpErrorCode = 0;
+    RemotePermissions _remotePerm;
+    QString _errorString;
+    QString _errorExceptionName;
+    QString _errorExceptionMessage;
+    QByteArray _responseTimeStamp;
+    QByteArray _requestId;
+    quint32 _affectedItems = 1;
+    SyncInstructions _instruction = CSYNC_INSTRUCTION_NONE;
+    time_t _modtime = 0;
+    QByteArray _etag;
+    qint64 _size = 0;
+    quint64 _inode = 0;
+    QByteArray _fileId;
+    QByteArray _checksumHeader;
+    qint64 _previousSize = 0;
+    time_t _previousModtime = 0;
+    QString _directDownloadUrl;
+    QString _directDownloadCookies;
+    SyncFileItem::LockStatus _locked = SyncFileItem::LockStatus::UnlockedItem;
+    QString _lockOwnerId;
+    QString _lockOwnerDisplayName;
+    SyncFileItem::LockOwnerType _lockOwnerType = SyncFileItem::LockOwnerType::UserLock;
+    QString _lockEditorApp;
+    qint64 _lockTime = 0;
+    qint64 _lockTimeout = 0;
+    bool _isShared = false;
+    time_t _lastShareStateFetchedTimestamp = 0;
+    bool _sharedByMe = false;
+    bool _isFileDropDetected = false;
+    bool _isEncryptedMetadataNeedUpdate = false;
+    bool _isAnyInvalidCharChild = false;
+    bool _isAnyCaseClashChild = false;
+};
+
+constexpr auto itemCount = 1000000;
+constexpr auto filesPerDirectory = 250;
+
+// Sets what discovery sets for a new remote file, the same for both layouts
+template <typename Item>
+void fillItem(Item &item, int i)
+{
+    item._file = QStringLiteral("folder%1/sub%2/file%3.txt").arg(i / 100000).arg(i / filesPerDirectory).arg(i);
+    item._originalFile = item._file;
+    item._type = ItemTypeFile;
+    item._instruction = CSYNC_INSTRUCTION_NEW;
+    item._direction = SyncFileItem::Down;
+    item._etag = QByteArray::number(0x5f3c1a2b00000000LL + i, 16);
+    item._fileId = QByteArray::number(i).rightJustified(8, '0') + "ocabcdefgh12";
+    item._checksumHeader = "SHA1:" + QByteArray::number(i, 16).rightJustified(40, '0');
+    item._size = i;
+    item._modtime = 1700000000 + i;
+    item._remotePerm = RemotePermissions::fromServerString(QStringLiteral("WDNVCKR"));
+    if (i % 200 == 0) {
+        item._locked = SyncFileItem::LockStatus::LockedItem;
+    }
+}
+
+// About 1% of the items are locked or failed
+template <typename Details>
+void fillDetails(Details &details, int i)
+{
+    if (i % 200 == 0) {
+        details._lockOwnerId = QStringLiteral("alice");
+        details._lockOwnerDisplayName = QStringLiteral("Alice");
+        details._lockEditorApp = QStringLiteral("text");
+        details._lockTime = 1700000000;
+        details._lockTimeout = 1800;
+    } else if (i % 200 == 100) {
+        details._errorExceptionName = QStringLiteral("Sabre\\DAV\\Exception\\Forbidden");
+        details._errorExceptionMessage = QStringLiteral("Access denied");
+    }
+}
+
+bool hasDetails(int i)
+{
+    return i % 100 == 0;
+}
+
+// Heap bytes per item of itemCount items created by \a create, or -1
+template <typename Create>
+double heapPerItem(Create create, qint64 *elapsedMs)
+{
+    const auto heapBefore = heapInUse();
+    QElapsedTimer timer;
+    timer.start();
+    const auto items = create();
+    *elapsedMs = timer.elapsed();
+    const auto heapAfter = heapInUse();
+    if (heapBefore < 0 || heapAfter < 0) {
+        return -1;
+    }
+    return static_cast<double>(heapAfter - heapBefore) / items.size();
+}
+
+}
+
+// Creates the items of a discovery of 1M files with the current layout of
+// SyncFileItem and with the previous one, which kept all fields inline, and
+// reports how much memory an item takes with each.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    qint64 inlineMs = 0;
+    const auto inlineHeap = heapPerItem([] {
+        QVector<QSharedPointer<InlineSyncFileItem>> items;
+        items.reserve(itemCount);
+        for (int i = 0; i < itemCount; ++i) {
+            QSharedPointer<InlineSyncFileItem> item(new InlineSyncFileItem);
+            fillItem(*item, i);
+            if (hasDetails(i)) {
+                fillDetails(*item, i);
+            }
+            items.append(item);
+        }
+        return items;
+    }, &inlineMs);
+
+    qint64 currentMs = 0;
+    int withDetails = 0;
+    const auto currentHeap = heapPerItem([&withDetails] {
+        SyncFileItemVector items;
+        items.reserve(itemCount);
+        for (int i = 0; i < itemCount; ++i) {
+            SyncFileItemPtr item(new SyncFileItem);
+            fillItem(*item, i);
+            if (hasDetails(i)) {
+                fillDetails(item->mutableDetails(), i);
+            }
+            items.append(item);
+        }
+        withDetails = static_cast<int>(std::count_if(items.cbegin(), items.cend(), [](const SyncFileItemPtr &item) { return item->hasDetails(); }));
+        return items;
+    }, &currentMs);
+
+    qDebug() << "Created" << itemCount << "items," << withDetails << "with details";
+    qDebug() << "Previous layout: sizeof" << sizeof(InlineSyncFileItem) << "bytes, created in" << inlineMs << "ms";
+    qDebug() << "Current layout: sizeof(SyncFileItem)" << sizeof(SyncFileItem) << "bytes, sizeof(SyncFileItem::Details)"
+             << sizeof(SyncFileItem::Details) << "bytes, created in" << currentMs << "ms";
+    if (inlineHeap >= 0 && currentHeap >= 0) {
+        qDebug() << "Heap per item, with strings and reference counts:" << inlineHeap << "bytes before," << currentHeap << "bytes now";
+    } else {
+        qDebug() << "The heap in use can't be measured on this platform";
+    }
+    return 0;
+}
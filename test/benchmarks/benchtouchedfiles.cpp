@@ -0,0 +1,61 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "touchedfiles.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+// Replays the file watcher traffic of a large download: every downloaded file is
+// touched by the propagator and then reported by the watcher, while some
+// external changes for files that weren't touched come in too.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    constexpr auto fileCount = 100000;
+    constexpr auto eventCount = 1000000;
+    constexpr auto eventsPerMillisecond = 10;
+
+    QStringList paths;
+    paths.reserve(fileCount);
+    for (int i = 0; i < fileCount; ++i) {
+        paths.append(QStringLiteral("/home/user/Nextcloud/folder%1/file%2.dat").arg(i / 1000).arg(i));
+    }
+    const auto externalPath = QStringLiteral("/home/user/Nextcloud/external.txt");
+
+    TouchedFiles touchedFiles(3s);
+    int suppressed = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int event = 0; event < eventCount; ++event) {
+        const auto now = std::chrono::milliseconds(event / eventsPerMillisecond);
+        const auto &path = paths.at(event % fileCount);
+        if (event % 10 == 9) {
+            suppressed += touchedFiles.contains(externalPath, now);
+            continue;
+        }
+        touchedFiles.add(path, now);
+        suppressed += touchedFiles.contains(path, now);
+    }
+    const auto elapsedNs = qMax<qint64>(timer.nsecsElapsed(), 1);
+
+    qDebug().noquote() << eventCount << "watcher events in" << elapsedNs / 1000000 << "ms,"
+                       << QString::number(static_cast<double>(elapsedNs) / eventCount, 'f', 1) << "ns/event,"
+                       << suppressed << "suppressed," << touchedFiles.size() << "paths remembered";
+
+    // The paths that expired are gone from the interned path table too
+    qDebug().noquote() << InternedPath::pathCount() << "interned paths," << InternedPath::nameCount() << "names";
+    touchedFiles.clear();
+    qDebug().noquote() << "after clear():" << InternedPath::pathCount() << "interned paths," << InternedPath::nameCount() << "names";
+    return 0;
+}
@@ -336,7 +336,7 @@ FileInfo *FileInfo::findInvalidatingEtags(PathComponents pathComponents)
     return find(std::move(pathComponents), true);
 }
 
-FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent, const QByteArray &syncToken)
     : FakeReply { parent }
 {
     setRequest(request);
@@ -352,6 +352,7 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
         return;
     }
     const QString prefix = request.url().path().left(request.url().path().size() - fileName.size());
+    const FileInfo *requestedFileInfo = fileInfo;
 
     // Don't care about the request and just return a full propfind
     const QString davUri { QStringLiteral("DAV:") };
@@ -411,6 +412,9 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
         xml.writeTextElement(ncUri, QStringLiteral("lock-timeout"), QString::number(fileInfo.lockTimeout));
         xml.writeTextElement(ncUri, QStringLiteral("is-encrypted"), fileInfo.isEncrypted ? QString::number(1) : QString::number(0));
         buffer.write(fileInfo.extraDavProperties);
+        if (&fileInfo == requestedFileInfo && !syncToken.isEmpty()) {
+            xml.writeTextElement(davUri, QStringLiteral("sync-token"), QString::fromUtf8(syncToken));
+        }
         xml.writeEndElement(); // prop
         xml.writeTextElement(davUri, QStringLiteral("status"), QStringLiteral("HTTP/1.1 200 OK"));
         xml.writeEndElement(); // propstat
@@ -418,8 +422,16 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
     };
 
     writeFileResponse(*fileInfo);
-    foreach (const FileInfo &childFileInfo, fileInfo->children)
-        writeFileResponse(childFileInfo);
+    const auto depthInfinity = request.rawHeader("Depth") == "infinity";
+    std::function<void(const FileInfo &)> writeChildren = [&](const FileInfo &dirInfo) {
+        for (const auto &childFileInfo : dirInfo.children) {
+            writeFileResponse(childFileInfo);
+            if (depthInfinity) {
+                writeChildren(childFileInfo);
+            }
+        }
+    };
+    writeChildren(*fileInfo);
     xml.writeEndElement(); // multistatus
     xml.writeEndDocument();
 
@@ -471,6 +483,79 @@ qint64 FakePropfindReply::readData(char *data, qint64 maxlen)
     return len;
 }
 
+FakeSyncCollectionReply::FakeSyncCollectionReply(FileInfo &remoteRootFileInfo, const QHash<QString, QByteArray> &etagsAtToken, const QByteArray &newSyncToken,
+    QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : FakePropfindReply(QByteArray(), op, request, parent)
+{
+    open(QIODevice::ReadOnly);
+
+    const auto fileName = getFilePathFromUrl(request.url());
+    Q_ASSERT(!fileName.isNull());
+    const QString prefix = request.url().path().left(request.url().path().size() - fileName.size());
+    const auto isBelowRequest = [&fileName](const QString &path) {
+        return fileName.isEmpty() ? !path.isEmpty() : path.startsWith(fileName + QLatin1Char('/'));
+    };
+
+    const auto currentEtags = etagSnapshot(remoteRootFileInfo);
+
+    const QString davUri { QStringLiteral("DAV:") };
+    QBuffer buffer { &payload };
+    buffer.open(QIODevice::WriteOnly);
+    QXmlStreamWriter xml(&buffer);
+    xml.writeNamespace(davUri, QStringLiteral("d"));
+    xml.writeStartDocument();
+    xml.writeStartElement(davUri, QStringLiteral("multistatus"));
+    const auto writeHref = [&](const QString &path) {
+        const auto url = QString::fromUtf8(QUrl::toPercentEncoding(path, "/"));
+        xml.writeTextElement(davUri, QStringLiteral("href"), OCC::Utility::concatUrlPath(prefix, url).path());
+    };
+    for (auto it = currentEtags.cbegin(); it != currentEtags.cend(); ++it) {
+        if (!isBelowRequest(it.key()) || etagsAtToken.value(it.key()) == it.value()) {
+            continue;
+        }
+        const auto fileInfo = remoteRootFileInfo.find(it.key());
+        xml.writeStartElement(davUri, QStringLiteral("response"));
+        writeHref(it.key());
+        xml.writeStartElement(davUri, QStringLiteral("propstat"));
+        xml.writeStartElement(davUri, QStringLiteral("prop"));
+        xml.writeTextElement(davUri, QStringLiteral("getetag"), QStringLiteral("\"%1\"").arg(QString::fromLatin1(it.value())));
+        xml.writeStartElement(davUri, QStringLiteral("resourcetype"));
+        if (fileInfo->isDir) {
+            xml.writeEmptyElement(davUri, QStringLiteral("collection"));
+        }
+        xml.writeEndElement(); // resourcetype
+        xml.writeEndElement(); // prop
+        xml.writeTextElement(davUri, QStringLiteral("status"), QStringLiteral("HTTP/1.1 200 OK"));
+        xml.writeEndElement(); // propstat
+        xml.writeEndElement(); // response
+    }
+    for (auto it = etagsAtToken.cbegin(); it != etagsAtToken.cend(); ++it) {
+        if (!isBelowRequest(it.key()) || currentEtags.contains(it.key())) {
+            continue;
+        }
+        xml.writeStartElement(davUri, QStringLiteral("response"));
+        writeHref(it.key());
+        xml.writeTextElement(davUri, QStringLiteral("status"), QStringLiteral("HTTP/1.1 404 Not Found"));
+        xml.writeEndElement(); // response
+    }
+    xml.writeTextElement(davUri, QStringLiteral("sync-token"), QString::fromUtf8(newSyncToken));
+    xml.writeEndElement(); // multistatus
+    xml.writeEndDocument();
+}
+
+QHash<QString, QByteArray> FakeSyncCollectionReply::etagSnapshot(const FileInfo &remoteRootFileInfo)
+{
+    QHash<QString, QByteArray> etags;
+    std::function<void(const FileInfo &)> addChildren = [&](const FileInfo &fileInfo) {
+        for (const auto &child : fileInfo.children) {
+            etags.insert(child.path(), child.etag);
+            addChildren(child);
+        }
+    };
+    addChildren(remoteRootFileInfo);
+    return etags;
+}
+
 FakePutReply::FakePutReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &putPayload, QObject *parent)
     : FakeReply { parent }
 {
@@ -722,8 +807,24 @@ void FakeGetReply::respond()
     }
     payload = fileInfo->contentChar;
     size = fileInfo->size;
+    auto httpStatus = 200;
+
+    // honor range requests of the form "bytes=N-" and "bytes=N-M"
+    static const QRegularExpression rangePattern(QStringLiteral("^bytes=(?<start>\\d+)-(?<end>\\d*)$"));
+    const auto match = rangePattern.match(QString::fromUtf8(request().rawHeader("Range")));
+    if (match.hasMatch()) {
+        const auto start = match.captured(QStringLiteral("start")).toInt();
+        const auto endString = match.captured(QStringLiteral("end"));
+        const auto end = endString.isEmpty() ? size - 1 : std::min(endString.toInt(), size - 1);
+        if (start <= end) {
+            setRawHeader("Content-Range", "bytes " + QByteArray::number(start) + '-' + QByteArray::number(end) + '/' + QByteArray::number(size));
+            size = end - start + 1;
+            httpStatus = 206;
+        }
+    }
+
     setHeader(QNetworkRequest::ContentLengthHeader, size);
-    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, httpStatus);
     setRawHeader("OC-ETag", fileInfo->etag);
     setRawHeader("ETag", fileInfo->etag);
     setRawHeader("OC-FileId", fileInfo->fileId);
@@ -1082,9 +1183,28 @@ QNetworkReply *FakeQNAM::createRequest(QNetworkAccessManager::Operation op, cons
         FileInfo &info = isUpload ? _uploadFileInfo : _remoteRootFileInfo;
 
         auto verb = newRequest.attribute(QNetworkRequest::CustomVerbAttribute).toString();
-        if (verb == QLatin1String("PROPFIND")) {
+        if (verb == QLatin1String("PROPFIND") && newRequest.rawHeader("Depth") == "infinity" && !_depthInfinitySupported && !_depthInfinityDowngraded) {
+            // The {DAV:}propfind-finite-depth precondition failed
+            reply = new FakeErrorReply { op, newRequest, this, 403 };
+        } else if (verb == QLatin1String("PROPFIND")) {
+            auto propfindRequest = newRequest;
+            if (_depthInfinityDowngraded && propfindRequest.rawHeader("Depth") == "infinity") {
+                propfindRequest.setRawHeader("Depth", "1");
+            }
             // Ignore outgoingData always returning something good enough, works for now.
-            reply = new FakePropfindReply { info, op, newRequest, this };
+            reply = new FakePropfindReply { info, op, propfindRequest, this, _syncCollectionSupported ? issueSyncToken() : QByteArray() };
+        } else if (verb == QLatin1String("REPORT")) {
+            static const QRegularExpression syncTokenRx(QStringLiteral("<d:sync-token>(.*)</d:sync-token>"));
+            const auto syncToken = syncTokenRx.match(QString::fromUtf8(outgoingData->readAll())).captured(1).toUtf8();
+            if (!_syncCollectionSupported) {
+                reply = new FakeErrorReply { op, newRequest, this, 415 };
+            } else if (!_syncTokenSnapshots.contains(syncToken)) {
+                // The {DAV:}valid-sync-token precondition failed
+                reply = new FakeErrorReply { op, newRequest, this, 403 };
+            } else {
+                const auto etagsAtToken = _syncTokenSnapshots.value(syncToken);
+                reply = new FakeSyncCollectionReply { info, etagsAtToken, issueSyncToken(), op, newRequest, this };
+            }
         } else if (verb == QLatin1String("GET") || op == QNetworkAccessManager::GetOperation) {
             reply = new FakeGetReply { info, op, newRequest, this };
         } else if (verb == QLatin1String("PUT") || op == QNetworkAccessManager::PutOperation) {
@@ -1117,6 +1237,13 @@ QNetworkReply *FakeQNAM::createRequest(QNetworkAccessManager::Operation op, cons
     return reply;
 }
 
+QByteArray FakeQNAM::issueSyncToken()
+{
+    const auto syncToken = QByteArrayLiteral("http://fake.server/sync/") + QByteArray::number(_syncTokenSnapshots.size());
+    _syncTokenSnapshots.insert(syncToken, FakeSyncCollectionReply::etagSnapshot(_remoteRootFileInfo));
+    return syncToken;
+}
+
 QNetworkReply * FakeQNAM::overrideReplyWithError(QString fileName, QNetworkAccessManager::Operation op, QNetworkRequest newRequest)
 {
     QNetworkReply *reply = nullptr;
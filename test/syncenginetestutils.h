@@ -217,10 +217,10 @@ class FakePropfindReply : public FakeReply
 public:
     QByteArray payload;
 
-    explicit FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+    explicit FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent, const QByteArray &syncToken = {});
     explicit FakePropfindReply(const QByteArray &replyContents, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
-    Q_INVOKABLE void respond();
+    Q_INVOKABLE virtual void respond();
 
     Q_INVOKABLE void respond404();
 
@@ -230,6 +230,19 @@ public:
     qint64 readData(char *data, qint64 maxlen) override;
 };
 
+// Answers a sync-collection REPORT with the entries whose etag changed since
+// the snapshot of the remote tree that was taken when the token was handed out
+class FakeSyncCollectionReply : public FakePropfindReply
+{
+    Q_OBJECT
+public:
+    FakeSyncCollectionReply(FileInfo &remoteRootFileInfo, const QHash<QString, QByteArray> &etagsAtToken, const QByteArray &newSyncToken,
+        QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
+
+    // Maps the path of every entry in the tree to its etag
+    static QHash<QString, QByteArray> etagSnapshot(const FileInfo &remoteRootFileInfo);
+};
+
 class FakePutReply : public FakeReply
 {
     Q_OBJECT
@@ -285,7 +298,7 @@ class FakeDeleteReply : public FakeReply
 public:
     FakeDeleteReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
-    Q_INVOKABLE void respond();
+    Q_INVOKABLE virtual void respond();
 
     void abort() override { }
     qint64 readData(char *, qint64) override { return 0; }
@@ -474,6 +487,11 @@ private:
     QHash<QString, int> _errorPaths;
     // monitor requests and optionally provide custom replies
     Override _override;
+    bool _syncCollectionSupported = false;
+    bool _depthInfinitySupported = false;
+    bool _depthInfinityDowngraded = false;
+    // the etags of the remote tree when each sync token was handed out
+    QHash<QByteArray, QHash<QString, QByteArray>> _syncTokenSnapshots;
 
 public:
     FakeQNAM(FileInfo initialRoot);
@@ -484,6 +502,18 @@ public:
 
     void setOverride(const Override &override) { _override = override; }
 
+    // Answer "Depth: infinity" PROPFINDs instead of rejecting them with 403, like Nextcloud does by default
+    void setDepthInfinitySupported(bool supported) { _depthInfinitySupported = supported; }
+    // Answer "Depth: infinity" PROPFINDs as if they asked for depth 1, like sabre/dav does when infinity is disabled
+    void setDepthInfinityDowngraded(bool downgraded) { _depthInfinityDowngraded = downgraded; }
+
+    // Hand out sync tokens in PROPFINDs and answer sync-collection REPORTs for them
+    void setSyncCollectionSupported(bool supported) { _syncCollectionSupported = supported; }
+    // Makes the server forget the tokens it handed out
+    void clearSyncTokens() { _syncTokenSnapshots.clear(); }
+    // A token for the current state of the remote tree
+    QByteArray issueSyncToken();
+
     QJsonObject forEachReplyPart(QIODevice *outgoingData,
                                  const QString &contentType,
                                  std::function<QJsonObject(const QMap<QString, QByteArray> &)> replyFunction);
@@ -553,6 +583,7 @@ public:
     };
     ErrorList serverErrorPaths() { return {_fakeQnam}; }
     void setServerOverride(const FakeQNAM::Override &override) { _fakeQnam->setOverride(override); }
+    FakeQNAM *fakeQnam() { return _fakeQnam; }
     QJsonObject forEachReplyPart(QIODevice *outgoingData,
                                  const QString &contentType,
                                  std::function<QJsonObject(const QMap<QString, QByteArray>&)> replyFunction) {
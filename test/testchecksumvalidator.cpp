@@ -12,12 +12,15 @@
 #include "common/checksums.h"
 #include "networkjobs.h"
 #include "common/checksumcalculator.h"
+#include "common/checksumkernels.h"
 #include "common/checksumconsts.h"
 #include "common/utility.h"
 #include "filesystem.h"
 #include "logger.h"
 #include "propagatorjobs.h"
 
+#include <zlib.h>
+
 using namespace OCC;
 using namespace OCC::Utility;
 
@@ -123,6 +126,60 @@ private slots:
         QCOMPARE(sSum, sum);
     }
 
+    void testAdler32Kernel()
+    {
+        QByteArray data(3 * 5552 + 77, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<char>((i * 7919) % 256);
+        }
+
+        // odd sizes and offsets exercise the vector blocks as well as the scalar tail
+        for (const auto size : {0, 1, 31, 32, 33, 5551, 5552, 5553, 12345, static_cast<int>(data.size())}) {
+            for (const auto offset : {0, 1, 13}) {
+                const auto length = qMax(0, size - offset);
+                const auto expected = static_cast<quint32>(adler32(1, reinterpret_cast<const Bytef *>(data.constData() + offset), length));
+                QCOMPARE(ChecksumKernels::adler32(1, data.constData() + offset, length), expected);
+            }
+        }
+
+        // all 0xff bytes is the worst case for the intermediate sums
+        const QByteArray ones(1024 * 1024, '\xff');
+        const auto expected = static_cast<quint32>(adler32(1, reinterpret_cast<const Bytef *>(ones.constData()), ones.size()));
+        QCOMPARE(ChecksumKernels::adler32(1, ones.constData(), ones.size()), expected);
+    }
+
+    void testIncrementalCalculation_data()
+    {
+        QTest::addColumn<QByteArray>("checksumType");
+
+        QTest::newRow("Adler32") << QByteArray(checkSumAdlerC);
+        QTest::newRow("MD5") << QByteArray(checkSumMD5C);
+        QTest::newRow("SHA1") << QByteArray(checkSumSHA1C);
+        QTest::newRow("SHA256") << QByteArray(checkSumSHA2C);
+        QTest::newRow("SHA3-256") << QByteArray(checkSumSHA3C);
+    }
+
+    void testIncrementalCalculation()
+    {
+        QFETCH(QByteArray, checksumType);
+
+        QFile file(_testfile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto content = file.readAll();
+        file.close();
+
+        ChecksumCalculator fileCalculator(_testfile, checksumType);
+        const auto expected = fileCalculator.calculate();
+        QVERIFY(!expected.isEmpty());
+
+        ChecksumCalculator streamCalculator(checksumType);
+        QVERIFY(streamCalculator.isValid());
+        for (qint64 offset = 0; offset < content.size(); offset += 1000) {
+            QVERIFY(streamCalculator.addData(content.constData() + offset, qMin<qint64>(1000, content.size() - offset)));
+        }
+        QCOMPARE(streamCalculator.result(), expected);
+    }
+
     void testUploadChecksummingAdler() {
 #ifndef ZLIB_FOUND
         QSKIP("ZLIB not found.", SkipSingle);
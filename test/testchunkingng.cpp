@@ -172,22 +172,20 @@ private slots:
         QVERIFY(uploadedSize > 2 * 1000 * 1000); // at least 50 MB
         QVERIFY(chunkMap.size() >= 3); // at least three chunks
 
-        QStringList chunksToDelete;
-
-        // Remove the second chunk, so all further chunks will be deleted and resent
+        // Remove the second chunk: the journal knows which part of the file it covered,
+        // so only that chunk is resent and the further chunks are kept
         auto firstChunk = chunkMap.first();
         auto secondChunk = *(chunkMap.begin() + 1);
-        const auto chunksList = chunkMap.keys().mid(2);
-        for (const auto& name : chunksList) {
-            chunksToDelete.append(name);
-        }
         fakeFolder.uploadState().children.first().remove(secondChunk.name);
 
+        QStringList putChunks;
         QStringList deletedPaths;
         fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
             if (op == QNetworkAccessManager::PutOperation) {
                 // Test that we properly resuming, not resending the first chunk
                 Q_ASSERT(request.rawHeader("OC-Chunk-Offset").toLongLong() >= firstChunk.size);
+                const auto path = request.url().path();
+                putChunks.append(path.mid(path.lastIndexOf('/') + 1));
             } else if (op == QNetworkAccessManager::DeleteOperation) {
                 deletedPaths.append(request.url().path());
             }
@@ -196,15 +194,11 @@ private slots:
 
         QVERIFY(fakeFolder.syncOnce());
 
-        for (const auto& toDelete : chunksToDelete) {
-            bool wasDeleted = false;
-            for (const auto& deleted : deletedPaths) {
-                if (deleted.mid(deleted.lastIndexOf('/') + 1) == toDelete) {
-                    wasDeleted = true;
-                    break;
-                }
-            }
-            QVERIFY(wasDeleted);
+        QVERIFY(deletedPaths.isEmpty());
+        QVERIFY(!putChunks.isEmpty());
+        QCOMPARE(putChunks.first(), secondChunk.name);
+        for (const auto &name : chunkMap.keys()) {
+            QVERIFY(name == secondChunk.name || !putChunks.contains(name));
         }
 
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
@@ -260,6 +254,97 @@ private slots:
         QCOMPARE(fakeFolder.uploadState().children.first().name, chunkingId);
     }
 
+    // Several chunks of the same file are uploaded at once
+    void testParallelChunkUpload()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"chunking", "1.0"} } } });
+        constexpr auto size = 30 * 1000 * 1000; // 30 MB
+        setChunkSize(fakeFolder.syncEngine(), 5 * 1000 * 1000);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelChunkUploads = 3;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        QObject parent;
+        int inFlightPuts = 0;
+        int maxInFlightPuts = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                const auto reply = new FakePutReply(fakeFolder.uploadState(), op, request, outgoingData->readAll(), &parent);
+                maxInFlightPuts = qMax(maxInFlightPuts, ++inFlightPuts);
+                connect(reply, &QNetworkReply::finished, &parent, [&inFlightPuts] { --inFlightPuts; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(maxInFlightPuts, 3);
+        QCOMPARE(inFlightPuts, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1); // the transfer was done with chunking
+    }
+
+    // A chunk in the middle failed while the ones after it completed: only that chunk is resent
+    void testResumeOutOfOrderChunks()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ {"chunking", "1.0"} } } });
+        constexpr auto chunkSize = 5 * 1000 * 1000; // 5 MB
+        constexpr auto size = 2 * chunkSize + 1000; // three chunks
+        setChunkSize(fakeFolder.syncEngine(), chunkSize);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelChunkUploads = 3;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        const auto chunkName = [](const QNetworkRequest &request) {
+            const auto path = request.url().path();
+            return path.mid(path.lastIndexOf('/') + 1);
+        };
+
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && chunkName(request) == QStringLiteral("00002")) {
+                return new FakeErrorReply(op, request, &fakeFolder.syncEngine(), 500);
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/a0", size);
+        QVERIFY(!fakeFolder.syncOnce());
+
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+        const auto chunkingId = fakeFolder.uploadState().children.first().name;
+        const auto &chunkMap = fakeFolder.uploadState().children.first().children;
+        QVERIFY(chunkMap.contains(QStringLiteral("00001")));
+        QVERIFY(!chunkMap.contains(QStringLiteral("00002")));
+        QVERIFY(chunkMap.contains(QStringLiteral("00003")));
+
+        QStringList requests;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                requests.append(QStringLiteral("PUT ") + chunkName(request));
+            } else if (op == QNetworkAccessManager::DeleteOperation) {
+                requests.append(QStringLiteral("DELETE ") + chunkName(request));
+            } else if (request.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QStringLiteral("MOVE")) {
+                requests.append(QStringLiteral("MOVE"));
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(requests, QStringList({QStringLiteral("PUT 00002"), QStringLiteral("MOVE")}));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->size, size);
+        // The same chunk id was re-used
+        QCOMPARE(fakeFolder.uploadState().children.count(), 1);
+        QCOMPARE(fakeFolder.uploadState().children.first().name, chunkingId);
+    }
+
     // Test resuming (or rather not resuming!) for the error case of the sum of
     // chunk sizes being larger than the file size
     void testResume4() {
@@ -9,6 +9,10 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 #include <owncloudpropagator.h>
+#include <propagatorjobs.h>
+#include <common/checksumcalculator.h>
+#include <common/checksums.h>
+#include <common/checksumconsts.h>
 
 using namespace OCC;
 
@@ -98,6 +102,207 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testResumeWithChecksum()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        const auto size = 30 * 1000 * 1000;
+        fakeFolder.remoteModifier().insert("A/a0", size, 'A');
+
+        ChecksumCalculator calculator(checkSumSHA1C);
+        const QByteArray content(size, 'A');
+        QVERIFY(calculator.addData(content.constData(), content.size()));
+        const auto checksumHeader = makeChecksumHeader(checkSumSHA1C, calculator.result());
+
+        // First, download only the first 3 MB of the file
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/a0")) {
+                auto reply = new BrokenFakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+                reply->setRawHeader(checkSumHeaderC, checksumHeader);
+                return reply;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(getItem(completeSpy, "A/a0")->_status, SyncFileItem::SoftError);
+
+        // The resumed download only gets the rest of the file, the checksum
+        // computed while writing must still cover the whole file
+        QByteArray ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/a0")) {
+                ranges = request.rawHeader("Range");
+                auto reply = new FakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+                reply->setRawHeader(checkSumHeaderC, checksumHeader);
+                return reply;
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges, QByteArray("bytes=" + QByteArray::number(stopAfter) + "-"));
+        QCOMPARE(getItem(completeSpy, "A/a0")->_status, SyncFileItem::Success);
+        QCOMPARE(getItem(completeSpy, "A/a0")->_checksumHeader, checksumHeader);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownload()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = 4;
+        options._minSegmentedDownloadSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        fakeFolder.remoteModifier().insert("A/big", 10 * 1000 * 1000, 'B');
+        fakeFolder.remoteModifier().insert("A/small", 1000, 'S');
+
+        QByteArrayList ranges;
+        QByteArray smallRange;
+        int smallGets = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+            } else if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/small")) {
+                smallRange = request.rawHeader("Range");
+                ++smallGets;
+            }
+            return nullptr;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        std::sort(ranges.begin(), ranges.end());
+        QCOMPARE(ranges, QByteArrayList({ "bytes=0-2499999", "bytes=2500000-4999999", "bytes=5000000-7499999", "bytes=7500000-9999999" }));
+        QCOMPARE(smallGets, 1);
+        QVERIFY(smallRange.isEmpty());
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::Success);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.syncJournal().downloadInfoCount(), 0);
+    }
+
+    void testSegmentedDownloadResume()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = 4;
+        options._minSegmentedDownloadSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        const auto size = 20 * 1000 * 1000;
+        fakeFolder.remoteModifier().insert("A/big", size, 'B');
+
+        // The second segment breaks off after stopAfter bytes
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.rawHeader("Range") == "bytes=5000000-9999999") {
+                return new BrokenFakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+            }
+            return nullptr;
+        });
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::SoftError);
+        const auto info = fakeFolder.syncJournal().getDownloadInfo("A/big");
+        QVERIFY(info._valid);
+        QCOMPARE(info._segments.size(), 4);
+        QCOMPARE(info._segments[1]._done, stopAfter);
+        QVERIFY(info._segments[0].isComplete() && info._segments[2].isComplete() && info._segments[3].isComplete());
+
+        // Only the missing part of the second segment is downloaded again
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges, QByteArrayList({ "bytes=" + QByteArray::number(5000000 + stopAfter) + "-9999999" }));
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::Success);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownloadSavesFinishedSegments()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = 4;
+        options._minSegmentedDownloadSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        fakeFolder.remoteModifier().insert("A/big", 10 * 1000 * 1000, 'B');
+
+        // The second segment never finishes
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.rawHeader("Range") == "bytes=2500000-4999999") {
+                return new FakeHangingReply(op, request, &parent);
+            }
+            return nullptr;
+        });
+
+        // The finished segments are in the journal while the download is still
+        // running, so they survive the client being killed
+        fakeFolder.scheduleSync();
+        const auto finishedSegmentsSaved = [&] {
+            const auto info = fakeFolder.syncJournal().getDownloadInfo("A/big");
+            return info._valid && info._segments.size() == 4
+                && info._segments[0].isComplete() && info._segments[2].isComplete() && info._segments[3].isComplete();
+        };
+        QTRY_VERIFY(finishedSegmentsSaved());
+        QCOMPARE(fakeFolder.syncJournal().getDownloadInfo("A/big")._segments[1]._done, qint64(0));
+
+        fakeFolder.syncEngine().abort();
+        QVERIFY(!fakeFolder.execUntilFinished());
+        QVERIFY(finishedSegmentsSaved());
+
+        // Only the segment that didn't finish is downloaded again
+        QByteArrayList ranges;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ranges.append(request.rawHeader("Range"));
+            }
+            return nullptr;
+        });
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges, QByteArrayList({ "bytes=2500000-4999999" }));
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::Success);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSegmentedDownloadRangeIgnored()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._downloadSegments = 4;
+        options._minSegmentedDownloadSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), &OCC::SyncEngine::itemCompleted);
+        fakeFolder.remoteModifier().insert("A/big", 10 * 1000 * 1000, 'B');
+
+        // A server that always sends the whole file
+        int gets = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().endsWith("A/big")) {
+                ++gets;
+                auto requestWithoutRange = request;
+                requestWithoutRange.setRawHeader("Range", {});
+                return new FakeGetReply(fakeFolder.remoteModifier(), op, requestWithoutRange, this);
+            }
+            return nullptr;
+        });
+
+        // falls back to a single request
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(gets, 5);
+        QCOMPARE(getItem(completeSpy, "A/big")->_status, SyncFileItem::Success);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void testErrorMessage () {
         // This test's main goal is to test that the error string from the server is shown in the UI
 
@@ -16,6 +16,7 @@
 #include "accountstate.h"
 #include <accountmanager.h>
 #include "configfile.h"
+#include "filesystem.h"
 #include "syncenginetestutils.h"
 #include "testhelper.h"
 
@@ -250,6 +251,68 @@ private slots:
         OCC::AccountManager::instance()->deleteAccount(accountState);
     }
 
+    void testLocalDiscoveryStateAcrossRestarts()
+    {
+#ifdef Q_OS_LINUX
+        QTemporaryDir dir;
+        ConfigFile::setConfDir(dir.path()); // we don't want to pollute the user's config file
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        const AccountStatePtr accountState(new FakeAccountState(fakeFolder.account()));
+        auto definition = folderDefinition(fakeFolder.localPath());
+        definition.targetPath = QString();
+        definition.journalPath = definition.defaultJournalPath(fakeFolder.account());
+
+        // What the previous run left after a clean shutdown
+        const auto lastFullLocalDiscovery = QDateTime::currentMSecsSinceEpoch() - 60 * 1000;
+        const auto writePreviousRun = [&](qint64 rootModTime) {
+            SyncJournalDb journal(definition.absoluteJournalPath());
+            journal.keyValueStoreSet(QStringLiteral("last_full_local_discovery"), lastFullLocalDiscovery);
+            journal.keyValueStoreSet(QStringLiteral("watcher_stopped_root_mtime"), rootModTime);
+            journal.keyValueStoreSet(QStringLiteral("watcher_stopped_at"), QDateTime::currentMSecsSinceEpoch() - 1000);
+            journal.setLocalDiscoveryPaths({QStringLiteral("A/a1")});
+            journal.close();
+        };
+        const auto syncFolder = [](Folder &folder) {
+            QSignalSpy syncFinished(&folder, &Folder::syncFinished);
+            folder.prepareToSync();
+            folder.startSync();
+            return syncFinished.wait() ? folder.syncEngine().lastLocalDiscoveryStyle() : LocalDiscoveryStyle::FilesystemOnly;
+        };
+
+        // Continues with the paths of the previous run
+        writePreviousRun(static_cast<qint64>(FileSystem::getModTime(fakeFolder.localPath())));
+        {
+            Folder folder(definition, accountState.data(), createVfsFromPlugin(Vfs::Off));
+            QCOMPARE(folder.journalDb()->keyValueStoreGetInt(QStringLiteral("watcher_stopped_at"), 0), qint64(0));
+            folder.registerFolderWatcher();
+
+            fakeFolder.localModifier().appendByte("A/a1");
+            QCOMPARE(syncFolder(folder), LocalDiscoveryStyle::DatabaseAndFilesystem);
+            QCOMPARE(fakeFolder.currentRemoteState().find("A/a1")->size, fakeFolder.currentLocalState().find("A/a1")->size);
+        }
+
+        // The shutdown recorded that the next run may continue, with the age
+        // of the last full local discovery carried over
+        {
+            SyncJournalDb journal(definition.absoluteJournalPath());
+            QVERIFY(journal.keyValueStoreGetInt(QStringLiteral("watcher_stopped_at"), 0) != 0);
+            QVERIFY(qAbs(journal.keyValueStoreGetInt(QStringLiteral("last_full_local_discovery"), 0) - lastFullLocalDiscovery) < 10 * 1000);
+            journal.close();
+        }
+
+        // Something changed at the top level meanwhile: a full local discovery again
+        writePreviousRun(static_cast<qint64>(FileSystem::getModTime(fakeFolder.localPath())) - 10);
+        {
+            Folder folder(definition, accountState.data(), createVfsFromPlugin(Vfs::Off));
+            folder.registerFolderWatcher();
+            QCOMPARE(syncFolder(folder), LocalDiscoveryStyle::FilesystemOnly);
+        }
+#else
+        QSKIP("Needs a reliable folder watcher");
+#endif
+    }
+
     void testCheckPathValidityForNewFolder()
     {
 #ifdef Q_OS_WIN
@@ -142,6 +142,8 @@ private slots:
         OCC::Logger::instance()->setLogDebug(true);
 
         QStandardPaths::setTestModeEnabled(true);
+
+        QTRY_VERIFY(_watcher->isReady());
     }
 
     void init()
@@ -171,6 +173,58 @@ private slots:
         QVERIFY(waitForPathChanged(file));
     }
 
+    void testChangesAreBatched()
+    {
+        QSignalSpy pathsChangedSpy(_watcher.data(), &FolderWatcher::pathsChanged);
+
+        // Changes reported in one go are handed on as one batch, without duplicates
+        QSet<QString> files;
+        for (int i = 0; i < 10; ++i) {
+            const auto file = _rootPath + QStringLiteral("/a1/batched%1.txt").arg(i);
+            files.insert(file);
+            _watcher->slotLockFileDetectedExternally(file);
+        }
+        _watcher->slotLockFileDetectedExternally(_rootPath + QStringLiteral("/a1/batched0.txt"));
+
+        QVERIFY(pathsChangedSpy.wait());
+        QCOMPARE(pathsChangedSpy.count(), 1);
+        QCOMPARE(pathsChangedSpy.first().first().value<QSet<QString>>(), files);
+        for (const auto &file : qAsConst(files)) {
+            QVERIFY(waitForPathChanged(file));
+        }
+    }
+
+#ifdef Q_OS_LINUX
+    void testWatchesAreAddedInBackground()
+    {
+        QTemporaryDir root;
+        const auto rootPath = QDir(root.path()).canonicalPath();
+        QDir rootDir(rootPath);
+        for (int i = 0; i < 20; ++i) {
+            for (int j = 0; j < 20; ++j) {
+                QVERIFY(rootDir.mkpath(QStringLiteral("d%1/d%2").arg(i).arg(j)));
+            }
+        }
+
+        FolderWatcher watcher;
+        QSignalSpy readySpy(&watcher, &FolderWatcher::becameReady);
+        QSignalSpy pathChangedSpy(&watcher, &FolderWatcher::pathChanged);
+        watcher.init(rootPath);
+        QVERIFY(!watcher.isReady());
+
+        QVERIFY(readySpy.wait());
+        QVERIFY(watcher.isReady());
+        QCOMPARE(watcher.testLinuxWatchCount(), countFolders(rootPath) + 1);
+
+        // The deepest directories are watched too
+        const auto file = rootPath + "/d19/d19/file";
+        touch(file);
+        QVERIFY(pathChangedSpy.wait());
+        QCOMPARE(pathChangedSpy.first().first().toString(), file);
+        QCOMPARE(readySpy.count(), 1);
+    }
+#endif
+
     void testMove3LevelDirWithFile() {
         QString file(_rootPath + "/a0/b/c/empty.txt");
         mkdir(_rootPath + "/a0");
@@ -345,6 +399,7 @@ private slots:
 
         _watcher.reset(new FolderWatcher);
         _watcher->init(_rootPath);
+        QTRY_VERIFY(_watcher->isReady());
         _watcher->setShouldWatchForFileUnlocking(true);
         _pathChangedSpy.reset(new QSignalSpy(_watcher.data(), &FolderWatcher::pathChanged));
         QScopedPointer<QSignalSpy> locksImposedSpy(new QSignalSpy(_watcher.data(), &FolderWatcher::filesLockImposed));
@@ -7,7 +7,6 @@
 #include <QtTest>
 
 #include "folderwatcher_linux.h"
-#include "common/utility.h"
 
 using namespace OCC;
 
@@ -15,55 +14,40 @@ class TestInotifyWatcher: public FolderWatcherPrivate
 {
     Q_OBJECT
 
-private:
-    QString _root;
-
 private slots:
-    void initTestCase()
-    {
-        _root = QDir::tempPath() + "/" + "test_" + QString::number(OCC::Utility::rand());
-        qDebug() << "creating test directory tree in " << _root;
-        QDir rootDir(_root);
-
-        rootDir.mkpath(_root + "/a1/b1/c1");
-        rootDir.mkpath(_root + "/a1/b1/c2");
-        rootDir.mkpath(_root + "/a1/b2/c1");
-        rootDir.mkpath(_root + "/a1/b3/c3");
-        rootDir.mkpath(_root + "/a2/b3/c3");
-    }
-
-    // Test the recursive path listing function findFoldersBelow
-    void testDirsBelowPath() {
-        QStringList dirs;
-
-        bool ok = findFoldersBelow(QDir(_root), dirs);
-        QVERIFY( dirs.indexOf(_root + "/a1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1/c1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b1/c2")>-1);
-
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/rand1.dat"));
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/b1/rand2.dat"));
-        QVERIFY(Utility::writeRandomFile(_root+"/a1/b1/c1/rand3.dat"));
-
-        QVERIFY( dirs.indexOf(_root + "/a1/b2")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b2/c1")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b3")>-1);
-        QVERIFY( dirs.indexOf(_root + "/a1/b3/c3")>-1);
-
-        QVERIFY( dirs.indexOf(_root + "/a2"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3/c3"));
-
-        QVERIFY2(dirs.count() == 11, "Directory count wrong.");
-
-        QVERIFY2(ok, "findFoldersBelow failed.");
-    }
-
-    void cleanupTestCase() {
-        if( _root.startsWith(QDir::tempPath() )) {
-           system( QString("rm -rf %1").arg(_root).toLocal8Bit() );
-        }
+    // Test the tree of watched directories
+    void testWatchTree() {
+        QVERIFY(insertWatch(-1, "/tmp/root", 1));
+        QVERIFY(insertWatch(1, "a1", 2));
+        QVERIFY(insertWatch(2, "b1", 3));
+        QVERIFY(insertWatch(3, "c1", 4));
+        // sorts between 'a1' and 'a1/b1'
+        QVERIFY(insertWatch(1, "a1 b", 5));
+        QVERIFY(insertWatch(5, "c1", 6));
+        QCOMPARE(testWatchCount(), 6);
+
+        QCOMPARE(pathForWatch(1), QStringLiteral("/tmp/root"));
+        QCOMPARE(pathForWatch(4), QStringLiteral("/tmp/root/a1/b1/c1"));
+        QCOMPARE(pathForWatch(6), QStringLiteral("/tmp/root/a1 b/c1"));
+        QCOMPARE(pathForWatch(7), QString());
+
+        // Known already, or the parent is gone
+        QVERIFY(!insertWatch(2, "b1", 3));
+        QVERIFY(!insertWatch(42, "orphan", 7));
+        QCOMPARE(testWatchCount(), 6);
+
+        removeWatchesBelow(2);
+        QCOMPARE(testWatchCount(), 3);
+        QCOMPARE(pathForWatch(3), QString());
+        QCOMPARE(pathForWatch(4), QString());
+        QCOMPARE(pathForWatch(6), QStringLiteral("/tmp/root/a1 b/c1"));
+
+        // The name can be watched again
+        QVERIFY(insertWatch(1, "a1", 8));
+        QCOMPARE(pathForWatch(8), QStringLiteral("/tmp/root/a1"));
+
+        removeWatchesBelow(1);
+        QCOMPARE(testWatchCount(), 0);
     }
 };
 
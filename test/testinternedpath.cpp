@@ -0,0 +1,151 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "internedpath.h"
+
+#include <thread>
+#include <vector>
+
+using namespace OCC;
+
+class TestInternedPath : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testRoundTrip_data()
+    {
+        QTest::addColumn<QString>("path");
+        QTest::newRow("empty") << QString();
+        QTest::newRow("name") << QStringLiteral("a");
+        QTest::newRow("relative") << QStringLiteral("a/b/c.txt");
+        QTest::newRow("absolute") << QStringLiteral("/home/user/Nextcloud/a");
+        QTest::newRow("windows") << QStringLiteral("C:/Users/user/Nextcloud");
+        QTest::newRow("trailing slash") << QStringLiteral("a/b/");
+        QTest::newRow("unicode") << QStringLiteral("ä/🙂/ö");
+    }
+
+    void testRoundTrip()
+    {
+        QFETCH(QString, path);
+        const auto interned = InternedPath::fromString(path);
+        QVERIFY(!interned.isNull());
+        QCOMPARE(interned.toString(), path);
+        QCOMPARE(InternedPath::fromString(path), interned);
+        QCOMPARE(InternedPath::find(path), interned);
+    }
+
+    void testStructure()
+    {
+        const auto file = InternedPath::fromString(QStringLiteral("structure/sub/file"));
+        const auto sub = InternedPath::fromString(QStringLiteral("structure/sub"));
+        const auto root = InternedPath();
+
+        QCOMPARE(file.name(), QStringLiteral("file"));
+        QCOMPARE(file.depth(), 3);
+        QCOMPARE(file.parent(), sub);
+        QCOMPARE(sub.child(QStringLiteral("file")), file);
+        QCOMPARE(sub.parent().parent(), root);
+        QVERIFY(root.isRoot());
+        QCOMPARE(root.parent(), root);
+        QCOMPARE(root.depth(), 0);
+
+        QVERIFY(sub.isAncestorOf(file));
+        QVERIFY(root.isAncestorOf(file));
+        QVERIFY(!file.isAncestorOf(sub));
+        QVERIFY(!file.isAncestorOf(file));
+        QVERIFY(!InternedPath::fromString(QStringLiteral("structure/other")).isAncestorOf(file));
+        QVERIFY(!InternedPath::fromString(QStringLiteral("structure/su")).isAncestorOf(file));
+    }
+
+    void testSharedStorage()
+    {
+        const auto pathsBefore = InternedPath::pathCount();
+        const auto namesBefore = InternedPath::nameCount();
+        QVector<InternedPath> paths;
+        for (int dir = 0; dir < 10; ++dir) {
+            for (int file = 0; file < 100; ++file) {
+                paths.append(InternedPath::fromString(QStringLiteral("shared/dir%1/file%2").arg(dir).arg(file)));
+            }
+        }
+        // One node per path, one name per distinct component
+        QCOMPARE(InternedPath::pathCount() - pathsBefore, quint32(1 + 10 + 1000));
+        QCOMPARE(InternedPath::nameCount() - namesBefore, quint32(1 + 10 + 100));
+    }
+
+    void testReleased()
+    {
+        const auto pathsBefore = InternedPath::pathCount();
+        const auto namesBefore = InternedPath::nameCount();
+        {
+            auto file = InternedPath::fromString(QStringLiteral("released/sub/file"));
+            const auto copy = file;
+            QCOMPARE(InternedPath::pathCount() - pathsBefore, quint32(3));
+
+            // The parent stays as long as a child does
+            const auto sub = file.parent();
+            file = InternedPath();
+            QCOMPARE(InternedPath::pathCount() - pathsBefore, quint32(3));
+            QCOMPARE(copy.toString(), QStringLiteral("released/sub/file"));
+            QVERIFY(sub.isAncestorOf(copy));
+        }
+        QCOMPARE(InternedPath::pathCount(), pathsBefore);
+        QCOMPARE(InternedPath::nameCount(), namesBefore);
+        QVERIFY(InternedPath::find(QStringLiteral("released/sub")).isNull());
+
+        // Many paths, which also gives the storage back
+        {
+            QVector<InternedPath> paths;
+            for (int i = 0; i < 100000; ++i) {
+                paths.append(InternedPath::fromString(QStringLiteral("released/dir%1/file%2").arg(i % 100).arg(i)));
+            }
+            QCOMPARE(InternedPath::pathCount() - pathsBefore, quint32(1 + 100 + 100000));
+        }
+        QCOMPARE(InternedPath::pathCount(), pathsBefore);
+        QCOMPARE(InternedPath::nameCount(), namesBefore);
+
+        // and the ids are used again
+        const auto again = InternedPath::fromString(QStringLiteral("released/again"));
+        QCOMPARE(again.toString(), QStringLiteral("released/again"));
+        QCOMPARE(InternedPath::pathCount() - pathsBefore, quint32(2));
+    }
+
+    void testFindDoesNotAdd()
+    {
+        const auto pathsBefore = InternedPath::pathCount();
+        QVERIFY(InternedPath::find(QStringLiteral("never/added")).isNull());
+        QCOMPARE(InternedPath::pathCount(), pathsBefore);
+        QVERIFY(InternedPath::find(QStringLiteral("never/added")).toString().isEmpty());
+    }
+
+    void testThreads()
+    {
+        std::vector<std::thread> threads;
+        std::vector<std::vector<InternedPath>> results(4);
+        for (int thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&results, thread] {
+                for (int i = 0; i < 1000; ++i) {
+                    results[thread].push_back(InternedPath::fromString(QStringLiteral("threads/dir%1/file%2").arg(i % 10).arg(i)));
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (int i = 0; i < 1000; ++i) {
+            QCOMPARE(results[1][i], results[0][i]);
+            QCOMPARE(results[3][i], results[2][i]);
+            QCOMPARE(results[0][i], results[3][i]);
+            QCOMPARE(results[0][i].toString(), QStringLiteral("threads/dir%1/file%2").arg(i % 10).arg(i));
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(TestInternedPath)
+#include "testinternedpath.moc"
@@ -0,0 +1,136 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QSemaphore>
+#include <QTemporaryDir>
+
+#include "logger.h"
+
+#include <atomic>
+
+using namespace OCC;
+
+namespace {
+
+void log(QtMsgType type, const QString &message)
+{
+    const QMessageLogContext ctx("testlogger.cpp", 1, "log", "nextcloud.test.logger");
+    Logger::instance()->doLog(type, ctx, message);
+}
+
+QString readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+}
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFlush()
+    {
+        QTemporaryDir dir;
+        const auto fileName = dir.filePath(QStringLiteral("flush.log"));
+        const auto logger = Logger::instance();
+        logger->setLogFile(fileName);
+        QVERIFY(logger->isLoggingToFile());
+
+        for (int i = 0; i < 1000; ++i) {
+            log(QtInfoMsg, QStringLiteral("flushed line %1").arg(i));
+        }
+        logger->flush();
+
+        // Everything logged before flush() is in the file
+        const auto content = readFile(fileName);
+        QVERIFY(content.contains(QStringLiteral("flushed line 0\n")));
+        QVERIFY(content.contains(QStringLiteral("flushed line 999\n")));
+        QCOMPARE(content.count(QStringLiteral("flushed line")), 1000);
+
+        logger->setLogFile(QString());
+    }
+
+    void testDroppedWhenFull()
+    {
+        const auto logger = Logger::instance();
+        logger->setLogFile(QString());
+        logger->flush();
+
+        // Hold the worker in the log window signal, so the queue fills up
+        QSemaphore workerBlocked;
+        QSemaphore releaseWorker;
+        std::atomic<bool> blockWorker{true};
+        QMutex linesMutex;
+        QStringList lines;
+        const auto connection = connect(logger, &Logger::logWindowLog, this, [&](const QString &line) {
+            {
+                QMutexLocker lock(&linesMutex);
+                lines.append(line);
+            }
+            if (blockWorker.exchange(false)) {
+                workerBlocked.release();
+                releaseWorker.acquire();
+            }
+        }, Qt::DirectConnection);
+
+        log(QtInfoMsg, QStringLiteral("blocking"));
+        QVERIFY(workerBlocked.tryAcquire(1, 10000));
+
+        constexpr auto lineCount = 20000;
+        const auto droppedBefore = logger->droppedLineCount();
+        for (int i = 0; i < lineCount; ++i) {
+            log(QtDebugMsg, QStringLiteral("filling %1").arg(i));
+        }
+        const auto dropped = logger->droppedLineCount() - droppedBefore;
+
+        releaseWorker.release();
+        logger->flush();
+        disconnect(connection);
+
+        // Verbose messages don't wait for room, the ones that didn't fit
+        // are counted and reported
+        QVERIFY(dropped > 0);
+        QVERIFY(dropped < lineCount);
+        QMutexLocker lock(&linesMutex);
+        QCOMPARE(quint64(lines.filter(QStringLiteral("filling ")).size()), lineCount - dropped);
+        QCOMPARE(lines.filter(QStringLiteral("%1 messages were dropped").arg(dropped)).size(), 1);
+    }
+
+    void testFatal()
+    {
+#ifdef Q_OS_WIN
+        QSKIP("A fatal message crashes the process on Windows");
+#else
+        QTemporaryDir dir;
+        const auto fileName = dir.filePath(QStringLiteral("fatal.log"));
+        const auto logger = Logger::instance();
+        logger->setLogFile(fileName);
+
+        for (int i = 0; i < 1000; ++i) {
+            log(QtDebugMsg, QStringLiteral("before fatal %1").arg(i));
+        }
+        log(QtFatalMsg, QStringLiteral("the fatal message"));
+
+        // The fatal message waits for everything before it to be written,
+        // and closes the log file, the process is about to end
+        QVERIFY(!logger->isLoggingToFile());
+        const auto content = readFile(fileName);
+        QCOMPARE(content.count(QStringLiteral("before fatal")), 1000);
+        QVERIFY(content.trimmed().endsWith(QStringLiteral("the fatal message")));
+#endif
+    }
+};
+
+QTEST_GUILESS_MAIN(TestLogger)
+#include "testlogger.moc"
@@ -0,0 +1,177 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "common/metrics.h"
+#include "syncenginetestutils.h"
+
+#include <thread>
+
+using namespace OCC;
+
+class TestMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testTextFormat()
+    {
+        MetricsRegistry registry;
+        registry.counter("test_requests", "Requests.").add(3);
+        registry.gauge("test_jobs", "Jobs.").set(-2);
+        auto &histogram = registry.histogram("test_duration_seconds", "Durations.", {0.1, 1});
+        histogram.observe(0.05);
+        histogram.observe(0.1);
+        histogram.observe(0.5);
+        histogram.observe(std::chrono::seconds(2));
+
+        const auto text = registry.toOpenMetrics();
+        QCOMPARE(text,
+            QByteArray("# TYPE test_duration_seconds histogram\n"
+                       "# HELP test_duration_seconds Durations.\n"
+                       "test_duration_seconds_bucket{le=\"0.1\"} 2\n"
+                       "test_duration_seconds_bucket{le=\"1\"} 3\n"
+                       "test_duration_seconds_bucket{le=\"+Inf\"} 4\n"
+                       "test_duration_seconds_count 4\n"
+                       "test_duration_seconds_sum 2.65\n"
+                       "# TYPE test_jobs gauge\n"
+                       "# HELP test_jobs Jobs.\n"
+                       "test_jobs -2\n"
+                       "# TYPE test_requests counter\n"
+                       "# HELP test_requests Requests.\n"
+                       "test_requests_total 3\n"
+                       "# EOF\n"));
+    }
+
+    void testLabels()
+    {
+        MetricsRegistry registry;
+        const auto get = MetricsRegistry::label("verb", "GET");
+        registry.counter("test_requests", "Requests.", get).add(2);
+        registry.counter("test_requests", "Requests.", MetricsRegistry::label("verb", "PUT")).add();
+        registry.histogram("test_duration_seconds", "Durations.", {1}, get).observe(0.5);
+
+        QCOMPARE(registry.toOpenMetrics(),
+            QByteArray("# TYPE test_duration_seconds histogram\n"
+                       "# HELP test_duration_seconds Durations.\n"
+                       "test_duration_seconds_bucket{verb=\"GET\",le=\"1\"} 1\n"
+                       "test_duration_seconds_bucket{verb=\"GET\",le=\"+Inf\"} 1\n"
+                       "test_duration_seconds_count{verb=\"GET\"} 1\n"
+                       "test_duration_seconds_sum{verb=\"GET\"} 0.5\n"
+                       "# TYPE test_requests counter\n"
+                       "# HELP test_requests Requests.\n"
+                       "test_requests_total{verb=\"GET\"} 2\n"
+                       "test_requests_total{verb=\"PUT\"} 1\n"
+                       "# EOF\n"));
+        QCOMPARE(MetricsRegistry::label("path", "a\"b\\c"), QByteArray("path=\"a\\\"b\\\\c\""));
+    }
+
+    void testSameNameSameMetric()
+    {
+        MetricsRegistry registry;
+        auto &first = registry.counter("test_counter", "A counter.");
+        auto &second = registry.counter("test_counter", "A counter.");
+        QCOMPARE(&first, &second);
+        first.add();
+        second.add(2);
+        QCOMPARE(first.value(), 3u);
+    }
+
+    void testConcurrentUpdates()
+    {
+        MetricsRegistry registry;
+        auto &counter = registry.counter("test_counter", "A counter.");
+        auto &histogram = registry.histogram("test_histogram", "A histogram.", {1});
+
+        constexpr auto threadCount = 4;
+        constexpr auto perThread = 10000;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < perThread; ++j) {
+                    counter.add();
+                    histogram.observe(0.5);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        QCOMPARE(counter.value(), quint64(threadCount * perThread));
+        QCOMPARE(histogram.count(), quint64(threadCount * perThread));
+        QCOMPARE(histogram.sum(), threadCount * perThread * 0.5);
+    }
+
+    void testWriteFile()
+    {
+        QTemporaryDir dir;
+        const auto fileName = dir.filePath(QStringLiteral("metrics.prom"));
+        MetricsRegistry registry;
+        registry.counter("test_counter", "A counter.").add();
+        QVERIFY(registry.writeOpenMetrics(fileName));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), registry.toOpenMetrics());
+    }
+
+    void testSyncIsCounted()
+    {
+        const auto syncRuns = SyncMetrics::syncRuns().value();
+        const auto uploadedBytes = SyncMetrics::uploadedBytes().value();
+        const auto propagatedItems = SyncMetrics::propagatedItems().value();
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.localModifier().insert(QStringLiteral("A/new"), 100);
+        QVERIFY(fakeFolder.syncOnce());
+
+        // The constructor of FakeFolder syncs once too
+        QCOMPARE(SyncMetrics::syncRuns().value(), syncRuns + 2);
+        QCOMPARE(SyncMetrics::uploadedBytes().value(), uploadedBytes + 100);
+        QVERIFY(SyncMetrics::propagatedItems().value() > propagatedItems);
+        QVERIFY(MetricsRegistry::instance().toOpenMetrics().contains("nextcloud_sync_runs_total"));
+    }
+
+    void testUploadedBytes_data()
+    {
+        QTest::addColumn<QVariantMap>("capabilities");
+        QTest::addColumn<qint64>("fileSize");
+
+        QTest::newRow("single request") << QVariantMap{} << qint64(100);
+        QTest::newRow("chunked") << QVariantMap{{QStringLiteral("chunking"), QStringLiteral("1.0")}} << qint64(3500 * 1000);
+        QTest::newRow("bulk") << QVariantMap{{QStringLiteral("bulkupload"), QStringLiteral("1.0")}} << qint64(100);
+    }
+
+    void testUploadedBytes()
+    {
+        QFETCH(QVariantMap, capabilities);
+        QFETCH(qint64, fileSize);
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.syncEngine().account()->setCapabilities({{QStringLiteral("dav"), capabilities}});
+        SyncOptions options;
+        options.setMinChunkSize(1000 * 1000);
+        options.setMaxChunkSize(1000 * 1000);
+        options._initialChunkSize = 1000 * 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        const auto uploadedBytes = SyncMetrics::uploadedBytes().value();
+        fakeFolder.localModifier().insert(QStringLiteral("A/new1"), fileSize);
+        fakeFolder.localModifier().insert(QStringLiteral("A/new2"), fileSize);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Every byte counts once, when the server acknowledged it
+        QCOMPARE(SyncMetrics::uploadedBytes().value(), uploadedBytes + 2 * fileSize);
+        QCOMPARE(SyncMetrics::activeJobs().value(), qint64(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMetrics)
+#include "testmetrics.moc"
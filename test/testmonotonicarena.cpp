@@ -0,0 +1,78 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "monotonicarena.h"
+
+#include <cstdint>
+#include <map>
+
+using namespace OCC;
+
+class TestMonotonicArena : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAlignment()
+    {
+        MonotonicArena arena;
+        for (const std::size_t alignment : {1, 2, 8, 16, 64}) {
+            // Odd sizes before, so the next allocation has to be aligned
+            Q_UNUSED(arena.allocate(3, 1));
+            const auto address = reinterpret_cast<std::uintptr_t>(arena.allocate(5, alignment));
+            QCOMPARE(address % alignment, std::uintptr_t(0));
+        }
+        QCOMPARE(arena.allocationCount(), quint64(10));
+        QCOMPARE(arena.bytesAllocated(), quint64(40));
+    }
+
+    void testBlocks()
+    {
+        MonotonicArena arena(1024);
+        QCOMPARE(arena.bytesReserved(), quint64(0));
+
+        auto first = static_cast<char *>(arena.allocate(100, 1));
+        auto second = static_cast<char *>(arena.allocate(100, 1));
+        QCOMPARE(second, first + 100);
+        const auto reserved = arena.bytesReserved();
+        QVERIFY(reserved >= 1024);
+
+        // Larger than any block: gets a block of its own
+        const auto big = MonotonicArena::maxBlockSize * 2;
+        memset(arena.allocate(big), 1, big);
+        QVERIFY(arena.bytesReserved() >= reserved + big);
+
+        arena.release();
+        QCOMPARE(arena.allocationCount(), quint64(0));
+        QCOMPARE(arena.bytesAllocated(), quint64(0));
+        QCOMPARE(arena.bytesReserved(), quint64(0));
+        QVERIFY(arena.allocate(8));
+    }
+
+    void testContainer()
+    {
+        MonotonicArena arena;
+        using Map = std::map<QString, int, std::less<QString>, ArenaAllocator<std::pair<const QString, int>>>;
+        {
+            Map map{ArenaAllocator<Map::value_type>(&arena)};
+            for (int i = 0; i < 10000; ++i) {
+                map[QString::number(i)] = i;
+            }
+            map.erase(QStringLiteral("42"));
+            QCOMPARE(map.size(), std::size_t(9999));
+            QCOMPARE(map.at(QStringLiteral("4711")), 4711);
+            QVERIFY(map.find(QStringLiteral("42")) == map.end());
+        }
+        // One allocation per node
+        QCOMPARE(arena.allocationCount(), quint64(10000));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMonotonicArena)
+#include "testmonotonicarena.moc"
@@ -0,0 +1,104 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "mpscringbuffer.h"
+
+#include <thread>
+#include <vector>
+
+using namespace OCC;
+
+class TestMpscRingBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testCapacity()
+    {
+        QCOMPARE(MpscRingBuffer<int>(1).capacity(), std::size_t(2));
+        QCOMPARE(MpscRingBuffer<int>(8).capacity(), std::size_t(8));
+        QCOMPARE(MpscRingBuffer<int>(9).capacity(), std::size_t(16));
+    }
+
+    void testFifo()
+    {
+        MpscRingBuffer<QString> buffer(4);
+        QVERIFY(buffer.isEmpty());
+        for (int i = 0; i < 4; ++i) {
+            QVERIFY(buffer.tryPush(QString::number(i)));
+        }
+        QCOMPARE(buffer.size(), std::size_t(4));
+
+        // Full: the value isn't taken
+        auto value = QStringLiteral("extra");
+        QVERIFY(!buffer.tryPush(std::move(value)));
+        QCOMPARE(value, QStringLiteral("extra"));
+
+        QString popped;
+        QVERIFY(buffer.tryPop(popped));
+        QCOMPARE(popped, QStringLiteral("0"));
+        QVERIFY(buffer.tryPush(std::move(value)));
+
+        for (const auto expected : {"1", "2", "3", "extra"}) {
+            QVERIFY(buffer.tryPop(popped));
+            QCOMPARE(popped, QString::fromLatin1(expected));
+        }
+        QVERIFY(buffer.isEmpty());
+        QVERIFY(!buffer.tryPop(popped));
+        QCOMPARE(buffer.pushCount(), std::size_t(5));
+        QCOMPARE(buffer.popCount(), std::size_t(5));
+    }
+
+    void testManyProducers()
+    {
+        constexpr int producerCount = 4;
+        constexpr int valuesPerProducer = 100000;
+        MpscRingBuffer<int> buffer(64);
+
+        std::vector<std::thread> producers;
+        for (int producer = 0; producer < producerCount; ++producer) {
+            producers.emplace_back([&buffer, producer] {
+                for (int i = 0; i < valuesPerProducer; ++i) {
+                    while (!buffer.tryPush(producer * valuesPerProducer + i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        // Every value arrives once, and in order for each producer. Only
+        // checked once the producers are joined: a failing QCOMPARE returns
+        // right away, and destroying a joinable thread terminates the test.
+        QVector<int> next(producerCount, 0);
+        int outOfOrder = 0;
+        int received = 0;
+        while (received < producerCount * valuesPerProducer) {
+            int value = 0;
+            if (!buffer.tryPop(value)) {
+                std::this_thread::yield();
+                continue;
+            }
+            const auto producer = value / valuesPerProducer;
+            if (value % valuesPerProducer != next[producer]) {
+                ++outOfOrder;
+            }
+            next[producer] = value % valuesPerProducer + 1;
+            ++received;
+        }
+        for (auto &producerThread : producers) {
+            producerThread.join();
+        }
+        QCOMPARE(outOfOrder, 0);
+        QCOMPARE(next, QVector<int>(producerCount, valuesPerProducer));
+        QVERIFY(buffer.isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMpscRingBuffer)
+#include "testmpscringbuffer.moc"
@@ -9,6 +9,7 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 #include <localdiscoverytracker.h>
+#include <networkjobs.h>
 
 using namespace OCC;
 
@@ -178,6 +179,301 @@ private slots:
         QVERIFY(completeSpy.findItem("nofileid")->_errorString.contains("file id"));
         QVERIFY(completeSpy.findItem("nopermissions/A")->_errorString.contains("permission"));
     }
+
+    // Check that with sync tokens only the folders containing remote changes are listed
+    void testSyncCollection()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.remoteModifier().mkdir("A/X");
+        fakeFolder.remoteModifier().mkdir("A/X/Y");
+        fakeFolder.remoteModifier().insert("A/X/Y/y1");
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList propfinds;
+        int reports = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            const auto verb = req.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            if (verb == QLatin1String("PROPFIND")) {
+                propfinds.append(getFilePathFromUrl(req.url()));
+            } else if (verb == QLatin1String("REPORT")) {
+                ++reports;
+            }
+            return nullptr;
+        });
+
+        // The first sync with support only fetches a token
+        fakeFolder.fakeQnam()->setSyncCollectionSupported(true);
+        fakeFolder.remoteModifier().insert("B/b3");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(reports, 0);
+        QVERIFY(propfinds.contains("B"));
+        QVERIFY(!fakeFolder.syncJournal().syncToken().isEmpty());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A deep change only lists the folders leading to it, not their siblings
+        propfinds.clear();
+        fakeFolder.remoteModifier().insert("A/X/Y/y2");
+        fakeFolder.remoteModifier().appendByte("A/X/Y/y1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(reports, 1);
+        QCOMPARE(propfinds, QStringList({"", "A", "A/X", "A/X/Y"}));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // New folders are listed in full, removed entries are found in their parent
+        propfinds.clear();
+        fakeFolder.remoteModifier().mkdir("C/N");
+        fakeFolder.remoteModifier().mkdir("C/N/M");
+        fakeFolder.remoteModifier().insert("C/N/M/m1");
+        fakeFolder.remoteModifier().remove("B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(reports, 2);
+        QVERIFY(propfinds.contains("C/N/M"));
+        QVERIFY(propfinds.contains("B"));
+        QVERIFY(!propfinds.contains("A"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Nothing changed: only the root is listed
+        propfinds.clear();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(reports, 3);
+        QCOMPARE(propfinds, QStringList({""}));
+
+        // An unknown token falls back to comparing etags
+        propfinds.clear();
+        fakeFolder.fakeQnam()->clearSyncTokens();
+        fakeFolder.remoteModifier().appendByte("A/a1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(reports, 4);
+        QVERIFY(propfinds.contains("A"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.syncJournal().syncToken().isEmpty());
+    }
+
+    // A known folder that changed itself is updated from its parent's listing
+    void testSyncCollectionFolderPermissions()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.remoteModifier().mkdir("A/X");
+        fakeFolder.remoteModifier().insert("A/X/x1");
+        fakeFolder.fakeQnam()->setSyncCollectionSupported(true);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.syncJournal().syncToken().isEmpty());
+
+        const auto permissions = RemotePermissions::fromServerString(QStringLiteral("SDNVCK"));
+        auto folder = fakeFolder.remoteModifier().find("A/X");
+        QVERIFY(folder);
+        folder->permissions = permissions;
+        folder->etag = generateEtag();
+        fakeFolder.remoteModifier().find("A")->etag = generateEtag();
+        QVERIFY(fakeFolder.syncOnce());
+
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("A/X"), &record) && record.isValid());
+        QCOMPARE(record._remotePerm, permissions);
+    }
+
+    // Items that failed are reported again by the next sync
+    void testSyncCollectionRetriesFailedItems()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.fakeQnam()->setSyncCollectionSupported(true);
+        QVERIFY(fakeFolder.syncOnce());
+        const auto syncToken = fakeFolder.syncJournal().syncToken();
+        QVERIFY(!syncToken.isEmpty());
+
+        fakeFolder.remoteModifier().mkdir("A/X");
+        fakeFolder.remoteModifier().insert("A/X/x1");
+        fakeFolder.serverErrorPaths().append("A/X/x1");
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.syncJournal().syncToken(), syncToken);
+
+        // Skipped as blacklisted, that doesn't move the token either
+        fakeFolder.syncOnce();
+        QCOMPARE(fakeFolder.syncJournal().syncToken(), syncToken);
+
+        fakeFolder.serverErrorPaths().clear();
+        QVERIFY(fakeFolder.syncJournal().wipeErrorBlacklist() != -1);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.syncJournal().syncToken() != syncToken);
+    }
+
+    // Folders scheduled for remote discovery are listed despite the change set
+    void testSyncCollectionScheduledDiscovery()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.fakeQnam()->setSyncCollectionSupported(true);
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.syncJournal().syncToken().isEmpty());
+
+        // A change the server doesn't report is not found
+        fakeFolder.remoteModifier().insert("B/b3");
+        fakeFolder.syncJournal().setSyncToken(fakeFolder.fakeQnam()->issueSyncToken());
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(!fakeFolder.currentLocalState().find("B/b3"));
+
+        fakeFolder.syncJournal().schedulePathForRemoteDiscovery(QStringLiteral("B"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testSyncCollectionParser()
+    {
+        const QByteArray xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+            "<d:multistatus xmlns:d=\"DAV:\">"
+            "<d:response><d:href>/remote.php/dav/files/admin/sync/A/a%201</d:href>"
+            "<d:propstat><d:prop><d:getetag>\"1\"</d:getetag><d:resourcetype/></d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+            "<d:response><d:href>/remote.php/dav/files/admin/sync/B/</d:href>"
+            "<d:propstat><d:prop><d:getetag>\"2\"</d:getetag><d:resourcetype><d:collection/></d:resourcetype></d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+            "<d:response><d:href>/remote.php/dav/files/admin/sync/C</d:href><d:status>HTTP/1.1 404 Not Found</d:status></d:response>"
+            "<d:sync-token>http://example.com/sync/2</d:sync-token>"
+            "</d:multistatus>";
+
+        QVector<SyncCollectionJob::Change> changes;
+        QByteArray syncToken;
+        QVERIFY(SyncCollectionJob::parse(xml, "/remote.php/dav/files/admin/sync/", &changes, &syncToken));
+        QCOMPARE(syncToken, QByteArray("http://example.com/sync/2"));
+        QCOMPARE(changes.size(), 3);
+        QCOMPARE(changes[0].path, QString("A/a 1"));
+        QVERIFY(!changes[0].isDirectory && !changes[0].isRemoved);
+        QCOMPARE(changes[1].path, QString("B"));
+        QVERIFY(changes[1].isDirectory && !changes[1].isRemoved);
+        QCOMPARE(changes[2].path, QString("C"));
+        QVERIFY(changes[2].isRemoved);
+
+        // Changes outside of the requested collection are an error
+        changes.clear();
+        QVERIFY(!SyncCollectionJob::parse(xml, "/remote.php/dav/files/admin/sync/A", &changes, &syncToken));
+
+        // So are truncated results
+        const QByteArray truncated = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+            "<d:multistatus xmlns:d=\"DAV:\">"
+            "<d:response><d:href>/remote.php/dav/files/admin/sync/</d:href><d:status>HTTP/1.1 507 Insufficient Storage</d:status></d:response>"
+            "<d:sync-token>http://example.com/sync/3</d:sync-token>"
+            "</d:multistatus>";
+        QVERIFY(!SyncCollectionJob::parse(truncated, "/remote.php/dav/files/admin/sync/", &changes, &syncToken));
+    }
+
+    void testDepthInfinity()
+    {
+        // The sync in the constructor found the server rejecting Depth:infinity
+        FakeFolder fakeFolder{FileInfo{}};
+        QVERIFY(!fakeFolder.account()->isDepthInfinityPropfindSupported());
+        fakeFolder.fakeQnam()->setDepthInfinitySupported(true);
+        fakeFolder.account()->setDepthInfinityPropfindSupported(true);
+
+        QStringList propfinds;
+        QStringList depthInfinityPropfinds;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QLatin1String("PROPFIND")) {
+                const auto path = getFilePathFromUrl(req.url());
+                (req.rawHeader("Depth") == "infinity" ? depthInfinityPropfinds : propfinds).append(path);
+            }
+            return nullptr;
+        });
+
+        // The initial sync lists the whole tree at once
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().insert("A/a1");
+        fakeFolder.remoteModifier().mkdir("A/X");
+        fakeFolder.remoteModifier().mkdir("A/X/Y");
+        fakeFolder.remoteModifier().insert("A/X/Y/y1");
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().insert("c1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, QStringList({""}));
+        QCOMPARE(propfinds, QStringList());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Later syncs list new remote folders at once
+        propfinds.clear();
+        depthInfinityPropfinds.clear();
+        fakeFolder.remoteModifier().mkdir("B/N");
+        fakeFolder.remoteModifier().mkdir("B/N/M");
+        fakeFolder.remoteModifier().insert("B/N/M/m1");
+        fakeFolder.remoteModifier().insert("B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, QStringList({"B/N"}));
+        QVERIFY(propfinds.contains("B"));
+        QVERIFY(!propfinds.contains("B/N/M"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Selective sync keeps the excluded folders out of the request
+        depthInfinityPropfinds.clear();
+        fakeFolder.syncEngine().journal()->setSelectiveSyncList(SyncJournalDb::SelectiveSyncBlackList, {"C/S/"});
+        fakeFolder.remoteModifier().mkdir("C");
+        fakeFolder.remoteModifier().mkdir("C/S");
+        fakeFolder.remoteModifier().insert("C/S/s1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, QStringList());
+        QVERIFY(!fakeFolder.currentLocalState().find("C/S"));
+    }
+
+    void testDepthInfinityFallback()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.account()->setDepthInfinityPropfindSupported(true);
+
+        int depthInfinityPropfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QLatin1String("PROPFIND") && req.rawHeader("Depth") == "infinity") {
+                ++depthInfinityPropfinds;
+            }
+            return nullptr;
+        });
+
+        // The rejected request is repeated with Depth:1
+        fakeFolder.remoteModifier().mkdir("A/N");
+        fakeFolder.remoteModifier().mkdir("A/N/M");
+        fakeFolder.remoteModifier().insert("A/N/M/m1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, 1);
+        QVERIFY(!fakeFolder.account()->isDepthInfinityPropfindSupported());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // and not attempted again
+        fakeFolder.remoteModifier().mkdir("B/N");
+        fakeFolder.remoteModifier().insert("B/N/n1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testDepthInfinityDowngraded()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.fakeQnam()->setDepthInfinityDowngraded(true);
+        fakeFolder.account()->setDepthInfinityPropfindSupported(true);
+
+        int depthInfinityPropfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QLatin1String("PROPFIND") && req.rawHeader("Depth") == "infinity") {
+                ++depthInfinityPropfinds;
+            }
+            return nullptr;
+        });
+
+        // The reply has the subfolders of A but not their contents, they must still be synced
+        fakeFolder.remoteModifier().mkdir("A");
+        fakeFolder.remoteModifier().insert("A/a1");
+        fakeFolder.remoteModifier().mkdir("A/X");
+        fakeFolder.remoteModifier().insert("A/X/x1");
+        fakeFolder.remoteModifier().mkdir("A/X/Y");
+        fakeFolder.remoteModifier().insert("A/X/Y/y1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, 1);
+        QVERIFY(!fakeFolder.account()->isDepthInfinityPropfindSupported());
+        QVERIFY(fakeFolder.currentLocalState().find("A/X/Y/y1"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // and not attempted again
+        fakeFolder.remoteModifier().mkdir("B");
+        fakeFolder.remoteModifier().mkdir("B/N");
+        fakeFolder.remoteModifier().insert("B/N/n1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(depthInfinityPropfinds, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestRemoteDiscovery)
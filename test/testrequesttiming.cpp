@@ -0,0 +1,183 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "requesttiming.h"
+#include "common/metrics.h"
+#include "syncenginetestutils.h"
+
+using namespace OCC;
+
+namespace {
+
+// A reply whose signals the test emits by hand
+class TimedReply : public FakeReply
+{
+    Q_OBJECT
+public:
+    TimedReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+        : FakeReply(parent)
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+    }
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+};
+
+QNetworkRequest davRequest(const QString &path)
+{
+    return QNetworkRequest(QUrl(QStringLiteral("https://cloud.example.com/remote.php/dav/files/admin/") + path));
+}
+
+}
+
+class TestRequestTiming : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEndpoint_data()
+    {
+        QTest::addColumn<QByteArray>("verb");
+        QTest::addColumn<QString>("url");
+        QTest::addColumn<RequestTiming::Endpoint>("endpoint");
+
+        QTest::newRow("get") << QByteArray("GET") << "https://c.example.com/remote.php/dav/files/admin/A/a1" << RequestTiming::Endpoint::DavFile;
+        QTest::newRow("put webdav") << QByteArray("PUT") << "https://c.example.com/remote.php/webdav/A/a1" << RequestTiming::Endpoint::DavFile;
+        QTest::newRow("propfind") << QByteArray("PROPFIND") << "https://c.example.com/remote.php/dav/files/admin/A" << RequestTiming::Endpoint::DavDirectory;
+        QTest::newRow("mkcol") << QByteArray("MKCOL") << "https://c.example.com/nc/remote.php/dav/files/admin/B" << RequestTiming::Endpoint::DavDirectory;
+        QTest::newRow("chunk") << QByteArray("PUT") << "https://c.example.com/remote.php/dav/uploads/admin/123/00001" << RequestTiming::Endpoint::Chunk;
+        QTest::newRow("ocs") << QByteArray("GET") << "https://c.example.com/ocs/v2.php/cloud/capabilities" << RequestTiming::Endpoint::Ocs;
+        QTest::newRow("status") << QByteArray("GET") << "https://c.example.com/status.php" << RequestTiming::Endpoint::Other;
+    }
+
+    void testEndpoint()
+    {
+        QFETCH(QByteArray, verb);
+        QFETCH(QString, url);
+        QFETCH(RequestTiming::Endpoint, endpoint);
+        QCOMPARE(RequestTiming::endpointFor(verb, QUrl(url)), endpoint);
+    }
+
+    void testNewConnection()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
+        QSKIP("QNetworkReply reports the connection and the sent request since Qt 6.3");
+#else
+        QObject context;
+        TimedReply reply(QNetworkAccessManager::PutOperation, davRequest(QStringLiteral("A/a1")), nullptr);
+        RequestTiming timing;
+        timing.start(&reply, &context);
+        QCOMPARE(timing.verb(), QByteArray("PUT"));
+        QCOMPARE(timing.endpoint(), RequestTiming::Endpoint::DavFile);
+
+        QTest::qSleep(2);
+        emit reply.socketStartedConnecting();
+        QTest::qSleep(2);
+        emit reply.uploadProgress(100, 200);
+        emit reply.uploadProgress(200, 200);
+        emit reply.requestSent();
+        QTest::qSleep(2);
+        emit reply.metaDataChanged();
+        emit reply.downloadProgress(50, 50);
+        timing.finish();
+        QVERIFY(timing.isFinished());
+
+        auto sum = std::chrono::nanoseconds(0);
+        for (int phase = 0; phase < RequestTiming::PhaseCount; ++phase) {
+            const auto duration = timing.duration(static_cast<RequestTiming::Phase>(phase));
+            QVERIFY2(duration.count() >= 0, RequestTiming::phaseName(static_cast<RequestTiming::Phase>(phase)));
+            sum += duration;
+        }
+        QCOMPARE(sum.count(), timing.total().count());
+        QVERIFY(timing.duration(RequestTiming::Queued) >= std::chrono::milliseconds(2));
+        QVERIFY(timing.duration(RequestTiming::Connect) >= std::chrono::milliseconds(2));
+        QVERIFY(timing.duration(RequestTiming::Wait) >= std::chrono::milliseconds(2));
+        QCOMPARE(timing.bytesSent(), qint64(200));
+        QCOMPARE(timing.bytesReceived(), qint64(50));
+#endif
+    }
+
+    void testReusedConnection()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
+        QSKIP("QNetworkReply reports the connection and the sent request since Qt 6.3");
+#else
+        QObject context;
+        TimedReply reply(QNetworkAccessManager::GetOperation, davRequest(QStringLiteral("A/a1")), nullptr);
+        RequestTiming timing;
+        timing.start(&reply, &context);
+        emit reply.requestSent();
+        emit reply.metaDataChanged();
+        timing.finish();
+
+        QVERIFY(timing.duration(RequestTiming::Connect).count() < 0);
+        QVERIFY(timing.duration(RequestTiming::Queued).count() >= 0);
+        QVERIFY(timing.duration(RequestTiming::Send).count() == 0);
+        QVERIFY(timing.duration(RequestTiming::Wait).count() >= 0);
+        QVERIFY(timing.duration(RequestTiming::Transfer).count() >= 0);
+        QVERIFY(!timing.toString().contains(QStringLiteral("connect")));
+#endif
+    }
+
+    void testRedirectStartsOver()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
+        QSKIP("QNetworkReply reports the connection and the sent request since Qt 6.3");
+#else
+        QObject context;
+        TimedReply first(QNetworkAccessManager::GetOperation, davRequest(QStringLiteral("A/a1")), nullptr);
+        TimedReply second(QNetworkAccessManager::GetOperation, davRequest(QStringLiteral("A/a2")), nullptr);
+        RequestTiming timing;
+        timing.start(&first, &context);
+        emit first.requestSent();
+        emit first.metaDataChanged();
+        timing.start(&second, &context);
+
+        // Late signals of the first reply don't count for the second
+        emit first.downloadProgress(1000, 1000);
+        QCOMPARE(timing.bytesReceived(), qint64(0));
+        QVERIFY(timing.duration(RequestTiming::Wait).count() < 0);
+        emit second.requestSent();
+        emit second.metaDataChanged();
+        QVERIFY(timing.duration(RequestTiming::Wait).count() >= 0);
+#endif
+    }
+
+    void testRecordMetrics()
+    {
+#if QT_VERSION < QT_VERSION_CHECK(6, 3, 0)
+        QSKIP("QNetworkReply reports the connection and the sent request since Qt 6.3");
+#else
+        QObject context;
+        auto request = davRequest(QStringLiteral("A"));
+        request.setAttribute(QNetworkRequest::CustomVerbAttribute, QByteArray("PROPFIND"));
+        TimedReply reply(QNetworkAccessManager::CustomOperation, request, nullptr);
+        RequestTiming timing;
+        timing.start(&reply, &context);
+        emit reply.requestSent();
+        emit reply.metaDataChanged();
+        emit reply.downloadProgress(300, 300);
+        timing.finish();
+        timing.recordMetrics();
+
+        const auto metrics = MetricsRegistry::instance().toOpenMetrics();
+        QVERIFY(metrics.contains(R"(nextcloud_http_request_phase_seconds_count{verb="PROPFIND",endpoint="dav_directory",phase="wait"} 1)"));
+        QVERIFY(metrics.contains(R"(nextcloud_http_request_duration_seconds_count{verb="PROPFIND",endpoint="dav_directory"} 1)"));
+        QVERIFY(metrics.contains(R"(nextcloud_http_received_bytes_total{verb="PROPFIND",endpoint="dav_directory"} 300)"));
+        QVERIFY(!metrics.contains(R"(phase="connect")"));
+#endif
+    }
+};
+
+QTEST_GUILESS_MAIN(TestRequestTiming)
+#include "testrequesttiming.moc"
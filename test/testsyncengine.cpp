@@ -587,6 +587,25 @@ private slots:
         QVERIFY(fakeFolder.syncOnce());
     }
 
+    // The encrypted name of an item is cleared once the server no longer reports it
+    void testStaleEncryptedNameIsCleared()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+
+        // The db still knows a mangled name the server doesn't report anymore
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/a1"), &record) && record.isValid());
+        record._e2eMangledName = "A/0123456789abcdef";
+        QVERIFY(fakeFolder.syncJournal().setFileRecord(record));
+
+        fakeFolder.remoteModifier().appendByte("A/a1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/a1"), &record) && record.isValid());
+        QVERIFY(record._e2eMangledName.isEmpty());
+    }
+
     /**
      * Checks whether subsequent large uploads are skipped after a 507 error
      */
@@ -1979,6 +1998,175 @@ private slots:
         QCOMPARE(fakeFolder.remoteModifier().find("folder2"), nullptr);
         QCOMPARE(fakeFolder.remoteModifier().find("file1"), nullptr);
     }
+
+    void testHttp2StreamBudget()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.remoteModifier().insert("keep");
+        for (int i = 0; i < 30; ++i) {
+            fakeFolder.remoteModifier().insert(QStringLiteral("file%1").arg(i));
+        }
+        QVERIFY(fakeFolder.syncOnce());
+
+        int inFlight = 0;
+        int maxInFlight = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toString() != QLatin1String("DELETE")
+                && op != QNetworkAccessManager::DeleteOperation) {
+                return nullptr;
+            }
+            auto reply = new DelayedReply<FakeDeleteReply>(200, fakeFolder.remoteModifier(), op, request, &fakeFolder.syncEngine());
+            maxInFlight = qMax(maxInFlight, ++inFlight);
+            connect(reply, &QNetworkReply::finished, this, [&inFlight] { --inFlight; });
+            return reply;
+        });
+        const auto removeFiles = [&fakeFolder] {
+            for (int i = 0; i < 30; ++i) {
+                fakeFolder.localModifier().remove(QStringLiteral("file%1").arg(i));
+            }
+        };
+        const auto restoreFiles = [&fakeFolder] {
+            for (int i = 0; i < 30; ++i) {
+                fakeFolder.remoteModifier().insert(QStringLiteral("file%1").arg(i));
+            }
+        };
+
+        // Over HTTP/1.1 the requests are limited to the number of connections
+        removeFiles();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(maxInFlight <= 6);
+
+        // Over HTTP/2 they may use many more streams
+        restoreFiles();
+        QVERIFY(fakeFolder.syncOnce());
+        fakeFolder.account()->setHttp2Supported(true);
+        maxInFlight = 0;
+        removeFiles();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(maxInFlight > 6);
+
+        // and are still limited by the stream budget
+        restoreFiles();
+        QVERIFY(fakeFolder.syncOnce());
+        auto syncOptions = fakeFolder.syncEngine().syncOptions();
+        syncOptions._http2StreamBudget = 8;
+        fakeFolder.syncEngine().setSyncOptions(syncOptions);
+        maxInFlight = 0;
+        removeFiles();
+        QVERIFY(fakeFolder.syncOnce());
+        QVERIFY(maxInFlight <= 8);
+    }
+
+    void testDirectoriesCreatedAheadOfUploads()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.localModifier().mkdir("A");
+        for (int i = 0; i < 3; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/big%1").arg(i), 200 * 1000);
+        }
+        fakeFolder.localModifier().mkdir("A/S");
+        fakeFolder.localModifier().mkdir("A/S/T");
+        fakeFolder.localModifier().mkdir("A/S/T/U");
+        fakeFolder.localModifier().insert("A/S/T/U/file");
+
+        int runningUploads = 0;
+        QStringList mkcolsDuringUploads;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            const auto path = getFilePathFromUrl(request.url());
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute).toString() == QLatin1String("MKCOL") && runningUploads > 0) {
+                mkcolsDuringUploads.append(path);
+            }
+            if (op != QNetworkAccessManager::PutOperation || !path.contains(QLatin1String("big"))) {
+                return nullptr;
+            }
+            // Keep the transfer slots busy
+            auto reply = new DelayedReply<FakePutReply>(300, fakeFolder.remoteModifier(), op, request, outgoingData->readAll(), &fakeFolder.syncEngine());
+            ++runningUploads;
+            connect(reply, &QNetworkReply::finished, this, [&runningUploads] { --runningUploads; });
+            return reply;
+        });
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        // The new directories didn't wait for the uploads
+        QVERIFY(mkcolsDuringUploads.contains("A/S/T"));
+        QVERIFY(mkcolsDuringUploads.contains("A/S/T/U"));
+    }
+
+    void testManyRemoteDeletesAndMoves()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.localModifier().mkdir("A");
+        fakeFolder.localModifier().mkdir("B");
+        for (int i = 0; i < 250; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/file%1").arg(i));
+        }
+        QVERIFY(fakeFolder.syncOnce());
+
+        // More items than fit in one journal batch
+        for (int i = 0; i < 250; ++i) {
+            if (i % 2) {
+                fakeFolder.localModifier().rename(QStringLiteral("A/file%1").arg(i), QStringLiteral("B/file%1").arg(i));
+            } else {
+                fakeFolder.localModifier().remove(QStringLiteral("A/file%1").arg(i));
+            }
+        }
+        const auto commitsBefore = SyncMetrics::journalCommitDuration().count();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A commit per batch, not per item, next to the few commits every sync makes
+        QVERIFY(SyncMetrics::journalCommitDuration().count() - commitsBefore < 50);
+
+        for (int i = 0; i < 250; ++i) {
+            SyncJournalFileRecord record;
+            QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("A/file%1").arg(i), &record));
+            QVERIFY(!record.isValid());
+            QVERIFY(fakeFolder.syncJournal().getFileRecord(QStringLiteral("B/file%1").arg(i), &record));
+            QCOMPARE(record.isValid(), i % 2 == 1);
+        }
+    }
+
+    void testBatchedJournalChangesCommittedAfterDelay()
+    {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.localModifier().remove("A/a1");
+        fakeFolder.localModifier().insert("B/new");
+
+        // The upload keeps the propagation running. The delete finishes after
+        // the upload started, which commits the journal too.
+        QObject parent;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation && request.url().path().endsWith("B/new")) {
+                return new FakeHangingReply(op, request, &parent);
+            }
+            if (op == QNetworkAccessManager::DeleteOperation) {
+                return new DelayedReply<FakeDeleteReply>(500, fakeFolder.remoteModifier(), op, request, &parent);
+            }
+            return nullptr;
+        });
+
+        quint64 commitsAtDelete = 0;
+        QElapsedTimer sinceDelete;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&](const SyncFileItemPtr &item) {
+            if (item->_file == QLatin1String("A/a1")) {
+                commitsAtDelete = SyncMetrics::journalCommitDuration().count();
+                sinceDelete.start();
+            }
+        });
+
+        // The delete alone doesn't fill a batch, it is committed once the delay passed
+        fakeFolder.scheduleSync();
+        QTRY_VERIFY(sinceDelete.isValid());
+        QTRY_VERIFY_WITH_TIMEOUT(SyncMetrics::journalCommitDuration().count() > commitsAtDelete, 5000);
+        QVERIFY(sinceDelete.elapsed() >= 900);
+        QVERIFY(fakeFolder.syncEngine().isSyncRunning());
+
+        fakeFolder.syncEngine().abort();
+        QVERIFY(!fakeFolder.execUntilFinished());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
@@ -69,6 +69,24 @@ private slots:
         QVERIFY(!(b < b));
         QVERIFY(!(c < c));
     }
+
+    void testDetails() {
+        auto item = createItem(QStringLiteral("a/b"));
+        QVERIFY(!item.hasDetails());
+        QVERIFY(item.details()._lockOwnerId.isEmpty());
+        QCOMPARE(item.details()._lockOwnerType, SyncFileItem::LockOwnerType::UserLock);
+        QVERIFY(!item.hasDetails());
+
+        item.mutableDetails()._lockOwnerId = QStringLiteral("alice");
+        QVERIFY(item.hasDetails());
+
+        // copies share the details until one of them changes them
+        auto copy = item;
+        QCOMPARE(&copy.details(), &item.details());
+        copy.mutableDetails()._lockOwnerId = QStringLiteral("bob");
+        QCOMPARE(item.details()._lockOwnerId, QStringLiteral("alice"));
+        QCOMPARE(copy.details()._lockOwnerId, QStringLiteral("bob"));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestSyncFileItem)
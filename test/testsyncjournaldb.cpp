@@ -94,6 +94,56 @@ private slots:
         QVERIFY(!record.isValid());
     }
 
+    void testGetFileRecords()
+    {
+        QByteArrayList paths;
+        for (int i = 0; i < 100; ++i) {
+            SyncJournalFileRecord record;
+            record._path = "batch/file" + QByteArray::number(i);
+            record._type = ItemTypeFile;
+            record._fileSize = i;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(_db.setFileRecord(record));
+            paths.append(record._path);
+        }
+        paths.append("batch/nonexistent");
+
+        QHash<QByteArray, qint64> found;
+        QVERIFY(_db.getFileRecords(paths, [&](const SyncJournalFileRecord &record) {
+            found.insert(record._path, record._fileSize);
+        }));
+        QCOMPARE(found.size(), 100);
+        QCOMPARE(found.value("batch/file0"), 0);
+        QCOMPARE(found.value("batch/file99"), 99);
+
+        found.clear();
+        QVERIFY(_db.getFileRecords({"batch/file7"}, [&](const SyncJournalFileRecord &record) {
+            found.insert(record._path, record._fileSize);
+        }));
+        QCOMPARE(found.size(), 1);
+        QCOMPARE(found.value("batch/file7"), 7);
+    }
+
+    void testLocalDiscoveryPaths()
+    {
+        bool ok = false;
+        QVERIFY(_db.getLocalDiscoveryPaths(&ok).isEmpty());
+        QVERIFY(ok);
+
+        _db.addLocalDiscoveryPaths({"A/a1", "A/a2"});
+        _db.addLocalDiscoveryPaths({"A/a2", "B"});
+        auto paths = _db.getLocalDiscoveryPaths(&ok);
+        QVERIFY(ok);
+        paths.sort();
+        QCOMPARE(paths, QStringList({"A/a1", "A/a2", "B"}));
+
+        _db.setLocalDiscoveryPaths({"C"});
+        QCOMPARE(_db.getLocalDiscoveryPaths(&ok), QStringList{"C"});
+
+        _db.setLocalDiscoveryPaths({});
+        QVERIFY(_db.getLocalDiscoveryPaths(&ok).isEmpty());
+    }
+
     void testFileRecordChecksum()
     {
         // Try with and without a checksum
@@ -150,6 +200,35 @@ private slots:
         QVERIFY(!wipedRecord._valid);
     }
 
+    void testDownloadInfoSegments()
+    {
+        using Info = SyncJournalDb::DownloadInfo;
+        Info record;
+        record._etag = "ABCDEF";
+        record._valid = true;
+        record._tmpfile = "/tmp/foo";
+        record._segments = {
+            { 0, 5368709119, 5368709120 },
+            { 5368709120, 10737418239, 1234 },
+            { 10737418240, 12884901887, 0 },
+        };
+        _db.setDownloadInfo("segmented", record);
+
+        Info storedRecord = _db.getDownloadInfo("segmented");
+        QVERIFY(storedRecord == record);
+        QVERIFY(storedRecord._segments[0].isComplete());
+        QVERIFY(!storedRecord._segments[1].isComplete());
+        QCOMPARE(storedRecord._segments[2].size(), 2147483648LL);
+
+        // back to a sequential download
+        record._segments.clear();
+        _db.setDownloadInfo("segmented", record);
+        storedRecord = _db.getDownloadInfo("segmented");
+        QVERIFY(storedRecord._segments.isEmpty());
+
+        _db.setDownloadInfo("segmented", Info());
+    }
+
     void testUploadInfo()
     {
         using Info = SyncJournalDb::UploadInfo;
@@ -167,6 +246,13 @@ private slots:
         Info storedRecord = _db.getUploadInfo("foo");
         QVERIFY(storedRecord == record);
 
+        // Chunks that completed out of order
+        record._chunks = {{1, 0, 1000, true}, {2, 1000, 1000, false}, {3, 2000, 500, true}};
+        _db.setUploadInfo("foo", record);
+        storedRecord = _db.getUploadInfo("foo");
+        QCOMPARE(storedRecord._chunks.size(), 3);
+        QVERIFY(storedRecord == record);
+
         _db.setUploadInfo("foo", Info());
         Info wipedRecord = _db.getUploadInfo("foo");
         QVERIFY(!wipedRecord._valid);
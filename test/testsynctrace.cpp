@@ -0,0 +1,128 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "common/synctrace.h"
+#include "syncenginetestutils.h"
+
+using namespace OCC;
+
+namespace {
+
+QJsonArray convert(const QByteArray &trace, bool *ok = nullptr)
+{
+    QBuffer traceBuffer;
+    traceBuffer.setData(trace);
+    traceBuffer.open(QIODevice::ReadOnly);
+    QBuffer jsonBuffer;
+    jsonBuffer.open(QIODevice::WriteOnly);
+    const auto converted = SyncTrace::convertToChromeTrace(&traceBuffer, &jsonBuffer);
+    if (ok) {
+        *ok = converted;
+    }
+    return QJsonDocument::fromJson(jsonBuffer.data()).object().value(QStringLiteral("traceEvents")).toArray();
+}
+
+QSet<QString> categories(const QJsonArray &events)
+{
+    QSet<QString> result;
+    for (const auto &event : events) {
+        const auto category = event.toObject().value(QStringLiteral("cat")).toString();
+        if (!category.isEmpty()) {
+            result.insert(category);
+        }
+    }
+    return result;
+}
+
+}
+
+class TestSyncTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDisabled()
+    {
+        QVERIFY(!SyncTrace::isEnabled());
+        // Nothing happens without a trace
+        SyncTrace::begin(SyncTrace::Category::Sync, "test");
+        SyncTrace::end(SyncTrace::Category::Sync, "test");
+    }
+
+    void testSyncRun()
+    {
+        QTemporaryDir dir;
+        const auto traceFile = dir.filePath(QStringLiteral("sync.trace"));
+
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        fakeFolder.localModifier().appendByte("A/a1");
+        fakeFolder.localModifier().insert("A/new");
+        fakeFolder.remoteModifier().appendByte("B/b1");
+
+        QVERIFY(SyncTrace::start(traceFile));
+        QVERIFY(SyncTrace::isEnabled());
+        QVERIFY(fakeFolder.syncOnce());
+        SyncTrace::stop();
+        QVERIFY(!SyncTrace::isEnabled());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        QFile file(traceFile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const auto trace = file.readAll();
+        bool ok = false;
+        const auto events = convert(trace, &ok);
+        QVERIFY(ok);
+
+        const auto seen = categories(events);
+        for (const auto category : {"sync", "discovery", "network", "propagation", "database"}) {
+            QVERIFY2(seen.contains(QString::fromLatin1(category)), category);
+        }
+
+        // Every async span ends, and the uploaded file got one
+        QHash<QString, int> openSpans;
+        auto uploadSeen = false;
+        for (const auto &value : events) {
+            const auto event = value.toObject();
+            const auto phase = event.value(QStringLiteral("ph")).toString();
+            const auto key = event.value(QStringLiteral("cat")).toString() + event.value(QStringLiteral("name")).toString()
+                + event.value(QStringLiteral("id")).toString();
+            if (phase == QLatin1String("b")) {
+                ++openSpans[key];
+                uploadSeen |= event.value(QStringLiteral("cat")).toString() == QLatin1String("propagation")
+                    && event.value(QStringLiteral("args")).toObject().value(QStringLiteral("detail")).toString() == QLatin1String("A/new");
+            } else if (phase == QLatin1String("e")) {
+                --openSpans[key];
+            }
+            if (phase != QLatin1String("M")) {
+                QVERIFY(event.value(QStringLiteral("ts")).toDouble() >= 0);
+                QVERIFY(event.value(QStringLiteral("tid")).toInt() > 0);
+            }
+        }
+        QVERIFY(uploadSeen);
+        for (auto it = openSpans.cbegin(); it != openSpans.cend(); ++it) {
+            QVERIFY2(it.value() == 0, qPrintable(it.key()));
+        }
+
+        // A trace cut short is converted up to the last complete event
+        const auto truncated = convert(trace.left(trace.size() - 3), &ok);
+        QVERIFY(ok);
+        QVERIFY(!truncated.isEmpty());
+        QVERIFY(truncated.size() < events.size());
+    }
+
+    void testNotATrace()
+    {
+        bool ok = true;
+        convert(QByteArrayLiteral("this is a log file, not a trace"), &ok);
+        QVERIFY(!ok);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncTrace)
+#include "testsynctrace.moc"
@@ -0,0 +1,84 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "touchedfiles.h"
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+class TestTouchedFiles : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testMaxAge()
+    {
+        TouchedFiles touchedFiles(3s);
+        touchedFiles.add("/sync/a", 1000ms);
+
+        QVERIFY(touchedFiles.contains("/sync/a", 1000ms));
+        QVERIFY(touchedFiles.contains("/sync/a", 4000ms));
+        QVERIFY(!touchedFiles.contains("/sync/a", 4001ms));
+        QVERIFY(!touchedFiles.contains("/sync/b", 1000ms));
+    }
+
+    void testTouchAgain()
+    {
+        TouchedFiles touchedFiles(3s);
+        touchedFiles.add("/sync/a", 1000ms);
+        touchedFiles.add("/sync/a", 1100ms); // same bucket
+        touchedFiles.add("/sync/a", 3500ms);
+
+        QVERIFY(touchedFiles.contains("/sync/a", 6500ms));
+        QVERIFY(!touchedFiles.contains("/sync/a", 6501ms));
+
+        // Expiring the bucket of the first touches keeps the path
+        touchedFiles.add("/sync/b", 6000ms);
+        QVERIFY(touchedFiles.contains("/sync/a", 6000ms));
+    }
+
+    void testExpiry()
+    {
+        TouchedFiles touchedFiles(3s);
+        for (int i = 0; i < 100; ++i) {
+            touchedFiles.add(QStringLiteral("/sync/file%1").arg(i), std::chrono::milliseconds(i * 10));
+        }
+        QCOMPARE(touchedFiles.size(), 100);
+
+        touchedFiles.add("/sync/late", 10000ms);
+        QCOMPARE(touchedFiles.size(), 1);
+        QVERIFY(touchedFiles.contains("/sync/late", 10000ms));
+
+        touchedFiles.clear();
+        QCOMPARE(touchedFiles.size(), 0);
+        QVERIFY(!touchedFiles.contains("/sync/late", 10000ms));
+    }
+
+    void testCleanPath_data()
+    {
+        QTest::addColumn<QString>("path");
+        QTest::newRow("clean") << "/sync/dir/a";
+        QTest::newRow("double slash") << "/sync//dir/a";
+        QTest::newRow("dot") << "/sync/./dir/a";
+        QTest::newRow("dot dot") << "/sync/other/../dir/a";
+        QTest::newRow("trailing slash") << "/sync/dir/a/";
+    }
+
+    void testCleanPath()
+    {
+        QFETCH(QString, path);
+        TouchedFiles touchedFiles(3s);
+        touchedFiles.add(path, 0ms);
+        QVERIFY(touchedFiles.contains("/sync/dir/a", 0ms));
+        QCOMPARE(touchedFiles.size(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestTouchedFiles)
+#include "testtouchedfiles.moc"
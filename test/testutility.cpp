@@ -5,9 +5,11 @@
 */
 
 #include <QtTest>
+#include <QStorageInfo>
 #include <QTemporaryDir>
 
 #include "common/utility.h"
+#include "common/filesystembase.h"
 #include "config.h"
 #include "logger.h"
 
@@ -201,6 +203,127 @@ private slots:
         dir.remove();
     }
 
+    void testCopyFile()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const auto source = dir.filePath("source");
+        const auto destination = dir.filePath("destination");
+
+        QByteArray content(3 * 1024 * 1024 + 17, 'A');
+        for (int i = 0; i < content.size(); i += 4096) {
+            content[i] = static_cast<char>(i % 251);
+        }
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::WriteOnly));
+            QCOMPARE(file.write(content), content.size());
+        }
+
+        // an existing destination is overwritten
+        {
+            QFile file(destination);
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("previous content that is longer than nothing");
+        }
+
+        QString error;
+        QVERIFY(OCC::FileSystem::copyFile(source, destination, &error));
+        QVERIFY(error.isEmpty());
+
+        QFile copied(destination);
+        QVERIFY(copied.open(QFile::ReadOnly));
+        QCOMPARE(copied.readAll(), content);
+
+        // the source is left untouched
+        QFile original(source);
+        QVERIFY(original.open(QFile::ReadOnly));
+        QCOMPARE(original.readAll(), content);
+
+        QVERIFY(!OCC::FileSystem::copyFile(dir.filePath("missing"), destination, &error));
+        QVERIFY(!error.isEmpty());
+    }
+
+    void testCopyFileKeepsModificationTime()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const auto source = dir.filePath("source");
+        const auto destination = dir.filePath("destination");
+        const auto modificationTime = QDateTime::currentDateTimeUtc().addDays(-3).addMSecs(-123);
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("content");
+            QVERIFY(file.setFileTime(modificationTime, QFileDevice::FileModificationTime));
+        }
+
+        QVERIFY(OCC::FileSystem::copyFile(source, destination));
+        QCOMPARE(QFileInfo(destination).lastModified().toSecsSinceEpoch(), modificationTime.toSecsSinceEpoch());
+    }
+
+    void testCopyFileFailureKeepsDestination()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const auto source = dir.filePath("source");
+        const auto destination = dir.filePath("destination");
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("content");
+        }
+        // a file can't replace a directory, so the copy fails after the data was written
+        QVERIFY(QDir(dir.path()).mkdir("destination"));
+        QVERIFY(QFile::copy(source, destination + "/inside"));
+
+        QString error;
+        QVERIFY(!OCC::FileSystem::copyFile(source, destination, &error));
+        QVERIFY(!error.isEmpty());
+        QVERIFY(QFileInfo(destination).isDir());
+        QVERIFY(QFileInfo::exists(destination + "/inside"));
+        // and the temporary file is gone
+        QCOMPARE(QDir(dir.path()).entryList(QDir::Files | QDir::Hidden), QStringList{"source"});
+    }
+
+    void testRenameReplaceAcrossDevices()
+    {
+#ifdef Q_OS_LINUX
+        // /dev/shm usually is a tmpfs, on another device than the temporary directory
+        QTemporaryDir sourceDir;
+        QTemporaryDir destinationDir(QStringLiteral("/dev/shm/testutility-XXXXXX"));
+        QVERIFY(sourceDir.isValid());
+        if (!destinationDir.isValid() || QStorageInfo(sourceDir.path()).device() == QStorageInfo(destinationDir.path()).device()) {
+            QSKIP("No second file system to rename across");
+        }
+        const auto source = sourceDir.filePath("source");
+        const auto destination = destinationDir.filePath("destination");
+        const auto modificationTime = QDateTime::currentDateTimeUtc().addDays(-3);
+        {
+            QFile file(source);
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("new content");
+            QVERIFY(file.setFileTime(modificationTime, QFileDevice::FileModificationTime));
+        }
+        {
+            QFile file(destination);
+            QVERIFY(file.open(QFile::WriteOnly));
+            file.write("previous content");
+        }
+
+        QString error;
+        QVERIFY(OCC::FileSystem::uncheckedRenameReplace(source, destination, &error));
+        QVERIFY(!QFileInfo::exists(source));
+        QFile renamed(destination);
+        QVERIFY(renamed.open(QFile::ReadOnly));
+        QCOMPARE(renamed.readAll(), QByteArray("new content"));
+        QCOMPARE(QFileInfo(destination).lastModified().toSecsSinceEpoch(), modificationTime.toSecsSinceEpoch());
+        QCOMPARE(QDir(destinationDir.path()).entryList(QDir::Files | QDir::Hidden), QStringList{"destination"});
+#else
+        QSKIP("Only Linux copies across devices itself");
+#endif
+    }
+
     void testSanitizeForFileName_data()
     {
         QTest::addColumn<QString>("input");